@@ -0,0 +1,70 @@
+#pragma once
+// Decimation helpers for oversampled ADC streams.
+//
+// Pure logic (no Arduino / IDF headers) so the filtering can be exercised on
+// the host with synthetic or recorded sample blocks.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+
+// Mean of one block after discarding the trimEach lowest and highest
+// samples. Sorts the block in place.
+inline uint16_t trimmedMean(uint16_t *samples, size_t n, size_t trimEach) {
+  if (n == 0) {
+    return 0;
+  }
+  if (trimEach * 2 >= n) {
+    trimEach = (n - 1) / 2;
+  }
+  std::sort(samples, samples + n);
+  uint32_t sum = 0;
+  for (size_t i = trimEach; i < n - trimEach; ++i) {
+    sum += samples[i];
+  }
+  const size_t kept = n - 2 * trimEach;
+  return static_cast<uint16_t>((sum + kept / 2) / kept);
+}
+
+// Running median over the last N decimated values; rejects single-block
+// spikes without the lag of a long moving average.
+template <size_t N>
+class MedianWindow {
+ public:
+  void push(uint16_t v) {
+    window_[next_] = v;
+    next_ = (next_ + 1) % N;
+    if (filled_ < N) {
+      filled_++;
+    }
+  }
+
+  uint16_t median() const {
+    if (filled_ == 0) {
+      return 0;
+    }
+    uint16_t tmp[N];
+    std::copy(window_, window_ + filled_, tmp);
+    std::nth_element(tmp, tmp + filled_ / 2, tmp + filled_);
+    return tmp[filled_ / 2];
+  }
+
+  size_t size() const { return filled_; }
+
+ private:
+  uint16_t window_[N] = {};
+  size_t next_ = 0;
+  size_t filled_ = 0;
+};
+
+// Two-point linear map from calibrated millivolts to percent x100,
+// clamped to [0, 10000]. emptyMv may be above fullMv for inverted probes.
+inline uint32_t millivoltsToCentiPercent(uint32_t mv, uint32_t emptyMv, uint32_t fullMv) {
+  if (emptyMv == fullMv) {
+    return 0;
+  }
+  const int32_t span = static_cast<int32_t>(fullMv) - static_cast<int32_t>(emptyMv);
+  const int32_t pos = static_cast<int32_t>(mv) - static_cast<int32_t>(emptyMv);
+  const int64_t scaled = static_cast<int64_t>(pos) * 10000 / span;
+  return static_cast<uint32_t>(std::min<int64_t>(10000, std::max<int64_t>(0, scaled)));
+}
@@ -0,0 +1,74 @@
+#pragma once
+// Device-side alarms: one latch per condition with hysteresis and hold-off
+// timers, reported as raise/clear transitions only.
+//
+// Pure logic (no Arduino headers). The firmware evaluates each condition
+// once per control cycle and publishes the latches whose state differs
+// from what was last delivered, so an event that happens while offline is
+// still sent once the broker is back (and a raise and clear that both
+// happened offline cancel out).
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum class AlarmType : uint8_t { TempHigh, TempLow, HumHigh, HumLow, SensorFailure, WaterLow, Count };
+
+inline const char *alarmTypeName(AlarmType type) {
+  static const char *const NAMES[] = {"temp_high", "temp_low", "hum_high", "hum_low", "sensor_failure", "water_low"};
+  return type < AlarmType::Count ? NAMES[static_cast<size_t>(type)] : "unknown";
+}
+
+enum class AlarmEvent : uint8_t { None, Raised, Cleared };
+
+class AlarmLatch {
+ public:
+  // beyond: the condition holds (counts toward raising). within: it is
+  // clearly gone, past any hysteresis (counts toward clearing). Neither
+  // (inside the hysteresis band) holds the state and restarts both timers.
+  AlarmEvent update(bool beyond, bool within, uint32_t nowMs, uint32_t raiseHoldMs, uint32_t clearHoldMs,
+                    float value = 0.0f, float limit = 0.0f) {
+    const bool toward = active_ ? within : beyond;
+    if (!toward) {
+      pending_ = false;
+      return AlarmEvent::None;
+    }
+    if (!pending_) {
+      pending_ = true;
+      sinceMs_ = nowMs;
+    }
+    if (nowMs - sinceMs_ < (active_ ? clearHoldMs : raiseHoldMs)) {
+      return AlarmEvent::None;
+    }
+    pending_ = false;
+    active_ = !active_;
+    value_ = value;
+    limit_ = limit;
+    return active_ ? AlarmEvent::Raised : AlarmEvent::Cleared;
+  }
+
+  // value > limit raises, value <= limit - hysteresis clears
+  AlarmEvent updateHigh(float value, float limit, float hysteresis, uint32_t nowMs, uint32_t raiseHoldMs,
+                        uint32_t clearHoldMs) {
+    return update(value > limit, value <= limit - hysteresis, nowMs, raiseHoldMs, clearHoldMs, value, limit);
+  }
+
+  // value < limit raises, value >= limit + hysteresis clears
+  AlarmEvent updateLow(float value, float limit, float hysteresis, uint32_t nowMs, uint32_t raiseHoldMs,
+                       uint32_t clearHoldMs) {
+    return update(value < limit, value >= limit + hysteresis, nowMs, raiseHoldMs, clearHoldMs, value, limit);
+  }
+
+  bool active() const { return active_; }
+  bool unreported() const { return active_ != reported_; }
+  void markReported() { reported_ = active_; }
+  float value() const { return value_; }  // at the last transition
+  float limit() const { return limit_; }
+
+ private:
+  bool active_ = false;
+  bool reported_ = false;
+  bool pending_ = false;
+  uint32_t sinceMs_ = 0;
+  float value_ = 0.0f;
+  float limit_ = 0.0f;
+};
@@ -0,0 +1,108 @@
+#pragma once
+// Minimal google-benchmark-style harness for the host firmware builds.
+//
+//   static void BM_thing(bench::State &state) {
+//     setup();                       // not timed
+//     for (auto _ : state) {
+//       bench::DoNotOptimize(thing());
+//     }
+//   }
+//   BENCHMARK(BM_thing);
+//
+// The runner (bench_main.cpp) repeats a benchmark with growing iteration
+// counts until one batch runs for the minimum time, then reports time and
+// heap calls (malloc/calloc/realloc, including operator new) per iteration
+// for that batch.
+
+#include <stdint.h>
+#include <time.h>
+
+namespace bench {
+
+// Heap calls and requested bytes since start (0 where not hooked)
+uint64_t heapCalls();
+uint64_t heapBytes();
+
+inline uint64_t nowNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+template <class T>
+inline void DoNotOptimize(const T &value) {
+  asm volatile("" : : "m"(value) : "memory");
+}
+
+inline void ClobberMemory() { asm volatile("" : : : "memory"); }
+
+class State {
+ public:
+  explicit State(uint64_t iterations) : iterations_(iterations) {}
+
+  struct __attribute__((unused)) Value {};
+
+  struct Iterator {
+    State *state;
+    uint64_t left;
+    bool operator!=(const Iterator &) {
+      if (left != 0) {
+        return true;
+      }
+      state->finish();
+      return false;
+    }
+    void operator++() { --left; }
+    Value operator*() const { return Value(); }
+  };
+
+  Iterator begin() {
+    resume();
+    return Iterator{this, iterations_};
+  }
+  Iterator end() { return Iterator{this, 0}; }
+
+  // Exclude per-iteration setup from time and heap counts
+  void PauseTiming() {
+    if (running_) {
+      accumulate();
+      running_ = false;
+    }
+  }
+  void ResumeTiming() { resume(); }
+
+  uint64_t iterations() const { return iterations_; }
+  uint64_t elapsedNs() const { return elapsedNs_; }
+  uint64_t heapCallCount() const { return heapCalls_; }
+  uint64_t heapByteCount() const { return heapBytes_; }
+
+ private:
+  void resume() {
+    running_ = true;
+    startCalls_ = heapCalls();
+    startBytes_ = heapBytes();
+    startNs_ = nowNs();
+  }
+  void accumulate() {
+    elapsedNs_ += nowNs() - startNs_;
+    heapCalls_ += heapCalls() - startCalls_;
+    heapBytes_ += heapBytes() - startBytes_;
+  }
+  void finish() { PauseTiming(); }
+
+  uint64_t iterations_;
+  bool running_ = false;
+  uint64_t startNs_ = 0;
+  uint64_t startCalls_ = 0;
+  uint64_t startBytes_ = 0;
+  uint64_t elapsedNs_ = 0;
+  uint64_t heapCalls_ = 0;
+  uint64_t heapBytes_ = 0;
+};
+
+typedef void (*BenchmarkFn)(State &);
+bool registerBenchmark(const char *name, BenchmarkFn fn);
+
+}  // namespace bench
+
+#define BENCHMARK(fn) static const bool fn##_registered_ = ::bench::registerBenchmark(#fn, fn)
@@ -0,0 +1,40 @@
+// Benchmarks for the BLE provisioning firmware
+// (bluetooth_provisioning_main.cpp), built for the relay controller board so
+// the water input is the digital float switch.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <PubSubClient.h>
+#include <ArduinoJson.h>
+#include <DHT.h>
+#include <BLEDevice.h>
+#include <Preferences.h>
+
+// main.cpp's setup()/loop() are linked in too (bench_controller.cpp); these
+// become weak so the two firmwares share one binary. Neither is called.
+void setup() __attribute__((weak));
+void loop() __attribute__((weak));
+#include "../bluetooth_provisioning_main.cpp"
+
+#include "bench.h"
+
+namespace {
+
+// What the app writes once the user picks a network
+const char *const CREDENTIALS = "{\"ssid\":\"Millo-Farm-2G\",\"password\":\"grow-room-42\"}";
+
+void BM_bleCredentialWrite(bench::State &state) {
+  if (pWifiCharacteristic == NULL) {
+    setupBLE();
+  }
+  BLECharacteristic *characteristic = pWifiCharacteristic;
+  characteristic->setValue(CREDENTIALS);
+  BLECharacteristicCallbacks *callbacks = characteristic->callbacks();
+  for (auto _ : state) {
+    callbacks->onWrite(characteristic);
+  }
+}
+BENCHMARK(BM_bleCredentialWrite);
+
+}  // namespace
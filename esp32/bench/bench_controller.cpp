@@ -0,0 +1,108 @@
+// Benchmarks for the controller firmware (main.cpp), compiled against the
+// host shims. Inputs match what a provisioned controller sees in the field.
+
+#include "../main.cpp"
+#include "bench.h"
+
+namespace {
+
+// Shape of a controller-thresholds response: one entry per sensor
+// arrangement, with the backend's bookkeeping fields left in.
+const char *const THRESHOLD_BODY =
+    "{\"success\":true,\"data\":["
+    "{\"id\":412,\"controller_id\":\"246F28000100\",\"arrangement\":2,\"sensor_name\":\"Temperature\","
+    "\"is_enabled\":true,\"min_threshold\":22.5,\"max_threshold\":26.5,\"sensor_min\":22,\"sensor_max\":27,"
+    "\"updated_at\":\"2025-05-02T09:14:11.000Z\"},"
+    "{\"id\":413,\"controller_id\":\"246F28000100\",\"arrangement\":0,\"sensor_name\":\"Humidity\","
+    "\"is_enabled\":true,\"min_threshold\":80,\"max_threshold\":84,\"sensor_min\":80,\"sensor_max\":83,"
+    "\"updated_at\":\"2025-05-02T09:14:11.000Z\"},"
+    "{\"id\":414,\"controller_id\":\"246F28000100\",\"arrangement\":1,\"sensor_name\":\"Water level\","
+    "\"is_enabled\":false,\"min_threshold\":null,\"max_threshold\":null,\"sensor_min\":0,\"sensor_max\":1,"
+    "\"updated_at\":\"2025-05-02T09:14:11.000Z\"}]}";
+
+void provisionedController() {
+  static bool done = false;
+  if (done) {
+    return;
+  }
+  done = true;
+  g_cfg.ssid = "Millo-Farm-2G";
+  g_cfg.password = "grow-room-42";
+  g_cfg.email = "grower@example.com";
+  g_cfg.controllerName = "Fruiting room B";
+  g_cfg.factoryName = "North unit";
+  g_cfg.registered = true;
+  g_controllerId = "24:6F:28:00:01:00";
+  g_controllerIdCompact = "246F28000100";
+  snprintf(topicBuf, sizeof(topicBuf), "topic/%s", g_controllerIdCompact.c_str());
+  for (size_t z = 0; z < ZONE_COUNT; ++z) {
+    g_zones[z].th = DEFAULT_THRESHOLDS;
+  }
+  mqtt.connect(g_controllerIdCompact.c_str(), "user", "pass");
+}
+
+void BM_publishArray(bench::State &state) {
+  provisionedController();
+  for (auto _ : state) {
+    publishArray(topicBuf, 25, 81, 0);
+  }
+}
+BENCHMARK(BM_publishArray);
+
+void BM_urlEncode_compactId(bench::State &state) {
+  provisionedController();
+  for (auto _ : state) {
+    String encoded = urlEncode(g_controllerIdCompact);
+    bench::DoNotOptimize(encoded);
+  }
+}
+BENCHMARK(BM_urlEncode_compactId);
+
+void BM_urlEncode_macId(bench::State &state) {
+  provisionedController();
+  for (auto _ : state) {
+    String encoded = urlEncode(g_controllerId);  // every ':' is escaped
+    bench::DoNotOptimize(encoded);
+  }
+}
+BENCHMARK(BM_urlEncode_macId);
+
+void BM_applyThresholdEntry(bench::State &state) {
+  provisionedController();
+  DynamicJsonDocument doc(4096);
+  deserializeJson(doc, THRESHOLD_BODY);
+  JsonArrayConst entries = doc["data"].as<JsonArrayConst>();
+  for (auto _ : state) {
+    for (JsonObjectConst entry : entries) {
+      applyThresholdEntry(entry);
+    }
+  }
+}
+BENCHMARK(BM_applyThresholdEntry);
+
+void BM_applyThresholdResponse(bench::State &state) {
+  provisionedController();
+  const String body(THRESHOLD_BODY);
+  for (auto _ : state) {
+    bench::DoNotOptimize(applyThresholdResponse(body));
+  }
+}
+BENCHMARK(BM_applyThresholdResponse);
+
+void BM_handleConfigGet(bench::State &state) {
+  provisionedController();
+  for (auto _ : state) {
+    handleConfigGet();
+  }
+}
+BENCHMARK(BM_handleConfigGet);
+
+void BM_deriveControllerId(bench::State &state) {
+  for (auto _ : state) {
+    String id = deriveControllerId();
+    bench::DoNotOptimize(id);
+  }
+}
+BENCHMARK(BM_deriveControllerId);
+
+}  // namespace
@@ -0,0 +1,229 @@
+// Host microbenchmarks for the firmware's per-tick and per-request functions.
+//
+// bench_controller.cpp and bench_ble.cpp each compile one firmware file
+// against the shims in replay/hal and register benchmarks with bench.h.
+// This file runs them and compares the results with a baseline:
+//
+//   name   ns/op   allocs/op   bytes/op   [vs baseline]
+//
+// Heap calls are counted by wrapping glibc's malloc family, so they include
+// every operator new and ArduinoJson pool. The shim String is a std::string,
+// which has a small-string buffer like the ESP32 core's String, so the counts
+// follow the device closely but are not identical.
+//
+// A regression is time above the baseline by more than --tolerance, or any
+// extra heap call. Time only compares on the machine that recorded the
+// baseline; heap counts compare anywhere. The exit code is 1 on a
+// regression.
+//
+// usage: bench [--filter text] [--min-time s] [--baseline file] [--save-baseline file] [--tolerance f]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "bench.h"
+
+HardwareSerial Serial;
+WiFiClass WiFi;
+EspClass ESP;
+
+namespace {
+
+uint64_t g_heapCalls = 0;
+uint64_t g_heapBytes = 0;
+
+struct Registered {
+  const char *name;
+  bench::BenchmarkFn fn;
+};
+
+std::vector<Registered> &registry() {
+  static std::vector<Registered> benchmarks;
+  return benchmarks;
+}
+
+struct Result {
+  double nsPerOp;
+  double allocsPerOp;
+  double bytesPerOp;
+  uint64_t iterations;
+};
+
+Result run(bench::BenchmarkFn fn, double minSeconds) {
+  const uint64_t minNs = static_cast<uint64_t>(minSeconds * 1e9);
+  uint64_t iterations = 1;
+  for (;;) {
+    bench::State state(iterations);
+    fn(state);
+    const uint64_t ns = state.elapsedNs() ? state.elapsedNs() : 1;
+    if (ns >= minNs || iterations >= 1000000000ULL) {
+      Result r;
+      r.iterations = iterations;
+      r.nsPerOp = static_cast<double>(ns) / iterations;
+      r.allocsPerOp = static_cast<double>(state.heapCallCount()) / iterations;
+      r.bytesPerOp = static_cast<double>(state.heapByteCount()) / iterations;
+      return r;
+    }
+    // Aim 40% past the target, growing at most 10x per round
+    double next = iterations * (minNs * 1.4 / ns);
+    if (next > iterations * 10.0) {
+      next = iterations * 10.0;
+    }
+    iterations = next > iterations ? static_cast<uint64_t>(next) : iterations + 1;
+  }
+}
+
+typedef std::map<std::string, Result> Baseline;
+
+bool loadBaseline(const char *path, Baseline &out) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    char name[128];
+    Result r = {};
+    if (line[0] != '#' && sscanf(line, "%127s %lf %lf %lf", name, &r.nsPerOp, &r.allocsPerOp, &r.bytesPerOp) == 4) {
+      out[name] = r;
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+bool saveBaseline(const char *path, const std::vector<std::pair<std::string, Result> > &results) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    return false;
+  }
+  fprintf(f, "# bench baseline: name ns_per_op allocs_per_op bytes_per_op\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result &r = results[i].second;
+    fprintf(f, "%s %.1f %.2f %.1f\n", results[i].first.c_str(), r.nsPerOp, r.allocsPerOp, r.bytesPerOp);
+  }
+  fclose(f);
+  return true;
+}
+
+}  // namespace
+
+namespace bench {
+
+uint64_t heapCalls() { return g_heapCalls; }
+uint64_t heapBytes() { return g_heapBytes; }
+
+bool registerBenchmark(const char *name, BenchmarkFn fn) {
+  registry().push_back(Registered{name, fn});
+  return true;
+}
+
+}  // namespace bench
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t n);
+void *__libc_calloc(size_t count, size_t n);
+void *__libc_realloc(void *p, size_t n);
+void __libc_free(void *p);
+
+void *malloc(size_t n) {
+  g_heapCalls++;
+  g_heapBytes += n;
+  return __libc_malloc(n);
+}
+void *calloc(size_t count, size_t n) {
+  g_heapCalls++;
+  g_heapBytes += count * n;
+  return __libc_calloc(count, n);
+}
+void *realloc(void *p, size_t n) {
+  g_heapCalls++;
+  g_heapBytes += n;
+  return __libc_realloc(p, n);
+}
+void free(void *p) { __libc_free(p); }
+}
+#endif
+
+int main(int argc, char **argv) {
+  const char *filter = nullptr;
+  const char *baselinePath = nullptr;
+  const char *savePath = nullptr;
+  double minSeconds = 0.2;
+  double tolerance = 0.5;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+      filter = argv[++i];
+    } else if (!strcmp(argv[i], "--min-time") && i + 1 < argc) {
+      minSeconds = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) {
+      baselinePath = argv[++i];
+    } else if (!strcmp(argv[i], "--save-baseline") && i + 1 < argc) {
+      savePath = argv[++i];
+    } else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc) {
+      tolerance = atof(argv[++i]);
+    } else {
+      fprintf(stderr,
+              "usage: %s [--filter text] [--min-time s] [--baseline file] [--save-baseline file] "
+              "[--tolerance f]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  Baseline baseline;
+  if (baselinePath && !loadBaseline(baselinePath, baseline)) {
+    fprintf(stderr, "cannot read baseline %s\n", baselinePath);
+    return 2;
+  }
+
+  printf("%-32s %12s %12s %10s %10s  %s\n", "benchmark", "ns/op", "iterations", "allocs/op", "bytes/op",
+         baselinePath ? "vs baseline" : "");
+  std::vector<std::pair<std::string, Result> > results;
+  int regressions = 0;
+  for (size_t i = 0; i < registry().size(); ++i) {
+    const Registered &b = registry()[i];
+    if (filter && !strstr(b.name, filter)) {
+      continue;
+    }
+    const Result r = run(b.fn, minSeconds);
+    results.push_back(std::make_pair(std::string(b.name), r));
+    char verdict[96] = "";
+    if (baselinePath) {
+      Baseline::const_iterator it = baseline.find(b.name);
+      if (it == baseline.end()) {
+        snprintf(verdict, sizeof(verdict), "new");
+      } else {
+        const Result &base = it->second;
+        const double change = base.nsPerOp > 0.0 ? (r.nsPerOp / base.nsPerOp - 1.0) * 100.0 : 0.0;
+        const bool slower = r.nsPerOp > base.nsPerOp * (1.0 + tolerance);
+        const bool moreAllocs = r.allocsPerOp > base.allocsPerOp + 0.005;
+        snprintf(verdict, sizeof(verdict), "%+.0f%% time, %+.2f allocs%s", change, r.allocsPerOp - base.allocsPerOp,
+                 (slower || moreAllocs) ? "  REGRESSION" : "");
+        regressions += (slower || moreAllocs) ? 1 : 0;
+      }
+    }
+    printf("%-32s %12.1f %12llu %10.2f %10.1f  %s\n", b.name, r.nsPerOp, static_cast<unsigned long long>(r.iterations),
+           r.allocsPerOp, r.bytesPerOp, verdict);
+  }
+
+  if (savePath) {
+    if (!saveBaseline(savePath, results)) {
+      fprintf(stderr, "cannot write baseline %s\n", savePath);
+      return 2;
+    }
+    printf("baseline written to %s\n", savePath);
+  }
+  if (regressions) {
+    printf("%d regression(s)\n", regressions);
+    return 1;
+  }
+  return 0;
+}
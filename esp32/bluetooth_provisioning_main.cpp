@@ -8,6 +8,7 @@
  * 4. Sensor data publishing to device-specific MQTT topics
  * 
  * Hardware: ESP32 DevKit, DHT22, LDR, Moisture Sensor
+ * Pin map comes from board_profile.h (MILLO_BOARD_*, set per PlatformIO env)
  * 
  * Author: MAB System
  * Date: 2025
@@ -22,29 +23,46 @@
 #include <BLEServer.h>
 #include <BLEUtils.h>
 #include <BLE2902.h>
-#include <NTPClient.h>
-#include <WiFiUdp.h>
+#include "time_service.h"
+#include <Preferences.h>
+#include <esp_bt.h>
+
+// Built outside PlatformIO: default to the wiring this firmware was written for
+#if !defined(MILLO_BOARD_CONTROLLER_V1) && !defined(MILLO_BOARD_BLE_KIT)
+#define MILLO_BOARD_BLE_KIT
+#endif
+#include "board_profile.h"
+
+#if MILLO_WATER_ANALOG
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+#include <atomic>
+#include "adc_decimator.h"
+#endif
+#include "pattern_player.h"
 
 // ============================================================================
 // BLE UUIDs (must match Flutter app)
 // ============================================================================
 #define SERVICE_UUID        "4fafc201-1fb5-459e-8fcc-c5c9c331914b"
 #define WIFI_CHAR_UUID      "beb5483e-36e1-4688-b7f5-ea07361b26a8"
+#define STATUS_CHAR_UUID    "beb5483f-36e1-4688-b7f5-ea07361b26a8"  // provisioning progress (notify)
+#define BLE_LOCAL_MTU       517  // lets a full config JSON arrive in one write
 
 // ============================================================================
-// Hardware Pin Definitions
+// Hardware Pin Definitions (see board_profile.h)
 // ============================================================================
-#define DHT_PIN 4
+#define DHT_PIN board::DHT_PIN
 #define DHT_TYPE DHT22
-#define WATER_LEVEL_PIN 35  // GPIO 35 (ADC1_CH7) - Water level sensor S pin
-#define LED_PIN 2
+#define WATER_LEVEL_PIN board::WATER_PIN  // analog probe S pin, or float switch
+#define LED_PIN board::STATUS_LED_PIN
 
 // Actuator control pins
-#define HUMIDIFIER1_PIN 25  // GPIO 25 - Humidifier 1 relay
-#define HUMIDIFIER2_PIN 26  // GPIO 26 - Humidifier 2 relay
-#define FAN1_PIN 27         // GPIO 27 - Fan 1 relay
-#define FAN2_PIN 14         // GPIO 14 - Fan 2 relay
-#define BUZZER_PIN 33       // GPIO 33 - Buzzer for alarm
+#define HUMIDIFIER1_PIN board::HUMIDIFIER1_PIN
+#define HUMIDIFIER2_PIN board::HUMIDIFIER2_PIN
+#define FAN1_PIN board::FAN1_PIN
+#define FAN2_PIN board::FAN2_PIN
+#define BUZZER_PIN board::BUZZER_PIN
 
 // ============================================================================
 // MQTT Configuration - Secure connection to private broker
@@ -55,6 +73,14 @@ const char* mqtt_username = "zhangyifei";
 const char* mqtt_password = "123456";
 const char* registration_topic = "system/devices/register";
 
+// Telemetry: one snapshot message per interval on devices/<id>/snapshot.
+// The per-sensor topics (+ actuators/status) are still published for app
+// versions that have not moved to the snapshot; set to 0 (or build with
+// -DPUBLISH_LEGACY_SENSOR_TOPICS=0) to drop them.
+#ifndef PUBLISH_LEGACY_SENSOR_TOPICS
+#define PUBLISH_LEGACY_SENSOR_TOPICS 1
+#endif
+
 // ============================================================================
 // Global Variables
 // ============================================================================
@@ -64,21 +90,58 @@ String deviceMacAddress = "";
 String deviceId = "";  // Will be MAC without colons
 String deviceName = "";  // Will be "ESP32_XXXXXX"
 
-bool wifiCredentialsReceived = false;
+volatile bool wifiCredentialsReceived = false;
 bool wifiConnected = false;
 bool mqttConnected = false;
 bool deviceRegistered = false;
 
+// Provisioning runs as a state machine stepped from loop(); every transition
+// is notified to the phone on the status characteristic.
+enum ProvisionState {
+  PROV_WAITING,         // advertising, no credentials yet
+  PROV_ASSOCIATING,     // WiFi.begin() issued
+  PROV_TIME_SYNC,       // IP acquired, waiting for SNTP
+  PROV_MQTT_CONNECTING,
+  PROV_REGISTERING,
+  PROV_BLE_SHUTDOWN,    // registered, letting the last notification go out
+  PROV_COMPLETE
+};
+ProvisionState provState = PROV_WAITING;
+unsigned long provStateSince = 0;
+unsigned long provStartedAt = 0;
+unsigned long nextMqttAttemptAt = 0;
+int mqttAttempts = 0;
+const unsigned long WIFI_ASSOC_TIMEOUT_MS = 20000;
+const unsigned long TIME_SYNC_TIMEOUT_MS = 5000;
+const unsigned long MQTT_RETRY_MS = 2000;
+const unsigned long BLE_SHUTDOWN_DELAY_MS = 1000;
+const unsigned long WIFI_RETRY_STORED_MS = 30000;  // retry interval when booted from stored credentials
+
 DHT dht(DHT_PIN, DHT_TYPE);
 WiFiClientSecure espClient;  // Use WiFiClientSecure for TLS connection
 PubSubClient mqttClient(espClient);
 
-// NTP Client setup
-WiFiUDP ntpUDP;
-NTPClient timeClient(ntpUDP, "pool.ntp.org", 0, 60000); // UTC, update every 60 seconds
+// Status LED patterns (played from an esp_timer, never block loop())
+PatternPlayer statusLed(LED_PIN);
+
+// SNTP-backed millis() -> epoch mapping
+TimeService timeService;
+const TonePattern LED_WIFI_CONNECTING = {0, 500, 500, 0, 1};   // slow blink until stopped
+const TonePattern LED_CREDENTIALS_OK  = {0, 200, 200, 3, 2};   // 3 blinks
+const TonePattern LED_REGISTERED      = {0, 100, 100, 5, 3};   // 5 rapid blinks
 
 BLEServer* pServer = NULL;
 BLECharacteristic* pWifiCharacteristic = NULL;
+BLECharacteristic* pStatusCharacteristic = NULL;
+bool bleActive = false;
+
+// Stored credentials + reboot-into-BLE flag. Once provisioning completes the
+// BT controller memory is released for good, so BLE can only come back via
+// a reboot with "reprov" set. "reprov_nonce" is the last remote request acted
+// on, so a retained copy delivered again after the reboot is not.
+Preferences provPrefs;
+const char* PROV_PREFS_NAMESPACE = "ble_prov";
+const size_t REPROVISION_NONCE_MAX = 32;
 bool deviceConnected = false;
 
 // Actuator states
@@ -91,21 +154,107 @@ bool buzzerState = false;
 // Cultivation mode
 enum CultivationMode { NORMAL, PINNING };
 CultivationMode currentMode = NORMAL;
+unsigned long pinningEndsAt = 0;  // millis() deadline while PINNING
+
+// Per-mode targets (docs/MODE_CONTROL_IMPLEMENTATION.md)
+struct ModeThresholds {
+  float humMin;
+  float humMax;
+  float tempMin;
+  float tempMax;
+};
+const ModeThresholds NORMAL_THRESHOLDS  = {80.0f, 85.0f, 25.0f, 30.0f};
+const ModeThresholds PINNING_THRESHOLDS = {90.0f, 95.0f, 18.0f, 22.0f};
+const unsigned long PINNING_MAX_SECONDS = 24UL * 3600UL;
+
+// Latest readings used by the control loop (NAN until the first good read)
+float lastTemperature = NAN;
+float lastHumidity = NAN;
+
+// Mode command bookkeeping: every command is acked on devices/<id>/mode/ack
+// with its sequence ID and the command-to-relay latency.
+uint32_t commandSeq = 0;
+uint32_t commandCount = 0;
+uint32_t commandRelayUsMax = 0;
+uint64_t commandRelayUsTotal = 0;
+char ackBuf[160];
+
+#if MILLO_WATER_ANALOG
+// Water level ADC: continuous DMA sampling decimated by a background task.
+// readWaterLevel() only loads the latest filtered value.
+const uint32_t WATER_ADC_SAMPLE_HZ = 20000;      // lowest rate the ESP32 DMA controller supports
+const uint32_t WATER_ADC_FRAME_SAMPLES = 256;    // one DMA frame -> one decimated value (~78 Hz)
+const uint32_t WATER_LEVEL_EMPTY_MV = 0;         // probe output when dry
+const uint32_t WATER_LEVEL_FULL_MV = 3100;       // probe output fully submerged
+esp_adc_cal_characteristics_t waterAdcChars;
+std::atomic<uint32_t> waterLevelCentiPct{0};     // percent x100
+std::atomic<bool> waterAdcReady{false};
+#endif
 
-// Timing
-unsigned long lastSensorPublish = 0;
+// Timing: sensors are read and relays driven on this period in every
+// provisioning state; the publish only follows once provisioning is done
+unsigned long lastSensorRead = 0;
 const unsigned long sensorInterval = 5000;  // 5 seconds
 
+// Topics are built once in buildDeviceTopics(); payloads reuse one buffer
+char topicSnapshot[64];
+char topicTemperature[64];
+char topicHumidity[64];
+char topicWaterLevel[64];
+char topicActuators[64];
+char topicModeSet[64];
+char topicModeSetCompact[64];
+char topicModeAck[64];
+char topicModeStatus[64];
+char topicReprovision[64];
+char topicReprovisionAck[64];
+char publishBuf[320];
+
+// Offline telemetry ring, allocated from the heap the BT stack gives back.
+// Snapshots taken while MQTT is down are replayed (oldest first) on reconnect.
+struct SnapshotRecord {
+  uint32_t acquiredMs;  // millis() at read; resolved to epoch when sent
+  float temperature;
+  float humidity;
+  float waterLevel;
+  uint8_t actuators;  // bit0 H1, bit1 H2, bit2 F1, bit3 F2, bit4 buzzer
+  uint8_t mode;
+};
+const size_t OFFLINE_RING_MAX_BYTES = 24 * 1024;
+const size_t OFFLINE_FLUSH_PER_CYCLE = 10;
+SnapshotRecord* offlineRing = NULL;
+size_t offlineCapacity = 0;
+size_t offlineHead = 0;   // oldest record
+size_t offlineCount = 0;
+
+// Publish cost accounting, logged every PUBLISH_STATS_EVERY cycles
+const uint32_t PUBLISH_STATS_EVERY = 60;
+uint32_t publishCycles = 0;
+uint32_t publishMessages = 0;
+uint32_t publishMicros = 0;
+
 // ============================================================================
 // Function Forward Declarations
 // ============================================================================
 void setupBLE();
-void connectWiFi();
-void connectMQTT();
-void registerDevice();
-void publishSensorData();
-void publishSensorValue(String sensorType, float value, unsigned long timestamp);
+void notifyProvisionStatus(const char* status, const char* detail = NULL);
+void serviceProvisioning();
+bool connectMQTT();
+bool registerDevice();
+bool readSensors(SnapshotRecord& record);
+void publishSensorData(const SnapshotRecord& record);
+bool publishSensorValue(const char* topic, float value, unsigned long timestamp);
+void buildDeviceTopics();
+void mqttCallback(char* topic, byte* payload, unsigned int length);
+bool applyControl();
+void checkPinningTimer();
+void publishModeStatus();
 float readWaterLevel();
+void setupWaterAdc();
+bool loadStoredCredentials();
+void requestReprovision(const char* reason, const char* nonce = NULL);
+void handleReprovisionRequest(const byte* payload, unsigned int length);
+void releaseBluetoothMemory();
 
 // ============================================================================
 // BLE Callback Classes
@@ -114,16 +263,16 @@ class ServerCallbacks: public BLEServerCallbacks {
     void onConnect(BLEServer* pServer) {
       deviceConnected = true;
       Serial.println("📱 BLE Client connected");
-      digitalWrite(LED_PIN, HIGH);
+      statusLed.setIdle(true);
     };
 
     void onDisconnect(BLEServer* pServer) {
       deviceConnected = false;
       Serial.println("📱 BLE Client disconnected");
-      digitalWrite(LED_PIN, LOW);
+      statusLed.setIdle(false);
       
       // Restart advertising for new connections
-      if (!wifiCredentialsReceived) {
+      if (provState == PROV_WAITING) {
         BLEDevice::startAdvertising();
         Serial.println("🔵 BLE Advertising restarted");
       }
@@ -137,13 +286,19 @@ class WiFiCharacteristicCallbacks: public BLECharacteristicCallbacks {
       if (value.length() > 0) {
         Serial.println("📩 Received WiFi credentials");
         
+        if (provState != PROV_WAITING) {
+          notifyProvisionStatus("busy");
+          return;
+        }
+        
         // Parse JSON
-        StaticJsonDocument<256> doc;
+        StaticJsonDocument<512> doc;
         DeserializationError error = deserializeJson(doc, value.c_str());
         
-        if (error) {
+        if (error || !doc["ssid"].is<const char*>()) {
           Serial.print("❌ JSON parse failed: ");
           Serial.println(error.c_str());
+          notifyProvisionStatus("failed", "bad_credentials");
           return;
         }
         
@@ -155,14 +310,10 @@ class WiFiCharacteristicCallbacks: public BLECharacteristicCallbacks {
         Serial.println("   Password: ********");
         
         wifiCredentialsReceived = true;
+        notifyProvisionStatus("credentials_parsed");
         
         // Blink LED to indicate success
-        for (int i = 0; i < 3; i++) {
-          digitalWrite(LED_PIN, HIGH);
-          delay(200);
-          digitalWrite(LED_PIN, LOW);
-          delay(200);
-        }
+        statusLed.play(LED_CREDENTIALS_OK);
       }
     }
 };
@@ -180,8 +331,7 @@ void setup() {
   Serial.println("===============================================");
   
   // Initialize LED
-  pinMode(LED_PIN, OUTPUT);
-  digitalWrite(LED_PIN, LOW);
+  statusLed.begin(false);
   
   // Initialize actuator pins as outputs
   pinMode(HUMIDIFIER1_PIN, OUTPUT);
@@ -201,6 +351,7 @@ void setup() {
   // Initialize sensors
   dht.begin();
   Serial.println("✅ DHT22 sensor initialized");
+  setupWaterAdc();
   
   // Get MAC address
   deviceMacAddress = WiFi.macAddress();
@@ -219,8 +370,16 @@ void setup() {
   deviceName = "ESP32_" + macLast6;
   Serial.print("📛 Device Name: ");
   Serial.println(deviceName);
+  buildDeviceTopics();
   
-  // Initialize BLE
+  // Stored credentials skip BLE entirely; otherwise advertise for provisioning
+  if (loadStoredCredentials()) {
+    wifiCredentialsReceived = true;
+    releaseBluetoothMemory();
+    Serial.println("✅ Setup complete - joining stored WiFi");
+    Serial.println("===============================================\n");
+    return;
+  }
   setupBLE();
   
   Serial.println("✅ Setup complete - waiting for WiFi credentials via BLE");
@@ -232,6 +391,8 @@ void setupBLE() {
   
   // Create BLE Device
   BLEDevice::init(deviceName.c_str());
+  BLEDevice::setMTU(BLE_LOCAL_MTU);
+  bleActive = true;
   
   // Create BLE Server
   pServer = BLEDevice::createServer();
@@ -250,6 +411,15 @@ void setupBLE() {
   pWifiCharacteristic->setCallbacks(new WiFiCharacteristicCallbacks());
   pWifiCharacteristic->addDescriptor(new BLE2902());
   
+  // Create provisioning status characteristic
+  pStatusCharacteristic = pService->createCharacteristic(
+                            STATUS_CHAR_UUID,
+                            BLECharacteristic::PROPERTY_READ |
+                            BLECharacteristic::PROPERTY_NOTIFY
+                          );
+  pStatusCharacteristic->addDescriptor(new BLE2902());
+  pStatusCharacteristic->setValue("{\"status\":\"waiting\"}");
+  
   // Start the service
   pService->start();
   
@@ -269,85 +439,238 @@ void setupBLE() {
 // ============================================================================
 // WiFi Functions
 // ============================================================================
-void connectWiFi() {
-  if (wifiSSID.length() == 0) {
-    return;
+// Publish progress as {"status":..., "detail":..., "elapsed_ms":...}
+void notifyProvisionStatus(const char* status, const char* detail) {
+  char buf[128];
+  const unsigned long elapsed = provStartedAt ? millis() - provStartedAt : 0;
+  if (detail) {
+    snprintf(buf, sizeof(buf), "{\"status\":\"%s\",\"detail\":\"%s\",\"elapsed_ms\":%lu}", status, detail, elapsed);
+  } else {
+    snprintf(buf, sizeof(buf), "{\"status\":\"%s\",\"elapsed_ms\":%lu}", status, elapsed);
   }
+  Serial.print("📶 Provisioning: ");
+  Serial.println(buf);
   
-  Serial.println("\n📡 Connecting to WiFi...");
-  Serial.print("   SSID: ");
-  Serial.println(wifiSSID);
+  if (pStatusCharacteristic == NULL) return;
+  pStatusCharacteristic->setValue(buf);
+  if (deviceConnected) {
+    pStatusCharacteristic->notify();
+  }
+}
+
+void setProvisionState(ProvisionState next) {
+  provState = next;
+  provStateSince = millis();
+}
+
+void failProvisioning(const char* reason) {
+  Serial.println("\n❌ Provisioning failed - please check credentials and try again");
+  statusLed.stop(LED_WIFI_CONNECTING.priority);
+  WiFi.disconnect(true);
+  notifyProvisionStatus("failed", reason);
   
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(wifiSSID.c_str(), wifiPassword.c_str());
+  wifiConnected = false;
+  setProvisionState(PROV_WAITING);
   
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 40) {  // 20 seconds timeout
-    delay(500);
-    Serial.print(".");
-    attempts++;
-    
-    // Blink LED while connecting
-    digitalWrite(LED_PIN, !digitalRead(LED_PIN));
+  if (!bleActive) {
+    // Booted from stored credentials: keep them and retry (network may just be down)
+    provStateSince = millis();
+    return;
   }
   
-  if (WiFi.status() == WL_CONNECTED) {
-    wifiConnected = true;
-    digitalWrite(LED_PIN, HIGH);
-    
-    Serial.println("\n✅ WiFi connected!");
-    Serial.print("   IP Address: ");
-    Serial.println(WiFi.localIP());
-    Serial.print("   Signal Strength: ");
-    Serial.print(WiFi.RSSI());
-    Serial.println(" dBm");
-    
-    // Initialize NTP client for real timestamps
-    timeClient.begin();
-    Serial.print("⏰ Synchronizing time with NTP server...");
-    int retries = 0;
-    while (!timeClient.update() && retries < 10) {
-      timeClient.forceUpdate();
-      delay(1000);
-      Serial.print(".");
-      retries++;
-    }
-    if (retries < 10) {
-      Serial.println(" success!");
-      Serial.print("   Current time: ");
-      Serial.println(timeClient.getFormattedTime());
-      Serial.print("   Epoch time: ");
-      Serial.println(timeClient.getEpochTime());
-    } else {
-      Serial.println(" failed! Using fallback");
-    }
-    
-    // Stop BLE to free resources
-    BLEDevice::deinit(false);
-    Serial.println("🔵 BLE stopped (resources freed)");
-    
-  } else {
-    Serial.println("\n❌ WiFi connection failed!");
-    Serial.println("   Please check credentials and try again");
-    
-    // Reset to receive new credentials
-    wifiCredentialsReceived = false;
+  // Reset to receive new credentials
+  wifiCredentialsReceived = false;
+  wifiSSID = "";
+  wifiPassword = "";
+  if (!deviceConnected) {
+    BLEDevice::startAdvertising();
+  }
+}
+
+bool loadStoredCredentials() {
+  if (!provPrefs.begin(PROV_PREFS_NAMESPACE, false)) return false;
+  const bool reprovision = provPrefs.getBool("reprov", false);
+  if (reprovision) {
+    provPrefs.remove("reprov");
+  }
+  wifiSSID = provPrefs.getString("ssid", "");
+  wifiPassword = provPrefs.getString("pass", "");
+  provPrefs.end();
+  
+  if (reprovision) {
+    Serial.println("🔁 Re-provisioning requested - starting BLE");
     wifiSSID = "";
     wifiPassword = "";
+    return false;
+  }
+  return wifiSSID.length() > 0;
+}
+
+void storeCredentials() {
+  if (!provPrefs.begin(PROV_PREFS_NAMESPACE, false)) return;
+  provPrefs.putString("ssid", wifiSSID);
+  provPrefs.putString("pass", wifiPassword);
+  provPrefs.end();
+}
+
+void requestReprovision(const char* reason, const char* nonce) {
+  Serial.print("🔁 Rebooting into BLE provisioning: ");
+  Serial.println(reason);
+  if (provPrefs.begin(PROV_PREFS_NAMESPACE, false)) {
+    provPrefs.putBool("reprov", true);
+    if (nonce) provPrefs.putString("reprov_nonce", nonce);
+    provPrefs.end();
+  }
+  delay(200);
+  ESP.restart();
+}
+
+void allocateOfflineRing(size_t reclaimedBytes) {
+  if (offlineRing != NULL) return;
+  size_t bytes = reclaimedBytes < OFFLINE_RING_MAX_BYTES ? reclaimedBytes : OFFLINE_RING_MAX_BYTES;
+  offlineCapacity = bytes / sizeof(SnapshotRecord);
+  if (offlineCapacity == 0) return;
+  offlineRing = (SnapshotRecord*)malloc(offlineCapacity * sizeof(SnapshotRecord));
+  if (offlineRing == NULL) {
+    offlineCapacity = 0;
+    return;
+  }
+  Serial.printf("💾 Offline ring: %u snapshots (%u bytes)\n",
+                (unsigned)offlineCapacity, (unsigned)(offlineCapacity * sizeof(SnapshotRecord)));
+}
+
+// Give the BT controller + Bluedroid memory back to the heap permanently.
+// After this BLE cannot be restarted until the next boot.
+void releaseBluetoothMemory() {
+  const uint32_t heapBefore = ESP.getFreeHeap();
+  const uint32_t blockBefore = ESP.getMaxAllocHeap();
+  if (bleActive) {
+    BLEDevice::deinit(true);  // true = also release BT memory
+    bleActive = false;
+    pStatusCharacteristic = NULL;
+    deviceConnected = false;
+  } else {
+    esp_bt_mem_release(ESP_BT_MODE_BTDM);
+  }
+  const uint32_t heapAfter = ESP.getFreeHeap();
+  Serial.printf("🔵 BT memory released: free heap %u -> %u (+%u), largest block %u -> %u\n",
+                heapBefore, heapAfter, heapAfter - heapBefore, blockBefore, ESP.getMaxAllocHeap());
+  allocateOfflineRing(heapAfter > heapBefore ? heapAfter - heapBefore : 0);
+}
+
+// One non-blocking step of the provisioning flow; also keeps MQTT up afterwards
+void serviceProvisioning() {
+  const unsigned long now = millis();
+  
+  switch (provState) {
+    case PROV_WAITING:
+      if (!wifiCredentialsReceived) return;
+      if (!bleActive && provStartedAt != 0 && now - provStateSince < WIFI_RETRY_STORED_MS) return;
+      provStartedAt = now;
+      Serial.println("\n📡 Connecting to WiFi...");
+      Serial.print("   SSID: ");
+      Serial.println(wifiSSID);
+      WiFi.mode(WIFI_STA);
+      WiFi.begin(wifiSSID.c_str(), wifiPassword.c_str());
+      statusLed.play(LED_WIFI_CONNECTING);  // Blink LED while connecting
+      setProvisionState(PROV_ASSOCIATING);
+      notifyProvisionStatus("associating");
+      return;
+      
+    case PROV_ASSOCIATING:
+      if (WiFi.status() != WL_CONNECTED) {
+        if (now - provStateSince >= WIFI_ASSOC_TIMEOUT_MS) {
+          failProvisioning("wifi_timeout");
+        }
+        return;
+      }
+      wifiConnected = true;
+      statusLed.stop(LED_WIFI_CONNECTING.priority);
+      statusLed.setIdle(true);
+      Serial.println("\n✅ WiFi connected!");
+      Serial.print("   IP Address: ");
+      Serial.println(WiFi.localIP());
+      Serial.print("   Signal Strength: ");
+      Serial.print(WiFi.RSSI());
+      Serial.println(" dBm");
+      notifyProvisionStatus("ip_acquired", WiFi.localIP().toString().c_str());
+      
+      // lwIP SNTP runs in the background; no blocking forceUpdate() loop
+      timeService.begin("pool.ntp.org", "time.google.com");
+      setProvisionState(PROV_TIME_SYNC);
+      return;
+      
+    case PROV_TIME_SYNC:
+      if (timeService.synced()) {
+        notifyProvisionStatus("time_synced");
+      } else if (now - provStateSince >= TIME_SYNC_TIMEOUT_MS) {
+        // Keep going; SNTP keeps retrying and timestamps fill in once it lands
+        notifyProvisionStatus("time_sync_pending");
+      } else {
+        return;
+      }
+      mqttAttempts = 0;
+      nextMqttAttemptAt = now;
+      setProvisionState(PROV_MQTT_CONNECTING);
+      return;
+      
+    case PROV_MQTT_CONNECTING:
+      if ((long)(now - nextMqttAttemptAt) < 0) return;
+      if (!connectMQTT()) {
+        nextMqttAttemptAt = now + MQTT_RETRY_MS;
+        char detail[16];
+        snprintf(detail, sizeof(detail), "attempt_%d", mqttAttempts);
+        notifyProvisionStatus("mqtt_retry", detail);
+        return;
+      }
+      notifyProvisionStatus("mqtt_up");
+      setProvisionState(PROV_REGISTERING);
+      return;
+      
+    case PROV_REGISTERING:
+      if (!registerDevice()) {
+        setProvisionState(PROV_MQTT_CONNECTING);
+        nextMqttAttemptAt = now + MQTT_RETRY_MS;
+        return;
+      }
+      notifyProvisionStatus("registered", deviceId.c_str());
+      Serial.printf("⏱️ Provisioning took %lu ms\n", now - provStartedAt);
+      if (bleActive) {
+        storeCredentials();
+      }
+      setProvisionState(PROV_BLE_SHUTDOWN);
+      return;
+      
+    case PROV_BLE_SHUTDOWN:
+      if (bleActive && now - provStateSince < BLE_SHUTDOWN_DELAY_MS) return;
+      releaseBluetoothMemory();
+      setProvisionState(PROV_COMPLETE);
+      return;
+      
+    case PROV_COMPLETE:
+      // Reconnect MQTT after broker/WiFi drops without blocking the loop
+      if (mqttConnected || (long)(now - nextMqttAttemptAt) < 0) return;
+      if (WiFi.status() != WL_CONNECTED || !connectMQTT()) {
+        nextMqttAttemptAt = now + MQTT_RETRY_MS;
+      }
+      return;
   }
 }
 
 // ============================================================================
 // MQTT Functions
 // ============================================================================
-void connectMQTT() {
-  if (!wifiConnected) return;
+// Single connection attempt; callers own the retry schedule
+bool connectMQTT() {
+  if (!wifiConnected) return false;
   
   // Configure TLS for secure connection
   espClient.setInsecure();  // Skip certificate verification (no custom CA)
   Serial.println("🔒 TLS configured (certificate verification disabled)");
   
   mqttClient.setServer(mqtt_server, mqtt_port);
+  mqttClient.setBufferSize(512);  // snapshot payload exceeds the 256 B default
+  mqttClient.setCallback(mqttCallback);
   
   Serial.println("\n📨 Connecting to MQTT broker...");
   Serial.print("   Broker: ");
@@ -359,37 +682,38 @@ void connectMQTT() {
   
   String clientId = "ESP32_" + deviceId;
   
-  int attempts = 0;
-  while (!mqttClient.connected() && attempts < 5) {
-    Serial.print("   Attempt ");
-    Serial.print(attempts + 1);
-    Serial.print("/5... ");
+  mqttAttempts++;
+  Serial.print("   Attempt ");
+  Serial.print(mqttAttempts);
+  Serial.print("... ");
+  
+  // Connect with username and password
+  if (mqttClient.connect(clientId.c_str(), mqtt_username, mqtt_password)) {
+    mqttConnected = true;
+    Serial.println("✅ Connected!");
+    Serial.println("✅ Authenticated successfully with secure broker");
     
-    // Connect with username and password
-    if (mqttClient.connect(clientId.c_str(), mqtt_username, mqtt_password)) {
-      mqttConnected = true;
-      Serial.println("✅ Connected!");
-      Serial.println("✅ Authenticated successfully with secure broker");
-      
-      // Subscribe to device-specific topics
-      String modeTopic = "devices/" + deviceId + "/mode/set";
-      mqttClient.subscribe(modeTopic.c_str());
-      Serial.print("   Subscribed to: ");
-      Serial.println(modeTopic);
-      
-    } else {
-      Serial.print("❌ Failed, rc=");
-      Serial.println(mqttClient.state());
-      Serial.println("⚠️ Check MQTT credentials and broker availability");
-      delay(2000);
-    }
+    // Subscribe to device-specific topics (JSON and the app's compact "p,3600" form)
+    mqttClient.subscribe(topicModeSet);
+    mqttClient.subscribe(topicModeSetCompact);
+    mqttClient.subscribe(topicReprovision);
+    Serial.print("   Subscribed to: ");
+    Serial.print(topicModeSet);
+    Serial.print(", ");
+    Serial.println(topicModeSetCompact);
     
-    attempts++;
+  } else {
+    Serial.print("❌ Failed, rc=");
+    Serial.println(mqttClient.state());
+    Serial.println("⚠️ Check MQTT credentials and broker availability");
+    mqttConnected = false;
   }
+  return mqttConnected;
 }
 
-void registerDevice() {
-  if (!mqttConnected || deviceRegistered) return;
+bool registerDevice() {
+  if (deviceRegistered) return true;
+  if (!mqttConnected) return false;
   
   Serial.println("\n📝 Registering device on MQTT...");
   
@@ -413,24 +737,257 @@ void registerDevice() {
     Serial.print("   Payload: ");
     Serial.println(payload);
     
-    // Blink LED rapidly to indicate success
-    for (int i = 0; i < 5; i++) {
-      digitalWrite(LED_PIN, HIGH);
-      delay(100);
-      digitalWrite(LED_PIN, LOW);
-      delay(100);
-    }
-    digitalWrite(LED_PIN, HIGH);
+    // Blink LED rapidly to indicate success, then stay lit
+    statusLed.play(LED_REGISTERED);
+    statusLed.setIdle(true);
     
   } else {
     Serial.println("❌ Registration failed");
   }
+  return deviceRegistered;
+}
+
+void buildDeviceTopics() {
+  snprintf(topicSnapshot, sizeof(topicSnapshot), "devices/%s/snapshot", deviceId.c_str());
+  snprintf(topicTemperature, sizeof(topicTemperature), "devices/%s/sensors/temperature", deviceId.c_str());
+  snprintf(topicHumidity, sizeof(topicHumidity), "devices/%s/sensors/humidity", deviceId.c_str());
+  snprintf(topicWaterLevel, sizeof(topicWaterLevel), "devices/%s/sensors/water_level", deviceId.c_str());
+  snprintf(topicActuators, sizeof(topicActuators), "devices/%s/actuators/status", deviceId.c_str());
+  snprintf(topicModeSet, sizeof(topicModeSet), "devices/%s/mode/set", deviceId.c_str());
+  snprintf(topicModeSetCompact, sizeof(topicModeSetCompact), "topic/%s/mode/set", deviceId.c_str());
+  snprintf(topicModeAck, sizeof(topicModeAck), "devices/%s/mode/ack", deviceId.c_str());
+  snprintf(topicModeStatus, sizeof(topicModeStatus), "devices/%s/mode/status", deviceId.c_str());
+  snprintf(topicReprovision, sizeof(topicReprovision), "devices/%s/provision/reset", deviceId.c_str());
+  snprintf(topicReprovisionAck, sizeof(topicReprovisionAck), "devices/%s/provision/ack", deviceId.c_str());
+}
+
+const char* onOff(bool on) {
+  return on ? "on" : "off";
+}
+
+unsigned long pinningRemainingSeconds() {
+  if (currentMode != PINNING) return 0;
+  long remaining = (long)(pinningEndsAt - millis());
+  return remaining > 0 ? (unsigned long)remaining / 1000UL : 0;
+}
+
+// ============================================================================
+// Mode Control
+// ============================================================================
+void setActuator(uint8_t pin, bool& state, bool on) {
+  if (state == on) return;
+  digitalWrite(pin, on ? HIGH : LOW);
+  state = on;
+}
+
+// Drive humidifiers/fans from the latest readings and the active mode.
+// Returns true if any relay changed.
+bool applyControl() {
+  if (isnan(lastTemperature) || isnan(lastHumidity)) return false;
+  
+  const ModeThresholds& t = (currentMode == PINNING) ? PINNING_THRESHOLDS : NORMAL_THRESHOLDS;
+  const bool before[4] = {humidifier1State, humidifier2State, fan1State, fan2State};
+  
+  // Humidity (3-state): below -> both on, in range -> H1 only, above -> both off
+  setActuator(HUMIDIFIER1_PIN, humidifier1State, lastHumidity <= t.humMax);
+  setActuator(HUMIDIFIER2_PIN, humidifier2State, lastHumidity < t.humMin);
+  
+  // Temperature (2-state): Fan 1 always on, Fan 2 only above max
+  setActuator(FAN1_PIN, fan1State, true);
+  setActuator(FAN2_PIN, fan2State, lastTemperature > t.tempMax);
+  
+  return before[0] != humidifier1State || before[1] != humidifier2State ||
+         before[2] != fan1State || before[3] != fan2State;
 }
 
-void publishSensorData() {
+void publishModeStatus() {
   if (!mqttConnected) return;
+  mqttClient.publish(topicModeStatus, (currentMode == PINNING) ? "pinning" : "normal", true);
+}
+
+void checkPinningTimer() {
+  if (currentMode != PINNING || (long)(millis() - pinningEndsAt) < 0) return;
+  currentMode = NORMAL;
+  Serial.println("🍄 Pinning timer expired -> NORMAL mode");
+  applyControl();
+  publishModeStatus();
+}
+
+// Accepts {"mode":"pinning","duration":3600,"seq":7} or the compact "p,3600[,seq]"
+void mqttCallback(char* topic, byte* payload, unsigned int length) {
+  const uint32_t receivedUs = micros();
+  if (strcmp(topic, topicReprovision) == 0) {
+    handleReprovisionRequest(payload, length);
+    return;
+  }
+  if (strcmp(topic, topicModeSet) != 0 && strcmp(topic, topicModeSetCompact) != 0) return;
+  
+  char body[96];
+  const unsigned int n = length < sizeof(body) - 1 ? length : sizeof(body) - 1;
+  memcpy(body, payload, n);
+  body[n] = '\0';
+  
+  char mode[12] = "";
+  unsigned long duration = 0;
+  uint32_t seq = commandSeq + 1;
+  bool parsed = false;
   
-  // Read sensors
+  if (body[0] == '{') {
+    StaticJsonDocument<128> doc;
+    if (!deserializeJson(doc, body)) {
+      strlcpy(mode, doc["mode"] | "", sizeof(mode));
+      duration = doc["duration"] | 0UL;
+      seq = doc["seq"] | seq;
+      parsed = true;
+    }
+  } else {
+    char* save = NULL;
+    char* tok = strtok_r(body, ",", &save);
+    if (tok) {
+      strlcpy(mode, tok[0] == 'p' ? "pinning" : (tok[0] == 'n' ? "normal" : tok), sizeof(mode));
+      if ((tok = strtok_r(NULL, ",", &save))) duration = strtoul(tok, NULL, 10);
+      if ((tok = strtok_r(NULL, ",", &save))) seq = strtoul(tok, NULL, 10);
+      parsed = true;
+    }
+  }
+  commandSeq = seq;
+  
+  bool accepted = false;
+  if (parsed && strcmp(mode, "pinning") == 0 && duration > 0) {
+    if (duration > PINNING_MAX_SECONDS) duration = PINNING_MAX_SECONDS;
+    currentMode = PINNING;
+    pinningEndsAt = millis() + duration * 1000UL;
+    accepted = true;
+  } else if (parsed && strcmp(mode, "normal") == 0) {
+    currentMode = NORMAL;
+    pinningEndsAt = 0;
+    accepted = true;
+  }
+  
+  const bool relaysChanged = accepted && applyControl();
+  const uint32_t relayUs = micros() - receivedUs;
+  
+  snprintf(ackBuf, sizeof(ackBuf),
+           "{\"seq\":%lu,\"accepted\":%s,\"mode\":\"%s\",\"pinning_remaining\":%lu,\"relays_changed\":%s,\"relay_us\":%lu}",
+           (unsigned long)seq, accepted ? "true" : "false",
+           (currentMode == PINNING) ? "pinning" : "normal", pinningRemainingSeconds(),
+           relaysChanged ? "true" : "false", (unsigned long)relayUs);
+  mqttClient.publish(topicModeAck, ackBuf);
+  if (accepted) publishModeStatus();
+  
+  if (accepted) {
+    commandCount++;
+    commandRelayUsTotal += relayUs;
+    if (relayUs > commandRelayUsMax) commandRelayUsMax = relayUs;
+  }
+  Serial.printf("🎛️ Mode cmd seq=%lu '%s' -> %s, relay %lu us (avg %lu, max %lu over %lu)\n",
+                (unsigned long)seq, mode, accepted ? "applied" : "rejected", (unsigned long)relayUs,
+                commandCount ? (unsigned long)(commandRelayUsTotal / commandCount) : 0UL,
+                (unsigned long)commandRelayUsMax, (unsigned long)commandCount);
+}
+
+// Remote reprovision: {"confirm":"reprovision","nonce":"<1-32 of A-Z a-z 0-9 _ ->"}.
+// The request may be retained, so it arrives again after every reconnect;
+// a nonce already acted on is acked as not accepted and ignored. Either way
+// the retained copy is cleared (the cloud also clears it when it sees the ack).
+void handleReprovisionRequest(const byte* payload, unsigned int length) {
+  if (length == 0) return;  // the retained copy being cleared
+  
+  char body[96];
+  StaticJsonDocument<128> doc;
+  const char* nonce = "";
+  if (length < sizeof(body)) {
+    memcpy(body, payload, length);
+    body[length] = '\0';
+    if (!deserializeJson(doc, body) && strcmp(doc["confirm"] | "", "reprovision") == 0) {
+      nonce = doc["nonce"] | "";
+    }
+  }
+  size_t nonceLen = strlen(nonce);
+  for (size_t i = 0; i < nonceLen; ++i) {
+    if (!isalnum((unsigned char)nonce[i]) && nonce[i] != '_' && nonce[i] != '-') nonceLen = 0;
+  }
+  if (nonceLen == 0 || nonceLen > REPROVISION_NONCE_MAX) {
+    Serial.println("⚠️ Reprovision request without confirm/nonce - ignored");
+    return;
+  }
+  
+  String lastNonce;
+  if (provPrefs.begin(PROV_PREFS_NAMESPACE, true)) {
+    lastNonce = provPrefs.getString("reprov_nonce", "");
+    provPrefs.end();
+  }
+  const bool repeat = lastNonce == nonce;
+  snprintf(ackBuf, sizeof(ackBuf), "{\"nonce\":\"%s\",\"accepted\":%s}", nonce, repeat ? "false" : "true");
+  mqttClient.publish(topicReprovisionAck, ackBuf);
+  mqttClient.publish(topicReprovision, "", true);
+  if (repeat) {
+    Serial.printf("🔁 Reprovision nonce %s already handled - ignored\n", nonce);
+    return;
+  }
+  requestReprovision("remote request", nonce);
+}
+
+uint8_t packActuators() {
+  return (humidifier1State ? 0x01 : 0) | (humidifier2State ? 0x02 : 0) | (fan1State ? 0x04 : 0) |
+         (fan2State ? 0x08 : 0) | (buzzerState ? 0x10 : 0);
+}
+
+// Snapshot JSON into publishBuf. Timestamps are resolved from the acquisition
+// millis() here, so readings buffered before SNTP synced get real times once
+// it has; still-unsynced ones go out with timestamp 0 + "time_synced":false
+// and their age so the backend can re-stamp them.
+void formatSnapshot(const SnapshotRecord& r, bool backlog) {
+  const uint32_t epoch = timeService.epoch(r.acquiredMs);
+  char extra[64] = "";
+  if (epoch == 0) {
+    snprintf(extra, sizeof(extra), ",\"time_synced\":false,\"age_ms\":%lu",
+             (unsigned long)(millis() - r.acquiredMs));
+  }
+  snprintf(publishBuf, sizeof(publishBuf),
+           "{\"device_id\":\"%s\",\"timestamp\":%lu,"
+           "\"temperature\":%.1f,\"humidity\":%.1f,\"water_level\":%.1f,"
+           "\"actuators\":{\"humidifier1\":\"%s\",\"humidifier2\":\"%s\",\"fan1\":\"%s\",\"fan2\":\"%s\",\"buzzer\":\"%s\"},"
+           "\"mode\":\"%s\",\"pinning_remaining\":%lu%s%s}",
+           deviceId.c_str(), (unsigned long)epoch,
+           r.temperature, r.humidity, r.waterLevel,
+           onOff(r.actuators & 0x01), onOff(r.actuators & 0x02), onOff(r.actuators & 0x04),
+           onOff(r.actuators & 0x08), onOff(r.actuators & 0x10),
+           (r.mode == PINNING) ? "pinning" : "normal",
+           backlog ? 0UL : pinningRemainingSeconds(),
+           backlog ? ",\"backlog\":true" : "", extra);
+}
+
+void bufferOffline(const SnapshotRecord& r) {
+  if (offlineCapacity == 0) return;
+  if (offlineCount == offlineCapacity) {
+    // Full: overwrite the oldest
+    offlineHead = (offlineHead + 1) % offlineCapacity;
+    offlineCount--;
+  }
+  offlineRing[(offlineHead + offlineCount) % offlineCapacity] = r;
+  offlineCount++;
+}
+
+// Replay a bounded number of buffered snapshots per cycle
+uint32_t flushOffline() {
+  uint32_t sent = 0;
+  while (offlineCount > 0 && sent < OFFLINE_FLUSH_PER_CYCLE) {
+    formatSnapshot(offlineRing[offlineHead], true);
+    if (!mqttClient.publish(topicSnapshot, publishBuf)) break;
+    offlineHead = (offlineHead + 1) % offlineCapacity;
+    offlineCount--;
+    sent++;
+  }
+  return sent;
+}
+
+// Read sensors and drive the relays from them. Runs whatever the
+// provisioning or MQTT state, so the chamber stays controlled while the
+// device is offline. False when the DHT read failed (relays keep their state).
+bool readSensors(SnapshotRecord& record) {
+  // Stamp at acquisition, not at publish
+  const uint32_t acquiredMs = millis();
   float temperature = dht.readTemperature();
   float humidity = dht.readHumidity();
   float waterLevel = readWaterLevel();
@@ -438,36 +995,14 @@ void publishSensorData() {
   // Check if DHT reading is valid
   if (isnan(temperature) || isnan(humidity)) {
     Serial.println("⚠️ Failed to read from DHT sensor");
-    return;
+    return false;
   }
   
-  // Get real Unix timestamp (seconds since epoch)
-  unsigned long timestamp = timeClient.getEpochTime();
-  
-  // Publish temperature
-  publishSensorValue("temperature", temperature, timestamp);
-  delay(100);
-  
-  // Publish humidity
-  publishSensorValue("humidity", humidity, timestamp);
-  delay(100);
+  lastTemperature = temperature;
+  lastHumidity = humidity;
+  applyControl();
   
-  // Publish water_level
-  publishSensorValue("water_level", waterLevel, timestamp);
-  
-  // Publish actuator states
-  String actuatorTopic = "devices/" + deviceId + "/actuators/status";
-  StaticJsonDocument<256> actuatorDoc;
-  actuatorDoc["humidifier1"] = humidifier1State ? "on" : "off";
-  actuatorDoc["humidifier2"] = humidifier2State ? "on" : "off";
-  actuatorDoc["fan1"] = fan1State ? "on" : "off";
-  actuatorDoc["fan2"] = fan2State ? "on" : "off";
-  actuatorDoc["buzzer"] = buzzerState ? "on" : "off";
-  actuatorDoc["mode"] = (currentMode == PINNING) ? "pinning" : "normal";
-  
-  String actuatorPayload;
-  serializeJson(actuatorDoc, actuatorPayload);
-  mqttClient.publish(actuatorTopic.c_str(), actuatorPayload.c_str());
+  record = {acquiredMs, temperature, humidity, waterLevel, packActuators(), (uint8_t)currentMode};
   
   // Print rounded values to serial (1 decimal place)
   Serial.print("📊 Sensors: ");
@@ -478,62 +1013,179 @@ void publishSensorData() {
   Serial.print("%, Water=");
   Serial.print(round(waterLevel * 10.0) / 10.0, 1);
   Serial.println("%");
+  return true;
 }
 
-void publishSensorValue(String sensorType, float value, unsigned long timestamp) {
-  String topic = "devices/" + deviceId + "/sensors/" + sensorType;
+// Publish one reading (or buffer it while MQTT is down)
+void publishSensorData(const SnapshotRecord& record) {
+  if (!mqttConnected) {
+    bufferOffline(record);
+    return;
+  }
   
-  // Round value to 1 decimal place
-  float roundedValue = round(value * 10.0) / 10.0;
+  const uint32_t startUs = micros();
+  uint32_t messages = flushOffline();
   
-  // Create JSON payload with value, timestamp, and device_id (MAC without colons)
-  StaticJsonDocument<200> doc;
-  doc["value"] = serialized(String(roundedValue, 1));  // Force 1 decimal place (e.g., 29.0)
-  doc["timestamp"] = timestamp;
-  doc["device_id"] = deviceId;  // MAC without colons (e.g., AABBCCDDEEFF)
+  // Combined snapshot: one timestamp, sensors + actuators in one message
+  formatSnapshot(record, false);
+  if (mqttClient.publish(topicSnapshot, publishBuf)) {
+    messages++;
+  }
   
-  String payload;
-  serializeJson(doc, payload);
+#if PUBLISH_LEGACY_SENSOR_TOPICS
+  const unsigned long timestamp = timeService.epoch(record.acquiredMs);
+  if (publishSensorValue(topicTemperature, record.temperature, timestamp)) messages++;
+  if (publishSensorValue(topicHumidity, record.humidity, timestamp)) messages++;
+  if (publishSensorValue(topicWaterLevel, record.waterLevel, timestamp)) messages++;
+  
+  snprintf(publishBuf, sizeof(publishBuf),
+           "{\"humidifier1\":\"%s\",\"humidifier2\":\"%s\",\"fan1\":\"%s\",\"fan2\":\"%s\",\"buzzer\":\"%s\",\"mode\":\"%s\",\"pinning_remaining\":%lu}",
+           onOff(humidifier1State), onOff(humidifier2State), onOff(fan1State), onOff(fan2State), onOff(buzzerState),
+           (currentMode == PINNING) ? "pinning" : "normal", pinningRemainingSeconds());
+  if (mqttClient.publish(topicActuators, publishBuf)) messages++;
+#endif
   
-  mqttClient.publish(topic.c_str(), payload.c_str());
+  publishMicros += micros() - startUs;
+  publishMessages += messages;
+  if (++publishCycles >= PUBLISH_STATS_EVERY) {
+    Serial.printf("📈 Publish cost: %lu us/cycle, %.2f msgs/cycle over %lu cycles\n",
+                  (unsigned long)(publishMicros / publishCycles),
+                  (float)publishMessages / publishCycles,
+                  (unsigned long)publishCycles);
+    timeService.printStatus();
+    publishCycles = 0;
+    publishMessages = 0;
+    publishMicros = 0;
+  }
 }
 
-// Function to read water level
+bool publishSensorValue(const char* topic, float value, unsigned long timestamp) {
+  // Legacy per-sensor payload: value (1 decimal), timestamp, device_id (MAC without colons)
+  snprintf(publishBuf, sizeof(publishBuf),
+           "{\"value\":%.1f,\"timestamp\":%lu,\"device_id\":\"%s\"}",
+           value, timestamp, deviceId.c_str());
+  return mqttClient.publish(topic, publishBuf);
+}
+
+// ============================================================================
+// Water Level (analog probe via continuous ADC DMA, or float switch)
+// ============================================================================
+#if MILLO_WATER_ANALOG
+void waterAdcTask(void *) {
+  static uint8_t frame[WATER_ADC_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES];
+  static uint16_t samples[WATER_ADC_FRAME_SAMPLES];
+  MedianWindow<5> smooth;
+
+  for (;;) {
+    uint32_t got = 0;
+    if (adc_digi_read_bytes(frame, sizeof(frame), &got, 1000) != ESP_OK) {
+      continue;  // timeout or DMA overrun; the next frame is fine
+    }
+
+    size_t n = 0;
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= got; i += SOC_ADC_DIGI_RESULT_BYTES) {
+      const adc_digi_output_data_t *d = reinterpret_cast<const adc_digi_output_data_t *>(&frame[i]);
+      if (d->type1.channel == MILLO_WATER_ADC_CHANNEL) {
+        samples[n++] = d->type1.data;
+      }
+    }
+    if (n < 16) {
+      continue;
+    }
+
+    // Oversample -> trimmed mean (drop top/bottom quarter) -> median of 5 frames
+    smooth.push(trimmedMean(samples, n, n / 4));
+    const uint32_t mv = esp_adc_cal_raw_to_voltage(smooth.median(), &waterAdcChars);
+    waterLevelCentiPct.store(millivoltsToCentiPercent(mv, WATER_LEVEL_EMPTY_MV, WATER_LEVEL_FULL_MV),
+                             std::memory_order_relaxed);
+    waterAdcReady.store(true, std::memory_order_release);
+  }
+}
+
+void setupWaterAdc() {
+  // Raw -> mV curve from eFuse two-point values when burnt, else eFuse/default Vref
+  esp_adc_cal_value_t calSource = esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, &waterAdcChars);
+  Serial.print("💧 Water ADC calibration: ");
+  Serial.println(calSource == ESP_ADC_CAL_VAL_EFUSE_TP ? "eFuse two-point" :
+                 calSource == ESP_ADC_CAL_VAL_EFUSE_VREF ? "eFuse Vref" : "default Vref");
+
+  adc_digi_init_config_t initCfg = {};
+  initCfg.max_store_buf_size = WATER_ADC_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES * 4;
+  initCfg.conv_num_each_intr = WATER_ADC_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES;
+  initCfg.adc1_chan_mask = BIT(MILLO_WATER_ADC_CHANNEL);
+
+  adc_digi_pattern_config_t pattern = {};
+  pattern.atten = ADC_ATTEN_DB_11;
+  pattern.channel = MILLO_WATER_ADC_CHANNEL;
+  pattern.unit = 0;  // ADC1
+  pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+
+  adc_digi_configuration_t digCfg = {};
+  digCfg.conv_limit_en = true;  // required on ESP32
+  digCfg.conv_limit_num = 250;
+  digCfg.pattern_num = 1;
+  digCfg.adc_pattern = &pattern;
+  digCfg.sample_freq_hz = WATER_ADC_SAMPLE_HZ;
+  digCfg.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  digCfg.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+
+  if (adc_digi_initialize(&initCfg) != ESP_OK ||
+      adc_digi_controller_configure(&digCfg) != ESP_OK ||
+      adc_digi_start() != ESP_OK) {
+    Serial.println("⚠️ Water ADC DMA init failed - falling back to analogRead()");
+    adc_digi_deinitialize();
+    return;
+  }
+
+  xTaskCreatePinnedToCore(waterAdcTask, "water_adc", 3072, NULL, 2, NULL, 0);
+  Serial.println("✅ Water level ADC streaming (DMA)");
+}
+
+// Function to read water level (latest filtered value, lock-free)
 float readWaterLevel() {
+  if (waterAdcReady.load(std::memory_order_acquire)) {
+    return waterLevelCentiPct.load(std::memory_order_relaxed) / 100.0f;
+  }
   int rawValue = analogRead(WATER_LEVEL_PIN);
   // Convert to percentage (0-100%)
   float percentage = (rawValue / 4095.0) * 100.0;
   return percentage;
 }
+#else
+// Float-switch boards: report the tank as full (100%) or empty (0%)
+void setupWaterAdc() {
+  pinMode(WATER_LEVEL_PIN, INPUT_PULLUP);
+  Serial.println("✅ Water level float switch");
+}
+
+float readWaterLevel() {
+  return digitalRead(WATER_LEVEL_PIN) == LOW ? 100.0f : 0.0f;
+}
+#endif
 
 // ============================================================================
 // Main Loop
 // ============================================================================
 void loop() {
-  // If credentials received but not connected, try to connect
-  if (wifiCredentialsReceived && !wifiConnected) {
-    connectWiFi();
-  }
+  // Credentials -> WiFi -> time -> MQTT -> registration, one step per pass
+  serviceProvisioning();
   
-  // If WiFi connected but MQTT not connected, connect MQTT
-  if (wifiConnected && !mqttConnected) {
-    connectMQTT();
-  }
-  
-  // If MQTT connected but not registered, register device
-  if (mqttConnected && !deviceRegistered) {
-    registerDevice();
-  }
+  checkPinningTimer();
   
   // Maintain MQTT connection
   if (mqttConnected) {
     mqttClient.loop();
-    
-    // Publish sensor data periodically
-    unsigned long now = millis();
-    if (now - lastSensorPublish >= sensorInterval) {
-      publishSensorData();
-      lastSensorPublish = now;
+    mqttConnected = mqttClient.connected();
+  }
+  
+  // Read and control periodically in every state; only the publish (or
+  // offline buffering) waits for provisioning to complete
+  unsigned long now = millis();
+  if (now - lastSensorRead >= sensorInterval) {
+    lastSensorRead = now;
+    SnapshotRecord record;
+    if (readSensors(record) && provState == PROV_COMPLETE) {
+      publishSensorData(record);
     }
   }
   
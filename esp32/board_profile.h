@@ -0,0 +1,71 @@
+#pragma once
+// Compile-time board profile shared by both firmwares.
+//
+// Each PlatformIO env (see platformio.ini) defines one MILLO_BOARD_* and
+// builds exactly one entry point: main.cpp (SoftAP + WebServer provisioning)
+// or bluetooth_provisioning_main.cpp (BLE provisioning). Only the selected
+// entry point is compiled, so the other provisioning stack never reaches the
+// image. Pins are named by role so either firmware can drive either board:
+//
+//   role          controller-v1 (main.cpp relays)   ble-kit
+//   HUMIDIFIER1   32  IN4, humidity default ON       25
+//   HUMIDIFIER2   26  IN2, humidity NC               26
+//   FAN1          22  IN5, temperature default ON    27
+//   FAN2          25  IN1, temperature NC            14
+//   water         27  float switch                   35  analog probe (ADC1_CH7)
+//   I2C SDA/SCL   21/19                              21/22
+
+#include <stdint.h>
+
+#if !defined(MILLO_BOARD_CONTROLLER_V1) && !defined(MILLO_BOARD_BLE_KIT)
+#error "No board profile: build with -DMILLO_BOARD_CONTROLLER_V1 or -DMILLO_BOARD_BLE_KIT"
+#elif defined(MILLO_BOARD_CONTROLLER_V1) && defined(MILLO_BOARD_BLE_KIT)
+#error "Select only one MILLO_BOARD_* profile"
+#endif
+
+namespace board {
+
+constexpr uint8_t NO_PIN = 0xFF;
+
+enum class WaterSensor : uint8_t { FloatSwitch, AnalogProbe };
+
+#if defined(MILLO_BOARD_CONTROLLER_V1)
+
+constexpr const char *NAME = "controller-v1";
+constexpr uint8_t DHT_PIN = 4;
+constexpr uint8_t HUMIDIFIER1_PIN = 32;
+constexpr uint8_t HUMIDIFIER2_PIN = 26;
+constexpr uint8_t FAN1_PIN = 22;
+constexpr uint8_t FAN2_PIN = 25;
+constexpr uint8_t BUZZER_PIN = 33;
+constexpr WaterSensor WATER_SENSOR = WaterSensor::FloatSwitch;
+constexpr uint8_t WATER_PIN = 27;        // closed -> LOW (water present)
+constexpr uint8_t LIGHT_PIN = 34;
+constexpr uint8_t STATUS_LED_PIN = 2;    // on-board LED
+constexpr uint8_t RESET_BUTTON_PIN = 0;  // BOOT
+constexpr uint8_t I2C_SDA_PIN = 21;
+constexpr uint8_t I2C_SCL_PIN = 19;      // 22 is taken by IN5
+#define MILLO_WATER_ANALOG 0
+
+#elif defined(MILLO_BOARD_BLE_KIT)
+
+constexpr const char *NAME = "ble-kit";
+constexpr uint8_t DHT_PIN = 4;
+constexpr uint8_t HUMIDIFIER1_PIN = 25;
+constexpr uint8_t HUMIDIFIER2_PIN = 26;
+constexpr uint8_t FAN1_PIN = 27;
+constexpr uint8_t FAN2_PIN = 14;
+constexpr uint8_t BUZZER_PIN = 33;
+constexpr WaterSensor WATER_SENSOR = WaterSensor::AnalogProbe;
+constexpr uint8_t WATER_PIN = 35;        // probe S pin
+constexpr uint8_t LIGHT_PIN = NO_PIN;
+constexpr uint8_t STATUS_LED_PIN = 2;
+constexpr uint8_t RESET_BUTTON_PIN = 0;
+constexpr uint8_t I2C_SDA_PIN = 21;
+constexpr uint8_t I2C_SCL_PIN = 22;
+#define MILLO_WATER_ANALOG 1
+#define MILLO_WATER_ADC_CHANNEL ADC1_CHANNEL_7  // must match WATER_PIN
+
+#endif
+
+}  // namespace board
@@ -0,0 +1,100 @@
+#pragma once
+// Crash and stall forensics kept across reboots.
+//
+// Pure logic (no Arduino headers). The firmware keeps one CrashRecord in RTC
+// memory, which survives every reset except a power cycle. While running it
+// notes the loop stage, uptime and heap; resets the firmware starts itself
+// also leave a cause and a short backtrace. The next boot adds the reset
+// reason and reports the record once.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Where loop() was; a stall or crash leaves the stage it happened in
+enum class LoopStage : uint8_t {
+  Setup,
+  Http,
+  WiFi,
+  Registration,
+  Mqtt,
+  Bench,
+  Water,
+  Sensors,
+  Thresholds,
+  Relays,
+  Publish,
+  Satellites,
+  Alarms,
+  Count
+};
+
+inline const char *loopStageName(LoopStage stage) {
+  static const char *const NAMES[] = {"setup",   "http",    "wifi",       "registration", "mqtt",
+                                      "bench",   "water",   "sensors",    "thresholds",   "relays",
+                                      "publish", "satellites", "alarms"};
+  return stage < LoopStage::Count ? NAMES[static_cast<size_t>(stage)] : "unknown";
+}
+
+// Why the firmware restarted itself (None for every other reset)
+enum class RestartCause : uint8_t { None, SensorFailure, WiFiErase, SelfBenchmark, RemoteCommand, Count };
+
+inline const char *restartCauseName(RestartCause cause) {
+  static const char *const NAMES[] = {"none", "sensor_failure", "wifi_erase", "self_benchmark",
+                                      "remote_command"};
+  return cause < RestartCause::Count ? NAMES[static_cast<size_t>(cause)] : "unknown";
+}
+
+static const uint32_t CRASH_RECORD_MAGIC = 0x4d4c4352;  // "MLCR"
+static const size_t CRASH_BACKTRACE_DEPTH = 8;
+
+struct CrashRecord {
+  uint32_t magic;
+  uint32_t bootCount;  // boots since the last power cycle
+  uint32_t uptimeS;    // at the last loop() pass
+  uint32_t freeHeap;   // heap fields: last memory sample or the restart
+  uint32_t minFreeHeap;
+  uint32_t largestBlock;
+  uint8_t stage;       // LoopStage
+  uint8_t cause;       // RestartCause
+  uint8_t backtraceDepth;
+  char task[16];       // task the backtrace belongs to
+  uint32_t backtrace[CRASH_BACKTRACE_DEPTH];
+};
+
+// RTC memory holds garbage after a power cycle
+inline bool crashRecordValid(const CrashRecord &r) {
+  return r.magic == CRASH_RECORD_MAGIC && r.stage < static_cast<uint8_t>(LoopStage::Count) &&
+         r.cause < static_cast<uint8_t>(RestartCause::Count) && r.backtraceDepth <= CRASH_BACKTRACE_DEPTH;
+}
+
+// Start this boot's record; the boot count carries over from a valid one
+inline void crashRecordBegin(CrashRecord &r) {
+  const uint32_t boots = crashRecordValid(r) ? r.bootCount + 1 : 1;
+  memset(&r, 0, sizeof(r));
+  r.magic = CRASH_RECORD_MAGIC;
+  r.bootCount = boots;
+  r.stage = static_cast<uint8_t>(LoopStage::Setup);
+}
+
+// Compact JSON for topic/<id>/crash, e.g.
+// {"reason":"task_wdt","stage":"thresholds","cause":"none","up_s":86412,"boot":3,
+//  "heap":[151204,98012,65524],"task":"loopTask","bt":["0x400d2f1c",...]}
+// Returns the length snprintf would have written.
+inline int formatCrashReport(char *out, size_t len, const CrashRecord &r, const char *resetReason) {
+  int n = snprintf(out, len,
+                   "{\"reason\":\"%s\",\"stage\":\"%s\",\"cause\":\"%s\",\"up_s\":%lu,\"boot\":%lu,"
+                   "\"heap\":[%lu,%lu,%lu],\"task\":\"%.15s\",\"bt\":[",
+                   resetReason, loopStageName(static_cast<LoopStage>(r.stage)),
+                   restartCauseName(static_cast<RestartCause>(r.cause)), static_cast<unsigned long>(r.uptimeS),
+                   static_cast<unsigned long>(r.bootCount), static_cast<unsigned long>(r.freeHeap),
+                   static_cast<unsigned long>(r.minFreeHeap), static_cast<unsigned long>(r.largestBlock), r.task);
+  for (size_t i = 0; i < r.backtraceDepth && n >= 0 && static_cast<size_t>(n) < len; ++i) {
+    n += snprintf(out + n, len - n, "%s\"0x%08lx\"", i ? "," : "", static_cast<unsigned long>(r.backtrace[i]));
+  }
+  if (n >= 0 && static_cast<size_t>(n) < len) {
+    n += snprintf(out + n, len - n, "]}");
+  }
+  return n;
+}
@@ -0,0 +1,87 @@
+#pragma once
+// Maps the monotonic millis() counter onto Unix time.
+//
+// Pure logic (no Arduino / lwIP headers): the caller feeds it sync points
+// (monotonic ms at which an epoch was known to be true) and converts sample
+// stamps later. Samples therefore keep the millis() of their acquisition and
+// can be resolved after the fact, including samples taken before first sync.
+//
+// Small errors are slewed in (half per sync) and fold into a drift estimate
+// so one noisy SNTP reply does not step the timeline; large errors step.
+
+#include <stddef.h>
+#include <stdint.h>
+
+class EpochClock {
+ public:
+  static const int32_t STEP_THRESHOLD_MS = 1000;
+  static const uint32_t MIN_DRIFT_SPAN_MS = 60000;  // shorter spans are too noisy
+  static const int32_t MAX_DRIFT_PPM = 500;
+
+  // Record that epochMs was the wall time at monotonic monoMs.
+  void onSync(uint32_t monoMs, uint64_t epochMs) {
+    syncCount_++;
+    if (!synced_) {
+      anchorMono_ = monoMs;
+      anchorEpochMs_ = epochMs;
+      synced_ = true;
+      lastCorrectionMs_ = 0;
+      return;
+    }
+
+    const int64_t predicted = static_cast<int64_t>(toEpochMs(monoMs));
+    const int64_t error = static_cast<int64_t>(epochMs) - predicted;
+    const uint32_t span = monoMs - anchorMono_;
+    lastCorrectionMs_ = static_cast<int32_t>(error);
+
+    if (error > STEP_THRESHOLD_MS || error < -STEP_THRESHOLD_MS) {
+      // Wall clock jumped (or we were badly off): step, keep the drift estimate
+      anchorMono_ = monoMs;
+      anchorEpochMs_ = epochMs;
+      return;
+    }
+
+    if (span >= MIN_DRIFT_SPAN_MS) {
+      // Residual error over the span is uncorrected drift; blend it in at 1/4
+      const int64_t measuredPpm = error * 1000000 / static_cast<int64_t>(span);
+      int64_t ppm = driftPpm_ + measuredPpm / 4;
+      if (ppm > MAX_DRIFT_PPM) ppm = MAX_DRIFT_PPM;
+      if (ppm < -MAX_DRIFT_PPM) ppm = -MAX_DRIFT_PPM;
+      driftPpm_ = static_cast<int32_t>(ppm);
+    }
+
+    // Slew: take half of the error now, the rest over following syncs
+    anchorMono_ = monoMs;
+    anchorEpochMs_ = static_cast<uint64_t>(predicted + error / 2);
+  }
+
+  bool synced() const { return synced_; }
+
+  // Epoch ms for a monotonic stamp, or 0 before the first sync. Stamps up to
+  // ~24 days either side of the last sync resolve correctly across the
+  // millis() wrap.
+  uint64_t toEpochMs(uint32_t monoMs) const {
+    if (!synced_) {
+      return 0;
+    }
+    const int64_t delta = static_cast<int32_t>(monoMs - anchorMono_);
+    const int64_t corrected = delta + delta * driftPpm_ / 1000000;
+    return static_cast<uint64_t>(static_cast<int64_t>(anchorEpochMs_) + corrected);
+  }
+
+  uint32_t toEpoch(uint32_t monoMs) const {
+    return static_cast<uint32_t>(toEpochMs(monoMs) / 1000);
+  }
+
+  int32_t driftPpm() const { return driftPpm_; }
+  int32_t lastCorrectionMs() const { return lastCorrectionMs_; }
+  uint32_t syncCount() const { return syncCount_; }
+
+ private:
+  bool synced_ = false;
+  uint32_t anchorMono_ = 0;
+  uint64_t anchorEpochMs_ = 0;
+  int32_t driftPpm_ = 0;
+  int32_t lastCorrectionMs_ = 0;
+  uint32_t syncCount_ = 0;
+};
@@ -0,0 +1,525 @@
+#pragma once
+// ESP-NOW link between satellite sensor nodes and a gateway controller.
+//
+// Pure logic (no Arduino / esp_now headers), templated on the radio so the
+// same code runs over esp_now in the firmwares and over SimEspNow
+// (sim_espnow.h) on the host. A Radio needs one call:
+//
+//   bool send(const uint8_t mac[6], const uint8_t *data, size_t len);
+//
+// Satellites send a Reading frame every period; the gateway answers every
+// reading (including duplicates, since the previous answer may be what got
+// lost) with a Control frame that acks the sequence number and, when the
+// satellite reports a stale thresholds version, carries the current
+// thresholds. A satellite that hears nothing retransmits the same sequence
+// number a few times, so the gateway deduplicates per node with a sliding
+// window keyed on (bootId, seq).
+//
+// Frames are little-endian and serialized field by field (no packed
+// structs); the 802.11 FCS already covers corruption, the magic/version/
+// length checks reject foreign vendor frames.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static const uint8_t SAT_MAGIC = 0x4D;  // 'M'
+static const uint8_t SAT_VERSION = 1;
+static const uint8_t SAT_HEADER_LEN = 7;
+static const uint8_t SAT_READING_LEN = SAT_HEADER_LEN + 9;
+static const uint8_t SAT_CONTROL_LEN = SAT_HEADER_LEN + 12;
+static const uint8_t SAT_BROADCAST[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+enum class SatFrameType : uint8_t { Reading = 1, Control = 2 };
+
+struct SatReading {
+  uint16_t bootId;            // random per satellite boot; resets the seq window
+  uint16_t seq;
+  int16_t tempCenti;          // 0.01 C
+  uint16_t humCenti;          // 0.01 %RH
+  uint8_t water;              // 0 full, 1 needs water, 0xFF no sensor
+  bool climateValid;
+  uint16_t thresholdsVersion; // last version the satellite applied
+};
+
+struct SatThresholds {
+  int16_t tempMinCenti;
+  int16_t tempMaxCenti;
+  int16_t humMinCenti;
+  int16_t humMaxCenti;
+  bool tempEnabled;
+  bool humEnabled;
+};
+
+struct SatControl {
+  uint16_t bootId;  // echoed from the reading
+  uint16_t seq;     // acked sequence number
+  uint16_t thresholdsVersion;
+  bool hasThresholds;
+  SatThresholds thresholds;
+};
+
+inline bool operator==(const SatThresholds &a, const SatThresholds &b) {
+  return a.tempMinCenti == b.tempMinCenti && a.tempMaxCenti == b.tempMaxCenti &&
+         a.humMinCenti == b.humMinCenti && a.humMaxCenti == b.humMaxCenti &&
+         a.tempEnabled == b.tempEnabled && a.humEnabled == b.humEnabled;
+}
+inline bool operator!=(const SatThresholds &a, const SatThresholds &b) { return !(a == b); }
+
+// ---- serialization ----
+
+inline void satPut16(uint8_t *p, uint16_t v) {
+  p[0] = static_cast<uint8_t>(v & 0xFF);
+  p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+inline uint16_t satGet16(const uint8_t *p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+
+inline void satPutHeader(uint8_t *p, SatFrameType type, uint16_t bootId, uint16_t seq) {
+  p[0] = SAT_MAGIC;
+  p[1] = SAT_VERSION;
+  p[2] = static_cast<uint8_t>(type);
+  satPut16(p + 3, bootId);
+  satPut16(p + 5, seq);
+}
+
+inline bool satCheckHeader(const uint8_t *p, size_t len, SatFrameType type, size_t frameLen) {
+  return len >= frameLen && p[0] == SAT_MAGIC && p[1] == SAT_VERSION &&
+         p[2] == static_cast<uint8_t>(type);
+}
+
+inline size_t encodeReading(const SatReading &r, uint8_t *buf, size_t cap) {
+  if (cap < SAT_READING_LEN) {
+    return 0;
+  }
+  satPutHeader(buf, SatFrameType::Reading, r.bootId, r.seq);
+  uint8_t *p = buf + SAT_HEADER_LEN;
+  satPut16(p, static_cast<uint16_t>(r.tempCenti));
+  satPut16(p + 2, r.humCenti);
+  p[4] = r.water;
+  p[5] = r.climateValid ? 0x01 : 0x00;
+  satPut16(p + 6, r.thresholdsVersion);
+  p[8] = 0;  // reserved
+  return SAT_READING_LEN;
+}
+
+inline bool decodeReading(const uint8_t *buf, size_t len, SatReading &r) {
+  if (!satCheckHeader(buf, len, SatFrameType::Reading, SAT_READING_LEN)) {
+    return false;
+  }
+  r.bootId = satGet16(buf + 3);
+  r.seq = satGet16(buf + 5);
+  const uint8_t *p = buf + SAT_HEADER_LEN;
+  r.tempCenti = static_cast<int16_t>(satGet16(p));
+  r.humCenti = satGet16(p + 2);
+  r.water = p[4];
+  r.climateValid = (p[5] & 0x01) != 0;
+  r.thresholdsVersion = satGet16(p + 6);
+  return true;
+}
+
+inline size_t encodeControl(const SatControl &c, uint8_t *buf, size_t cap) {
+  if (cap < SAT_CONTROL_LEN) {
+    return 0;
+  }
+  satPutHeader(buf, SatFrameType::Control, c.bootId, c.seq);
+  uint8_t *p = buf + SAT_HEADER_LEN;
+  satPut16(p, c.thresholdsVersion);
+  p[2] = static_cast<uint8_t>((c.hasThresholds ? 0x01 : 0) | (c.thresholds.tempEnabled ? 0x02 : 0) |
+                              (c.thresholds.humEnabled ? 0x04 : 0));
+  satPut16(p + 3, static_cast<uint16_t>(c.thresholds.tempMinCenti));
+  satPut16(p + 5, static_cast<uint16_t>(c.thresholds.tempMaxCenti));
+  satPut16(p + 7, static_cast<uint16_t>(c.thresholds.humMinCenti));
+  satPut16(p + 9, static_cast<uint16_t>(c.thresholds.humMaxCenti));
+  p[11] = 0;  // reserved
+  return SAT_CONTROL_LEN;
+}
+
+inline bool decodeControl(const uint8_t *buf, size_t len, SatControl &c) {
+  if (!satCheckHeader(buf, len, SatFrameType::Control, SAT_CONTROL_LEN)) {
+    return false;
+  }
+  c.bootId = satGet16(buf + 3);
+  c.seq = satGet16(buf + 5);
+  const uint8_t *p = buf + SAT_HEADER_LEN;
+  c.thresholdsVersion = satGet16(p);
+  c.hasThresholds = (p[2] & 0x01) != 0;
+  c.thresholds.tempEnabled = (p[2] & 0x02) != 0;
+  c.thresholds.humEnabled = (p[2] & 0x04) != 0;
+  c.thresholds.tempMinCenti = static_cast<int16_t>(satGet16(p + 3));
+  c.thresholds.tempMaxCenti = static_cast<int16_t>(satGet16(p + 5));
+  c.thresholds.humMinCenti = static_cast<int16_t>(satGet16(p + 7));
+  c.thresholds.humMaxCenti = static_cast<int16_t>(satGet16(p + 9));
+  return true;
+}
+
+// ---- sequence window ----
+
+// Accepts each (bootId, seq) once. Tracks the highest seq seen plus a
+// 32-entry bitmap behind it, so late (reordered) frames are still accepted
+// once and retransmissions are dropped. A new bootId restarts the window.
+// Frames that fall out of the window unseen are counted as lost; frames from
+// before the first one heard are treated as already seen.
+class SequenceWindow {
+ public:
+  enum class Result : uint8_t { New, Late, Duplicate, Stale, Restarted };
+  static const uint16_t WINDOW = 32;
+
+  Result accept(uint16_t bootId, uint16_t seq) {
+    if (!started_ || bootId != bootId_) {
+      const bool restarted = started_;
+      started_ = true;
+      bootId_ = bootId;
+      highest_ = seq;
+      mask_ = 0xFFFFFFFFUL;  // nothing before the first frame counts as lost
+      return restarted ? Result::Restarted : Result::New;
+    }
+    const int16_t diff = static_cast<int16_t>(seq - highest_);
+    if (diff > 0) {
+      if (diff >= WINDOW) {
+        lost_ += WINDOW - popcount(mask_) + (diff - WINDOW);
+        mask_ = 0;
+      } else {
+        const uint32_t leaving = mask_ >> (WINDOW - diff);
+        lost_ += diff - popcount(leaving);
+        mask_ <<= diff;
+      }
+      mask_ |= 1;
+      highest_ = seq;
+      return Result::New;
+    }
+    const uint16_t age = static_cast<uint16_t>(-diff);
+    if (age >= WINDOW) {
+      return Result::Stale;
+    }
+    const uint32_t bit = 1UL << age;
+    if (mask_ & bit) {
+      return Result::Duplicate;
+    }
+    mask_ |= bit;
+    return Result::Late;
+  }
+
+  uint32_t lost() const { return lost_; }
+  uint16_t highest() const { return highest_; }
+
+ private:
+  static uint32_t popcount(uint32_t v) {
+    uint32_t n = 0;
+    for (; v; v &= v - 1) {
+      n++;
+    }
+    return n;
+  }
+
+  bool started_ = false;
+  uint16_t bootId_ = 0;
+  uint16_t highest_ = 0;
+  uint32_t mask_ = 0;
+  uint32_t lost_ = 0;
+};
+
+// ---- gateway ----
+
+struct SatelliteNode {
+  uint8_t mac[6];
+  bool used;
+  bool fresh;           // a new reading since the last drain
+  uint32_t lastSeenMs;
+  uint32_t acquiredMs;  // gateway millis() when `last` arrived
+  SatReading last;
+  SequenceWindow window;
+  uint32_t received;
+  uint32_t duplicates;
+  uint32_t restarts;
+};
+
+// Node table + dedup + threshold distribution for up to N satellites.
+// onFrame() is called from loop() (the firmware queues frames out of the
+// esp_now receive callback), so nothing here needs locking.
+template <size_t N>
+class SatelliteGateway {
+ public:
+  static const uint32_t NODE_TIMEOUT_MS = 5UL * 60UL * 1000UL;  // evictable after this silence
+
+  // Bumps the version only on a real change so satellites are not re-sent
+  // identical thresholds after every fetch.
+  void setThresholds(const SatThresholds &t) {
+    if (haveThresholds_ && t == thresholds_) {
+      return;
+    }
+    thresholds_ = t;
+    haveThresholds_ = true;
+    version_ = static_cast<uint16_t>(version_ + 1);
+    if (version_ == 0) {
+      version_ = 1;  // 0 means "never received" on the satellite
+    }
+  }
+
+  // Handle one received frame; replies through `radio`. False when the
+  // frame was not ours or the table is full.
+  template <class Radio>
+  bool onFrame(Radio &radio, const uint8_t mac[6], const uint8_t *data, size_t len, uint32_t nowMs) {
+    SatReading r;
+    if (!decodeReading(data, len, r)) {
+      foreign_++;
+      return false;
+    }
+    SatelliteNode *node = findOrAdd(mac, nowMs);
+    if (node == nullptr) {
+      tableFull_++;
+      return false;
+    }
+    node->lastSeenMs = nowMs;
+    switch (node->window.accept(r.bootId, r.seq)) {
+      case SequenceWindow::Result::Restarted:
+        node->restarts++;
+        // fall through
+      case SequenceWindow::Result::New:
+        node->last = r;
+        node->acquiredMs = nowMs;
+        node->fresh = true;
+        node->received++;
+        break;
+      case SequenceWindow::Result::Late:
+        node->received++;  // older than what we hold; counted, not reported
+        break;
+      case SequenceWindow::Result::Duplicate:
+      case SequenceWindow::Result::Stale:
+        node->duplicates++;
+        break;
+    }
+
+    SatControl c;
+    memset(&c, 0, sizeof(c));
+    c.bootId = r.bootId;
+    c.seq = r.seq;
+    c.thresholdsVersion = version_;
+    c.hasThresholds = haveThresholds_ && r.thresholdsVersion != version_;
+    if (c.hasThresholds) {
+      c.thresholds = thresholds_;
+    }
+    uint8_t buf[SAT_CONTROL_LEN];
+    const size_t n = encodeControl(c, buf, sizeof(buf));
+    if (!radio.send(mac, buf, n)) {
+      sendFailures_++;
+    }
+    return true;
+  }
+
+  // Calls fn(const SatelliteNode &) for up to maxNodes nodes with a new
+  // reading, oldest slot first, and leaves the flags set; returns the
+  // number of nodes visited. markDrained() clears them once the batch is
+  // delivered, so a failed publish is retried with the next one.
+  template <class Fn>
+  size_t forEachFresh(Fn fn, size_t maxNodes = N) const {
+    size_t n = 0;
+    for (size_t i = 0; i < N && n < maxNodes; ++i) {
+      if (nodes_[i].used && nodes_[i].fresh) {
+        fn(nodes_[i]);
+        n++;
+      }
+    }
+    return n;
+  }
+
+  // Clears the flags of the first `count` nodes forEachFresh() visits
+  void markDrained(size_t count) {
+    for (size_t i = 0; i < N && count > 0; ++i) {
+      if (nodes_[i].used && nodes_[i].fresh) {
+        nodes_[i].fresh = false;
+        count--;
+      }
+    }
+  }
+
+  size_t freshCount() const {
+    size_t n = 0;
+    for (size_t i = 0; i < N; ++i) {
+      n += (nodes_[i].used && nodes_[i].fresh) ? 1 : 0;
+    }
+    return n;
+  }
+
+  size_t nodeCount() const {
+    size_t n = 0;
+    for (size_t i = 0; i < N; ++i) {
+      n += nodes_[i].used ? 1 : 0;
+    }
+    return n;
+  }
+
+  const SatelliteNode &node(size_t i) const { return nodes_[i]; }
+  uint16_t thresholdsVersion() const { return version_; }
+  uint32_t foreignFrames() const { return foreign_; }
+  uint32_t tableFullDrops() const { return tableFull_; }
+  uint32_t sendFailures() const { return sendFailures_; }
+
+ private:
+  SatelliteNode *findOrAdd(const uint8_t mac[6], uint32_t nowMs) {
+    SatelliteNode *freeSlot = nullptr;
+    SatelliteNode *oldest = nullptr;
+    for (size_t i = 0; i < N; ++i) {
+      SatelliteNode &n = nodes_[i];
+      if (!n.used) {
+        if (freeSlot == nullptr) {
+          freeSlot = &n;
+        }
+        continue;
+      }
+      if (memcmp(n.mac, mac, 6) == 0) {
+        return &n;
+      }
+      if ((nowMs - n.lastSeenMs) >= NODE_TIMEOUT_MS &&
+          (oldest == nullptr || static_cast<int32_t>(n.lastSeenMs - oldest->lastSeenMs) < 0)) {
+        oldest = &n;
+      }
+    }
+    SatelliteNode *slot = freeSlot != nullptr ? freeSlot : oldest;
+    if (slot != nullptr) {
+      *slot = SatelliteNode();
+      memcpy(slot->mac, mac, 6);
+      slot->used = true;
+    }
+    return slot;
+  }
+
+  SatelliteNode nodes_[N] = {};
+  SatThresholds thresholds_ = {};
+  bool haveThresholds_ = false;
+  uint16_t version_ = 0;
+  uint32_t foreign_ = 0;
+  uint32_t tableFull_ = 0;
+  uint32_t sendFailures_ = 0;
+};
+
+// ---- satellite ----
+
+// Sends readings, waits briefly for the gateway's Control frame and
+// retransmits the same seq on silence. After MAX_MISSED unanswered readings
+// the gateway is forgotten and the firmware goes back to scanning channels
+// (the gateway's channel is whatever its AP uses).
+template <class Radio>
+class SatelliteLink {
+ public:
+  static const uint32_t ACK_TIMEOUT_MS = 50;
+  static const uint8_t MAX_RETRIES = 2;
+  static const uint8_t MAX_MISSED = 3;
+
+  enum class Event : uint8_t { None, Acked, ThresholdsUpdated, GatewayLost };
+
+  explicit SatelliteLink(Radio &radio) : radio_(radio) {}
+
+  void begin(uint16_t bootId) {
+    bootId_ = bootId;
+    seq_ = 0;
+    awaiting_ = false;
+    haveGateway_ = false;
+    missed_ = 0;
+  }
+
+  bool send(int16_t tempCenti, uint16_t humCenti, bool climateValid, uint8_t water, uint32_t nowMs) {
+    SatReading r;
+    r.bootId = bootId_;
+    r.seq = ++seq_;
+    r.tempCenti = tempCenti;
+    r.humCenti = humCenti;
+    r.water = water;
+    r.climateValid = climateValid;
+    r.thresholdsVersion = thresholdsVersion_;
+    frameLen_ = encodeReading(r, frame_, sizeof(frame_));
+    retries_ = 0;
+    return transmit(nowMs);
+  }
+
+  // Call every loop pass; handles ack timeouts and retransmissions
+  Event poll(uint32_t nowMs) {
+    if (!awaiting_ || static_cast<int32_t>(nowMs - sentMs_) < static_cast<int32_t>(ACK_TIMEOUT_MS)) {
+      return Event::None;
+    }
+    if (retries_ < MAX_RETRIES) {
+      retries_++;
+      transmit(nowMs);
+      return Event::None;
+    }
+    awaiting_ = false;
+    if (haveGateway_ && ++missed_ >= MAX_MISSED) {
+      missed_ = 0;
+      haveGateway_ = false;
+      return Event::GatewayLost;
+    }
+    return Event::None;
+  }
+
+  Event onFrame(const uint8_t mac[6], const uint8_t *data, size_t len) {
+    SatControl c;
+    if (!decodeControl(data, len, c) || c.bootId != bootId_ || c.seq != seq_) {
+      return Event::None;  // someone else's ack, or an old one
+    }
+    if (haveGateway_ && memcmp(mac, gateway_, 6) != 0) {
+      return Event::None;
+    }
+    memcpy(gateway_, mac, 6);
+    haveGateway_ = true;
+    awaiting_ = false;
+    missed_ = 0;
+    if (c.hasThresholds && c.thresholdsVersion != thresholdsVersion_) {
+      thresholds_ = c.thresholds;
+      thresholdsVersion_ = c.thresholdsVersion;
+      return Event::ThresholdsUpdated;
+    }
+    return Event::Acked;
+  }
+
+  // Thresholds restored from flash after a reboot
+  void restoreThresholds(const SatThresholds &t, uint16_t version) {
+    thresholds_ = t;
+    thresholdsVersion_ = version;
+  }
+
+  bool haveGateway() const { return haveGateway_; }
+  const uint8_t *gateway() const { return gateway_; }
+  const SatThresholds &thresholds() const { return thresholds_; }
+  uint16_t thresholdsVersion() const { return thresholdsVersion_; }
+  bool awaitingAck() const { return awaiting_; }
+
+ private:
+  bool transmit(uint32_t nowMs) {
+    sentMs_ = nowMs;
+    awaiting_ = true;
+    return radio_.send(haveGateway_ ? gateway_ : SAT_BROADCAST, frame_, frameLen_);
+  }
+
+  Radio &radio_;
+  uint8_t frame_[SAT_READING_LEN];
+  size_t frameLen_ = 0;
+  uint16_t bootId_ = 0;
+  uint16_t seq_ = 0;
+  bool awaiting_ = false;
+  uint32_t sentMs_ = 0;
+  uint8_t retries_ = 0;
+  uint8_t missed_ = 0;
+  bool haveGateway_ = false;
+  uint8_t gateway_[6] = {};
+  SatThresholds thresholds_ = {};
+  uint16_t thresholdsVersion_ = 0;
+};
+
+// ---- capacity ----
+
+// On-air time of one ESP-NOW unicast at the 1 Mbps default rate: long
+// preamble (192 us) + vendor action frame (43 bytes of 802.11/vendor header
+// + FCS around the payload), then SIFS + MAC ACK and DIFS + mean backoff.
+constexpr uint32_t espNowAirtimeUs(uint32_t payloadBytes) {
+  return 192 + (43 + payloadBytes) * 8 + 10 + (192 + 14 * 8) + 50 + 310;
+}
+
+// Satellites one gateway can serve when each reports every periodMs, if
+// the ESP-NOW exchanges (reading + control) may use budgetPct of airtime.
+// The gateway shares the channel with its own Wi-Fi uplink and other
+// networks, so budgets above ~20% are optimistic.
+constexpr uint32_t satelliteCapacityByAirtime(uint32_t periodMs, uint32_t budgetPct) {
+  return static_cast<uint32_t>(
+      (static_cast<uint64_t>(periodMs) * 1000ULL * budgetPct / 100ULL) /
+      (espNowAirtimeUs(SAT_READING_LEN) + espNowAirtimeUs(SAT_CONTROL_LEN)));
+}
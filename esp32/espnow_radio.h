@@ -0,0 +1,140 @@
+#pragma once
+// esp_now adapter for espnow_link.h (the firmware side of SimEspNow).
+//
+// The receive callback runs in the Wi-Fi task, so it only copies frames into
+// a small ring; loop() drains it with poll() and all protocol work happens
+// there. esp_now_send() needs a registered peer, and the peer list is capped
+// (ESP_NOW_MAX_TOTAL_PEER_NUM), so peers are added on demand and recycled
+// oldest-first.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+#include <string.h>
+
+class EspNowRadio {
+ public:
+  static const size_t QUEUE_DEPTH = 16;
+  static const size_t MAX_FRAME = 32;   // our frames are < 20 bytes
+  static const size_t PEER_SLOTS = 16;  // below the 20-peer driver limit
+
+  // Wi-Fi must already be in STA (or AP_STA) mode
+  bool begin() {
+    instance() = this;
+    if (esp_now_init() != ESP_OK) {
+      return false;
+    }
+    esp_now_register_recv_cb(&EspNowRadio::onReceive);
+    started_ = true;
+    return true;
+  }
+
+  bool started() const { return started_; }
+
+  // Satellites only: gateways follow their AP's channel
+  void setChannel(uint8_t channel) { esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE); }
+
+  bool send(const uint8_t mac[6], const uint8_t *data, size_t len) {
+    if (!started_ || !ensurePeer(mac)) {
+      return false;
+    }
+    return esp_now_send(mac, data, len) == ESP_OK;
+  }
+
+  // Calls fn(const uint8_t mac[6], const uint8_t *data, size_t len) for
+  // every queued frame; returns the number handled.
+  template <class Fn>
+  size_t poll(Fn fn) {
+    size_t handled = 0;
+    Frame f;
+    while (pop(f)) {
+      fn(f.mac, f.data, static_cast<size_t>(f.len));
+      handled++;
+    }
+    return handled;
+  }
+
+  uint32_t dropped() const { return dropped_; }
+
+ private:
+  struct Frame {
+    uint8_t mac[6];
+    uint8_t len;
+    uint8_t data[MAX_FRAME];
+  };
+
+  static EspNowRadio *&instance() {
+    static EspNowRadio *self = nullptr;
+    return self;
+  }
+
+#if defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 3
+  static void onReceive(const esp_now_recv_info_t *info, const uint8_t *data, int len) {
+    push(info->src_addr, data, len);
+  }
+#else
+  static void onReceive(const uint8_t *mac, const uint8_t *data, int len) { push(mac, data, len); }
+#endif
+
+  static void push(const uint8_t *mac, const uint8_t *data, int len) {
+    EspNowRadio *self = instance();
+    if (self == nullptr || len <= 0 || static_cast<size_t>(len) > MAX_FRAME) {
+      return;
+    }
+    portENTER_CRITICAL(&self->mux_);
+    if (self->count_ == QUEUE_DEPTH) {
+      self->dropped_++;
+    } else {
+      Frame &f = self->queue_[(self->head_ + self->count_) % QUEUE_DEPTH];
+      memcpy(f.mac, mac, 6);
+      f.len = static_cast<uint8_t>(len);
+      memcpy(f.data, data, len);
+      self->count_++;
+    }
+    portEXIT_CRITICAL(&self->mux_);
+  }
+
+  bool pop(Frame &out) {
+    bool have = false;
+    portENTER_CRITICAL(&mux_);
+    if (count_ > 0) {
+      out = queue_[head_];
+      head_ = (head_ + 1) % QUEUE_DEPTH;
+      count_--;
+      have = true;
+    }
+    portEXIT_CRITICAL(&mux_);
+    return have;
+  }
+
+  bool ensurePeer(const uint8_t mac[6]) {
+    if (esp_now_is_peer_exist(mac)) {
+      return true;
+    }
+    if (peerCount_ == PEER_SLOTS) {
+      esp_now_del_peer(peers_[nextPeer_]);  // recycle the oldest
+    } else {
+      peerCount_++;
+    }
+    esp_now_peer_info_t peer;
+    memset(&peer, 0, sizeof(peer));
+    memcpy(peer.peer_addr, mac, 6);
+    peer.channel = 0;  // current channel
+    peer.ifidx = WIFI_IF_STA;
+    peer.encrypt = false;
+    memcpy(peers_[nextPeer_], mac, 6);
+    nextPeer_ = (nextPeer_ + 1) % PEER_SLOTS;
+    return esp_now_add_peer(&peer) == ESP_OK;
+  }
+
+  Frame queue_[QUEUE_DEPTH];
+  size_t head_ = 0;
+  size_t count_ = 0;
+  uint32_t dropped_ = 0;
+  uint8_t peers_[PEER_SLOTS][6] = {};
+  size_t peerCount_ = 0;
+  size_t nextPeer_ = 0;
+  bool started_ = false;
+  portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+};
@@ -0,0 +1,256 @@
+#pragma once
+// Non-blocking drivers for Sensirion I2C climate sensors.
+//
+// Pure logic, templated on the bus so the same drivers run on Wire
+// (wire_bus.h) and on the host against SimI2cBus (sim_i2c_bus.h). A Bus
+// needs two calls, each one short I2C transaction:
+//
+//   bool write(uint8_t addr, const uint8_t *data, size_t len);
+//   bool read(uint8_t addr, uint8_t *data, size_t len);
+//
+// A measurement is trigger() (command write) followed by poll() from the
+// main loop. poll() returns Busy until the conversion time has passed, then
+// does the read, so loop() never sleeps through a conversion. Every driver
+// exposes the same begin()/trigger()/poll() surface, so the firmware picks
+// one with a typedef and the reading pipeline does not change.
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct ClimateReading {
+  float temperatureC;
+  float humidityPct;
+  uint16_t co2Ppm;    // 0 when the sensor has no CO2 channel
+  uint32_t acquiredMs;
+};
+
+enum class SensorStatus : uint8_t { Idle, Busy, Ready, Error };
+
+// Sensirion CRC-8: polynomial 0x31, init 0xFF, over each 16-bit word
+inline uint8_t sensirionCrc(const uint8_t *data, size_t len) {
+  uint8_t crc = 0xFF;
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; ++b) {
+      crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x31) : static_cast<uint8_t>(crc << 1);
+    }
+  }
+  return crc;
+}
+
+// Unpack `words` CRC-protected big-endian words; false on any CRC mismatch
+inline bool sensirionWords(const uint8_t *buf, uint16_t *out, size_t words) {
+  for (size_t i = 0; i < words; ++i) {
+    const uint8_t *w = buf + i * 3;
+    if (sensirionCrc(w, 2) != w[2]) {
+      return false;
+    }
+    out[i] = static_cast<uint16_t>((w[0] << 8) | w[1]);
+  }
+  return true;
+}
+
+inline float sensirionTemperature(uint16_t raw) { return -45.0f + 175.0f * raw / 65535.0f; }
+
+// Shared single-shot state machine: write a command, wait, read T + RH
+template <class Bus, class Chip>
+class SensirionSingleShot {
+ public:
+  explicit SensirionSingleShot(Bus &bus, uint8_t addr = Chip::DEFAULT_ADDR) : bus_(bus), addr_(addr) {}
+
+  // Soft reset; also the recovery path after Error
+  bool begin(uint32_t nowMs) {
+    state_ = SensorStatus::Idle;
+    readyAtMs_ = nowMs + Chip::RESET_MS;
+    return bus_.write(addr_, Chip::softReset(), Chip::COMMAND_LEN);
+  }
+
+  bool trigger(uint32_t nowMs) {
+    if (state_ == SensorStatus::Busy) {
+      return true;
+    }
+    if (static_cast<int32_t>(nowMs - readyAtMs_) < 0) {
+      return false;  // still inside the post-reset window
+    }
+    if (!bus_.write(addr_, Chip::measure(), Chip::COMMAND_LEN)) {
+      state_ = SensorStatus::Error;
+      return false;
+    }
+    readyAtMs_ = nowMs + Chip::CONVERSION_MS;
+    state_ = SensorStatus::Busy;
+    return true;
+  }
+
+  SensorStatus poll(uint32_t nowMs, ClimateReading &out) {
+    if (state_ != SensorStatus::Busy) {
+      return state_;
+    }
+    if (static_cast<int32_t>(nowMs - readyAtMs_) < 0) {
+      return SensorStatus::Busy;
+    }
+    uint8_t buf[6];
+    uint16_t words[2];
+    if (!bus_.read(addr_, buf, sizeof(buf)) || !sensirionWords(buf, words, 2)) {
+      state_ = SensorStatus::Error;
+      return state_;
+    }
+    out.temperatureC = sensirionTemperature(words[0]);
+    out.humidityPct = Chip::humidity(words[1]);
+    out.co2Ppm = 0;
+    out.acquiredMs = nowMs;
+    state_ = SensorStatus::Idle;
+    return SensorStatus::Ready;
+  }
+
+ private:
+  Bus &bus_;
+  const uint8_t addr_;
+  SensorStatus state_ = SensorStatus::Idle;
+  uint32_t readyAtMs_ = 0;
+};
+
+struct Sht3xChip {
+  static const uint8_t DEFAULT_ADDR = 0x44;
+  static const size_t COMMAND_LEN = 2;
+  static const uint8_t *measure() {
+    static const uint8_t cmd[] = {0x24, 0x00};  // single shot, high repeatability, no stretch
+    return cmd;
+  }
+  static const uint8_t *softReset() {
+    static const uint8_t cmd[] = {0x30, 0xA2};
+    return cmd;
+  }
+  static const uint32_t CONVERSION_MS = 16;
+  static const uint32_t RESET_MS = 2;
+  static float humidity(uint16_t raw) { return 100.0f * raw / 65535.0f; }
+};
+
+struct Sht4xChip {
+  static const uint8_t DEFAULT_ADDR = 0x44;
+  static const size_t COMMAND_LEN = 1;
+  static const uint8_t *measure() {
+    static const uint8_t cmd[] = {0xFD};  // high precision
+    return cmd;
+  }
+  static const uint8_t *softReset() {
+    static const uint8_t cmd[] = {0x94};
+    return cmd;
+  }
+  static const uint32_t CONVERSION_MS = 9;
+  static const uint32_t RESET_MS = 1;
+  static float humidity(uint16_t raw) {
+    const float rh = -6.0f + 125.0f * raw / 65535.0f;
+    return rh < 0.0f ? 0.0f : (rh > 100.0f ? 100.0f : rh);
+  }
+};
+
+template <class Bus>
+using Sht3x = SensirionSingleShot<Bus, Sht3xChip>;
+template <class Bus>
+using Sht4x = SensirionSingleShot<Bus, Sht4xChip>;
+
+// SCD4x runs in periodic mode (one result every 5 s). trigger() asks whether
+// a result is ready; poll() fetches it once the command delay has passed.
+template <class Bus>
+class Scd4x {
+ public:
+  static const uint8_t DEFAULT_ADDR = 0x62;
+  static const uint32_t COMMAND_MS = 1;
+  static const uint32_t STOP_MS = 500;
+
+  explicit Scd4x(Bus &bus, uint8_t addr = DEFAULT_ADDR) : bus_(bus), addr_(addr) {}
+
+  // Stops any running measurement, then starts periodic mode once the stop
+  // delay has passed (handled by the first trigger()).
+  bool begin(uint32_t nowMs) {
+    static const uint8_t stop[2] = {0x3F, 0x86};
+    phase_ = Phase::Stopping;
+    readyAtMs_ = nowMs + STOP_MS;
+    return bus_.write(addr_, stop, sizeof(stop));
+  }
+
+  bool trigger(uint32_t nowMs) {
+    if (!due(nowMs)) {
+      return phase_ != Phase::Error;
+    }
+    if (phase_ == Phase::Stopping) {
+      static const uint8_t start[2] = {0x21, 0xB1};
+      if (!bus_.write(addr_, start, sizeof(start))) {
+        phase_ = Phase::Error;
+        return false;
+      }
+      phase_ = Phase::Idle;
+      return true;
+    }
+    if (phase_ != Phase::Idle) {
+      return phase_ != Phase::Error;
+    }
+    static const uint8_t dataReady[2] = {0xE4, 0xB8};
+    if (!bus_.write(addr_, dataReady, sizeof(dataReady))) {
+      phase_ = Phase::Error;
+      return false;
+    }
+    phase_ = Phase::CheckingReady;
+    readyAtMs_ = nowMs + COMMAND_MS;
+    return true;
+  }
+
+  SensorStatus poll(uint32_t nowMs, ClimateReading &out) {
+    switch (phase_) {
+      case Phase::Error:
+        return SensorStatus::Error;
+      case Phase::Idle:
+      case Phase::Stopping:
+        return SensorStatus::Idle;
+      default:
+        break;
+    }
+    if (!due(nowMs)) {
+      return SensorStatus::Busy;
+    }
+
+    if (phase_ == Phase::CheckingReady) {
+      uint8_t buf[3];
+      uint16_t status;
+      if (!bus_.read(addr_, buf, sizeof(buf)) || !sensirionWords(buf, &status, 1)) {
+        phase_ = Phase::Error;
+        return SensorStatus::Error;
+      }
+      if ((status & 0x07FF) == 0) {
+        phase_ = Phase::Idle;  // nothing new yet; ask again on the next trigger()
+        return SensorStatus::Idle;
+      }
+      static const uint8_t readMeasurement[2] = {0xEC, 0x05};
+      if (!bus_.write(addr_, readMeasurement, sizeof(readMeasurement))) {
+        phase_ = Phase::Error;
+        return SensorStatus::Error;
+      }
+      phase_ = Phase::Reading;
+      readyAtMs_ = nowMs + COMMAND_MS;
+      return SensorStatus::Busy;
+    }
+
+    uint8_t buf[9];
+    uint16_t words[3];
+    if (!bus_.read(addr_, buf, sizeof(buf)) || !sensirionWords(buf, words, 3)) {
+      phase_ = Phase::Error;
+      return SensorStatus::Error;
+    }
+    out.co2Ppm = words[0];
+    out.temperatureC = sensirionTemperature(words[1]);
+    out.humidityPct = 100.0f * words[2] / 65535.0f;
+    out.acquiredMs = nowMs;
+    phase_ = Phase::Idle;
+    return SensorStatus::Ready;
+  }
+
+ private:
+  enum class Phase : uint8_t { Stopping, Idle, CheckingReady, Reading, Error };
+
+  bool due(uint32_t nowMs) const { return static_cast<int32_t>(nowMs - readyAtMs_) >= 0; }
+
+  Bus &bus_;
+  const uint8_t addr_;
+  Phase phase_ = Phase::Stopping;
+  uint32_t readyAtMs_ = 0;
+};
@@ -7,6 +7,39 @@
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include <ctype.h>
+#include <stdarg.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/timers.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <esp_task_wdt.h>
+#include <esp_debug_helpers.h>
+#include "pattern_player.h"
+#include "time_service.h"
+#include "zones.h"
+#include "relay_control.h"
+#include "mem_profile.h"
+#include "crash_record.h"
+#include "timeline_trace.h"
+#include "alarm_engine.h"
+#include "sensor_health.h"
+#include "rpc_channel.h"
+
+// Built outside PlatformIO: default to the relay board this firmware drives
+#if !defined(MILLO_BOARD_CONTROLLER_V1) && !defined(MILLO_BOARD_BLE_KIT)
+#define MILLO_BOARD_CONTROLLER_V1
+#endif
+#include "board_profile.h"
+// Panics are written to the coredump partition when the core is built for it
+#if defined(CONFIG_ESP_COREDUMP_ENABLE_TO_FLASH) && defined(CONFIG_ESP_COREDUMP_DATA_FORMAT_ELF)
+#include <esp_core_dump.h>
+#define CRASH_HAVE_COREDUMP 1
+#else
+#define CRASH_HAVE_COREDUMP 0
+#endif
+static_assert(board::WATER_SENSOR == board::WaterSensor::FloatSwitch,
+              "main.cpp reads the water level from a float switch");
 
 #define MQTT_HOST   "api.milloserver.uk"
 #define MQTT_PORT   8883
@@ -15,38 +48,161 @@
 
 #define PUBLISH_MS  10000
 
+// Field trace for replay/replay_main.cpp: build with TRACE_RECORD=1 and keep
+// the serial lines starting with "TRACE " (sensor reads, water edges,
+// threshold responses, link changes).
+#ifndef TRACE_RECORD
+#define TRACE_RECORD 0
+#endif
+#if TRACE_RECORD
+#define TRACE_AT(ms, fmt, ...) Serial.printf("TRACE %lu " fmt "\n", static_cast<unsigned long>(ms), ##__VA_ARGS__)
+#else
+#define TRACE_AT(ms, fmt, ...) do {} while (0)
+#endif
+#define TRACE_EVENT(fmt, ...) TRACE_AT(millis(), fmt, ##__VA_ARGS__)
+
 // ----------- Sensors -----------
-#define USE_DHT     1
-#define DHT_PIN     4        // DHT data pin
-#define LIGHT_PIN   34       // optional digital sensor (digital 0/1)
+// Temperature/humidity source; override with -DCLIMATE_SENSOR=... per env
+#define CLIMATE_SENSOR_DHT22 0
+#define CLIMATE_SENSOR_SHT3X 1   // I2C, ~16 ms per reading
+#define CLIMATE_SENSOR_SHT4X 2   // I2C, ~9 ms per reading
+#ifndef CLIMATE_SENSOR
+#define CLIMATE_SENSOR CLIMATE_SENSOR_DHT22
+#endif
+#ifndef USE_SCD4X
+#define USE_SCD4X   0        // optional I2C CO2 sensor, published on <topic>/sample
+#endif
+#define USE_DHT     (CLIMATE_SENSOR == CLIMATE_SENSOR_DHT22)
+#define USE_I2C     (!USE_DHT || USE_SCD4X)
+#define DHT_PIN     board::DHT_PIN
+#define LIGHT_PIN   board::LIGHT_PIN   // optional digital sensor (digital 0/1)
 
 #if USE_DHT
   #include <DHT.h>
   #define DHT_TYPE DHT22
-  static DHT dht(DHT_PIN, DHT_TYPE);
+#endif
+
+#if USE_I2C
+  #include "wire_bus.h"
+  #include "i2c_sensors.h"
+  static WireBus g_i2c;
+  #if CLIMATE_SENSOR == CLIMATE_SENSOR_SHT4X
+    typedef Sht4x<WireBus> I2cClimateSensor;
+  #elif CLIMATE_SENSOR == CLIMATE_SENSOR_SHT3X
+    typedef Sht3x<WireBus> I2cClimateSensor;
+  #endif
+  #if USE_SCD4X
+    static Scd4x<WireBus> g_co2Sensor(g_i2c);
+    static uint16_t g_co2Ppm = 0;
+  #endif
+#endif
+
+// ESP-NOW gateway: satellite nodes (satellite_main.cpp) report over ESP-NOW on
+// this controller's AP channel; readings are batched onto
+// topic/<id>/satellites and zone 0's thresholds are pushed back to them.
+#ifndef ESPNOW_GATEWAY
+#define ESPNOW_GATEWAY 0
+#endif
+#if ESPNOW_GATEWAY
+  #include "espnow_link.h"
+  #include "espnow_radio.h"
+  static const size_t GATEWAY_MAX_SATELLITES = 32;  // ~100 bytes of table each
+  static const size_t SAT_BATCH_PER_MESSAGE = 6;    // entries per MQTT publish
+  static const uint16_t GATEWAY_MQTT_BUFFER = 1024;
+  static EspNowRadio g_espNow;
+  static SatelliteGateway<GATEWAY_MAX_SATELLITES> g_satGateway;
 #endif
 
 // ----------- Relays ------------
-#define RELAY1_PIN  25        // IN1 (Temp control)
-#define RELAY2_PIN  26        // IN2 (Humidity control)
-#define BUZZER_PIN  33        // GPIO 33 - Buzzer for alarms
-#define RELAY4_PIN  32        // IN4 (mirror of RELAY2)
-#define RELAY5_PIN  22        // IN5 (mirror of RELAY1)
+// Roles per board_profile.h: IN1 = FAN2, IN2 = HUMIDIFIER2, IN4 = HUMIDIFIER1, IN5 = FAN1
+#define RELAY1_PIN  board::FAN2_PIN         // IN1 (Temp control)
+#define RELAY2_PIN  board::HUMIDIFIER2_PIN  // IN2 (Humidity control)
+#define BUZZER_PIN  board::BUZZER_PIN       // Buzzer for alarms
+#define RELAY4_PIN  board::HUMIDIFIER1_PIN  // IN4 (mirror of RELAY2)
+#define RELAY5_PIN  board::FAN1_PIN         // IN5 (mirror of RELAY1)
 
 // -------- Water Level Switch --------
-#define WATER_PIN   27        // Float switch input (closed -> LOW, open -> HIGH)
+#define WATER_PIN   board::WATER_PIN  // Float switch input (closed -> LOW, open -> HIGH)
 const unsigned long WATER_DEBOUNCE_MS = 100;  // milliseconds the reading must stay stable
+const UBaseType_t WATER_EVENT_QUEUE_LEN = 8;
 constexpr int WATER_FALLBACK_STATE = 0;       // value to publish while the sensor is untrusted (0 => assume full)
-constexpr uint8_t WIFI_RESET_PIN = 0;
+constexpr uint8_t WIFI_RESET_PIN = board::RESET_BUTTON_PIN;
 constexpr uint32_t WIFI_RESET_HOLD_MS = 3000;
+constexpr uint32_t BENCH_HOLD_MS = 1000;  // release between this and WIFI_RESET_HOLD_MS -> self-benchmark
+
+// ----------- Zones -------------
+// A zone is one chamber: its sensors are fused into one T/H pair that drives
+// the zone's relays, thresholds and telemetry. Every sensor is a
+// CLIMATE_SENSOR part; `source` is its DHT data pin or I2C address. Zone 0
+// owns RELAY1-5 and keeps the topic/<id> array the app reads; zone n
+// publishes on topic/<id>/zone/<n>. Relay pins of NO_PIN make a zone
+// monitor-only.
+struct ZoneSensorConfig {
+  uint8_t zone;
+  uint8_t source;
+};
+static const ZoneSensorConfig ZONE_SENSORS[] = {
+#if USE_DHT
+  {0, DHT_PIN},
+#else
+  {0, 0x44},
+#endif
+};
+static const size_t SENSOR_COUNT = sizeof(ZONE_SENSORS) / sizeof(ZONE_SENSORS[0]);
+
+struct ZoneRelayPins {
+  uint8_t relay1;  // temp NC
+  uint8_t relay2;  // humidity NC
+  uint8_t relay4;  // humidity default ON
+  uint8_t relay5;  // temp default ON
+};
+static const ZoneRelayPins ZONE_RELAYS[] = {
+  {RELAY1_PIN, RELAY2_PIN, RELAY4_PIN, RELAY5_PIN},
+};
+static const size_t ZONE_COUNT = sizeof(ZONE_RELAYS) / sizeof(ZONE_RELAYS[0]);
+
+static const uint32_t SENSOR_MIN_INTERVAL_MS = USE_DHT ? 2500 : 1000;  // per-part minimum between reads
+static const uint32_t SENSOR_READ_SPACING_MS = 250;                    // gap between any two reads
+static const uint32_t SENSOR_MAX_AGE_MS = 3 * PUBLISH_MS;              // older readings are not fused
+static const float ZONE_TEMP_SPREAD_C = 1.5f;      // disagreement tolerated before outlier rejection
+static const float ZONE_HUM_SPREAD_PCT = 4.0f;
+
+// Sensor health (sensor_health.h), checked on every reading
+static const SensorHealthConfig SENSOR_HEALTH = sensorHealthDefaults(SENSOR_MIN_INTERVAL_MS);
+
+// Adaptive cycle (zones.h): control and publish run between the configured
+// fast and slow periods, fast near a limit or while a value moves. Sensors
+// are read at their native rate regardless and summarised per cycle. The
+// fast bound never goes below SENSOR_MIN_INTERVAL_MS (DHT22: 2 s + margin).
+static const uint32_t SAMPLE_FAST_DEFAULT_MS = USE_DHT ? 2500 : 2000;
+static const uint32_t SAMPLE_SLOW_DEFAULT_MS = 30000;
+static const uint32_t SAMPLE_SLOW_LIMIT_MS = 60000;
+static const float SAMPLE_NEAR_TEMP_C = 1.0f;            // distance to a limit that counts as near
+static const float SAMPLE_NEAR_HUM_PCT = 3.0f;
+static const float SAMPLE_FAST_TEMP_C_PER_MIN = 0.5f;    // change that counts as rapid
+static const float SAMPLE_FAST_HUM_PCT_PER_MIN = 2.0f;
+static const uint32_t SAMPLE_RATE_WINDOW_MS = 30000;
+static const uint32_t THRESHOLD_FETCH_MS = PUBLISH_MS;   // thresholds keep their own cadence
+static const uint32_t RELAY_DECISION_MS = PUBLISH_MS;    // and so do relays (see loop())
+static const uint16_t SAMPLE_MQTT_BUFFER = 512;          // /sample with window stats exceeds 256 bytes
 
 // Threshold defaults (used until overwritten by API fetch)
-static float g_tempMinThreshold = 22.0f;
-static float g_tempMaxThreshold = 27.0f;
-static bool  g_tempThresholdEnabled = true;
-static float g_humMinThreshold = 80.0f;
-static float g_humMaxThreshold = 83.0f;
-static bool  g_humThresholdEnabled = true;
+struct ZoneThresholds {
+  float tempMin;
+  float tempMax;
+  bool tempEnabled;
+  float humMin;
+  float humMax;
+  bool humEnabled;
+};
+static const ZoneThresholds DEFAULT_THRESHOLDS = {22.0f, 27.0f, true, 80.0f, 83.0f, true};
+
+// Relay strategy (relay_control.h): 0 threshold, 1 hysteresis, 2 time-proportional.
+// Compare them on the host with replay/twin_main.cpp before changing the default.
+#ifndef RELAY_STRATEGY
+#define RELAY_STRATEGY 0
+#endif
+static RelayControlConfig g_relayControl = {static_cast<RelayStrategy>(RELAY_STRATEGY), 1.0f, 1.0f, 30};
 
 static const char *const CONTROLLER_THRESHOLD_URL = "https://api.milloserver.uk/api/controller-thresholds";
 static const int TEMP_SENSOR_ARRANGEMENT = 2;
@@ -71,6 +227,11 @@ WebServer server(80);
 unsigned long g_lastPubMs = 0;
 char topicBuf[96];
 char payload[64];
+
+// SNTP runs in the background once STA is up; samples carry their read time
+static TimeService g_time;
+static const char *const NTP_SERVER_1 = "pool.ntp.org";
+static const char *const NTP_SERVER_2 = "time.google.com";
 static String g_controllerId;
 static String g_controllerIdCompact;
 
@@ -81,6 +242,8 @@ struct AppConfig {
   String controllerName;
   String factoryName;
   bool registered;
+  uint32_t sampleFastMs;  // adaptive sampling bounds
+  uint32_t sampleSlowMs;
 };
 
 static AppConfig g_cfg;
@@ -92,31 +255,212 @@ static int g_wifiFailCount = 0;
 static unsigned long g_nextRegistrationAttemptMs = 0;
 static int g_registrationAttempts = 0;
 
+// Live config apply: Wi-Fi changes go through a staged connect that falls
+// back to the previous network (or the setup hotspot) instead of a reboot.
+enum WiFiSwitchState : uint8_t {
+  WIFI_SWITCH_IDLE,
+  WIFI_SWITCH_PENDING,     // waiting for the HTTP response to flush
+  WIFI_SWITCH_CONNECTING,  // associating with the new network
+  WIFI_SWITCH_REVERTING    // new network failed, rejoining the old one
+};
+static WiFiSwitchState g_wifiSwitchState = WIFI_SWITCH_IDLE;
+static unsigned long g_wifiSwitchSince = 0;
+static bool g_wifiSwitchFromAp = false;
+static String g_wifiSwitchPrevSsid;
+static String g_wifiSwitchPrevPass;
+static unsigned long g_factoryResetAt = 0;
+static const unsigned long CONFIG_APPLY_DELAY_MS = 750;   // let the HTTP reply leave before touching Wi-Fi
+static const unsigned long WIFI_SWITCH_TIMEOUT_MS = 15000;
+
+// Self-benchmark: one boot that times the real TLS handshake, MQTT round
+// trip, NVS, JSON parse and sensor read, requested via POST /bench or a
+// short BOOT press. Results stay on GET /bench and go to topic/<id>/bench.
+static const uint32_t BENCH_START_TIMEOUT_MS = 60000;  // run without MQTT if it is not up by then
+static const uint32_t BENCH_ECHO_TIMEOUT_MS = 5000;
+static const int BENCH_NVS_ROUNDS = 10;
+static const int BENCH_JSON_ROUNDS = 20;
+static const uint16_t BENCH_MQTT_BUFFER = 768;         // report exceeds the 256-byte default
+static bool g_benchPending = false;
+static unsigned long g_benchRebootAt = 0;
+static String g_benchJson;
+static char g_benchNonce[16];
+static volatile uint32_t g_benchEchoUs = 0;  // arrival of the echo, 0 until seen
+
+// Remote commands (rpc_channel.h): requests on topic/<id>/cmd, responses on
+// topic/<id>/resp. The inbox is filled from the MQTT callback, which runs
+// inside mqtt.loop() on the loop task, so it needs no lock.
+static const size_t RPC_INBOX_LEN = 4;
+static const size_t RPC_BODY_SIZE = 192;
+static const size_t RPC_ID_SIZE = 40;
+static const size_t RPC_RESPONSE_SIZE = 224;
+static const uint32_t RPC_OVERRIDE_DEFAULT_S = 600;
+static const uint32_t RPC_OVERRIDE_MAX_S = 24UL * 3600UL;
+static const uint32_t RPC_REBOOT_DELAY_MS = 500;         // let the response leave first
+static RpcInbox<RPC_INBOX_LEN, RPC_BODY_SIZE> g_rpcInbox;
+static RpcReplayCache<8, RPC_ID_SIZE, RPC_RESPONSE_SIZE> g_rpcDone;
+static char g_rpcCmdTopic[112];
+static bool g_publishNow = false;
+static unsigned long g_rpcRebootAt = 0;
+
+// Bits returned by diffConfig()
+static const uint8_t CFG_CHANGED_WIFI = 0x01;      // ssid or password
+static const uint8_t CFG_CHANGED_IDENTITY = 0x02;  // email, controller or factory name
+static const uint8_t CFG_CHANGED_SAMPLING = 0x04;  // adaptive sampling bounds
+
 // Track last water indicator state to reduce serial spam
 bool g_lastWaterOutputOn = false;
 int g_lastWaterRaw = WATER_FALLBACK_STATE;
-int g_waterPendingRaw = WATER_FALLBACK_STATE;
-unsigned long g_waterPendingSince = 0;
 bool g_waterValid = false;
 
+// Float switch edges arm a one-shot debounce timer from the ISR; when it
+// expires (timer task) a validated state change is queued for loop().
+struct WaterEvent {
+  uint8_t raw;
+  uint32_t edgeMs;       // last edge seen before the line settled
+  uint32_t validatedMs;  // when the debounce timer confirmed it
+};
+static QueueHandle_t g_waterQueue = nullptr;
+static TimerHandle_t g_waterDebounceTimer = nullptr;
+static volatile uint32_t g_waterLastEdgeMs = 0;
+static int g_waterPostedRaw = -1;  // only touched from the timer task
+
 // DHT recovery tracking
 static bool g_dhtInitialized = false;
+
+// Latest reading per sensor; the scheduler keeps one read in flight at a time
+// (DHT22 completes inside startSensorRead(), I2C a few ms later in pollSensorRead())
+struct SensorState {
+  float t;
+  float h;
+  uint32_t acquiredMs;
+  bool ok;
+  int failures;
+  bool lastReadSuccess;
+  SensorHealth health;
+  uint8_t reportedHealth;  // flags last published on topic/<id>/health
+};
+static SensorState g_sensors[SENSOR_COUNT];
+static SampleScheduler<SENSOR_COUNT> g_sampler;
+static AdaptivePeriod g_samplePeriod;
+static unsigned long g_lastThresholdFetchMs = 0;
+static unsigned long g_lastRelayMs = 0;
+static int g_readPending = -1;
+static uint32_t g_readStartMs = 0;
+#if USE_DHT
+static DHT *g_dht[SENSOR_COUNT];
+#else
+static I2cClimateSensor *g_climateSensors[SENSOR_COUNT];
+#endif
+static const uint32_t I2C_READ_TIMEOUT_MS = 100;
+static const int I2C_MAX_FAILURES_BEFORE_RESET = 3;
+
+// Fused per-zone values + the zone's thresholds and relay states
+struct ZoneState {
+  ZoneThresholds th;
+  bool relay1On;
+  bool relay2On;
+  bool relay4On;
+  bool relay5On;
+  RelayCycle cycle;
+  RelayOutputs decided;      // the strategy's last decision, before overrides
+  RelayOverrides overrides;  // remote "relay" commands
+  float t;
+  float h;
+  RateTracker tRate{SAMPLE_RATE_WINDOW_MS};
+  RateTracker hRate{SAMPLE_RATE_WINDOW_MS};
+  WindowStats tWindow;  // fused values since the last publish
+  WindowStats hWindow;
+  bool valid;
+  uint8_t sensorsUsed;
+  uint8_t sensorsRejected;
+  uint32_t acquiredMs;
+};
+static ZoneState g_zones[ZONE_COUNT];
+
+// Alarms (alarm_engine.h): raised after a condition holds for the raise
+// hold-off, cleared once it has been gone (past the hysteresis) for the
+// clear hold-off. Only transitions are published, on topic/<id>/alarm.
+static const uint32_t ALARM_RAISE_HOLD_MS = 120000;
+static const uint32_t ALARM_CLEAR_HOLD_MS = 60000;
+static const float ALARM_TEMP_HYSTERESIS_C = 0.5f;
+static const float ALARM_HUM_HYSTERESIS_PCT = 2.0f;
+// Types before WaterLow are per zone; water is per controller
+static const size_t ZONE_ALARM_COUNT = static_cast<size_t>(AlarmType::WaterLow);
+static AlarmLatch g_zoneAlarms[ZONE_COUNT][ZONE_ALARM_COUNT];
+static AlarmLatch g_waterAlarm;
 static unsigned long g_lastDhtInitTime = 0;
-static int g_consecutiveDhtFailures = 0;
 static const int DHT_MAX_FAILURES_BEFORE_REINIT = 3;
 static const int DHT_MAX_FAILURES_BEFORE_REBOOT = 10;  // ~100 seconds = ~1.7 min
 static const unsigned long DHT_REINIT_DELAY_MS = 5000;
 
-// Buzzer alert tracking
+// Buzzer alert tracking (patterns play from an esp_timer, not loop())
+static PatternPlayer g_buzzer(BUZZER_PIN);
+static const TonePattern BUZZER_SUCCESS     = {0, 150, 0, 1, 1};     // single short beep
+static const TonePattern BUZZER_DHT_ERROR   = {0, 100, 150, 3, 2};   // 3 quick beeps
+static const TonePattern BUZZER_WATER_EMPTY = {0, 200, 300, 2, 3};   // 2 short beeps
+static const TonePattern BUZZER_CRITICAL    = {0, 3000, 0, 1, 4};    // 3 s continuous
 static unsigned long g_lastDhtFailureBeepMs = 0;
+static unsigned long g_sensorRebootAt = 0;  // set once the critical alert starts
 static const unsigned long DHT_FAILURE_BEEP_INTERVAL_MS = 30000;  // Beep every 30 seconds
-static bool g_lastDhtReadSuccess = true;
 
-// Relay hysteresis/default-on behaviour
-bool g_relay1On = false;
-bool g_relay2On = false;
-bool g_relay4On = true;
-bool g_relay5On = true;
+// Memory profiler: heap and stack samples, served on GET /mem. Builds with
+// MEM_PROFILE_ALLOC_SITES=1 (env controller-softap-memdebug) also count
+// large allocations by call site through linker-wrapped malloc.
+#ifndef MEM_PROFILE_ALLOC_SITES
+#define MEM_PROFILE_ALLOC_SITES 0
+#endif
+static const uint32_t MEM_SAMPLE_MS = 60000;
+static const uint32_t MEM_BUCKET_S = 3600;  // coarse ring: hourly minima
+static const char *const MEM_TASK_NAMES[] = {"loopTask", "Tmr Svc", "tiT", "wifi"};
+static const size_t MEM_TASK_COUNT = sizeof(MEM_TASK_NAMES) / sizeof(MEM_TASK_NAMES[0]);
+static MemTimeline<60, 720, MEM_TASK_COUNT> g_memTimeline;  // last hour + 30 days, ~10 KB
+static unsigned long g_lastMemSampleMs = 0;
+#if MEM_PROFILE_ALLOC_SITES
+static const size_t MEM_SITE_MIN_BYTES = 1024;
+static AllocSiteTable<32> g_allocSites;
+static portMUX_TYPE g_allocSitesMux = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+// Crash forensics: loop stage, uptime and heap kept in RTC memory, reported
+// once on topic/<id>/crash after the next boot. The task watchdog reboots a
+// loop() stage that blocks for longer than the longest bounded wait in one
+// stage (WiFiClientSecure's 120 s handshake timeout); it is fed at every
+// stage change, since one pass can run several such waits in a row.
+static const uint32_t LOOP_STALL_TIMEOUT_S = 150;
+static bool g_stallWatchdogStarted = false;
+static const uint16_t CRASH_MQTT_BUFFER = 512;
+static RTC_NOINIT_ATTR CrashRecord g_crash;
+static RTC_NOINIT_ATTR RpcRebootMark<RPC_ID_SIZE> g_rpcRebootMark;  // last reboot command run
+static char g_crashReport[384];  // previous reset, empty once published
+
+// Timeline trace: loop() stages, network calls, callbacks and interrupts as
+// spans/instants in a RAM ring, dumped on GET /timeline for
+// replay/timeline_to_chrome.py. Stages shorter than TIMELINE_MIN_STAGE_US
+// are not kept, so idle loop() passes do not flush the ring.
+#ifndef TIMELINE_TRACE
+#define TIMELINE_TRACE 1
+#endif
+// Ids below LoopStage::Count are the loop() stages
+enum class TimelinePoint : uint16_t {
+  MqttConnect = 32,
+  HttpsGet,
+  DhtRead,
+  WaterEdge,
+  WaterDebounce,
+  MqttMessage,
+  HttpRequest,
+  RpcCommand,
+  Count
+};
+enum TimelineContext : uint8_t { TIMELINE_LOOP, TIMELINE_TIMER, TIMELINE_ISR, TIMELINE_OTHER, TIMELINE_CONTEXTS };
+#if TIMELINE_TRACE
+static const char *const TIMELINE_CONTEXT_NAMES[] = {"loopTask", "Tmr Svc", "isr", "other"};
+static const uint32_t TIMELINE_MIN_STAGE_US = 500;
+static TimelineRing<512> g_timeline;  // 8 KB
+static portMUX_TYPE g_timelineMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t g_loopTaskHandle = nullptr;
+static uint32_t g_stageStartUs = 0;
+#endif
 
 // Forward declarations
 static void setupHttpRoutes();
@@ -129,10 +473,21 @@ static void handleRegistration();
 static String deriveControllerId();
 
 static bool loadConfig();
-static bool saveConfig(const String &ssid, const String &password, const String &email, const String &controllerName, const String &factoryName);
+static bool saveConfig(const AppConfig &cfg);
 static void persistRegisteredFlag(bool value);
 static void clearConfig();
+static uint8_t diffConfig(const AppConfig &from, const AppConfig &to);
+static void beginWiFiSwitch(const String &prevSsid, const String &prevPass);
+static void serviceWiFiSwitch();
+static void serviceFactoryReset();
 static void pollWifiResetButton();
+static void requestSelfBenchmark(const String &host, uint16_t port);
+static void restartWithCause(RestartCause cause);
+static void ensureMqttBufferSize(uint16_t size);
+static void buildTopics();
+static void applySampleBounds();
+static void startCycles();
+static void onSensorReading(size_t idx, float t, float h, uint32_t acquiredMs);
 static void wipeWifiCredentials();
 
 // HTML templates for the tiny setup UI
@@ -170,18 +525,30 @@ static const char PROVISION_PAGE[] PROGMEM = R"rawliteral(
     <label for="email">Owner Email</label>
     <input id="email" name="email" type="email" required>
 
-    <button type="submit">Save &amp; Restart</button>
+    <button type="submit">Save &amp; Connect</button>
   </form>
-  <p class="note">Controller ID (MAC): <strong>{CONTROLLER_ID}</strong>. After restart the controller joins your Wi-Fi and notifies the cloud.</p>
+  <p class="note">Controller ID (MAC): <strong>{CONTROLLER_ID}</strong>. Once saved the controller joins your Wi-Fi, closes this hotspot and notifies the cloud.</p>
 </body>
 </html>
 )rawliteral";
 
 // ---------- Utility helpers ----------
 inline void relayWrite(uint8_t pin, bool on) {
+  if (pin == board::NO_PIN) {
+    return;  // monitor-only zone
+  }
   digitalWrite(pin, on ? HIGH : LOW);
 }
 
+static uint32_t uptimeSeconds() {
+  return static_cast<uint32_t>(esp_timer_get_time() / 1000000);
+}
+
+// Xtensa return addresses carry the caller's window size in the top two bits
+static inline uintptr_t codeAddress(uintptr_t ra) {
+  return (ra & 0x3fffffffU) | 0x40000000U;
+}
+
 static String deriveControllerId() {
   String mac = WiFi.macAddress();
   if (mac.length() == 17) {
@@ -201,9 +568,23 @@ static String deriveControllerId() {
   return String(buf);
 }
 
+// Unset bounds take the defaults; the fast bound respects the sensors'
+// minimum interval and the slow bound stays within SAMPLE_SLOW_LIMIT_MS.
+static void clampSampleBounds(AppConfig &cfg) {
+  if (cfg.sampleFastMs == 0) {
+    cfg.sampleFastMs = SAMPLE_FAST_DEFAULT_MS;
+  }
+  if (cfg.sampleSlowMs == 0) {
+    cfg.sampleSlowMs = SAMPLE_SLOW_DEFAULT_MS;
+  }
+  cfg.sampleFastMs = std::min(std::max(cfg.sampleFastMs, SENSOR_MIN_INTERVAL_MS), SAMPLE_SLOW_LIMIT_MS);
+  cfg.sampleSlowMs = std::min(std::max(cfg.sampleSlowMs, cfg.sampleFastMs), SAMPLE_SLOW_LIMIT_MS);
+}
+
 static bool loadConfig() {
   if (!g_prefs.begin("millo", true)) {
     Serial.println("Preferences begin failed (read)");
+    clampSampleBounds(g_cfg);
     return false;
   }
   g_cfg.ssid       = g_prefs.getString("ssid", "");
@@ -212,35 +593,51 @@ static bool loadConfig() {
   g_cfg.controllerName = g_prefs.getString("ctrl_name", "");
   g_cfg.factoryName = g_prefs.getString("factory", "");
   g_cfg.registered = g_prefs.getBool("reg", false);
+  g_cfg.sampleFastMs = g_prefs.getUInt("smp_fast", SAMPLE_FAST_DEFAULT_MS);
+  g_cfg.sampleSlowMs = g_prefs.getUInt("smp_slow", SAMPLE_SLOW_DEFAULT_MS);
   g_prefs.end();
+  clampSampleBounds(g_cfg);
   return !g_cfg.ssid.isEmpty() && !g_cfg.password.isEmpty();
 }
 
-static bool saveConfig(const String &ssid, const String &password, const String &email, const String &controllerName, const String &factoryName) {
+static bool saveConfig(const AppConfig &cfg) {
   if (!g_prefs.begin("millo", false)) {
     Serial.println("Preferences begin failed (write)");
     return false;
   }
   size_t wrote = 0;
-  wrote += g_prefs.putString("ssid", ssid);
-  wrote += g_prefs.putString("pass", password);
-  wrote += g_prefs.putString("email", email);
-  wrote += g_prefs.putString("ctrl_name", controllerName);
-  wrote += g_prefs.putString("factory", factoryName);
-  g_prefs.putBool("reg", false);
+  wrote += g_prefs.putString("ssid", cfg.ssid);
+  wrote += g_prefs.putString("pass", cfg.password);
+  wrote += g_prefs.putString("email", cfg.email);
+  wrote += g_prefs.putString("ctrl_name", cfg.controllerName);
+  wrote += g_prefs.putString("factory", cfg.factoryName);
+  g_prefs.putBool("reg", cfg.registered);
+  g_prefs.putUInt("smp_fast", cfg.sampleFastMs);
+  g_prefs.putUInt("smp_slow", cfg.sampleSlowMs);
   g_prefs.end();
 
-  g_cfg.ssid = ssid;
-  g_cfg.password = password;
-  g_cfg.email = email;
-  g_cfg.controllerName = controllerName;
-  g_cfg.factoryName = factoryName;
-  g_cfg.registered = false;
-  g_registrationAttempts = 0;
-  g_nextRegistrationAttemptMs = 0;
+  if (!cfg.registered) {
+    g_registrationAttempts = 0;
+    g_nextRegistrationAttemptMs = 0;
+  }
+  g_cfg = cfg;
   return wrote > 0;
 }
 
+static uint8_t diffConfig(const AppConfig &from, const AppConfig &to) {
+  uint8_t changed = 0;
+  if (from.ssid != to.ssid || from.password != to.password) {
+    changed |= CFG_CHANGED_WIFI;
+  }
+  if (from.email != to.email || from.controllerName != to.controllerName || from.factoryName != to.factoryName) {
+    changed |= CFG_CHANGED_IDENTITY;
+  }
+  if (from.sampleFastMs != to.sampleFastMs || from.sampleSlowMs != to.sampleSlowMs) {
+    changed |= CFG_CHANGED_SAMPLING;
+  }
+  return changed;
+}
+
 static void persistRegisteredFlag(bool value) {
   if (!g_prefs.begin("millo", false)) {
     Serial.println("Preferences begin failed (flag)");
@@ -257,6 +654,7 @@ static void clearConfig() {
     g_prefs.end();
   }
   g_cfg = AppConfig{};
+  clampSampleBounds(g_cfg);
 }
 
 static void wipeWifiCredentials() {
@@ -265,51 +663,28 @@ static void wipeWifiCredentials() {
   clearConfig();
   delay(100);
   Serial.println("Wi-Fi credentials cleared. Restarting...");
-  ESP.restart();
+  restartWithCause(RestartCause::WiFiErase);
 }
 
 // ---------- Buzzer Functions ----------
-static void buzzerBeep(int durationMs) {
-  digitalWrite(BUZZER_PIN, HIGH);
-  delay(durationMs);
-  digitalWrite(BUZZER_PIN, LOW);
-}
-
-static void buzzerShortBeep() {
-  buzzerBeep(150);  // 150ms short beep
-}
-
 static void buzzerErrorPattern() {
-  // 3 quick beeps for DHT failure alert
-  for (int i = 0; i < 3; i++) {
-    buzzerBeep(100);
-    delay(150);
-  }
+  g_buzzer.play(BUZZER_DHT_ERROR);
   Serial.println("🔔 Buzzer: DHT failure alert (3 beeps)");
 }
 
+// Preempts anything else and drops the preempted alerts waiting to resume;
+// returns at once, so the caller schedules its reboot after the tone
 static void buzzerCriticalAlert() {
-  // Long continuous beep before critical reboot
   Serial.println("🚨 Buzzer: CRITICAL - System rebooting!");
-  digitalWrite(BUZZER_PIN, HIGH);
-  delay(3000);  // 3 second continuous beep
-  digitalWrite(BUZZER_PIN, LOW);
+  g_buzzer.play(BUZZER_CRITICAL);
+  g_buzzer.stop(BUZZER_CRITICAL.priority - 1);
 }
 
 static void buzzerSuccessBeep() {
-  // Single short beep on recovery
-  buzzerShortBeep();
+  g_buzzer.play(BUZZER_SUCCESS);
   Serial.println("✅ Buzzer: DHT recovery success");
 }
 
-static void buzzerWaterEmptyAlert() {
-  // 2 short beeps for water empty
-  buzzerBeep(200);
-  delay(300);
-  buzzerBeep(200);
-  Serial.println("💧 Buzzer: Water tank empty!");
-}
-
 static void pollWifiResetButton() {
   static uint32_t pressStart = 0;
   static bool notified = false;
@@ -318,14 +693,16 @@ static void pollWifiResetButton() {
   if (pressed) {
     if (pressStart == 0) {
       pressStart = millis();
-      Serial.println("Hold BOOT for 3s to erase Wi-Fi (release to cancel)");
+      Serial.println("Hold BOOT for 3s to erase Wi-Fi, release after 1-3s to self-benchmark");
     } else if (!notified && (millis() - pressStart) >= WIFI_RESET_HOLD_MS) {
       notified = true;
       Serial.println("Erasing stored Wi-Fi...");
       wipeWifiCredentials();
     }
   } else if (pressStart != 0) {
-    if (!notified) {
+    if (!notified && (millis() - pressStart) >= BENCH_HOLD_MS) {
+      requestSelfBenchmark(String(), 0);
+    } else if (!notified) {
       Serial.println("Wi-Fi erase aborted");
     }
     pressStart = 0;
@@ -333,7 +710,293 @@ static void pollWifiResetButton() {
   }
 }
 
+// ---------- Memory profiler ----------
+static void sampleMemory() {
+  MemSample<MEM_TASK_COUNT> s;
+  s.uptimeS = uptimeSeconds();
+  s.freeHeap = ESP.getFreeHeap();
+  s.largestBlock = ESP.getMaxAllocHeap();
+  s.minEverFree = ESP.getMinFreeHeap();
+  for (size_t i = 0; i < MEM_TASK_COUNT; ++i) {
+    // Looked up every time: the Wi-Fi tasks come and go with the radio
+    TaskHandle_t task = xTaskGetHandle(MEM_TASK_NAMES[i]);
+    s.stackFree[i] = task ? static_cast<uint32_t>(uxTaskGetStackHighWaterMark(task)) : 0;
+  }
+  g_memTimeline.add(s);
+  g_crash.freeHeap = s.freeHeap;
+  g_crash.minFreeHeap = s.minEverFree;
+  g_crash.largestBlock = s.largestBlock;
+}
+
+static void serviceMemProfiler() {
+  const unsigned long now = millis();
+  if (!g_memTimeline.empty() && now - g_lastMemSampleMs < MEM_SAMPLE_MS) {
+    return;
+  }
+  g_lastMemSampleMs = now;
+  sampleMemory();
+}
+
+#if MEM_PROFILE_ALLOC_SITES
+// Task context only: this may be placed in flash, which an IRAM interrupt
+// handler cannot call while the flash cache is off
+static void recordAllocSite(void *pc, size_t size) {
+  portENTER_CRITICAL(&g_allocSitesMux);
+  g_allocSites.record(codeAddress(reinterpret_cast<uintptr_t>(pc)), size);
+  portEXIT_CRITICAL(&g_allocSitesMux);
+}
+
+// Linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc, so every
+// caller in the image (operator new, String, mbedTLS, ArduinoJson) lands here.
+// Only the direct caller is recorded: __builtin_return_address(1) needs the
+// caller's frame, which the Xtensa windowed ABI may still hold in registers.
+// The wrappers stay in IRAM and skip recording in an ISR.
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *IRAM_ATTR __wrap_malloc(size_t size) {
+  if (size >= MEM_SITE_MIN_BYTES && !xPortInIsrContext()) {
+    recordAllocSite(__builtin_return_address(0), size);
+  }
+  return __real_malloc(size);
+}
+
+void *IRAM_ATTR __wrap_calloc(size_t count, size_t size) {
+  if (count * size >= MEM_SITE_MIN_BYTES && !xPortInIsrContext()) {
+    recordAllocSite(__builtin_return_address(0), count * size);
+  }
+  return __real_calloc(count, size);
+}
+
+void *IRAM_ATTR __wrap_realloc(void *ptr, size_t size) {
+  if (size >= MEM_SITE_MIN_BYTES && !xPortInIsrContext()) {
+    recordAllocSite(__builtin_return_address(0), size);
+  }
+  return __real_realloc(ptr, size);
+}
+}
+#endif
+
+// ---------- Timeline trace ----------
+#if TIMELINE_TRACE
+static inline uint32_t timelineNow() {
+  return static_cast<uint32_t>(esp_timer_get_time());
+}
+
+static const char *timelinePointName(uint16_t id) {
+  if (id < static_cast<uint16_t>(LoopStage::Count)) {
+    return loopStageName(static_cast<LoopStage>(id));
+  }
+  switch (static_cast<TimelinePoint>(id)) {
+    case TimelinePoint::MqttConnect: return "mqtt_connect";
+    case TimelinePoint::HttpsGet: return "https_get";
+    case TimelinePoint::DhtRead: return "dht_read";
+    case TimelinePoint::WaterEdge: return "water_edge";
+    case TimelinePoint::WaterDebounce: return "water_debounce";
+    case TimelinePoint::MqttMessage: return "mqtt_message";
+    case TimelinePoint::HttpRequest: return "http_request";
+    case TimelinePoint::RpcCommand: return "rpc_command";
+    default: return "";
+  }
+}
+
+static uint8_t IRAM_ATTR timelineContext() {
+  if (xPortInIsrContext()) {
+    return TIMELINE_ISR;
+  }
+  const TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  if (task == g_loopTaskHandle) {
+    return TIMELINE_LOOP;
+  }
+  return task == xTimerGetTimerDaemonTaskHandle() ? TIMELINE_TIMER : TIMELINE_OTHER;
+}
+
+static void IRAM_ATTR timelinePush(uint16_t id, TimelineKind kind, uint32_t startUs, uint32_t durUs, uint32_t arg) {
+  const TimelineEvent e = {startUs, durUs, arg, id, static_cast<uint8_t>(kind), timelineContext()};
+  portENTER_CRITICAL_SAFE(&g_timelineMux);
+  g_timeline.push(e);
+  portEXIT_CRITICAL_SAFE(&g_timelineMux);
+}
+
+// From startUs (a timelineNow() value) until now
+static void timelineSpan(TimelinePoint point, uint32_t startUs, uint32_t arg = 0) {
+  timelinePush(static_cast<uint16_t>(point), TimelineKind::Span, startUs, timelineNow() - startUs, arg);
+}
+
+static void IRAM_ATTR timelineInstant(TimelinePoint point, uint32_t arg = 0) {
+  timelinePush(static_cast<uint16_t>(point), TimelineKind::Instant, timelineNow(), 0, arg);
+}
+
+// Close the running loop() stage (g_crash.stage) as it hands over to the next
+static void timelineStageChange() {
+  const uint32_t now = timelineNow();
+  if (g_stageStartUs != 0 && now - g_stageStartUs >= TIMELINE_MIN_STAGE_US) {
+    timelinePush(g_crash.stage, TimelineKind::Span, g_stageStartUs, now - g_stageStartUs, 0);
+  }
+  g_stageStartUs = now;
+}
+#else
+static inline uint32_t timelineNow() { return 0; }
+static inline void timelineSpan(TimelinePoint, uint32_t, uint32_t = 0) {}
+static inline void timelineInstant(TimelinePoint, uint32_t = 0) {}
+static inline void timelineStageChange() {}
+#endif
+
+// ---------- Crash forensics ----------
+static const char *resetReasonName(esp_reset_reason_t reason) {
+  switch (reason) {
+    case ESP_RST_POWERON: return "poweron";
+    case ESP_RST_EXT: return "ext";
+    case ESP_RST_SW: return "sw";
+    case ESP_RST_PANIC: return "panic";
+    case ESP_RST_INT_WDT: return "int_wdt";
+    case ESP_RST_TASK_WDT: return "task_wdt";
+    case ESP_RST_WDT: return "wdt";
+    case ESP_RST_DEEPSLEEP: return "deepsleep";
+    case ESP_RST_BROWNOUT: return "brownout";
+    case ESP_RST_SDIO: return "sdio";
+    default: return "unknown";
+  }
+}
+
+static inline void setLoopStage(LoopStage stage) {
+  if (g_stallWatchdogStarted) {
+    esp_task_wdt_reset();
+  }
+  timelineStageChange();
+  g_crash.stage = static_cast<uint8_t>(stage);
+}
+
+// Return addresses of the calling task, innermost first
+static void captureBacktrace(CrashRecord &r) {
+  esp_backtrace_frame_t frame = {};
+  esp_backtrace_get_start(&frame.pc, &frame.sp, &frame.next_pc);
+  uint8_t depth = 0;
+  while (depth < CRASH_BACKTRACE_DEPTH && frame.pc != 0) {
+    r.backtrace[depth++] = codeAddress(frame.pc);
+    if (frame.next_pc == 0 || !esp_backtrace_get_next_frame(&frame)) {
+      break;
+    }
+  }
+  r.backtraceDepth = depth;
+  strlcpy(r.task, pcTaskGetTaskName(nullptr), sizeof(r.task));
+}
+
+// A panic's backtrace is in the coredump partition, not RTC memory. Erased
+// once read so each dump is reported once.
+static void readCoreDumpSummary(CrashRecord &r) {
+#if CRASH_HAVE_COREDUMP
+  esp_core_dump_summary_t summary;
+  if (esp_core_dump_get_summary(&summary) != ESP_OK) {
+    return;
+  }
+  strlcpy(r.task, summary.exc_task, sizeof(r.task));
+  uint8_t depth = 0;
+  while (depth < CRASH_BACKTRACE_DEPTH && depth < summary.exc_bt_info.depth) {
+    r.backtrace[depth] = codeAddress(summary.exc_bt_info.bt[depth]);
+    depth++;
+  }
+  r.backtraceDepth = depth;
+  esp_core_dump_image_erase();
+#else
+  (void)r;
+#endif
+}
+
+// Format the previous boot's record (RTC memory does not survive a power
+// cycle), then start this boot's
+static void reviewLastReset() {
+  const esp_reset_reason_t reason = esp_reset_reason();
+  g_crashReport[0] = '\0';
+  if (reason != ESP_RST_POWERON && crashRecordValid(g_crash)) {
+    if (reason != ESP_RST_SW) {
+      readCoreDumpSummary(g_crash);
+    }
+    formatCrashReport(g_crashReport, sizeof(g_crashReport), g_crash, resetReasonName(reason));
+    Serial.printf("Last reset: %s\n", g_crashReport);
+  } else {
+    Serial.printf("Reset reason: %s\n", resetReasonName(reason));
+  }
+  crashRecordBegin(g_crash);
+}
+
+// Every restart the firmware decides on goes through here
+static void restartWithCause(RestartCause cause) {
+  g_crash.cause = static_cast<uint8_t>(cause);
+  g_crash.uptimeS = uptimeSeconds();
+  g_crash.freeHeap = ESP.getFreeHeap();
+  g_crash.minFreeHeap = ESP.getMinFreeHeap();
+  g_crash.largestBlock = ESP.getMaxAllocHeap();
+  captureBacktrace(g_crash);
+  ESP.restart();
+}
+
+// Each loop() stage must hand over within LOOP_STALL_TIMEOUT_S or the task
+// watchdog panics and reboots; the record then names the stage it stalled in
+static void startStallWatchdog() {
+  esp_task_wdt_init(LOOP_STALL_TIMEOUT_S, true);
+  esp_task_wdt_add(nullptr);
+  g_stallWatchdogStarted = true;
+}
+
+static void publishCrashReport() {
+  if (g_crashReport[0] == '\0' || !mqtt.connected()) {
+    return;
+  }
+  ensureMqttBufferSize(CRASH_MQTT_BUFFER);
+  char crashTopic[112];
+  snprintf(crashTopic, sizeof(crashTopic), "%s/crash", topicBuf);
+  if (mqtt.publish(crashTopic, g_crashReport)) {
+    Serial.println("Crash report published");
+    g_crashReport[0] = '\0';
+  }
+}
+
 // ---------- HTTP handlers ----------
+// Builds a large reply in small chunks so the body never sits on the heap
+class ChunkedReply {
+ public:
+  ChunkedReply() : len_(0) {}
+  void append(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf_ + len_, sizeof(buf_) - len_, fmt, args);
+    va_end(args);
+    if (n > 0 && static_cast<size_t>(n) >= sizeof(buf_) - len_) {
+      flush();
+      va_start(args, fmt);
+      n = vsnprintf(buf_, sizeof(buf_), fmt, args);
+      va_end(args);
+    }
+    if (n > 0) {
+      len_ += static_cast<size_t>(n) < sizeof(buf_) - len_ ? static_cast<size_t>(n) : sizeof(buf_) - 1 - len_;
+    }
+  }
+  void write(const void *data, size_t len) {
+    if (len > sizeof(buf_) - len_) {
+      flush();
+    }
+    if (len > sizeof(buf_)) {
+      server.sendContent(static_cast<const char *>(data), len);
+      return;
+    }
+    memcpy(buf_ + len_, data, len);
+    len_ += len;
+  }
+  void flush() {
+    if (len_ > 0) {
+      server.sendContent(buf_, len_);
+      len_ = 0;
+    }
+  }
+
+ private:
+  char buf_[512];
+  size_t len_;
+};
+
 static void handleRoot() {
   if (g_isProvisioning) {
     String page = FPSTR(PROVISION_PAGE);
@@ -371,38 +1034,78 @@ static void handleRoot() {
   html += g_cfg.controllerName;
   html += F("'></label><label>Factory Name<input name='factory_name' required value='");
   html += g_cfg.factoryName;
+  html += F("'></label><label>Fastest sampling (ms)<input name='sample_fast_ms' type='number' min='");
+  html += SENSOR_MIN_INTERVAL_MS;
+  html += F("' value='");
+  html += g_cfg.sampleFastMs;
+  html += F("'></label><label>Slowest sampling (ms)<input name='sample_slow_ms' type='number' max='");
+  html += SAMPLE_SLOW_LIMIT_MS;
+  html += F("' value='");
+  html += g_cfg.sampleSlowMs;
   html += F("'></label><p style='margin-top:1rem;color:#555;font-size:0.9rem;'>Controller ID (MAC): ");
   html += g_controllerId;
-  html += F("</p><button type='submit'>Save &amp; Restart</button></form></section><section><form method='post' action='/factory_reset' onsubmit='return confirm(\"Reset all saved credentials?\");'><button type='submit'>Factory Reset</button></form></section></body></html>");
+  html += F("</p><button type='submit'>Save &amp; Apply</button></form></section><section><form method='post' action='/bench'><button type='submit'>Run Self-Benchmark</button></form></section><section><form method='post' action='/factory_reset' onsubmit='return confirm(\"Reset all saved credentials?\");'><button type='submit'>Factory Reset</button></form></section></body></html>");
 
   server.send(200, "text/html", html);
 }
 
+// Persist the submitted config and apply only what changed: identity edits
+// re-trigger registration, credential edits start a staged Wi-Fi switch.
 static void handleSave() {
-  String ssid = server.arg("ssid");
-  String password = server.arg("password");
-  String email = server.arg("email");
-  String controllerName = server.arg("controller_name");
-  String factoryName = server.arg("factory_name");
-
-  if (ssid.isEmpty() || password.isEmpty() || email.isEmpty() || controllerName.isEmpty() || factoryName.isEmpty()) {
+  AppConfig next;
+  next.ssid = server.arg("ssid");
+  next.password = server.arg("password");
+  next.email = server.arg("email");
+  next.controllerName = server.arg("controller_name");
+  next.factoryName = server.arg("factory_name");
+  next.sampleFastMs = server.hasArg("sample_fast_ms") ? server.arg("sample_fast_ms").toInt() : g_cfg.sampleFastMs;
+  next.sampleSlowMs = server.hasArg("sample_slow_ms") ? server.arg("sample_slow_ms").toInt() : g_cfg.sampleSlowMs;
+  clampSampleBounds(next);
+
+  if (next.ssid.isEmpty() || next.password.isEmpty() || next.email.isEmpty() || next.controllerName.isEmpty() || next.factoryName.isEmpty()) {
     server.send(400, "text/plain", "Missing ssid/password/email/controller/factory");
     return;
   }
 
-  if (!saveConfig(ssid, password, email, controllerName, factoryName)) {
+  if (g_wifiSwitchState != WIFI_SWITCH_IDLE || g_factoryResetAt != 0) {
+    server.send(409, "text/plain", "Another configuration change is still being applied");
+    return;
+  }
+
+  const uint8_t changed = diffConfig(g_cfg, next);
+  if (changed == 0 && !g_isProvisioning) {
+    server.send(200, "text/html", "<html><body><h3>No changes to apply.</h3></body></html>");
+    return;
+  }
+
+  next.registered = (changed & CFG_CHANGED_IDENTITY) ? false : g_cfg.registered;
+  const String prevSsid = g_cfg.ssid;
+  const String prevPass = g_cfg.password;
+
+  if (!saveConfig(next)) {
     server.send(500, "text/plain", "Failed to persist credentials");
     return;
   }
 
-  server.send(200, "text/html", "<html><body><h3>Saved! Rebooting...</h3></body></html>");
-  delay(750);
-  ESP.restart();
+  if (changed & CFG_CHANGED_IDENTITY) {
+    Serial.println("Config: identity changed -> registration will be re-sent");
+  }
+  if (changed & CFG_CHANGED_SAMPLING) {
+    applySampleBounds();
+  }
+
+  if ((changed & CFG_CHANGED_WIFI) || g_isProvisioning) {
+    server.send(200, "text/html", "<html><body><h3>Saved! Switching Wi-Fi...</h3><p>If the new network cannot be joined the controller falls back to the previous one.</p></body></html>");
+    beginWiFiSwitch(prevSsid, prevPass);
+    return;
+  }
+
+  server.send(200, "text/html", "<html><body><h3>Saved! Changes applied.</h3></body></html>");
 }
 
 static void handleConfigGet() {
   String json;
-  json.reserve(256);
+  json.reserve(384);  // the whole body, sampling fields included
   json += F("{");
   json += F("\"ssid\":\"");
   json += g_cfg.ssid;
@@ -416,6 +1119,12 @@ static void handleConfigGet() {
   json += g_controllerId;
   json += F("\",\"registered\":");
   json += g_cfg.registered ? F("true") : F("false");
+  json += F(",\"sample_fast_ms\":");
+  json += g_cfg.sampleFastMs;
+  json += F(",\"sample_slow_ms\":");
+  json += g_cfg.sampleSlowMs;
+  json += F(",\"sample_period_ms\":");
+  json += g_samplePeriod.periodMs();
   json += F(",\"wifi_status\":\"");
   json += (WiFi.status() == WL_CONNECTED) ? F("connected") : F("disconnected");
   json += F("\"}");
@@ -424,9 +1133,141 @@ static void handleConfigGet() {
 
 static void handleFactoryReset() {
   clearConfig();
-  server.send(200, "text/html", "<html><body><h3>Factory data cleared. Rebooting...</h3></body></html>");
-  delay(750);
-  ESP.restart();
+  g_registrationAttempts = 0;
+  g_nextRegistrationAttemptMs = 0;
+  g_wifiSwitchState = WIFI_SWITCH_IDLE;
+  g_factoryResetAt = millis() + CONFIG_APPLY_DELAY_MS;
+  server.send(200, "text/html", "<html><body><h3>Factory data cleared. Starting setup hotspot...</h3></body></html>");
+}
+
+static void handleBenchGet() {
+  if (!g_benchJson.isEmpty()) {
+    server.send(200, "application/json", g_benchJson);
+  } else if (g_benchPending) {
+    server.send(202, "application/json", "{\"state\":\"running\"}");
+  } else {
+    server.send(404, "application/json", "{\"state\":\"none\"}");
+  }
+}
+
+// Optional host/port pick the TLS endpoint; it is kept for later runs
+static void handleBenchPost() {
+  if (g_isProvisioning) {
+    server.send(409, "text/plain", "Join a Wi-Fi network first");
+    return;
+  }
+  const long port = server.hasArg("port") ? server.arg("port").toInt() : 0;
+  if (port < 0 || port > 65535) {
+    server.send(400, "text/plain", "Invalid port");
+    return;
+  }
+  requestSelfBenchmark(server.arg("host"), static_cast<uint16_t>(port));
+  server.send(202, "text/html", "<html><body><h3>Rebooting into self-benchmark. Results appear at /bench within a minute.</h3></body></html>");
+}
+
+// Fine rows: [uptime_s, free, largest_block, min_ever_free, stack_free per task...]
+// Coarse rows: [bucket_start_s, min_free, min_largest_block]
+static void handleMemGet() {
+  if (g_memTimeline.empty()) {
+    sampleMemory();
+  }
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+  ChunkedReply out;
+  out.append("{\"sample_s\":%lu,\"bucket_s\":%lu,\"tasks\":[", static_cast<unsigned long>(MEM_SAMPLE_MS / 1000),
+             static_cast<unsigned long>(g_memTimeline.bucketS()));
+  for (size_t i = 0; i < MEM_TASK_COUNT; ++i) {
+    out.append("%s\"%s\"", i ? "," : "", MEM_TASK_NAMES[i]);
+  }
+  out.append("],\"fine\":[");
+  for (size_t i = 0; i < g_memTimeline.fineCount(); ++i) {
+    const MemSample<MEM_TASK_COUNT> &s = g_memTimeline.fine(i);
+    out.append("%s[%lu,%lu,%lu,%lu", i ? "," : "", static_cast<unsigned long>(s.uptimeS),
+               static_cast<unsigned long>(s.freeHeap), static_cast<unsigned long>(s.largestBlock),
+               static_cast<unsigned long>(s.minEverFree));
+    for (size_t t = 0; t < MEM_TASK_COUNT; ++t) {
+      out.append(",%lu", static_cast<unsigned long>(s.stackFree[t]));
+    }
+    out.append("]");
+  }
+  out.append("],\"coarse\":[");
+  for (size_t i = 0; i < g_memTimeline.coarseCount(); ++i) {
+    const MemBucket &b = g_memTimeline.coarse(i);
+    out.append("%s[%lu,%lu,%lu]", i ? "," : "", static_cast<unsigned long>(b.startS),
+               static_cast<unsigned long>(b.minFree), static_cast<unsigned long>(b.minLargest));
+  }
+  out.append("]");
+#if MEM_PROFILE_ALLOC_SITES
+  static AllocSiteTable<32> sites;  // snapshot; too big for the loop task's stack
+  portENTER_CRITICAL(&g_allocSitesMux);
+  sites = g_allocSites;
+  portEXIT_CRITICAL(&g_allocSitesMux);
+  out.append(",\"alloc_min_bytes\":%u,\"alloc_sites\":[", static_cast<unsigned>(MEM_SITE_MIN_BYTES));
+  bool first = true;
+  for (size_t i = 0; i < sites.capacity(); ++i) {
+    const AllocSiteTable<32>::Site &s = sites.at(i);
+    if (s.pc == 0) {
+      continue;
+    }
+    out.append("%s{\"pc\":\"0x%08lx\",\"count\":%lu,\"bytes\":%llu,\"largest\":%lu}",
+               first ? "" : ",", static_cast<unsigned long>(s.pc), static_cast<unsigned long>(s.count),
+               static_cast<unsigned long long>(s.bytes), static_cast<unsigned long>(s.largest));
+    first = false;
+  }
+  out.append("],\"alloc_sites_dropped\":%lu", static_cast<unsigned long>(sites.dropped()));
+#endif
+  out.append("}");
+  out.flush();
+  server.sendContent("");
+}
+
+#if TIMELINE_TRACE
+// Binary dump, layout in timeline_trace.h. Events recorded while it is sent
+// are dropped (and counted) rather than racing the reader.
+static void handleTimelineGet() {
+  portENTER_CRITICAL(&g_timelineMux);
+  g_timeline.pause();
+  portEXIT_CRITICAL(&g_timelineMux);
+
+  TimelineDumpHeader header = {};
+  memcpy(header.magic, "MLTL", sizeof(header.magic));
+  header.version = TIMELINE_DUMP_VERSION;
+  header.eventSize = sizeof(TimelineEvent);
+  header.nameCount = static_cast<uint8_t>(TimelinePoint::Count);
+  header.contextCount = TIMELINE_CONTEXTS;
+  header.count = static_cast<uint32_t>(g_timeline.count());
+  header.dropped = g_timeline.dropped();
+  header.nowUs = static_cast<uint64_t>(esp_timer_get_time());
+
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/octet-stream", "");
+  ChunkedReply out;
+  out.write(&header, sizeof(header));
+  for (uint16_t id = 0; id < header.nameCount; ++id) {
+    const char *name = timelinePointName(id);
+    out.write(name, strlen(name) + 1);
+  }
+  for (uint8_t c = 0; c < header.contextCount; ++c) {
+    out.write(TIMELINE_CONTEXT_NAMES[c], strlen(TIMELINE_CONTEXT_NAMES[c]) + 1);
+  }
+  for (size_t i = 0; i < header.count; ++i) {
+    out.write(&g_timeline.at(i), sizeof(TimelineEvent));
+  }
+  out.flush();
+  server.sendContent("");
+
+  portENTER_CRITICAL(&g_timelineMux);
+  g_timeline.resume();
+  portEXIT_CRITICAL(&g_timelineMux);
+}
+#endif
+
+// One http_request span per handled request
+template <void (*Handler)()>
+static void timelineHandler() {
+  const uint32_t start = timelineNow();
+  Handler();
+  timelineSpan(TimelinePoint::HttpRequest, start);
 }
 
 static void handleNotFound() {
@@ -434,11 +1275,17 @@ static void handleNotFound() {
 }
 
 static void setupHttpRoutes() {
-  server.on("/", HTTP_GET, handleRoot);
-  server.on("/save", HTTP_POST, handleSave);
-  server.on("/config", HTTP_GET, handleConfigGet);
-  server.on("/factory_reset", HTTP_POST, handleFactoryReset);
-  server.onNotFound(handleNotFound);
+  server.on("/", HTTP_GET, timelineHandler<handleRoot>);
+  server.on("/save", HTTP_POST, timelineHandler<handleSave>);
+  server.on("/config", HTTP_GET, timelineHandler<handleConfigGet>);
+  server.on("/factory_reset", HTTP_POST, timelineHandler<handleFactoryReset>);
+  server.on("/bench", HTTP_GET, timelineHandler<handleBenchGet>);
+  server.on("/bench", HTTP_POST, timelineHandler<handleBenchPost>);
+  server.on("/mem", HTTP_GET, timelineHandler<handleMemGet>);
+#if TIMELINE_TRACE
+  server.on("/timeline", HTTP_GET, handleTimelineGet);
+#endif
+  server.onNotFound(timelineHandler<handleNotFound>);
   server.enableCORS(true);
 }
 
@@ -467,6 +1314,101 @@ static void enterProvisioningMode(const char *reason) {
   ensureHttpServerStarted();
 }
 
+static void beginWiFiSwitch(const String &prevSsid, const String &prevPass) {
+  g_wifiSwitchPrevSsid = prevSsid;
+  g_wifiSwitchPrevPass = prevPass;
+  g_wifiSwitchFromAp = g_isProvisioning;
+  g_wifiSwitchSince = millis();
+  g_wifiSwitchState = WIFI_SWITCH_PENDING;
+}
+
+// Non-blocking Wi-Fi switch-over driven from loop(). The new network is only
+// kept once it associates; otherwise the previous credentials are restored.
+static void serviceWiFiSwitch() {
+  const unsigned long now = millis();
+
+  switch (g_wifiSwitchState) {
+    case WIFI_SWITCH_IDLE:
+      return;
+
+    case WIFI_SWITCH_PENDING:
+      if (now - g_wifiSwitchSince < CONFIG_APPLY_DELAY_MS) {
+        return;
+      }
+      mqtt.disconnect();
+      // AP_STA keeps the setup hotspot alive while the station side associates
+      WiFi.mode(g_wifiSwitchFromAp ? WIFI_AP_STA : WIFI_STA);
+      WiFi.disconnect(false);
+      WiFi.begin(g_cfg.ssid.c_str(), g_cfg.password.c_str());
+      Serial.printf("Switching Wi-Fi to '%s'...\n", g_cfg.ssid.c_str());
+      g_wifiSwitchState = WIFI_SWITCH_CONNECTING;
+      g_wifiSwitchSince = now;
+      return;
+
+    case WIFI_SWITCH_CONNECTING:
+      if (WiFi.status() == WL_CONNECTED) {
+        Serial.printf("Wi-Fi switched to '%s'. IP: %s\n", g_cfg.ssid.c_str(), WiFi.localIP().toString().c_str());
+        if (g_wifiSwitchFromAp) {
+          WiFi.softAPdisconnect(true);
+          WiFi.mode(WIFI_STA);
+          g_isProvisioning = false;
+          buildTopics();
+          startCycles();
+        }
+        break;
+      }
+      if (now - g_wifiSwitchSince < WIFI_SWITCH_TIMEOUT_MS) {
+        return;
+      }
+
+      Serial.printf("Wi-Fi switch to '%s' timed out; falling back\n", g_cfg.ssid.c_str());
+      {
+        AppConfig restored = g_cfg;
+        restored.ssid = g_wifiSwitchPrevSsid;
+        restored.password = g_wifiSwitchPrevPass;
+        saveConfig(restored);
+      }
+      WiFi.disconnect(false);
+      if (g_wifiSwitchFromAp || g_cfg.ssid.isEmpty()) {
+        WiFi.mode(WIFI_AP);
+        Serial.println("Staying in provisioning mode");
+        break;
+      }
+      WiFi.begin(g_cfg.ssid.c_str(), g_cfg.password.c_str());
+      Serial.printf("Rejoining previous Wi-Fi '%s'...\n", g_cfg.ssid.c_str());
+      g_wifiSwitchState = WIFI_SWITCH_REVERTING;
+      g_wifiSwitchSince = now;
+      return;
+
+    case WIFI_SWITCH_REVERTING:
+      if (WiFi.status() != WL_CONNECTED && (now - g_wifiSwitchSince) < WIFI_SWITCH_TIMEOUT_MS) {
+        return;
+      }
+      Serial.printf("Wi-Fi fallback %s\n", WiFi.status() == WL_CONNECTED ? "connected" : "pending; regular reconnect takes over");
+      break;
+  }
+
+  // Hand back to ensureWiFiConnected() for any further retries
+  g_lastWiFiReconnectMs = now;
+  if (WiFi.status() == WL_CONNECTED) {
+    g_wifiFailCount = 0;
+    g_wifiDisconnectedSince = 0;
+  }
+  g_wifiSwitchPrevSsid = String();
+  g_wifiSwitchPrevPass = String();
+  g_wifiSwitchState = WIFI_SWITCH_IDLE;
+}
+
+static void serviceFactoryReset() {
+  if (g_factoryResetAt == 0 || (long)(millis() - g_factoryResetAt) < 0) {
+    return;
+  }
+  g_factoryResetAt = 0;
+  mqtt.disconnect();
+  g_isProvisioning = false;  // force enterProvisioningMode() to rebuild the AP
+  enterProvisioningMode("factory reset");
+}
+
 static bool connectWiFiWithTimeout(uint32_t timeoutMs) {
   if (g_cfg.ssid.isEmpty() || g_cfg.password.isEmpty()) {
     return false;
@@ -502,7 +1444,7 @@ static bool connectWiFiWithTimeout(uint32_t timeoutMs) {
 }
 
 static void ensureWiFiConnected() {
-  if (g_isProvisioning || g_cfg.ssid.isEmpty()) {
+  if (g_isProvisioning || g_cfg.ssid.isEmpty() || g_wifiSwitchState != WIFI_SWITCH_IDLE) {
     return;
   }
   if (WiFi.status() == WL_CONNECTED) {
@@ -598,6 +1540,33 @@ static void handleRegistration() {
 }
 
 // ---------- Wi-Fi / MQTT ----------
+static void ensureMqttBufferSize(uint16_t size) {
+  if (mqtt.getBufferSize() < size) {
+    mqtt.setBufferSize(size);
+  }
+}
+
+// topic/<id> and the command topic under it; set once the controller leaves
+// provisioning, at boot or after a live /save
+static void buildTopics() {
+  snprintf(topicBuf, sizeof(topicBuf), "topic/%s", g_controllerIdCompact.c_str());
+  snprintf(g_rpcCmdTopic, sizeof(g_rpcCmdTopic), "%s/cmd", topicBuf);
+}
+
+static void onMqttMessage(char *topic, uint8_t *body, unsigned int len) {
+  timelineInstant(TimelinePoint::MqttMessage, len);
+  if (g_rpcCmdTopic[0] != '\0' && strcmp(topic, g_rpcCmdTopic) == 0) {
+    TRACE_EVENT("cmd %.*s", static_cast<int>(len), reinterpret_cast<const char *>(body));
+    if (!g_rpcInbox.push(body, len, micros())) {
+      Serial.printf("Command dropped (%u bytes, %u queued)\n", len, static_cast<unsigned>(g_rpcInbox.size()));
+    }
+    return;
+  }
+  if (g_benchNonce[0] != '\0' && len == strlen(g_benchNonce) && memcmp(body, g_benchNonce, len) == 0) {
+    g_benchEchoUs = micros();
+  }
+}
+
 static void connectMQTT() {
   if (g_isProvisioning || WiFi.status() != WL_CONNECTED) {
     return;
@@ -607,54 +1576,80 @@ static void connectMQTT() {
   }
 
   mqtt.setServer(MQTT_HOST, MQTT_PORT);
+  mqtt.setCallback(onMqttMessage);
+#if ESPNOW_GATEWAY
+  mqtt.setBufferSize(GATEWAY_MQTT_BUFFER);  // satellite batches exceed the 256-byte default
+#endif
   tlsClient.setInsecure();
   Serial.printf("Connecting MQTT %s:%d\n", MQTT_HOST, MQTT_PORT);
 
+  const uint32_t traceStart = timelineNow();
   const unsigned long deadline = millis() + 5000;
   while (!mqtt.connected() && millis() < deadline) {
     String cid = "esp32-" + g_controllerIdCompact;
     if (mqtt.connect(cid.c_str(), MQTT_USER, MQTT_PASS)) {
       Serial.println("MQTT connected");
+      // QoS 1: the broker redelivers until acked; repeats hit the replay cache
+      if (g_rpcCmdTopic[0] != '\0' && !mqtt.subscribe(g_rpcCmdTopic, 1)) {
+        Serial.printf("Subscribe %s failed\n", g_rpcCmdTopic);
+      }
       break;
     }
     Serial.printf("MQTT failed rc=%d; retrying...\n", mqtt.state());
     delay(500);
   }
+  timelineSpan(TimelinePoint::MqttConnect, traceStart, mqtt.connected() ? 0 : static_cast<uint32_t>(mqtt.state()));
+}
+
+// A sensor has given up only when every sensor is failing: one dead probe
+// in a multi-sensor zone must not reboot the controller.
+static bool allSensorsFailing(int threshold) {
+  for (size_t i = 0; i < SENSOR_COUNT; ++i) {
+    if (g_sensors[i].failures < threshold) {
+      return false;
+    }
+  }
+  return true;
 }
 
-// returns true on success
-static bool readTempHum(int &tC, int &hPct) {
 #if USE_DHT
+// returns true on success; acquiredMs is when the attempt that succeeded
+// read the sensor, not when the retries gave up waiting
+static bool readTempHum(size_t idx, float &tC, float &hPct, uint32_t &acquiredMs) {
+  DHT &dht = *g_dht[idx];
+  SensorState &s = g_sensors[idx];
   // DHT22 requires minimum 2 seconds between reads
   float h = dht.readHumidity();
   float t = dht.readTemperature();
+  uint32_t readMs = millis();
+  TRACE_EVENT("dht %.1f %.1f", t, h);
   
   // Retry up to 3 times with proper 2.5 second delays
   for (int i = 0; i < 3 && (isnan(h) || isnan(t)); i++) {
     delay(2500);  // DHT22 needs >2 seconds between reads
     h = dht.readHumidity();
     t = dht.readTemperature();
+    readMs = millis();
+    TRACE_EVENT("dht %.1f %.1f", t, h);
   }
   
   if (isnan(h) || isnan(t)) {
-    tC = 0;
-    hPct = 0;
-    g_consecutiveDhtFailures++;
-    Serial.printf("DHT read failed (attempt %d/%d before reboot)\n", 
-                  g_consecutiveDhtFailures, DHT_MAX_FAILURES_BEFORE_REBOOT);
+    s.failures++;
+    Serial.printf("DHT #%u read failed (attempt %d/%d before reboot)\n", 
+                  static_cast<unsigned>(idx), s.failures, DHT_MAX_FAILURES_BEFORE_REBOOT);
     
     // Periodic beep alert for DHT failures (every 30 seconds)
     unsigned long now = millis();
-    if (g_consecutiveDhtFailures >= 3 && (now - g_lastDhtFailureBeepMs) >= DHT_FAILURE_BEEP_INTERVAL_MS) {
+    if (s.failures >= 3 && (now - g_lastDhtFailureBeepMs) >= DHT_FAILURE_BEEP_INTERVAL_MS) {
       buzzerErrorPattern();
       g_lastDhtFailureBeepMs = now;
     }
     
     // Re-initialize DHT if too many consecutive failures
-    if (g_consecutiveDhtFailures >= DHT_MAX_FAILURES_BEFORE_REINIT && 
-        g_consecutiveDhtFailures < DHT_MAX_FAILURES_BEFORE_REBOOT) {
+    if (s.failures >= DHT_MAX_FAILURES_BEFORE_REINIT && 
+        s.failures < DHT_MAX_FAILURES_BEFORE_REBOOT) {
       if (now - g_lastDhtInitTime >= DHT_REINIT_DELAY_MS) {
-        Serial.println("Re-initializing DHT22 sensor...");
+        Serial.printf("Re-initializing DHT22 sensor #%u...\n", static_cast<unsigned>(idx));
         dht.begin();
         g_lastDhtInitTime = now;
         delay(3000);  // Give DHT time to stabilize after re-init
@@ -662,38 +1657,271 @@ static bool readTempHum(int &tC, int &hPct) {
     }
     
     // CRITICAL: Auto-reboot if failures exceed threshold
-    if (g_consecutiveDhtFailures >= DHT_MAX_FAILURES_BEFORE_REBOOT) {
+    if (allSensorsFailing(DHT_MAX_FAILURES_BEFORE_REBOOT) && g_sensorRebootAt == 0) {
       Serial.println("❌ CRITICAL: DHT22 failed 10 times. Initiating automatic reboot...");
       buzzerCriticalAlert();
-      delay(500);
-      ESP.restart();
+      g_sensorRebootAt = millis() + BUZZER_CRITICAL.onMs + 500;  // the tone plays out first
     }
     
-    g_lastDhtReadSuccess = false;
+    s.lastReadSuccess = false;
     return false;
   }
   
   // Success - reset failure counter and beep if recovering from failure
-  if (!g_lastDhtReadSuccess && g_consecutiveDhtFailures > 0) {
+  if (!s.lastReadSuccess && s.failures > 0) {
     buzzerSuccessBeep();
   }
-  g_consecutiveDhtFailures = 0;
-  g_lastDhtReadSuccess = true;
-  tC = static_cast<int>(t + 0.5f);
-  hPct = static_cast<int>(h + 0.5f);
+  s.failures = 0;
+  s.lastReadSuccess = true;
+  tC = t;
+  hPct = h;
+  acquiredMs = readMs;
   return true;
+}
 #else
-  tC = 0;
-  hPct = 0;
-  return false;
-#endif
+static void handleI2cClimateFailure(size_t idx, uint32_t now) {
+  SensorState &s = g_sensors[idx];
+  s.failures++;
+  Serial.printf("I2C climate #%u read failed (%d in a row)\n", static_cast<unsigned>(idx), s.failures);
+  if (s.failures >= I2C_MAX_FAILURES_BEFORE_RESET) {
+    if ((now - g_lastDhtFailureBeepMs) >= DHT_FAILURE_BEEP_INTERVAL_MS) {
+      buzzerErrorPattern();
+      g_lastDhtFailureBeepMs = now;
+    }
+    Serial.println("Soft-resetting I2C climate sensor...");
+    g_climateSensors[idx]->begin(now);
+  }
 }
+#endif
 
-static void applyThresholdEntry(const JsonObjectConst &entry) {
-  if (!entry.containsKey("arrangement")) {
+// Start reading one sensor. DHT22 completes here (blocking, with retries);
+// I2C sensors only get their measure command.
+static void startSensorRead(size_t idx) {
+  g_readPending = static_cast<int>(idx);
+  g_readStartMs = millis();
+#if USE_DHT
+  float t = 0.0f, h = 0.0f;
+  uint32_t acquiredMs = 0;
+  // Only read DHT if initialization is complete
+  if (!g_dhtInitialized) {
+    Serial.println("DHT not yet initialized, skipping read");
+    g_readPending = -1;
     return;
   }
-
+  const uint32_t traceStart = timelineNow();
+  const bool ok = readTempHum(idx, t, h, acquiredMs);  // may retry for several seconds
+  timelineSpan(TimelinePoint::DhtRead, traceStart, ok ? 1 : 0);
+  if (ok) {
+    onSensorReading(idx, t, h, acquiredMs);
+  }
+  g_readPending = -1;
+#else
+  if (!g_climateSensors[idx]->trigger(g_readStartMs)) {
+    Serial.printf("I2C climate #%u not ready for a new reading\n", static_cast<unsigned>(idx));
+  }
+#endif
+}
+
+// Finish the in-flight I2C read once its conversion time has passed
+static void pollSensorRead() {
+#if !USE_DHT
+  if (g_readPending < 0) {
+    return;
+  }
+  const size_t idx = static_cast<size_t>(g_readPending);
+  const uint32_t now = millis();
+  ClimateReading r;
+  const SensorStatus status = g_climateSensors[idx]->poll(now, r);
+  if (status == SensorStatus::Busy && (now - g_readStartMs) < I2C_READ_TIMEOUT_MS) {
+    return;
+  }
+  g_readPending = -1;
+  if (status == SensorStatus::Ready) {
+    g_sensors[idx].failures = 0;
+    onSensorReading(idx, r.temperatureC, r.humidityPct, r.acquiredMs);
+  } else {
+    handleI2cClimateFailure(idx, now);
+  }
+#endif
+}
+
+// Staggered acquisition at the sensors' native rate: at most one read in
+// flight, reads spaced out so no two sensors are hit in the same loop pass.
+static void serviceSensors() {
+  pollSensorRead();
+  if (g_readPending >= 0 || g_sensorRebootAt != 0) {
+    return;  // no new (possibly seconds-long) read once a sensor reboot is due
+  }
+  const uint32_t now = millis();
+  const int next = g_sampler.next(now);
+  if (next >= 0) {
+    g_sampler.started(static_cast<size_t>(next), now);
+    startSensorRead(static_cast<size_t>(next));
+  }
+}
+
+// Median of the zone's fresh readings with outliers dropped
+static void fuseZone(size_t zone, uint32_t now) {
+  float temps[SENSOR_COUNT];
+  float hums[SENSOR_COUNT];
+  size_t n = 0;
+  uint32_t newest = 0;
+  for (size_t i = 0; i < SENSOR_COUNT; ++i) {
+    const SensorState &s = g_sensors[i];
+    if (ZONE_SENSORS[i].zone != zone || !s.ok || !s.health.usable() || (now - s.acquiredMs) > SENSOR_MAX_AGE_MS) {
+      continue;
+    }
+    temps[n] = s.t;
+    hums[n] = s.h;
+    if (n == 0 || static_cast<int32_t>(s.acquiredMs - newest) > 0) {
+      newest = s.acquiredMs;
+    }
+    n++;
+  }
+
+  ZoneState &z = g_zones[zone];
+  const FusedValue t = fuseMedian(temps, n, ZONE_TEMP_SPREAD_C);
+  const FusedValue h = fuseMedian(hums, n, ZONE_HUM_SPREAD_PCT);
+  z.valid = t.valid && h.valid;
+  z.t = z.valid ? t.value : 0.0f;
+  z.h = z.valid ? h.value : 0.0f;
+  if (z.valid) {
+    z.tRate.add(z.t, now);
+    z.hRate.add(z.h, now);
+  } else {
+    z.tRate.reset();
+    z.hRate.reset();
+  }
+  z.sensorsUsed = static_cast<uint8_t>(n);
+  z.sensorsRejected = static_cast<uint8_t>(t.rejected > h.rejected ? t.rejected : h.rejected);
+  z.acquiredMs = z.valid ? newest : now;
+}
+
+// Feed an accepted reading's offset from the median of the zone's other
+// usable, fresh sensors to its drift check. Needs two others to tell which
+// sensor is off; with fewer the check stays idle.
+static void crossCheckSensor(size_t idx, uint32_t now) {
+  const size_t zone = ZONE_SENSORS[idx].zone;
+  float temps[SENSOR_COUNT];
+  float hums[SENSOR_COUNT];
+  size_t n = 0;
+  for (size_t i = 0; i < SENSOR_COUNT; ++i) {
+    const SensorState &o = g_sensors[i];
+    if (i == idx || ZONE_SENSORS[i].zone != zone || !o.ok || !o.health.usable() ||
+        (now - o.acquiredMs) > SENSOR_MAX_AGE_MS) {
+      continue;
+    }
+    temps[n] = o.t;
+    hums[n] = o.h;
+    n++;
+  }
+  if (n < 2) {
+    return;
+  }
+  SensorState &s = g_sensors[idx];
+  const FusedValue t = fuseMedian(temps, n, ZONE_TEMP_SPREAD_C);
+  const FusedValue h = fuseMedian(hums, n, ZONE_HUM_SPREAD_PCT);
+  s.health.crossCheck(s.t - t.value, s.h - h.value, SENSOR_HEALTH);
+}
+
+// A reading landed: screen it, then refresh its zone's fused value and add
+// that to the publish window, so the window sees every reading, not one
+// per cycle. Rejected readings leave the last good one in place.
+static void onSensorReading(size_t idx, float t, float h, uint32_t acquiredMs) {
+  SensorState &s = g_sensors[idx];
+  const uint8_t before = s.health.flags();
+  const bool accepted = s.health.check(t, h, acquiredMs, SENSOR_HEALTH);
+  if (accepted) {
+    s.t = t;
+    s.h = h;
+    s.acquiredMs = acquiredMs;
+    s.ok = true;
+    crossCheckSensor(idx, acquiredMs);
+  } else if (s.health.flags() & HEALTH_SPIKE) {
+    Serial.printf("Sensor #%u reading T=%.1f H=%.1f rejected as a spike\n", static_cast<unsigned>(idx), t, h);
+  }
+  if ((s.health.flags() ^ before) & HEALTH_EXCLUDE) {
+    Serial.printf("Sensor #%u health 0x%02x -> 0x%02x%s\n", static_cast<unsigned>(idx), before, s.health.flags(),
+                  s.health.usable() ? "" : " (excluded from control)");
+  }
+
+  const uint32_t now = millis();
+  const size_t zone = ZONE_SENSORS[idx].zone;
+  fuseZone(zone, now);
+  ZoneState &z = g_zones[zone];
+  if (z.valid) {
+    z.tWindow.add(z.t);
+    z.hWindow.add(z.h);
+  }
+}
+
+// 0..1: how much the zone needs a faster cycle. A zone without a fresh
+// reading holds the nominal PUBLISH_MS cadence, so sensor failures are
+// neither retried faster nor left for the slow bound.
+static float zoneSamplingUrgency(const ZoneState &z) {
+  if (!z.valid) {
+    return g_samplePeriod.urgencyFor(PUBLISH_MS);
+  }
+  const float t = samplingUrgency(z.t, z.tRate.perMinute(), z.th.tempMin, z.th.tempMax, z.th.tempEnabled,
+                                  SAMPLE_NEAR_TEMP_C, SAMPLE_FAST_TEMP_C_PER_MIN);
+  const float h = samplingUrgency(z.h, z.hRate.perMinute(), z.th.humMin, z.th.humMax, z.th.humEnabled,
+                                  SAMPLE_NEAR_HUM_PCT, SAMPLE_FAST_HUM_PCT_PER_MIN);
+  return std::max(t, h);
+}
+
+// Pick the next cycle's period from the most urgent zone
+static void updateSamplePeriod(float urgency) {
+  const uint32_t before = g_samplePeriod.periodMs();
+  const uint32_t period = g_samplePeriod.update(urgency);
+  if (period != before) {
+    Serial.printf("Cycle period %lu -> %lu ms (urgency %.2f)\n", static_cast<unsigned long>(before),
+                  static_cast<unsigned long>(period), urgency);
+  }
+}
+
+// (Re)start the adaptive period from the configured bounds
+static void applySampleBounds() {
+  g_samplePeriod.begin(g_cfg.sampleFastMs, g_cfg.sampleSlowMs, PUBLISH_MS);
+  Serial.printf("Cycle between %lu and %lu ms\n", static_cast<unsigned long>(g_cfg.sampleFastMs),
+                static_cast<unsigned long>(g_cfg.sampleSlowMs));
+}
+
+// Sampling, publish, relay and threshold cycles; loop() skips them while
+// provisioning, so they start at boot or when a live /save leaves it
+static void startCycles() {
+  // Delay first publish to ensure DHT is fully ready after WiFi power surge
+  g_samplePeriod.begin(g_cfg.sampleFastMs, g_cfg.sampleSlowMs, PUBLISH_MS);
+  const uint32_t period = g_samplePeriod.periodMs();
+  g_lastPubMs = millis() - (period > 5000 ? period - 5000 : 0);  // First publish in 5 seconds
+  g_lastThresholdFetchMs = millis() - THRESHOLD_FETCH_MS;
+  g_lastRelayMs = millis() - (RELAY_DECISION_MS - 5000);  // first decision with the first publish
+  g_sampler.begin(millis(), SENSOR_MIN_INTERVAL_MS, SENSOR_READ_SPACING_MS);
+}
+
+#if USE_SCD4X
+// SCD4x measures on its own 5 s period; check once per publish tick and
+// finish the fetch over the following loop passes.
+static void serviceCo2Sensor(bool tick) {
+  const uint32_t now = millis();
+  if (tick) {
+    g_co2Sensor.trigger(now);
+  }
+  ClimateReading r;
+  const SensorStatus status = g_co2Sensor.poll(now, r);
+  if (status == SensorStatus::Ready) {
+    g_co2Ppm = r.co2Ppm;
+  } else if (status == SensorStatus::Error) {
+    Serial.println("SCD4x read failed; restarting periodic measurement");
+    g_co2Sensor.begin(now);
+  }
+}
+#endif
+
+static void applyThresholdEntry(const JsonObjectConst &entry) {
+  if (!entry.containsKey("arrangement")) {
+    return;
+  }
+
   const int arrangement = entry["arrangement"].as<int>();
   const bool enabled = entry["is_enabled"] | false;
   const bool hasMin = !entry["min_threshold"].isNull();
@@ -709,17 +1937,45 @@ static void applyThresholdEntry(const JsonObjectConst &entry) {
     useMax = entry["max_threshold"].as<float>();
   }
 
+  // Entries without "zone" apply to zone 0 (single-zone controllers)
+  const int zone = entry["zone"] | 0;
+  if (zone < 0 || static_cast<size_t>(zone) >= ZONE_COUNT) {
+    return;
+  }
+  ZoneThresholds &th = g_zones[zone].th;
   if (arrangement == TEMP_SENSOR_ARRANGEMENT) {
-    g_tempMinThreshold = useMin;
-    g_tempMaxThreshold = useMax;
-    g_tempThresholdEnabled = enabled && hasMin && hasMax;
+    th.tempMin = useMin;
+    th.tempMax = useMax;
+    th.tempEnabled = enabled && hasMin && hasMax;
   } else if (arrangement == HUM_SENSOR_ARRANGEMENT) {
-    g_humMinThreshold = useMin;
-    g_humMaxThreshold = useMax;
-    g_humThresholdEnabled = enabled && hasMin && hasMax;
+    th.humMin = useMin;
+    th.humMax = useMax;
+    th.humEnabled = enabled && hasMin && hasMax;
   }
 }
 
+// Parse a controller-thresholds response body and apply every entry
+static bool applyThresholdResponse(const String &body) {
+  DynamicJsonDocument doc(4096);
+  DeserializationError err = deserializeJson(doc, body);
+
+  if (err) {
+    Serial.printf("Threshold JSON parse error: %s\n", err.c_str());
+    return false;
+  }
+
+  if (!doc.containsKey("data")) {
+    Serial.println("Threshold response missing data array");
+    return false;
+  }
+
+  JsonArrayConst arr = doc["data"].as<JsonArrayConst>();
+  for (JsonObjectConst entry : arr) {
+    applyThresholdEntry(entry);
+  }
+  return true;
+}
+
 static String urlEncode(const String &value) {
   String encoded;
   char hex[4];
@@ -753,8 +2009,20 @@ static bool fetchControllerThresholds() {
     return false;
   }
 
+  const uint32_t traceStart = timelineNow();
   const int code = http.GET();
+  timelineSpan(TimelinePoint::HttpsGet, traceStart, static_cast<uint32_t>(code));
+#if TRACE_RECORD
+  static int lastTracedCode = 0;
+  static String lastTracedBody;
+#endif
   if (code != 200) {
+#if TRACE_RECORD
+    if (code != lastTracedCode) {
+      lastTracedCode = code;
+      TRACE_EVENT("thresholds http %d", code);
+    }
+#endif
     Serial.printf("Threshold HTTP status %d (%s)\n", code, http.errorToString(code).c_str());
     http.end();
     return false;
@@ -762,118 +2030,165 @@ static bool fetchControllerThresholds() {
 
   String body = http.getString();
   http.end();
-  Serial.printf("Threshold payload (%d bytes): %s\n", body.length(), body.c_str());
-
-  DynamicJsonDocument doc(4096);
-  DeserializationError err = deserializeJson(doc, body);
-
-  if (err) {
-    Serial.printf("Threshold JSON parse error: %s\n", err.c_str());
-    return false;
+#if TRACE_RECORD
+  if (lastTracedCode != 200 || body != lastTracedBody) {
+    lastTracedCode = 200;
+    lastTracedBody = body;
+    TRACE_EVENT("thresholds %s", body.c_str());
   }
+#endif
+  Serial.printf("Threshold payload (%d bytes): %s\n", body.length(), body.c_str());
 
-  if (!doc.containsKey("data")) {
-    Serial.println("Threshold response missing data array");
+  if (!applyThresholdResponse(body)) {
     return false;
   }
 
-  JsonArrayConst arr = doc["data"].as<JsonArrayConst>();
-  for (JsonObjectConst entry : arr) {
-    applyThresholdEntry(entry);
-  }
-
   g_lastThresholdFetch = millis();
-  Serial.printf("Thresholds updated -> Temp %.2f-%.2f (%s), Hum %.2f-%.2f (%s)\n",
-                g_tempMinThreshold, g_tempMaxThreshold,
-                g_tempThresholdEnabled ? "enabled" : "fallback",
-                g_humMinThreshold, g_humMaxThreshold,
-                g_humThresholdEnabled ? "enabled" : "fallback");
+  for (size_t z = 0; z < ZONE_COUNT; ++z) {
+    const ZoneThresholds &th = g_zones[z].th;
+    Serial.printf("Thresholds zone %u -> Temp %.2f-%.2f (%s), Hum %.2f-%.2f (%s)\n",
+                  static_cast<unsigned>(z),
+                  th.tempMin, th.tempMax, th.tempEnabled ? "enabled" : "fallback",
+                  th.humMin, th.humMax, th.humEnabled ? "enabled" : "fallback");
+  }
   return true;
 }
 
-// Turn relays based on thresholds (active-HIGH relays)
-static void handleRelays(int tC, int hPct) {
-  const bool tempHigh = static_cast<float>(tC) > g_tempMaxThreshold;
-  const bool tempLow = static_cast<float>(tC) < g_tempMinThreshold;
-  const bool humHigh = static_cast<float>(hPct) > g_humMaxThreshold;
-  const bool humLow = static_cast<float>(hPct) < g_humMinThreshold;
+// Drive a zone's relays to its last decision, with remote overrides on top
+// (active-HIGH relays). Returns true if any relay switched.
+static bool driveRelays(size_t zone) {
+  ZoneState &z = g_zones[zone];
+  const ZoneRelayPins &pins = ZONE_RELAYS[zone];
+  const float tC = z.t;
+  const float hPct = z.h;
+  RelayOutputs desired = z.decided;
+  z.overrides.apply(desired, millis());
 
   bool anyChange = false;
 
-  bool desiredRelay1;
-  bool desiredRelay5;
-
-  if (tempLow) {
-    desiredRelay1 = false;
-    desiredRelay5 = false;
-  } else if (tempHigh) {
-    desiredRelay1 = true;
-    desiredRelay5 = true;
-  } else {
-    desiredRelay1 = false;
-    desiredRelay5 = true;
-  }
+  const bool desiredRelay1 = desired.relay1;
+  const bool desiredRelay5 = desired.relay5;
 
-  if (desiredRelay1 != g_relay1On) {
-    relayWrite(RELAY1_PIN, desiredRelay1);
-    Serial.printf("Relay1 (Temp NC) -> %s (T=%dC)\n", desiredRelay1 ? "ON" : "OFF", tC);
-    g_relay1On = desiredRelay1;
+  if (desiredRelay1 != z.relay1On) {
+    relayWrite(pins.relay1, desiredRelay1);
+    Serial.printf("Zone %u Relay1 (Temp NC) -> %s (T=%.1fC)\n", static_cast<unsigned>(zone), desiredRelay1 ? "ON" : "OFF", tC);
+    z.relay1On = desiredRelay1;
     anyChange = true;
   }
 
-  if (desiredRelay5 != g_relay5On) {
-    relayWrite(RELAY5_PIN, desiredRelay5);
-    Serial.printf("Relay5 (Temp default ON) -> %s (T=%dC)\n", desiredRelay5 ? "ON" : "OFF", tC);
-    g_relay5On = desiredRelay5;
+  if (desiredRelay5 != z.relay5On) {
+    relayWrite(pins.relay5, desiredRelay5);
+    Serial.printf("Zone %u Relay5 (Temp default ON) -> %s (T=%.1fC)\n", static_cast<unsigned>(zone), desiredRelay5 ? "ON" : "OFF", tC);
+    z.relay5On = desiredRelay5;
     anyChange = true;
   }
 
-  bool desiredRelay2 = humLow;
-  if (desiredRelay2 != g_relay2On) {
-    relayWrite(RELAY2_PIN, desiredRelay2);
-    Serial.printf("Relay2 (Hum NC) -> %s (H=%d%%)\n", desiredRelay2 ? "ON" : "OFF", hPct);
-    g_relay2On = desiredRelay2;
+  bool desiredRelay2 = desired.relay2;
+  if (desiredRelay2 != z.relay2On) {
+    relayWrite(pins.relay2, desiredRelay2);
+    Serial.printf("Zone %u Relay2 (Hum NC) -> %s (H=%.1f%%)\n", static_cast<unsigned>(zone), desiredRelay2 ? "ON" : "OFF", hPct);
+    z.relay2On = desiredRelay2;
     anyChange = true;
   }
 
-  bool desiredRelay4 = !humHigh;
-  if (desiredRelay4 != g_relay4On) {
-    relayWrite(RELAY4_PIN, desiredRelay4);
-    Serial.printf("Relay4 (Hum default ON) -> %s (H=%d%%)\n", desiredRelay4 ? "ON" : "OFF", hPct);
-    g_relay4On = desiredRelay4;
+  bool desiredRelay4 = desired.relay4;
+  if (desiredRelay4 != z.relay4On) {
+    relayWrite(pins.relay4, desiredRelay4);
+    Serial.printf("Zone %u Relay4 (Hum default ON) -> %s (H=%.1f%%)\n", static_cast<unsigned>(zone), desiredRelay4 ? "ON" : "OFF", hPct);
+    z.relay4On = desiredRelay4;
     anyChange = true;
   }
+  return anyChange;
+}
 
-  if (!anyChange) {
-    Serial.println("Relays -> no change");
+// Turn a zone's relays based on its thresholds
+static void handleRelays(size_t zone) {
+  ZoneState &z = g_zones[zone];
+  if (!z.valid) {
+    // No usable reading (failed, stale or excluded sensors): z.t/z.h are
+    // placeholders, so the relays hold the last decision until one returns
+    Serial.printf("Zone %u relays -> held (no usable reading)\n", static_cast<unsigned>(zone));
+    return;
+  }
+  const RelayLimits limits = {z.th.tempMin, z.th.tempMax, z.th.humMin, z.th.humMax};
+  // Hysteresis follows the strategy's own outputs, not an override's
+  const RelayOutputs previous = z.decided;
+  z.decided = decideRelays(g_relayControl, limits, z.t, z.h, previous, z.cycle);
+  if (!driveRelays(zone)) {
+    Serial.printf("Zone %u relays -> no change\n", static_cast<unsigned>(zone));
   }
 }
 
-// Handle water level float switch: track validity + drive water output
-static void handleWaterLevel() {
-  static bool lastLoggedValid = false;
+// Hand relays back to the strategy as their overrides run out, between
+// control cycles too
+static void serviceRelayOverrides() {
+  const uint32_t now = millis();
+  for (size_t z = 0; z < ZONE_COUNT; ++z) {
+    if (g_zones[z].overrides.expire(now)) {
+      Serial.printf("Zone %u relay override expired\n", static_cast<unsigned>(z));
+      driveRelays(z);
+    }
+  }
+}
 
-  int raw = digitalRead(WATER_PIN);
-  unsigned long now = millis();
+static void IRAM_ATTR onWaterEdge() {
+  g_waterLastEdgeMs = millis();
+  timelineInstant(TimelinePoint::WaterEdge);
+  BaseType_t woken = pdFALSE;
+  xTimerResetFromISR(g_waterDebounceTimer, &woken);
+  if (woken == pdTRUE) {
+    portYIELD_FROM_ISR();
+  }
+}
 
-  if (raw != g_waterPendingRaw) {
-    g_waterPendingRaw = raw;
-    g_waterPendingSince = now;
+// Runs in the FreeRTOS timer task WATER_DEBOUNCE_MS after the last edge, so
+// detection latency does not depend on how long loop() takes per pass.
+static void onWaterDebounced(TimerHandle_t) {
+  const int raw = digitalRead(WATER_PIN);
+  timelineInstant(TimelinePoint::WaterDebounce, static_cast<uint32_t>(raw));
+  if (raw == g_waterPostedRaw) {
+    return;  // bounced back to the already reported state
+  }
+  g_waterPostedRaw = raw;
+
+  WaterEvent ev = {static_cast<uint8_t>(raw), g_waterLastEdgeMs, static_cast<uint32_t>(millis())};
+  if (xQueueSend(g_waterQueue, &ev, 0) != pdTRUE) {
+    // Queue full: loop() is badly stalled, keep the newest state
+    WaterEvent dropped;
+    xQueueReceive(g_waterQueue, &dropped, 0);
+    xQueueSend(g_waterQueue, &ev, 0);
+  }
 
-    if (raw != g_lastWaterRaw) {
-      if (g_waterValid) {
-        Serial.printf("Water sensor change detected (raw=%d) -> debouncing\n", raw);
-      }
-      g_waterValid = false;
-    }
+  // Alarm straight from here rather than waiting for loop() to drain the queue
+  if (raw == HIGH) {
+    g_buzzer.play(BUZZER_WATER_EMPTY);
   }
+}
+
+static void setupWaterSensor() {
+  pinMode(WATER_PIN, INPUT_PULLUP);
+  g_waterQueue = xQueueCreate(WATER_EVENT_QUEUE_LEN, sizeof(WaterEvent));
+  g_waterDebounceTimer = xTimerCreate("water_db", pdMS_TO_TICKS(WATER_DEBOUNCE_MS), pdFALSE, nullptr, onWaterDebounced);
+  g_waterLastEdgeMs = millis();
+  g_waterValid = false;
+  g_lastWaterOutputOn = false;
+  attachInterrupt(digitalPinToInterrupt(WATER_PIN), onWaterEdge, CHANGE);
+  xTimerStart(g_waterDebounceTimer, 0);  // validate the power-on level too
+}
 
-  bool stable = (now - g_waterPendingSince) >= WATER_DEBOUNCE_MS;
+// Handle water level float switch: apply validated changes + log transitions
+static void handleWaterLevel() {
+  static bool lastLoggedValid = false;
 
-  if (!g_waterValid && stable) {
-    g_lastWaterRaw = g_waterPendingRaw;
+  WaterEvent ev;
+  while (xQueueReceive(g_waterQueue, &ev, 0) == pdTRUE) {
+    g_lastWaterRaw = ev.raw;
     g_waterValid = true;
-    Serial.printf("Water sensor stable -> raw=%d\n", g_lastWaterRaw);
+    TRACE_AT(ev.edgeMs, "water %d", ev.raw);
+    Serial.printf("Water sensor stable -> raw=%d (edge->valid %lums, valid->loop %lums)\n",
+                  g_lastWaterRaw,
+                  static_cast<unsigned long>(ev.validatedMs - ev.edgeMs),
+                  static_cast<unsigned long>(millis() - ev.validatedMs));
   }
 
   const bool waterFull = g_waterValid && (g_lastWaterRaw == LOW);
@@ -887,9 +2202,9 @@ static void handleWaterLevel() {
                   g_waterValid ? "true" : "false",
                   state);
     
-    // Trigger buzzer alert when water becomes empty
+    // Buzzer was already started by the debounce timer
     if (waterEmpty && !g_lastWaterOutputOn) {
-      buzzerWaterEmptyAlert();
+      Serial.println("💧 Buzzer: Water tank empty!");
     }
     
     g_lastWaterOutputOn = waterEmpty;
@@ -897,53 +2212,784 @@ static void handleWaterLevel() {
   }
 }
 
+#if TRACE_RECORD
+static void traceLinkState() {
+  static int lastNet = -1;
+  static int lastMqtt = -1;
+  const int net = WiFi.status() == WL_CONNECTED ? 1 : 0;
+  const int broker = mqtt.connected() ? 1 : 0;
+  if (net != lastNet) {
+    lastNet = net;
+    TRACE_EVENT("net %s", net ? "up" : "down");
+  }
+  if (broker != lastMqtt) {
+    lastMqtt = broker;
+    TRACE_EVENT("mqtt %s", broker ? "up" : "down");
+  }
+}
+#endif
+
 // Publish your array [humidity, temperature, water]
-static void publishArray(int t, int h, int water) {
+static void publishArray(const char *topic, int t, int h, int water) {
   // Use REAL sensor data, not random values
   snprintf(payload, sizeof(payload), "[%d,%d,%d]", h, t, water);
-  bool ok = mqtt.publish(topicBuf, payload, true);
-  Serial.printf("Pub %s : %s -> %s\n", topicBuf, payload, ok ? "OK" : "FAIL");
+  bool ok = mqtt.publish(topic, payload, true);
+  Serial.printf("Pub %s : %s -> %s\n", topic, payload, ok ? "OK" : "FAIL");
+}
+
+// Same reading at full precision with its acquisition time on
+// <topic>/sample, plus min/max/mean/stddev of every reading in the window
+// since the last publish:
+//   "win":{"ms":10000,"n":4,"t":[min,max,mean,sd],"h":[min,max,mean,sd]}
+// The array topic stays unchanged (rounded) for the app. Before SNTP has
+// synced ts is 0 and age_ms lets the backend re-stamp the sample against
+// its own receive time.
+static void publishSample(const char *baseTopic, const ZoneState &z, int water, uint32_t windowMs) {
+  char sampleTopic[128];
+  char body[288];
+  const uint32_t acquiredMs = z.acquiredMs;
+  snprintf(sampleTopic, sizeof(sampleTopic), "%s/sample", baseTopic);
+  const uint32_t ts = g_time.epoch(acquiredMs);
+  int len = snprintf(body, sizeof(body), "{\"h\":%.2f,\"t\":%.2f,\"w\":%d,\"ts\":%lu,\"synced\":%s,\"age_ms\":%lu",
+                     z.h, z.t, water, static_cast<unsigned long>(ts), ts ? "true" : "false",
+                     static_cast<unsigned long>(millis() - acquiredMs));
+#if USE_SCD4X
+  len += snprintf(body + len, sizeof(body) - len, ",\"co2\":%u", g_co2Ppm);
+#endif
+  if (SENSOR_COUNT > 1) {
+    len += snprintf(body + len, sizeof(body) - len, ",\"n\":%u,\"rej\":%u", z.sensorsUsed, z.sensorsRejected);
+  }
+  const WindowStats &tw = z.tWindow;
+  const WindowStats &hw = z.hWindow;
+  if (tw.count() > 0) {
+    len += snprintf(body + len, sizeof(body) - len,
+                    ",\"win\":{\"ms\":%lu,\"n\":%lu,\"t\":[%.2f,%.2f,%.2f,%.2f],\"h\":[%.2f,%.2f,%.2f,%.2f]}",
+                    static_cast<unsigned long>(windowMs), static_cast<unsigned long>(tw.count()), tw.minValue(),
+                    tw.maxValue(), tw.mean(), tw.stddev(), hw.minValue(), hw.maxValue(), hw.mean(), hw.stddev());
+  }
+  snprintf(body + len, sizeof(body) - len, "}");
+  ensureMqttBufferSize(SAMPLE_MQTT_BUFFER);
+  if (!mqtt.publish(sampleTopic, body)) {
+    Serial.printf("Pub %s -> FAIL\n", sampleTopic);
+  }
+}
+
+#if ESPNOW_GATEWAY
+// Start ESP-NOW once STA is up: the gateway listens on its AP's channel
+// and satellites find that channel by scanning.
+static void startSatelliteGateway() {
+  WiFi.setSleep(false);  // modem sleep drops ESP-NOW frames between beacons
+  if (!g_espNow.begin()) {
+    Serial.println("ESP-NOW init failed; satellites disabled");
+    return;
+  }
+  Serial.printf("ESP-NOW gateway on channel %d: table %u satellites, airtime ~%u at %us reporting\n",
+                static_cast<int>(WiFi.channel()), static_cast<unsigned>(GATEWAY_MAX_SATELLITES),
+                satelliteCapacityByAirtime(PUBLISH_MS, 10), static_cast<unsigned>(PUBLISH_MS / 1000));
+}
+
+static void serviceSatellites() {
+  g_espNow.poll([](const uint8_t *mac, const uint8_t *data, size_t len) {
+    g_satGateway.onFrame(g_espNow, mac, data, len, millis());
+  });
+}
+
+static SatThresholds zoneSatThresholds(const ZoneThresholds &th) {
+  SatThresholds s;
+  s.tempMinCenti = static_cast<int16_t>(lroundf(th.tempMin * 100.0f));
+  s.tempMaxCenti = static_cast<int16_t>(lroundf(th.tempMax * 100.0f));
+  s.humMinCenti = static_cast<int16_t>(lroundf(th.humMin * 100.0f));
+  s.humMaxCenti = static_cast<int16_t>(lroundf(th.humMax * 100.0f));
+  s.tempEnabled = th.tempEnabled;
+  s.humEnabled = th.humEnabled;
+  return s;
+}
+
+// Fresh satellite readings as JSON batches on topic/<id>/satellites. A batch
+// stays fresh until its publish succeeds; after a failure the rest wait for
+// the next publish tick.
+static void publishSatellites() {
+  char satTopic[112];
+  snprintf(satTopic, sizeof(satTopic), "%s/satellites", topicBuf);
+  static char body[GATEWAY_MQTT_BUFFER - 128];
+  while (g_satGateway.freshCount() > 0) {
+    int len = snprintf(body, sizeof(body), "{\"sats\":[");
+    size_t entries = 0;
+    g_satGateway.forEachFresh([&](const SatelliteNode &n) {
+      const SatReading &r = n.last;
+      len += snprintf(body + len, sizeof(body) - len,
+                      "%s{\"id\":\"%02X%02X%02X%02X%02X%02X\"",
+                      entries ? "," : "", n.mac[0], n.mac[1], n.mac[2], n.mac[3], n.mac[4], n.mac[5]);
+      if (r.climateValid) {
+        len += snprintf(body + len, sizeof(body) - len, ",\"t\":%.2f,\"h\":%.2f",
+                        r.tempCenti / 100.0f, r.humCenti / 100.0f);
+      }
+      if (r.water != 0xFF) {
+        len += snprintf(body + len, sizeof(body) - len, ",\"w\":%u", r.water);
+      }
+      const uint32_t ts = g_time.epoch(n.acquiredMs);
+      if (ts != 0) {
+        len += snprintf(body + len, sizeof(body) - len, ",\"ts\":%lu", static_cast<unsigned long>(ts));
+      } else {
+        len += snprintf(body + len, sizeof(body) - len, ",\"age_ms\":%lu",
+                        static_cast<unsigned long>(millis() - n.acquiredMs));
+      }
+      len += snprintf(body + len, sizeof(body) - len, ",\"rx\":%lu,\"dup\":%lu,\"lost\":%lu}",
+                      static_cast<unsigned long>(n.received), static_cast<unsigned long>(n.duplicates),
+                      static_cast<unsigned long>(n.window.lost()));
+      entries++;
+    }, SAT_BATCH_PER_MESSAGE);
+    snprintf(body + len, sizeof(body) - len, "]}");
+    bool ok = mqtt.publish(satTopic, body);
+    Serial.printf("Pub %s : %u satellites -> %s\n", satTopic, static_cast<unsigned>(entries), ok ? "OK" : "FAIL");
+    if (!ok) {
+      break;
+    }
+    g_satGateway.markDrained(entries);
+  }
+}
+#endif
+
+// ---------- Alarms ----------
+static void logAlarmEvent(AlarmEvent ev, AlarmType type, size_t zone) {
+  if (ev != AlarmEvent::None) {
+    Serial.printf("Alarm %s zone %u -> %s\n", alarmTypeName(type), static_cast<unsigned>(zone),
+                  ev == AlarmEvent::Raised ? "RAISED" : "cleared");
+  }
+}
+
+static void updateBandAlarms(AlarmLatch *latches, AlarmType high, AlarmType low, size_t zone, float value,
+                             float min, float max, bool enabled, float hysteresis, uint32_t now) {
+  AlarmLatch &hi = latches[static_cast<size_t>(high)];
+  AlarmLatch &lo = latches[static_cast<size_t>(low)];
+  if (!enabled) {
+    // No thresholds to judge against: let an active alarm clear
+    logAlarmEvent(hi.update(false, true, now, ALARM_RAISE_HOLD_MS, ALARM_CLEAR_HOLD_MS, value, max), high, zone);
+    logAlarmEvent(lo.update(false, true, now, ALARM_RAISE_HOLD_MS, ALARM_CLEAR_HOLD_MS, value, min), low, zone);
+    return;
+  }
+  logAlarmEvent(hi.updateHigh(value, max, hysteresis, now, ALARM_RAISE_HOLD_MS, ALARM_CLEAR_HOLD_MS), high, zone);
+  logAlarmEvent(lo.updateLow(value, min, hysteresis, now, ALARM_RAISE_HOLD_MS, ALARM_CLEAR_HOLD_MS), low, zone);
+}
+
+// Once per control cycle, after fusion and the threshold fetch
+static void evaluateAlarms(uint32_t now) {
+  for (size_t z = 0; z < ZONE_COUNT; ++z) {
+    const ZoneState &zone = g_zones[z];
+    AlarmLatch *latches = g_zoneAlarms[z];
+    AlarmLatch &sensor = latches[static_cast<size_t>(AlarmType::SensorFailure)];
+    logAlarmEvent(sensor.update(!zone.valid, zone.valid, now, ALARM_RAISE_HOLD_MS, ALARM_CLEAR_HOLD_MS),
+                  AlarmType::SensorFailure, z);
+    if (!zone.valid) {
+      continue;  // climate alarms hold their state until readings return
+    }
+    updateBandAlarms(latches, AlarmType::TempHigh, AlarmType::TempLow, z, zone.t, zone.th.tempMin, zone.th.tempMax,
+                     zone.th.tempEnabled, ALARM_TEMP_HYSTERESIS_C, now);
+    updateBandAlarms(latches, AlarmType::HumHigh, AlarmType::HumLow, z, zone.h, zone.th.humMin, zone.th.humMax,
+                     zone.th.humEnabled, ALARM_HUM_HYSTERESIS_PCT, now);
+  }
+  // Water is already debounced; the hold-off rides out refills
+  const bool waterFull = g_lastWaterRaw == LOW;
+  logAlarmEvent(g_waterAlarm.update(g_waterValid && !waterFull, g_waterValid && waterFull, now, ALARM_RAISE_HOLD_MS,
+                                    ALARM_CLEAR_HOLD_MS),
+                AlarmType::WaterLow, 0);
+}
+
+static size_t activeAlarmCount() {
+  size_t n = g_waterAlarm.active() ? 1 : 0;
+  for (size_t z = 0; z < ZONE_COUNT; ++z) {
+    for (size_t a = 0; a < ZONE_ALARM_COUNT; ++a) {
+      n += g_zoneAlarms[z][a].active() ? 1 : 0;
+    }
+  }
+  return n;
+}
+
+// {"ev":"raise","type":"hum_low","zone":0,"value":77.40,"limit":80.00,"active":1,"ts":...}
+// value/limit only for threshold alarms; ts is 0 until SNTP has synced.
+// "active" counts alarms still raised after this one, so a clear with
+// "active":0 means the controller is all clear.
+static bool publishAlarm(AlarmLatch &latch, AlarmType type, size_t zone) {
+  char alarmTopic[112];
+  char body[192];
+  snprintf(alarmTopic, sizeof(alarmTopic), "%s/alarm", topicBuf);
+  int len = snprintf(body, sizeof(body), "{\"ev\":\"%s\",\"type\":\"%s\",\"zone\":%u",
+                     latch.active() ? "raise" : "clear", alarmTypeName(type), static_cast<unsigned>(zone));
+  if (type < AlarmType::SensorFailure) {
+    len += snprintf(body + len, sizeof(body) - len, ",\"value\":%.2f,\"limit\":%.2f", latch.value(), latch.limit());
+  }
+  snprintf(body + len, sizeof(body) - len, ",\"active\":%u,\"ts\":%lu}", static_cast<unsigned>(activeAlarmCount()),
+           static_cast<unsigned long>(g_time.epoch(millis())));
+  const bool ok = mqtt.publish(alarmTopic, body);
+  Serial.printf("Pub %s : %s -> %s\n", alarmTopic, body, ok ? "OK" : "FAIL");
+  if (ok) {
+    latch.markReported();
+  }
+  return ok;
+}
+
+// Deliver every latch whose state differs from the last one sent; runs
+// each loop() pass, so events raised while offline go out on reconnect.
+static void publishAlarms() {
+  if (!mqtt.connected()) {
+    return;
+  }
+  for (size_t z = 0; z < ZONE_COUNT; ++z) {
+    for (size_t a = 0; a < ZONE_ALARM_COUNT; ++a) {
+      AlarmLatch &latch = g_zoneAlarms[z][a];
+      if (latch.unreported() && !publishAlarm(latch, static_cast<AlarmType>(a), z)) {
+        return;
+      }
+    }
+  }
+  if (g_waterAlarm.unreported()) {
+    publishAlarm(g_waterAlarm, AlarmType::WaterLow, 0);
+  }
+}
+
+// Sensor-health changes (spikes only count) on topic/<id>/health, e.g.
+// {"sensor":0,"zone":0,"flags":["stuck"],"usable":false,"spikes":3,"drift":[0.12,-0.40]}
+static void publishSensorHealth() {
+  if (!mqtt.connected()) {
+    return;
+  }
+  char healthTopic[112];
+  char body[192];
+  snprintf(healthTopic, sizeof(healthTopic), "%s/health", topicBuf);
+  for (size_t i = 0; i < SENSOR_COUNT; ++i) {
+    SensorState &s = g_sensors[i];
+    const uint8_t flags = s.health.flags() & HEALTH_EXCLUDE;
+    if (flags == s.reportedHealth) {
+      continue;
+    }
+    int len = snprintf(body, sizeof(body), "{\"sensor\":%u,\"zone\":%u,\"flags\":[", static_cast<unsigned>(i),
+                       static_cast<unsigned>(ZONE_SENSORS[i].zone));
+    size_t named = 0;
+    for (uint8_t bit = 1; bit != 0 && bit <= HEALTH_EXCLUDE; bit <<= 1) {
+      if (flags & bit) {
+        len += snprintf(body + len, sizeof(body) - len, "%s\"%s\"", named++ ? "," : "", healthFlagName(bit));
+      }
+    }
+    snprintf(body + len, sizeof(body) - len, "],\"usable\":%s,\"spikes\":%lu,\"drift\":[%.2f,%.2f]}",
+             flags ? "false" : "true", static_cast<unsigned long>(s.health.spikes()), s.health.tempDrift(),
+             s.health.humDrift());
+    const bool ok = mqtt.publish(healthTopic, body);
+    Serial.printf("Pub %s : %s -> %s\n", healthTopic, body, ok ? "OK" : "FAIL");
+    if (!ok) {
+      return;
+    }
+    s.reportedHealth = flags;
+  }
+}
+
+// ---------- Remote commands ----------
+// Request: {"id":"42","cmd":"relay","zone":0,"relay":2,"on":true,"for_s":600}
+// Response: {"id":"42","cmd":"relay","status":"ok","result":{...},"dev_us":850}
+// "status" is "ok", "error" (with "error") or "accepted" for a command that
+// takes longer (its final response follows, or a reboot). dev_us runs from
+// the request's arrival to the response's publish.
+static bool rpcIdValid(const char *id) {
+  const size_t len = strlen(id);
+  if (len == 0 || len >= RPC_ID_SIZE) {
+    return false;
+  }
+  for (size_t i = 0; i < len; ++i) {
+    if (id[i] < 0x20 || id[i] > 0x7e || id[i] == '"' || id[i] == '\\') {
+      return false;  // echoed into the response unescaped
+    }
+  }
+  return true;
+}
+
+// `extra` is spliced in after "status" (",\"result\":{...}" or ",\"error\":\"...\"").
+// Final responses are kept for retries even when the publish fails.
+static void publishRpcResponse(const char *id, RpcCommand cmd, const char *status, const char *extra,
+                               uint32_t rxUs, bool final) {
+  char respTopic[112];
+  char body[RPC_RESPONSE_SIZE];
+  snprintf(respTopic, sizeof(respTopic), "%s/resp", topicBuf);
+  snprintf(body, sizeof(body), "{\"id\":\"%s\",\"cmd\":\"%s\",\"status\":\"%s\"%s,\"dev_us\":%lu}", id,
+           rpcCommandName(cmd), status, extra, static_cast<unsigned long>(micros() - rxUs));
+  const bool ok = mqtt.publish(respTopic, body);
+  Serial.printf("Pub %s : %s -> %s\n", respTopic, body, ok ? "OK" : "FAIL");
+  if (final && id[0] != '\0') {
+    g_rpcDone.remember(id, body);
+  }
+}
+
+static bool rpcError(char *extra, size_t size, const char *error) {
+  snprintf(extra, size, ",\"error\":\"%s\"", error);
+  return false;
+}
+
+static bool zoneRelayOn(const ZoneState &z, RelayOverrides::Relay relay) {
+  switch (relay) {
+    case RelayOverrides::Relay1: return z.relay1On;
+    case RelayOverrides::Relay2: return z.relay2On;
+    case RelayOverrides::Relay4: return z.relay4On;
+    default: return z.relay5On;
+  }
+}
+
+// Force one relay for for_s seconds (default 600); for_s 0 hands it back
+static bool rpcRelay(JsonObjectConst req, char *extra, size_t size) {
+  const int zone = req["zone"] | 0;
+  if (zone < 0 || static_cast<size_t>(zone) >= ZONE_COUNT) {
+    return rpcError(extra, size, "bad_zone");
+  }
+  const int number = req["relay"] | 0;
+  const RelayOverrides::Relay relay = RelayOverrides::fromNumber(number);
+  if (relay == RelayOverrides::Count) {
+    return rpcError(extra, size, "bad_relay");
+  }
+  const long forS = req["for_s"] | static_cast<long>(RPC_OVERRIDE_DEFAULT_S);
+  if (forS < 0 || forS > static_cast<long>(RPC_OVERRIDE_MAX_S)) {
+    return rpcError(extra, size, "bad_duration");
+  }
+  ZoneState &z = g_zones[zone];
+  const uint32_t now = millis();
+  if (forS == 0) {
+    z.overrides.clear(relay);
+  } else if (!req["on"].is<bool>()) {
+    return rpcError(extra, size, "missing_on");
+  } else {
+    z.overrides.set(relay, req["on"].as<bool>(), now, static_cast<uint32_t>(forS) * 1000UL);
+  }
+  Serial.printf("Zone %u relay%d override -> %s\n", static_cast<unsigned>(zone), number,
+                forS == 0 ? "cleared" : (req["on"].as<bool>() ? "ON" : "OFF"));
+  driveRelays(zone);
+  snprintf(extra, size, ",\"result\":{\"zone\":%d,\"relay\":%d,\"on\":%s,\"left_s\":%lu}", zone, number,
+           zoneRelayOn(z, relay) ? "true" : "false",
+           static_cast<unsigned long>(z.overrides.remainingMs(relay, now) / 1000UL));
+  return true;
+}
+
+// "ms" pins the cycle to one period; "fast_ms"/"slow_ms" set either bound.
+// Clamped and saved like the settings page.
+static bool rpcSetInterval(JsonObjectConst req, char *extra, size_t size) {
+  AppConfig next = g_cfg;
+  const char *const KEYS[] = {"ms", "fast_ms", "slow_ms"};
+  bool any = false;
+  for (size_t i = 0; i < 3; ++i) {
+    if (req[KEYS[i]].isNull()) {
+      continue;
+    }
+    const long ms = req[KEYS[i]] | -1L;
+    if (ms <= 0) {
+      return rpcError(extra, size, "bad_interval");
+    }
+    if (i != 2) {
+      next.sampleFastMs = static_cast<uint32_t>(ms);
+    }
+    if (i != 1) {
+      next.sampleSlowMs = static_cast<uint32_t>(ms);
+    }
+    any = true;
+  }
+  if (!any) {
+    return rpcError(extra, size, "missing_interval");
+  }
+  clampSampleBounds(next);
+  if (diffConfig(g_cfg, next) & CFG_CHANGED_SAMPLING) {
+    if (!saveConfig(next)) {
+      return rpcError(extra, size, "save_failed");
+    }
+    applySampleBounds();
+  }
+  snprintf(extra, size, ",\"result\":{\"fast_ms\":%lu,\"slow_ms\":%lu,\"period_ms\":%lu}",
+           static_cast<unsigned long>(g_cfg.sampleFastMs), static_cast<unsigned long>(g_cfg.sampleSlowMs),
+           static_cast<unsigned long>(g_samplePeriod.periodMs()));
+  return true;
+}
+
+// The HTTPS fetch can take seconds, so it is acknowledged first. New limits
+// reach the relays in this same loop() pass (an extra decision).
+static bool rpcFetchThresholds(const char *id, uint32_t rxUs, char *extra, size_t size) {
+  publishRpcResponse(id, RpcCommand::FetchThresholds, "accepted", "", rxUs, false);
+  setLoopStage(LoopStage::Thresholds);
+  g_lastThresholdFetchMs = millis();
+  if (!fetchControllerThresholds()) {
+    return rpcError(extra, size, "fetch_failed");
+  }
+  g_lastRelayMs = millis() - RELAY_DECISION_MS;
+  return true;
+}
+
+static void runRpcRequest(const RpcInbox<RPC_INBOX_LEN, RPC_BODY_SIZE>::Entry &request) {
+  StaticJsonDocument<256> doc;
+  if (deserializeJson(doc, request.body)) {
+    publishRpcResponse("", RpcCommand::Count, "error", ",\"error\":\"bad_json\"", request.rxUs, false);
+    return;
+  }
+  const char *id = doc["id"] | "";
+  const char *name = doc["cmd"] | "";
+  const RpcCommand cmd = rpcCommandFromName(name);
+  if (!rpcIdValid(id)) {
+    publishRpcResponse("", cmd, "error", ",\"error\":\"bad_id\"", request.rxUs, false);
+    return;
+  }
+  const char *done = g_rpcDone.find(id);
+  if (done) {
+    char respTopic[112];
+    snprintf(respTopic, sizeof(respTopic), "%s/resp", topicBuf);
+    const bool ok = mqtt.publish(respTopic, done);
+    Serial.printf("Command %s repeated; resent response -> %s\n", id, ok ? "OK" : "FAIL");
+    return;
+  }
+
+  Serial.printf("Command %s: %s\n", id, name);
+  const uint32_t traceStart = timelineNow();
+  char extra[128] = "";
+  const char *status = "ok";
+  bool ok = true;
+  switch (cmd) {
+    case RpcCommand::PublishNow:
+      g_publishNow = true;  // the cycle runs later in this loop() pass
+      break;
+    case RpcCommand::Relay:
+      ok = rpcRelay(doc.as<JsonObjectConst>(), extra, sizeof(extra));
+      break;
+    case RpcCommand::SetInterval:
+      ok = rpcSetInterval(doc.as<JsonObjectConst>(), extra, sizeof(extra));
+      break;
+    case RpcCommand::FetchThresholds:
+      ok = rpcFetchThresholds(id, request.rxUs, extra, sizeof(extra));
+      break;
+    case RpcCommand::Reboot:
+      // Refused if this id already rebooted us: a retained request must not loop
+      if (g_rpcRebootMark.matches(id)) {
+        ok = rpcError(extra, sizeof(extra), "already_done");
+      } else {
+        g_rpcRebootMark.set(id);
+        g_rpcRebootAt = millis() + RPC_REBOOT_DELAY_MS;
+        status = "accepted";
+      }
+      break;
+    default:
+      ok = rpcError(extra, sizeof(extra), "unknown_cmd");
+      break;
+  }
+  publishRpcResponse(id, cmd, ok ? status : "error", extra, request.rxUs, true);
+  timelineSpan(TimelinePoint::RpcCommand, traceStart, static_cast<uint32_t>(cmd));
+}
+
+// Requests queued by onMqttMessage(); runs right after mqtt.loop()
+static void serviceRpc() {
+  RpcInbox<RPC_INBOX_LEN, RPC_BODY_SIZE>::Entry request;
+  while (g_rpcInbox.pop(request)) {
+    runRpcRequest(request);
+  }
+}
+
+static void serviceSensorReboot() {
+  if (g_sensorRebootAt == 0 || (long)(millis() - g_sensorRebootAt) < 0) {
+    return;
+  }
+  g_sensorRebootAt = 0;
+  restartWithCause(RestartCause::SensorFailure);
+}
+
+static void serviceRpcReboot() {
+  if (g_rpcRebootAt == 0 || (long)(millis() - g_rpcRebootAt) < 0) {
+    return;
+  }
+  g_rpcRebootAt = 0;
+  mqtt.disconnect();
+  restartWithCause(RestartCause::RemoteCommand);
+}
+
+// ---------- Self-benchmark ----------
+struct BenchTiming {
+  uint32_t totalUs = 0;
+  uint32_t maxUs = 0;
+  uint32_t count = 0;
+  void add(uint32_t us) {
+    totalUs += us;
+    maxUs = us > maxUs ? us : maxUs;
+    count++;
+  }
+  uint32_t avgUs() const { return count ? totalUs / count : 0; }
+};
+
+// Arm the one-shot flag and reboot, so the run starts from a fresh heap and
+// a cold TLS session. An empty host keeps the stored (or default) endpoint.
+static void requestSelfBenchmark(const String &host, uint16_t port) {
+  if (!g_prefs.begin("millo", false)) {
+    Serial.println("Preferences begin failed (bench)");
+    return;
+  }
+  if (!host.isEmpty()) {
+    g_prefs.putString("bench_host", host);
+    g_prefs.putUInt("bench_port", port ? port : MQTT_PORT);
+  }
+  g_prefs.putBool("bench", true);
+  g_prefs.end();
+  g_benchRebootAt = millis() + CONFIG_APPLY_DELAY_MS;
+  Serial.println("Self-benchmark requested; rebooting");
+}
+
+// Cleared as soon as it is read, so a run that crashes is not repeated
+static bool takeBenchRequest() {
+  if (!g_prefs.begin("millo", false)) {
+    return false;
+  }
+  const bool requested = g_prefs.getBool("bench", false);
+  if (requested) {
+    g_prefs.remove("bench");
+  }
+  g_prefs.end();
+  return requested;
+}
+
+static void serviceBenchReboot() {
+  if (g_benchRebootAt == 0 || (long)(millis() - g_benchRebootAt) < 0) {
+    return;
+  }
+  g_benchRebootAt = 0;
+  mqtt.disconnect();
+  restartWithCause(RestartCause::SelfBenchmark);
+}
+
+// DNS, TCP connect and the full mbedTLS handshake, as a fresh session pays them
+static int32_t benchTlsHandshakeMs(const String &host, uint16_t port) {
+  WiFiClientSecure client;
+  client.setInsecure();
+  const uint32_t start = millis();
+  const bool ok = client.connect(host.c_str(), port);
+  const uint32_t elapsed = millis() - start;
+  client.stop();
+  return ok ? static_cast<int32_t>(elapsed) : -1;
+}
+
+// Publish a nonce to our own echo topic and wait for the broker to hand it back
+static int32_t benchMqttRoundTripUs() {
+  if (!mqtt.connected()) {
+    return -1;
+  }
+  char echoTopic[112];
+  snprintf(echoTopic, sizeof(echoTopic), "%s/bench/echo", topicBuf);
+  if (!mqtt.subscribe(echoTopic)) {
+    return -1;
+  }
+  snprintf(g_benchNonce, sizeof(g_benchNonce), "%lu", static_cast<unsigned long>(micros()));
+  g_benchEchoUs = 0;
+  int32_t rtt = -1;
+  const uint32_t start = micros();
+  if (mqtt.publish(echoTopic, g_benchNonce)) {
+    while (g_benchEchoUs == 0 && mqtt.connected() && (micros() - start) < BENCH_ECHO_TIMEOUT_MS * 1000UL) {
+      mqtt.loop();
+      delay(1);
+    }
+    if (g_benchEchoUs != 0) {
+      rtt = static_cast<int32_t>(g_benchEchoUs - start);
+    }
+  }
+  g_benchNonce[0] = '\0';
+  mqtt.unsubscribe(echoTopic);
+  return rtt;
+}
+
+// 64-byte blobs in a scratch namespace; contents change every round so each
+// write reaches flash
+static void benchNvs(BenchTiming &writes, BenchTiming &reads) {
+  Preferences nvs;
+  if (!nvs.begin("millo_bench", false)) {
+    return;
+  }
+  uint8_t blob[64];
+  uint8_t back[64];
+  for (int i = 0; i < BENCH_NVS_ROUNDS; ++i) {
+    memset(blob, i + 1, sizeof(blob));
+    uint32_t start = micros();
+    nvs.putBytes("blob", blob, sizeof(blob));
+    writes.add(micros() - start);
+    start = micros();
+    nvs.getBytes("blob", back, sizeof(back));
+    reads.add(micros() - start);
+  }
+  nvs.clear();
+  nvs.end();
+}
+
+// Parse cost of a typical controller-thresholds body, document allocation
+// included as in applyThresholdResponse(); nothing is applied
+static void benchJsonParse(BenchTiming &parses) {
+  static const char SAMPLE[] =
+      "{\"success\":true,\"data\":["
+      "{\"id\":412,\"controller_id\":\"246F28000100\",\"arrangement\":2,\"sensor_name\":\"Temperature\","
+      "\"is_enabled\":true,\"min_threshold\":22.5,\"max_threshold\":26.5,\"sensor_min\":22,\"sensor_max\":27,"
+      "\"updated_at\":\"2025-05-02T09:14:11.000Z\"},"
+      "{\"id\":413,\"controller_id\":\"246F28000100\",\"arrangement\":0,\"sensor_name\":\"Humidity\","
+      "\"is_enabled\":true,\"min_threshold\":80,\"max_threshold\":84,\"sensor_min\":80,\"sensor_max\":83,"
+      "\"updated_at\":\"2025-05-02T09:14:11.000Z\"}]}";
+  for (int i = 0; i < BENCH_JSON_ROUNDS; ++i) {
+    const uint32_t start = micros();
+    DynamicJsonDocument doc(4096);
+    const DeserializationError err = deserializeJson(doc, SAMPLE);
+    parses.add(micros() - start);
+    if (err) {
+      Serial.printf("Self-benchmark: sample JSON failed: %s\n", err.c_str());
+      return;
+    }
+  }
+}
+
+// One forced read of zone 0's first sensor
+static int32_t benchSensorReadUs() {
+#if USE_DHT
+  const uint32_t start = micros();
+  const bool ok = g_dht[0]->read(true);
+  const uint32_t elapsed = micros() - start;
+  return ok ? static_cast<int32_t>(elapsed) : -1;
+#else
+  while (g_readPending >= 0) {  // let a scheduled read finish first
+    pollSensorRead();
+    delay(1);
+  }
+  I2cClimateSensor &sensor = *g_climateSensors[0];
+  const uint32_t start = micros();
+  if (!sensor.trigger(millis())) {
+    return -1;
+  }
+  ClimateReading r;
+  SensorStatus status = sensor.poll(millis(), r);
+  while (status == SensorStatus::Busy && (micros() - start) < I2C_READ_TIMEOUT_MS * 1000UL) {
+    delay(1);
+    status = sensor.poll(millis(), r);
+  }
+  const uint32_t elapsed = micros() - start;
+  return status == SensorStatus::Ready ? static_cast<int32_t>(elapsed) : -1;
+#endif
+}
+
+// Times are -1 where a step failed or was skipped (e.g. no MQTT)
+static void runSelfBenchmark() {
+  String host = MQTT_HOST;
+  uint16_t port = MQTT_PORT;
+  if (g_prefs.begin("millo", true)) {
+    host = g_prefs.getString("bench_host", MQTT_HOST);
+    port = static_cast<uint16_t>(g_prefs.getUInt("bench_port", MQTT_PORT));
+    g_prefs.end();
+  }
+  Serial.printf("Self-benchmark: starting (TLS endpoint %s:%u)\n", host.c_str(), port);
+
+  const uint32_t heapFree = ESP.getFreeHeap();
+  const int32_t tlsMs = benchTlsHandshakeMs(host, port);
+  const int32_t mqttRttUs = benchMqttRoundTripUs();
+  BenchTiming nvsWrite, nvsRead, jsonParse;
+  benchNvs(nvsWrite, nvsRead);
+  benchJsonParse(jsonParse);
+  const int32_t sensorUs = benchSensorReadUs();
+
+  char json[640];
+  snprintf(json, sizeof(json),
+           "{\"board\":\"%s\",\"chip\":\"%s\",\"chip_rev\":%u,\"cpu_mhz\":%lu,\"heap_free\":%lu,"
+           "\"heap_min\":%lu,\"rssi\":%d,\"tls\":{\"host\":\"%.64s\",\"port\":%u,\"ms\":%ld},"
+           "\"mqtt_rtt_us\":%ld,\"nvs_write_us\":{\"avg\":%lu,\"max\":%lu},"
+           "\"nvs_read_us\":{\"avg\":%lu,\"max\":%lu},\"json_parse_us\":{\"avg\":%lu,\"max\":%lu},"
+           "\"sensor\":\"%s\",\"sensor_read_us\":%ld,\"ts\":%lu,\"uptime_ms\":%lu}",
+           board::NAME, ESP.getChipModel(), static_cast<unsigned>(ESP.getChipRevision()),
+           static_cast<unsigned long>(ESP.getCpuFreqMHz()), static_cast<unsigned long>(heapFree),
+           static_cast<unsigned long>(ESP.getMinFreeHeap()), static_cast<int>(WiFi.RSSI()), host.c_str(), port,
+           static_cast<long>(tlsMs), static_cast<long>(mqttRttUs), static_cast<unsigned long>(nvsWrite.avgUs()),
+           static_cast<unsigned long>(nvsWrite.maxUs), static_cast<unsigned long>(nvsRead.avgUs()),
+           static_cast<unsigned long>(nvsRead.maxUs), static_cast<unsigned long>(jsonParse.avgUs()),
+           static_cast<unsigned long>(jsonParse.maxUs), USE_DHT ? "dht22" : "i2c", static_cast<long>(sensorUs),
+           static_cast<unsigned long>(g_time.now()), static_cast<unsigned long>(millis()));
+  g_benchJson = json;
+  Serial.printf("Self-benchmark: %s\n", json);
+
+  if (!mqtt.connected()) {
+    Serial.println("Self-benchmark: MQTT down, report only on /bench");
+    return;
+  }
+  ensureMqttBufferSize(BENCH_MQTT_BUFFER);
+  char benchTopic[112];
+  snprintf(benchTopic, sizeof(benchTopic), "%s/bench", topicBuf);
+  if (!mqtt.publish(benchTopic, json, true)) {  // retained: the last run per controller
+    Serial.println("Self-benchmark: MQTT publish failed");
+  }
 }
 
 void setup() {
   Serial.begin(115200);
   delay(50);
+  reviewLastReset();
+#if TIMELINE_TRACE
+  g_loopTaskHandle = xTaskGetCurrentTaskHandle();
+#endif
 
   pinMode(WIFI_RESET_PIN, INPUT_PULLUP);
-  Serial.println(F("Hold BOOT for 3s to clear Wi-Fi credentials"));
+  Serial.println(F("Hold BOOT for 3s to clear Wi-Fi credentials, 1-3s to run the self-benchmark"));
   g_controllerId = deriveControllerId();
   g_controllerIdCompact = g_controllerId;
   g_controllerIdCompact.replace(":", "");
   Serial.printf("Controller ID (MAC): %s\n", g_controllerId.c_str());
 
-  pinMode(LIGHT_PIN, INPUT);
-  pinMode(WATER_PIN, INPUT_PULLUP);
-  pinMode(RELAY1_PIN, OUTPUT);
-  pinMode(RELAY2_PIN, OUTPUT);
-  pinMode(BUZZER_PIN, OUTPUT);
-  pinMode(RELAY4_PIN, OUTPUT);
-  pinMode(RELAY5_PIN, OUTPUT);
-
-  relayWrite(RELAY1_PIN, g_relay1On);
-  relayWrite(RELAY2_PIN, g_relay2On);
-  relayWrite(RELAY4_PIN, g_relay4On);
-  relayWrite(RELAY5_PIN, g_relay5On);
-  digitalWrite(BUZZER_PIN, LOW);  // Buzzer off initially
-
-  g_waterPendingRaw = digitalRead(WATER_PIN);
-  g_waterPendingSince = millis();
-  g_waterValid = false;
-  g_lastWaterOutputOn = false;
+  if (LIGHT_PIN != board::NO_PIN) {
+    pinMode(LIGHT_PIN, INPUT);
+  }
+  g_buzzer.begin();  // configures BUZZER_PIN, off initially
+  g_memTimeline.begin(MEM_BUCKET_S);
+
+  // Relay hysteresis/default-on behaviour, per zone
+  for (size_t z = 0; z < ZONE_COUNT; ++z) {
+    ZoneState &zone = g_zones[z];
+    const ZoneRelayPins &pins = ZONE_RELAYS[z];
+    zone.th = DEFAULT_THRESHOLDS;
+    zone.relay1On = false;
+    zone.relay2On = false;
+    zone.relay4On = true;
+    zone.relay5On = true;
+    zone.cycle = RelayCycle();
+    const uint8_t relayPins[] = {pins.relay1, pins.relay2, pins.relay4, pins.relay5};
+    for (uint8_t pin : relayPins) {
+      if (pin != board::NO_PIN) {
+        pinMode(pin, OUTPUT);
+      }
+    }
+    relayWrite(pins.relay1, zone.relay1On);
+    relayWrite(pins.relay2, zone.relay2On);
+    relayWrite(pins.relay4, zone.relay4On);
+    relayWrite(pins.relay5, zone.relay5On);
+  }
+
+  setupWaterSensor();
+
+  for (size_t i = 0; i < SENSOR_COUNT; ++i) {
+    g_sensors[i].lastReadSuccess = true;
+    g_sampler.setMinInterval(i, SENSOR_MIN_INTERVAL_MS);
+  }
+
+#if USE_I2C
+  g_i2c.begin(board::I2C_SDA_PIN, board::I2C_SCL_PIN);
+#if !USE_DHT
+  for (size_t i = 0; i < SENSOR_COUNT; ++i) {
+    g_climateSensors[i] = new I2cClimateSensor(g_i2c, ZONE_SENSORS[i].source);
+    g_climateSensors[i]->begin(millis());
+  }
+#endif
+#if USE_SCD4X
+  g_co2Sensor.begin(millis());
+#endif
+#endif
 
 #if USE_DHT
-  Serial.println("Initializing DHT22 sensor...");
-  dht.begin();
+  Serial.printf("Initializing %u DHT22 sensor(s)...\n", static_cast<unsigned>(SENSOR_COUNT));
+  for (size_t i = 0; i < SENSOR_COUNT; ++i) {
+    g_dht[i] = new DHT(ZONE_SENSORS[i].source, DHT_TYPE);
+    g_dht[i]->begin();
+  }
   g_lastDhtInitTime = millis();
   delay(3000); // Extended delay for DHT22 stabilization (was 2s, now 3s)
   Serial.println("DHT22 initial stabilization complete");
 #endif
 
   setupHttpRoutes();
+  g_benchPending = takeBenchRequest();
+  if (g_benchPending) {
+    Serial.println("Self-benchmark boot: runs once Wi-Fi and MQTT are up");
+  }
 
   bool haveConfig = loadConfig();
   if (!haveConfig) {
@@ -951,6 +2997,7 @@ void setup() {
     enterProvisioningMode("no stored credentials");
     ensureHttpServerStarted();
     g_dhtInitialized = true;  // Mark as initialized even in provisioning mode
+    startStallWatchdog();
     return;
   }
 
@@ -964,60 +3011,150 @@ void setup() {
   g_dhtInitialized = true;
 
   ensureHttpServerStarted();
+  buildTopics();
   connectMQTT();
-  snprintf(topicBuf, sizeof(topicBuf), "topic/%s", g_controllerIdCompact.c_str());
   
-  // Delay first publish to ensure DHT is fully ready after WiFi power surge
-  g_lastPubMs = millis() - (PUBLISH_MS - 5000);  // First publish in 5 seconds
+  startCycles();
+  startStallWatchdog();
 }
 
 void loop() {
+  g_crash.uptimeS = uptimeSeconds();
+  setLoopStage(LoopStage::Http);
   pollWifiResetButton();
   server.handleClient();
+  serviceFactoryReset();
+  serviceBenchReboot();
+  serviceRpcReboot();
+  serviceSensorReboot();
+  serviceWiFiSwitch();
+  serviceMemProfiler();
 
   if (g_isProvisioning) {
     return;
   }
 
+  setLoopStage(LoopStage::WiFi);
   ensureWiFiConnected();
+  if (!g_time.started() && WiFi.status() == WL_CONNECTED) {
+    g_time.begin(NTP_SERVER_1, NTP_SERVER_2);
+  }
+#if ESPNOW_GATEWAY
+  if (!g_espNow.started() && WiFi.status() == WL_CONNECTED) {
+    startSatelliteGateway();
+  }
+  setLoopStage(LoopStage::Satellites);
+  serviceSatellites();
+#endif
+  setLoopStage(LoopStage::Registration);
   handleRegistration();
+  setLoopStage(LoopStage::Mqtt);
   connectMQTT();
 
   if (mqtt.connected()) {
     mqtt.loop();
+    serviceRpc();
+    publishCrashReport();
+    setLoopStage(LoopStage::Alarms);
+    publishAlarms();
+    publishSensorHealth();
+  }
+  if (g_benchPending && WiFi.status() == WL_CONNECTED &&
+      (mqtt.connected() || millis() >= BENCH_START_TIMEOUT_MS)) {
+    g_benchPending = false;
+    setLoopStage(LoopStage::Bench);
+    runSelfBenchmark();
   }
 
+  setLoopStage(LoopStage::Relays);
+  serviceRelayOverrides();
+
+  setLoopStage(LoopStage::Water);
   handleWaterLevel();
+#if TRACE_RECORD
+  traceLinkState();
+#endif
+
+  setLoopStage(LoopStage::Sensors);
+  serviceSensors();
 
   unsigned long now = millis();
-  if (now - g_lastPubMs >= PUBLISH_MS) {
-    g_lastPubMs = now;
+  const bool publishTick = g_publishNow || (now - g_lastPubMs >= g_samplePeriod.periodMs());
+  // The adaptive period only sets how often readings go out. Relays decide
+  // on a fixed cadence: a faster one near a limit, where readings hover,
+  // would only make the bang-bang strategies chatter, and the
+  // time-proportional cycle is counted in decisions.
+  const bool relayTick = (now - g_lastRelayMs >= RELAY_DECISION_MS);
+#if USE_SCD4X
+  serviceCo2Sensor(publishTick);
+#endif
 
-    int t = 0, h = 0;
-    bool okRead = false;
-    
-    // Only read DHT if initialization is complete
-    if (g_dhtInitialized) {
-      okRead = readTempHum(t, h);
-    } else {
-      Serial.println("DHT not yet initialized, skipping read");
+  if (publishTick || relayTick) {
+    for (size_t z = 0; z < ZONE_COUNT; ++z) {
+      fuseZone(z, now);
+    }
+    setLoopStage(LoopStage::Thresholds);
+    if (now - g_lastThresholdFetchMs >= THRESHOLD_FETCH_MS) {
+      g_lastThresholdFetchMs = now;
+      if (!fetchControllerThresholds()) {
+        Serial.println("Using cached thresholds (latest fetch failed)");
+      }
     }
+#if ESPNOW_GATEWAY
+    g_satGateway.setThresholds(zoneSatThresholds(g_zones[0].th));
+#endif
+  }
 
-    if (okRead) {
-      Serial.printf("Sensors -> T=%dC, H=%d%%\n", t, h);
-    } else {
-      Serial.println("Sensors -> read failed (T=0, H=0)");
+  if (relayTick) {
+    g_lastRelayMs = now;
+    setLoopStage(LoopStage::Relays);
+    for (size_t z = 0; z < ZONE_COUNT; ++z) {
+      handleRelays(z);
     }
+  }
 
-    if (!fetchControllerThresholds()) {
-      Serial.println("Using cached thresholds (latest fetch failed)");
+  if (publishTick) {
+    const uint32_t windowMs = now - g_lastPubMs;
+    g_lastPubMs = now;
+    g_publishNow = false;
+
+    float urgency = 0.0f;
+    for (size_t z = 0; z < ZONE_COUNT; ++z) {
+      const ZoneState &zone = g_zones[z];
+      urgency = std::max(urgency, zoneSamplingUrgency(zone));
+      if (zone.valid) {
+        Serial.printf("Zone %u sensors -> T=%.1fC, H=%.1f%% (%u used, %u rejected, %lu in window)\n",
+                      static_cast<unsigned>(z), zone.t, zone.h, zone.sensorsUsed, zone.sensorsRejected,
+                      static_cast<unsigned long>(zone.tWindow.count()));
+      } else {
+        Serial.printf("Zone %u sensors -> no fresh reading (T=0, H=0)\n", static_cast<unsigned>(z));
+      }
     }
 
-    handleRelays(t, h);
+    setLoopStage(LoopStage::Alarms);
+    evaluateAlarms(now);
 
     int water = g_waterValid ? (g_lastWaterRaw == LOW ? 1 : 0) : WATER_FALLBACK_STATE;
     const char *waterSrc = g_waterValid ? "sensor" : "default";
     Serial.printf("Water -> %d (0=full,1=needs water, src=%s)\n", water, waterSrc);
-    publishArray(t, h, water);
+
+    char zoneTopic[112];
+    setLoopStage(LoopStage::Publish);
+    for (size_t z = 0; z < ZONE_COUNT; ++z) {
+      const char *topic = topicBuf;  // zone 0 keeps the app's topic
+      if (z > 0) {
+        snprintf(zoneTopic, sizeof(zoneTopic), "%s/zone/%u", topicBuf, static_cast<unsigned>(z));
+        topic = zoneTopic;
+      }
+      publishArray(topic, static_cast<int>(lroundf(g_zones[z].t)), static_cast<int>(lroundf(g_zones[z].h)), water);
+      publishSample(topic, g_zones[z], water, windowMs);
+      g_zones[z].tWindow.reset();
+      g_zones[z].hWindow.reset();
+    }
+#if ESPNOW_GATEWAY
+    setLoopStage(LoopStage::Satellites);
+    publishSatellites();
+#endif
+    updateSamplePeriod(urgency);
   }
 }
\ No newline at end of file
@@ -0,0 +1,140 @@
+#pragma once
+// Memory profiler: heap and stack samples on a fixed cadence.
+//
+// Pure logic (no Arduino headers). The firmware reads the heap and task
+// counters and feeds them in. This file keeps two rings:
+//   fine    the last FINE samples as taken, for the recent shape
+//   coarse  per-bucket minima (free heap, largest block), for long soaks
+// plus an optional table of large allocations by call site.
+
+#include <stddef.h>
+#include <stdint.h>
+
+template <size_t TASKS>
+struct MemSample {
+  uint32_t uptimeS;
+  uint32_t freeHeap;
+  uint32_t largestBlock;     // biggest single allocation that would succeed
+  uint32_t minEverFree;      // lowest free heap since boot
+  uint32_t stackFree[TASKS]; // per-task stack high-water mark (bytes never used), 0 if unknown
+};
+
+// Worst values seen in one coarse bucket
+struct MemBucket {
+  uint32_t startS;
+  uint32_t minFree;
+  uint32_t minLargest;
+};
+
+template <size_t FINE, size_t COARSE, size_t TASKS>
+class MemTimeline {
+ public:
+  typedef MemSample<TASKS> Sample;
+
+  void begin(uint32_t bucketS) { bucketS_ = bucketS ? bucketS : 1; }
+
+  void add(const Sample &s) {
+    fine_[fineNext_] = s;
+    fineNext_ = (fineNext_ + 1) % FINE;
+    if (fineCount_ < FINE) {
+      fineCount_++;
+    }
+    latest_ = s;
+
+    const uint32_t start = s.uptimeS - s.uptimeS % bucketS_;
+    if (!bucketOpen_ || start != current_.startS) {
+      if (bucketOpen_) {
+        pushBucket(current_);
+      }
+      current_.startS = start;
+      current_.minFree = s.freeHeap;
+      current_.minLargest = s.largestBlock;
+      bucketOpen_ = true;
+      return;
+    }
+    if (s.freeHeap < current_.minFree) {
+      current_.minFree = s.freeHeap;
+    }
+    if (s.largestBlock < current_.minLargest) {
+      current_.minLargest = s.largestBlock;
+    }
+  }
+
+  bool empty() const { return fineCount_ == 0; }
+  const Sample &latest() const { return latest_; }
+  uint32_t bucketS() const { return bucketS_; }
+
+  // Oldest first
+  size_t fineCount() const { return fineCount_; }
+  const Sample &fine(size_t i) const { return fine_[(fineNext_ + FINE - fineCount_ + i) % FINE]; }
+
+  // Closed buckets oldest first, then the one still filling
+  size_t coarseCount() const { return coarseCount_ + (bucketOpen_ ? 1 : 0); }
+  const MemBucket &coarse(size_t i) const {
+    if (i == coarseCount_) {
+      return current_;
+    }
+    return coarse_[(coarseNext_ + COARSE - coarseCount_ + i) % COARSE];
+  }
+
+ private:
+  void pushBucket(const MemBucket &b) {
+    coarse_[coarseNext_] = b;
+    coarseNext_ = (coarseNext_ + 1) % COARSE;
+    if (coarseCount_ < COARSE) {
+      coarseCount_++;
+    }
+  }
+
+  Sample fine_[FINE] = {};
+  size_t fineNext_ = 0;
+  size_t fineCount_ = 0;
+  Sample latest_ = {};
+  MemBucket coarse_[COARSE] = {};
+  size_t coarseNext_ = 0;
+  size_t coarseCount_ = 0;
+  MemBucket current_ = {};
+  bool bucketOpen_ = false;
+  uint32_t bucketS_ = 3600;
+};
+
+// Large allocations grouped by call site (the allocator's caller). record()
+// runs inside malloc: it never allocates, and the caller serialises access.
+// Sites past N are only counted in dropped().
+template <size_t N>
+class AllocSiteTable {
+ public:
+  struct Site {
+    uintptr_t pc;      // 0 = unused slot
+    uint32_t count;
+    uint32_t largest;
+    uint64_t bytes;
+  };
+
+  void record(uintptr_t pc, size_t size) {
+    const size_t start = static_cast<size_t>((pc >> 2) % N);
+    for (size_t probe = 0; probe < N; ++probe) {
+      Site &s = sites_[(start + probe) % N];
+      if (s.pc == 0) {
+        s.pc = pc;
+      } else if (s.pc != pc) {
+        continue;
+      }
+      s.count++;
+      s.bytes += size;
+      if (size > s.largest) {
+        s.largest = static_cast<uint32_t>(size);
+      }
+      return;
+    }
+    dropped_++;
+  }
+
+  static size_t capacity() { return N; }
+  const Site &at(size_t i) const { return sites_[i]; }
+  uint32_t dropped() const { return dropped_; }
+
+ private:
+  Site sites_[N] = {};
+  uint32_t dropped_ = 0;
+};
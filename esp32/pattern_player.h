@@ -0,0 +1,126 @@
+#pragma once
+// Runs a PatternSequencer off the main loop using a one-shot esp_timer.
+//
+// Each timer expiry advances the sequencer, writes the pin and re-arms the
+// timer for the next phase change, so loop() never waits on an alert.
+// play(), stop() and setIdle() may come from any task (loop, FreeRTOS timer
+// callbacks, BLE callbacks): they only change the queue under the lock and
+// kick a zero-delay timer, so the pin and the phase timer are only touched
+// on the esp_timer task, one callback at a time.
+// Pass a LEDC channel to drive a passive buzzer with the pattern's tone;
+// without one the pin is switched digitally (active buzzer / LED).
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "pattern_sequencer.h"
+
+class PatternPlayer {
+ public:
+  explicit PatternPlayer(uint8_t pin, int8_t ledcChannel = -1)
+      : pin_(pin), ledcChannel_(ledcChannel) {}
+
+  void begin(bool idleOn = false) {
+    idleOn_ = idleOn;
+    if (ledcChannel_ >= 0) {
+      ledcSetup(ledcChannel_, DEFAULT_TONE_HZ, 8);
+      ledcAttachPin(pin_, ledcChannel_);
+    } else {
+      pinMode(pin_, OUTPUT);
+    }
+
+    apply(idleOn_, 0);
+    esp_timer_create_args_t args = {};
+    args.callback = &PatternPlayer::onTimer;
+    args.arg = this;
+    args.name = "pattern";
+    esp_timer_create(&args, &timer_);
+    args.name = "pattern_kick";
+    esp_timer_create(&args, &kick_);
+  }
+
+  // Queue a pattern; returns false if it was rejected (queue full of
+  // higher-priority alerts).
+  bool play(const TonePattern &p) {
+    portENTER_CRITICAL(&mux_);
+    const bool ok = seq_.enqueue(p, millis());
+    portEXIT_CRITICAL(&mux_);
+    kick();
+    return ok;
+  }
+
+  void stop(uint8_t maxPriority = 0xFF) {
+    portENTER_CRITICAL(&mux_);
+    seq_.stop(millis(), maxPriority);
+    portEXIT_CRITICAL(&mux_);
+    kick();
+  }
+
+  // Level the pin rests at when no pattern is playing
+  void setIdle(bool on) {
+    portENTER_CRITICAL(&mux_);
+    idleOn_ = on;
+    portEXIT_CRITICAL(&mux_);
+    kick();
+  }
+
+  bool busy() {
+    portENTER_CRITICAL(&mux_);
+    const bool active = seq_.active();
+    portEXIT_CRITICAL(&mux_);
+    return active;
+  }
+
+ private:
+  static const uint16_t DEFAULT_TONE_HZ = 2700;
+
+  static void onTimer(void *arg) {
+    static_cast<PatternPlayer *>(arg)->service();
+  }
+
+  // Already armed is fine: the pending callback reads the new state
+  void kick() {
+    if (kick_ != nullptr) {
+      esp_timer_start_once(kick_, 0);
+    }
+  }
+
+  // esp_timer task only (both timers' callback)
+  void service() {
+    portENTER_CRITICAL(&mux_);
+    const uint32_t waitMs = seq_.tick(millis());
+    const bool on = seq_.active() ? seq_.outputOn() : idleOn_;
+    const uint16_t toneHz = seq_.outputToneHz();
+    portEXIT_CRITICAL(&mux_);
+
+    apply(on, toneHz);
+    esp_timer_stop(timer_);
+    if (waitMs > 0) {
+      esp_timer_start_once(timer_, static_cast<uint64_t>(waitMs) * 1000ULL);
+    }
+  }
+
+  void apply(bool on, uint16_t toneHz) {
+    if (applied_ && on == lastOn_ && toneHz == lastToneHz_) {
+      return;
+    }
+    applied_ = true;
+    lastOn_ = on;
+    lastToneHz_ = toneHz;
+    if (ledcChannel_ >= 0) {
+      ledcWriteTone(ledcChannel_, on ? (toneHz ? toneHz : DEFAULT_TONE_HZ) : 0);
+    } else {
+      digitalWrite(pin_, on ? HIGH : LOW);
+    }
+  }
+
+  const uint8_t pin_;
+  const int8_t ledcChannel_;
+  bool idleOn_ = false;
+  bool applied_ = false;
+  bool lastOn_ = false;
+  uint16_t lastToneHz_ = 0;
+  esp_timer_handle_t timer_ = nullptr;  // next phase change
+  esp_timer_handle_t kick_ = nullptr;   // a caller changed the queue or idle level
+  portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+  PatternSequencer<4> seq_;
+};
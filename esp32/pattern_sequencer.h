@@ -0,0 +1,143 @@
+#pragma once
+// Declarative on/off pattern sequencer for the buzzer and status LED.
+//
+// Pure logic with no Arduino dependencies: the caller feeds it a millisecond
+// clock through tick() and applies output() to the pin. On the device the
+// clock is an esp_timer (see pattern_player.h); on the host it can be any
+// virtual counter, which keeps the sequencing reproducible off-target.
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct TonePattern {
+  uint16_t toneHz;    // 0 = plain digital drive (active buzzer / LED)
+  uint16_t onMs;
+  uint16_t offMs;
+  uint8_t repeat;     // number of on/off cycles, 0 = until stop()
+  uint8_t priority;   // higher preempts lower
+};
+
+template <size_t QueueDepth = 4>
+class PatternSequencer {
+ public:
+  // Queue a pattern. A pattern with higher priority than the one playing
+  // preempts it immediately, and the preempted one waits at the head of its
+  // priority to resume (from the start of the interrupted cycle) afterwards.
+  // Otherwise the pattern waits behind anything of equal or higher priority.
+  // Returns false when the queue is full of patterns that outrank it.
+  bool enqueue(const TonePattern &p, uint32_t nowMs) {
+    if (p.onMs == 0) {
+      return false;
+    }
+    if (!active_ || p.priority > current_.priority) {
+      if (active_) {
+        TonePattern rest = current_;
+        rest.repeat = current_.repeat != 0 ? cyclesLeft_ : 0;
+        insert(rest, true);
+      }
+      start(p, nowMs);
+      return true;
+    }
+    return insert(p, false);
+  }
+
+  // Advance to nowMs. Returns the number of ms until the next output change,
+  // or 0 when nothing is playing.
+  uint32_t tick(uint32_t nowMs) {
+    while (active_ && static_cast<int32_t>(nowMs - phaseEndMs_) >= 0) {
+      advance();
+    }
+    return active_ ? (phaseEndMs_ - nowMs) : 0;
+  }
+
+  // Stop the current pattern and drop everything queued at or below priority.
+  void stop(uint32_t nowMs, uint8_t maxPriority = 0xFF) {
+    size_t kept = 0;
+    for (size_t i = 0; i < count_; ++i) {
+      if (queue_[i].priority > maxPriority) {
+        queue_[kept++] = queue_[i];
+      }
+    }
+    count_ = kept;
+    if (active_ && current_.priority <= maxPriority) {
+      active_ = false;
+      on_ = false;
+      if (count_ > 0) {
+        start(popFront(), nowMs);
+      }
+    }
+  }
+
+  bool active() const { return active_; }
+  bool outputOn() const { return active_ && on_; }
+  uint16_t outputToneHz() const { return outputOn() ? current_.toneHz : 0; }
+  uint8_t activePriority() const { return active_ ? current_.priority : 0; }
+  size_t queued() const { return count_; }
+
+ private:
+  void start(const TonePattern &p, uint32_t nowMs) {
+    current_ = p;
+    cyclesLeft_ = p.repeat;
+    active_ = true;
+    on_ = true;
+    phaseEndMs_ = nowMs + p.onMs;
+  }
+
+  bool insert(const TonePattern &p, bool aheadOfEqual) {
+    if (count_ == QueueDepth) {
+      // Evict the lowest-priority waiter if the newcomer outranks it
+      if (queue_[count_ - 1].priority >= p.priority) {
+        return false;
+      }
+      count_--;
+    }
+
+    size_t pos = count_;
+    while (pos > 0 && (queue_[pos - 1].priority < p.priority ||
+                       (aheadOfEqual && queue_[pos - 1].priority == p.priority))) {
+      queue_[pos] = queue_[pos - 1];
+      pos--;
+    }
+    queue_[pos] = p;
+    count_++;
+    return true;
+  }
+
+  TonePattern popFront() {
+    TonePattern p = queue_[0];
+    for (size_t i = 1; i < count_; ++i) {
+      queue_[i - 1] = queue_[i];
+    }
+    count_--;
+    return p;
+  }
+
+  void advance() {
+    const uint32_t at = phaseEndMs_;
+    if (on_ && current_.offMs > 0) {
+      on_ = false;
+      phaseEndMs_ = at + current_.offMs;
+      return;
+    }
+
+    // End of one on/off cycle
+    if (current_.repeat != 0 && --cyclesLeft_ == 0) {
+      active_ = false;
+      on_ = false;
+      if (count_ > 0) {
+        start(popFront(), at);
+      }
+      return;
+    }
+    on_ = true;
+    phaseEndMs_ = at + current_.onMs;
+  }
+
+  TonePattern queue_[QueueDepth] = {};
+  size_t count_ = 0;
+  TonePattern current_ = {};
+  uint8_t cyclesLeft_ = 0;
+  bool active_ = false;
+  bool on_ = false;
+  uint32_t phaseEndMs_ = 0;
+};
@@ -0,0 +1,180 @@
+#pragma once
+// Relay decisions for one zone, kept apart from the pins so the firmware and
+// the host twin (replay/twin_main.cpp) run the same code.
+//
+// Pure logic (no Arduino headers). Relay roles, as wired on the controller:
+//   relay1  extra cooling, on when too hot
+//   relay5  ventilation, on unless too cold
+//   relay2  humidifier boost, on when too dry
+//   relay4  humidifier, on unless too humid
+
+#include <stdint.h>
+
+enum class RelayStrategy : uint8_t {
+  Threshold = 0,         // every relay follows its limit directly (original behaviour)
+  Hysteresis = 1,        // a relay switches back only once the reading is a band inside the limit
+  TimeProportional = 2,  // relay5/relay4 duty over a cycle, proportional to the position in the band
+};
+
+struct RelayControlConfig {
+  RelayStrategy strategy;
+  float tempBandC;       // Hysteresis / boosts of TimeProportional
+  float humBandPct;
+  uint8_t cyclePeriods;  // TimeProportional: decisions (publish periods) per on/off cycle
+};
+
+struct RelayLimits {
+  float tempMin;
+  float tempMax;
+  float humMin;
+  float humMax;
+};
+
+struct RelayOutputs {
+  bool relay1;
+  bool relay2;
+  bool relay4;
+  bool relay5;
+};
+
+// Per-zone memory of the time-proportional cycle
+struct RelayCycle {
+  uint8_t step;
+  uint8_t ventSteps;
+  uint8_t humSteps;
+};
+
+namespace relay_control {
+
+inline float clamp01(float x) { return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x); }
+
+// Band limited to half the span so the two limits' bands never cross
+inline float band(float requested, float lo, float hi) {
+  const float half = (hi - lo) * 0.5f;
+  if (requested < 0.0f) {
+    return 0.0f;
+  }
+  return requested > half ? (half > 0.0f ? half : 0.0f) : requested;
+}
+
+// on above `limit`, off again at or below limit - b
+inline bool holdAbove(bool on, float x, float limit, float b) { return on ? x > limit - b : x > limit; }
+
+// on below `limit`, off again at or above limit + b
+inline bool holdBelow(bool on, float x, float limit, float b) { return on ? x < limit + b : x < limit; }
+
+}  // namespace relay_control
+
+// Outputs for the reading (t, h) given the current outputs. Called once per
+// publish period; `cycle` only matters for TimeProportional.
+inline RelayOutputs decideRelays(const RelayControlConfig &cfg, const RelayLimits &lim, float t, float h,
+                                 const RelayOutputs &current, RelayCycle &cycle) {
+  using namespace relay_control;
+  const bool tempHigh = t > lim.tempMax;
+  const bool tempLow = t < lim.tempMin;
+  const bool humHigh = h > lim.humMax;
+  const bool humLow = h < lim.humMin;
+
+  RelayOutputs out;
+  if (cfg.strategy == RelayStrategy::Threshold) {
+    out.relay1 = tempHigh;
+    out.relay5 = !tempLow;
+    out.relay2 = humLow;
+    out.relay4 = !humHigh;
+    return out;
+  }
+
+  const float tb = band(cfg.tempBandC, lim.tempMin, lim.tempMax);
+  const float hb = band(cfg.humBandPct, lim.humMin, lim.humMax);
+  out.relay1 = holdAbove(current.relay1, t, lim.tempMax, tb);
+  out.relay2 = holdBelow(current.relay2, h, lim.humMin, hb);
+  if (cfg.strategy == RelayStrategy::Hysteresis) {
+    out.relay5 = !holdBelow(!current.relay5, t, lim.tempMin, tb);
+    out.relay4 = !holdAbove(!current.relay4, h, lim.humMax, hb);
+    return out;
+  }
+
+  // TimeProportional: duty is fixed at the start of each cycle; a reading
+  // outside the limits overrides it at once.
+  const uint8_t periods = cfg.cyclePeriods ? cfg.cyclePeriods : 1;
+  if (cycle.step >= periods) {
+    cycle.step = 0;
+  }
+  if (cycle.step == 0) {
+    const float tSpan = lim.tempMax - lim.tempMin;
+    const float hSpan = lim.humMax - lim.humMin;
+    const float ventDuty = tSpan > 0.0f ? clamp01((t - lim.tempMin) / tSpan) : (tempLow ? 0.0f : 1.0f);
+    const float humDuty = hSpan > 0.0f ? clamp01((lim.humMax - h) / hSpan) : (humHigh ? 0.0f : 1.0f);
+    cycle.ventSteps = static_cast<uint8_t>(ventDuty * periods + 0.5f);
+    cycle.humSteps = static_cast<uint8_t>(humDuty * periods + 0.5f);
+  }
+  out.relay5 = tempHigh || (!tempLow && cycle.step < cycle.ventSteps);
+  out.relay4 = humLow || (!humHigh && cycle.step < cycle.humSteps);
+  cycle.step++;
+  return out;
+}
+
+// Remote overrides for one zone: a relay forced on or off for a while, after
+// which the strategy's decision applies again
+class RelayOverrides {
+ public:
+  enum Relay : uint8_t { Relay1, Relay2, Relay4, Relay5, Count };
+
+  // Relay number as wired (1, 2, 4 or 5); Count for anything else
+  static Relay fromNumber(int number) {
+    switch (number) {
+      case 1: return Relay1;
+      case 2: return Relay2;
+      case 4: return Relay4;
+      case 5: return Relay5;
+      default: return Count;
+    }
+  }
+
+  void set(Relay r, bool on, uint32_t nowMs, uint32_t forMs) {
+    slots_[r].active = forMs > 0;
+    slots_[r].on = on;
+    slots_[r].startMs = nowMs;
+    slots_[r].forMs = forMs;
+  }
+  void clear(Relay r) { slots_[r].active = false; }
+
+  // Drop overrides that have run out; true if any did
+  bool expire(uint32_t nowMs) {
+    bool any = false;
+    for (uint8_t r = 0; r < Count; ++r) {
+      if (slots_[r].active && nowMs - slots_[r].startMs >= slots_[r].forMs) {
+        slots_[r].active = false;
+        any = true;
+      }
+    }
+    return any;
+  }
+
+  // Replace the decisions of the relays still overridden
+  void apply(RelayOutputs &out, uint32_t nowMs) {
+    expire(nowMs);
+    bool *const outs[Count] = {&out.relay1, &out.relay2, &out.relay4, &out.relay5};
+    for (uint8_t r = 0; r < Count; ++r) {
+      if (slots_[r].active) {
+        *outs[r] = slots_[r].on;
+      }
+    }
+  }
+
+  bool active(Relay r) const { return slots_[r].active; }
+  uint32_t remainingMs(Relay r, uint32_t nowMs) const {
+    const Slot &s = slots_[r];
+    const uint32_t elapsed = nowMs - s.startMs;
+    return s.active && elapsed < s.forMs ? s.forMs - elapsed : 0;
+  }
+
+ private:
+  struct Slot {
+    bool active;
+    bool on;
+    uint32_t startMs;
+    uint32_t forMs;
+  };
+  Slot slots_[Count] = {};
+};
@@ -0,0 +1,92 @@
+#pragma once
+// Power cycles for the host builds of main.cpp (replay and twin runners).
+//
+// main.cpp keeps its state in globals and ESP.restart() must start from
+// fresh ones, so every boot runs in a forked child of a process that never
+// ran the firmware. State that outlives a reset (the simulated world) is
+// copied into the child and back over a pipe, so it must be trivially
+// copyable.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "replay_hal.h"
+
+namespace replay {
+
+// Config of a provisioned, registered controller, so setup() goes straight
+// to the station connection
+inline void seedProvisionedPreferences() {
+  std::map<std::string, std::string> &cfg = Hal::get().prefs("millo");
+  cfg["ssid"] = "replay";
+  cfg["pass"] = "replay";
+  cfg["ctrl_name"] = "replay";
+  cfg["factory"] = "replay";
+  cfg["email"] = "replay@example.com";
+  cfg["reg"] = "1";
+}
+
+// boot(State &state, uint32_t startMs) runs setup()/loop() from startMs and
+// returns the time of ESP.restart(), or 0 once it reached the end. The next
+// boot starts rebootMs later. Returns false if a boot crashed.
+template <class State, class Boot>
+bool runBoots(State &state, uint32_t endMs, uint32_t rebootMs, Boot boot) {
+  struct Result {
+    uint32_t rebootAt;
+    State state;
+  };
+  uint32_t bootMs = 0;
+  while (bootMs < endMs) {
+    fflush(nullptr);  // the child's output must not repeat buffered text
+    int fds[2];
+    if (pipe(fds) != 0) {
+      perror("pipe");
+      return false;
+    }
+    const pid_t pid = fork();
+    if (pid == 0) {
+      close(fds[0]);
+      Result r;
+      r.state = state;
+      r.rebootAt = boot(r.state, bootMs);
+      fflush(nullptr);  // _exit() does not flush, and the timeline may not be stdout
+      const char *p = reinterpret_cast<const char *>(&r);
+      for (size_t left = sizeof(r); left > 0;) {
+        const ssize_t n = write(fds[1], p, left);
+        if (n <= 0) {
+          _exit(1);
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+      }
+      _exit(0);
+    }
+    close(fds[1]);
+    Result r;
+    char *p = reinterpret_cast<char *>(&r);
+    size_t got = 0;
+    while (got < sizeof(r)) {
+      const ssize_t n = read(fds[0], p + got, sizeof(r) - got);
+      if (n <= 0) {
+        break;
+      }
+      got += static_cast<size_t>(n);
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (got != sizeof(r) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "boot at %lu ms crashed\n", static_cast<unsigned long>(bootMs));
+      return false;
+    }
+    state = r.state;
+    if (r.rebootAt == 0) {
+      break;
+    }
+    bootMs = r.rebootAt + rebootMs;
+  }
+  return true;
+}
+
+}  // namespace replay
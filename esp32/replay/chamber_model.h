@@ -0,0 +1,242 @@
+#pragma once
+// Grow-chamber physics for the digital twin (twin_main.cpp).
+//
+// Lumped model integrated in 1 s steps:
+//  - Temperature: one thermal mass. It exchanges heat with the room through
+//    the envelope and through air exchange. Air is exchanged by leakage, the
+//    ventilation fan (relay5) and door openings. A constant internal gain
+//    (lights, substrate) heats it and the cooler (relay1) cools it.
+//  - Moisture: water vapour density, exchanged with the room air the same
+//    way. The humidifiers (relay4, boost relay2) and substrate evaporation
+//    raise it. A buffer factor stands in for moisture held on surfaces. It
+//    is capped at saturation.
+//
+// The room follows a daily sine. Sensor reads add Gaussian noise, the
+// DHT22's 0.1 resolution and an occasional failed read. Door openings use
+// their own random stream, so every strategy sees the same disturbances for
+// a given seed. Everything is plain data so a run can be copied across
+// forks.
+
+#include <math.h>
+#include <stdint.h>
+#include "../relay_control.h"
+
+struct ChamberParams {
+  double volumeM3 = 2.0;
+  double heatCapacityJPerK = 60000.0;  // air + shelving + substrate
+  double envelopeWPerK = 6.0;
+  double internalGainW = 60.0;
+  double leakAch = 0.5;                // air changes per hour
+  double ventAch = 20.0;               // relay5
+  double doorAch = 60.0;
+  double coolerW = 150.0;              // heat removed by relay1
+  double humidifierGPerH = 300.0;      // relay4
+  double boostGPerH = 200.0;           // relay2
+  double substrateGPerH = 20.0;
+  double moistureBuffer = 4.0;         // effective volume multiplier for vapour
+  // Room
+  double roomMeanC = 24.0;
+  double roomSwingC = 3.0;
+  double roomPeakHour = 15.0;
+  double roomRhPct = 55.0;
+  double doorOpensPerDay = 4.0;
+  double doorOpenS = 120.0;
+  // Sensor (DHT22)
+  double sensorNoiseC = 0.2;
+  double sensorNoisePct = 1.0;
+  double sensorFailProb = 0.002;       // per read
+  // Electrical draw per relay, W
+  double coolerPowerW = 120.0;
+  double ventPowerW = 25.0;
+  double humidifierPowerW = 30.0;
+  double boostPowerW = 40.0;
+};
+
+struct ChamberActuators {
+  bool cooler;      // relay1
+  bool boost;       // relay2
+  bool humidifier;  // relay4
+  bool vent;        // relay5
+};
+
+// xorshift64*: small, seedable, trivially copyable
+struct ChamberRng {
+  uint64_t s;
+
+  void seed(uint64_t v) { s = v ? v : 0x9E3779B97F4A7C15ULL; }
+  uint64_t next() {
+    s ^= s >> 12;
+    s ^= s << 25;
+    s ^= s >> 27;
+    return s * 0x2545F4914F6CDD1DULL;
+  }
+  double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+  double gaussian() {
+    double u = uniform();
+    if (u < 1e-12) {
+      u = 1e-12;
+    }
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * uniform());
+  }
+};
+
+// Relay order in the score arrays
+enum ChamberRelay { CR_RELAY1, CR_RELAY2, CR_RELAY4, CR_RELAY5, CR_COUNT };
+
+// Time out of band, relay starts and energy, on the true (not sensed) values
+struct ChamberScore {
+  double seconds;
+  double outTempS;
+  double outHumS;
+  double outAnyS;
+  double worstTempC;    // furthest beyond a temperature limit
+  double worstHumPct;
+  uint32_t starts[CR_COUNT];
+  double energyWh[CR_COUNT];
+
+  double totalWh() const {
+    double wh = 0.0;
+    for (int i = 0; i < CR_COUNT; ++i) {
+      wh += energyWh[i];
+    }
+    return wh;
+  }
+  uint32_t totalStarts() const {
+    uint32_t n = 0;
+    for (int i = 0; i < CR_COUNT; ++i) {
+      n += starts[i];
+    }
+    return n;
+  }
+};
+
+class Chamber {
+ public:
+  static double saturationGPerM3(double tC) {
+    const double esHpa = 6.112 * exp(17.62 * tC / (243.12 + tC));  // Magnus
+    return 216.7 * esHpa / (tC + 273.15);
+  }
+
+  void begin(const ChamberParams &p, const RelayLimits &band, uint64_t seed, double tempC, double rhPct) {
+    p_ = p;
+    band_ = band;
+    tempC_ = tempC;
+    vapour_ = saturationGPerM3(tempC) * rhPct / 100.0;
+    simMs_ = 0;
+    doorLeftS_ = 0.0;
+    last_ = ChamberActuators();
+    score_ = ChamberScore();
+    world_.seed(seed);
+    sensor_.seed(seed * 0x100000001B3ULL + 1);
+  }
+
+  uint32_t timeMs() const { return simMs_; }
+  double temperature() const { return tempC_; }
+  double humidity() const {
+    const double rh = 100.0 * vapour_ / saturationGPerM3(tempC_);
+    return rh > 100.0 ? 100.0 : rh;
+  }
+  double roomTemperature() const {
+    const double hours = simMs_ / 3600000.0;
+    return p_.roomMeanC + p_.roomSwingC * cos(2.0 * M_PI * (hours - p_.roomPeakHour) / 24.0);
+  }
+  const ChamberScore &score() const { return score_; }
+
+  // Integrate with `a` held until ms (whole seconds; the rest carries over)
+  void advanceTo(uint32_t ms, const ChamberActuators &a) {
+    countStarts(a);
+    while (static_cast<int32_t>(ms - simMs_) >= 1000) {
+      step(1.0, a);
+      simMs_ += 1000;
+    }
+  }
+
+  float readTemperature() {
+    if (sensor_.uniform() < p_.sensorFailProb) {
+      return NAN;
+    }
+    return quantise(tempC_ + sensor_.gaussian() * p_.sensorNoiseC);
+  }
+  float readHumidity() {
+    if (sensor_.uniform() < p_.sensorFailProb) {
+      return NAN;
+    }
+    double rh = humidity() + sensor_.gaussian() * p_.sensorNoisePct;
+    rh = rh < 0.0 ? 0.0 : (rh > 99.9 ? 99.9 : rh);
+    return quantise(rh);
+  }
+
+ private:
+  static float quantise(double x) { return static_cast<float>(floor(x * 10.0 + 0.5) / 10.0); }
+
+  void countStarts(const ChamberActuators &a) {
+    const bool now[CR_COUNT] = {a.cooler, a.boost, a.humidifier, a.vent};
+    const bool before[CR_COUNT] = {last_.cooler, last_.boost, last_.humidifier, last_.vent};
+    for (int i = 0; i < CR_COUNT; ++i) {
+      if (now[i] && !before[i]) {
+        score_.starts[i]++;
+      }
+    }
+    last_ = a;
+  }
+
+  void step(double dt, const ChamberActuators &a) {
+    // Door: same draw every step whatever the actuators do
+    const bool doorOpens = world_.uniform() < p_.doorOpensPerDay / 86400.0 * dt;
+    if (doorLeftS_ <= 0.0 && doorOpens) {
+      doorLeftS_ = p_.doorOpenS;
+    }
+    const bool door = doorLeftS_ > 0.0;
+    if (door) {
+      doorLeftS_ -= dt;
+    }
+
+    const double roomC = roomTemperature();
+    const double roomVapour = saturationGPerM3(roomC) * p_.roomRhPct / 100.0;
+    const double ach = p_.leakAch + (a.vent ? p_.ventAch : 0.0) + (door ? p_.doorAch : 0.0);
+    const double exchange = ach / 3600.0;  // chamber volumes per second
+    const double airWPerK = 1.2 * 1005.0 * p_.volumeM3 * exchange;
+
+    const double heatW = (p_.envelopeWPerK + airWPerK) * (roomC - tempC_) + p_.internalGainW -
+                         (a.cooler ? p_.coolerW : 0.0);
+    tempC_ += heatW * dt / p_.heatCapacityJPerK;
+
+    const double sourceGPerS =
+        ((a.humidifier ? p_.humidifierGPerH : 0.0) + (a.boost ? p_.boostGPerH : 0.0) + p_.substrateGPerH) /
+        3600.0;
+    vapour_ += (exchange * (roomVapour - vapour_) + sourceGPerS / p_.volumeM3) * dt / p_.moistureBuffer;
+    const double sat = saturationGPerM3(tempC_);
+    vapour_ = vapour_ > sat ? sat : (vapour_ < 0.0 ? 0.0 : vapour_);
+
+    scoreStep(dt, a);
+  }
+
+  void scoreStep(double dt, const ChamberActuators &a) {
+    const double t = tempC_;
+    const double h = humidity();
+    const double tOut = t > band_.tempMax ? t - band_.tempMax : (t < band_.tempMin ? band_.tempMin - t : 0.0);
+    const double hOut = h > band_.humMax ? h - band_.humMax : (h < band_.humMin ? band_.humMin - h : 0.0);
+    score_.seconds += dt;
+    score_.outTempS += tOut > 0.0 ? dt : 0.0;
+    score_.outHumS += hOut > 0.0 ? dt : 0.0;
+    score_.outAnyS += (tOut > 0.0 || hOut > 0.0) ? dt : 0.0;
+    score_.worstTempC = tOut > score_.worstTempC ? tOut : score_.worstTempC;
+    score_.worstHumPct = hOut > score_.worstHumPct ? hOut : score_.worstHumPct;
+    const double hours = dt / 3600.0;
+    score_.energyWh[CR_RELAY1] += a.cooler ? p_.coolerPowerW * hours : 0.0;
+    score_.energyWh[CR_RELAY2] += a.boost ? p_.boostPowerW * hours : 0.0;
+    score_.energyWh[CR_RELAY4] += a.humidifier ? p_.humidifierPowerW * hours : 0.0;
+    score_.energyWh[CR_RELAY5] += a.vent ? p_.ventPowerW * hours : 0.0;
+  }
+
+  ChamberParams p_;
+  RelayLimits band_;
+  double tempC_;
+  double vapour_;  // g/m3
+  uint32_t simMs_;
+  double doorLeftS_;
+  ChamberActuators last_;
+  ChamberScore score_;
+  ChamberRng world_;
+  ChamberRng sensor_;
+};
@@ -0,0 +1,330 @@
+// ESP-NOW link check: runs SatelliteLink and SatelliteGateway from
+// espnow_link.h against each other over SimEspNow (sim_espnow.h) on Linux.
+//
+// Scenarios, each on a virtual 1 ms clock with satellites reporting every
+// 10 s at staggered offsets:
+//
+//   clean    no impairment; a threshold change and a satellite reboot
+//            mid-run. Every reading counted once, nothing lost.
+//   lossy    20 % loss, 10 % duplication and 0-40 ms delay (reordering),
+//            once per seed. The gateway's per-node received/dup/lost
+//            counters must match what the medium actually delivered, and
+//            every satellite must end on the gateway's thresholds.
+//   outage   60 s with every frame lost. Each satellite reports the
+//            gateway lost once, finds it again, and the missed readings
+//            show up as lost.
+//
+// Output is one line per scenario plus a line per failed check; the exit
+// code is 1 when any check failed.
+//
+// usage: espnow [--seeds n]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <set>
+#include <vector>
+
+#include "../espnow_link.h"
+#include "../sim_espnow.h"
+
+namespace {
+
+const uint32_t PERIOD_MS = 10000;
+const size_t MAX_SATS = 4;
+const uint8_t CHANNEL = 6;
+
+int g_failures = 0;
+
+#define CHECK(cond, ...)                                   \
+  do {                                                     \
+    if (!(cond)) {                                         \
+      g_failures++;                                        \
+      printf("FAIL %s:%d %s: ", __FILE__, __LINE__, #cond); \
+      printf(__VA_ARGS__);                                 \
+      printf("\n");                                        \
+    }                                                      \
+  } while (0)
+
+SatThresholds thresholdsFor(int16_t tempMax) {
+  SatThresholds t = {1800, tempMax, 7000, 9000, true, true};
+  return t;
+}
+
+struct Satellite {
+  SimEspNow::Port *port = nullptr;
+  SatelliteLink<SimEspNow::Port> *link = nullptr;
+  uint16_t bootId = 0;
+  uint32_t sent = 0;  // readings, not retransmissions
+  uint32_t lostEvents = 0;
+  std::set<uint16_t> delivered;  // seqs of the current boot that reached the gateway
+  uint32_t deliveries = 0;       // including duplicates
+  uint16_t firstHeard = 0;
+};
+
+class Bench {
+ public:
+  Bench(size_t sats, uint32_t seed) : count_(sats) {
+    const uint8_t gwMac[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+    sim_.seed(seed);
+    gateway_ = sim_.addPort(gwMac, CHANNEL);
+    for (size_t i = 0; i < count_; ++i) {
+      const uint8_t mac[6] = {0x24, 0x6F, 0x28, 0x10, 0x00, static_cast<uint8_t>(i + 1)};
+      Satellite &s = sats_[i];
+      s.port = sim_.addPort(mac, CHANNEL);
+      s.link = new SatelliteLink<SimEspNow::Port>(*s.port);
+      reboot(i);
+    }
+  }
+
+  ~Bench() {
+    for (size_t i = 0; i < count_; ++i) {
+      delete sats_[i].link;
+    }
+  }
+
+  SimEspNow &sim() { return sim_; }
+  SatelliteGateway<8> &gateway() { return gw_; }
+  Satellite &sat(size_t i) { return sats_[i]; }
+  uint32_t now() const { return now_; }
+
+  void reboot(size_t i) {
+    Satellite &s = sats_[i];
+    s.bootId = static_cast<uint16_t>(0x1000 * (i + 1) + ++boots_);
+    s.link->begin(s.bootId);
+    s.delivered.clear();
+    s.firstHeard = 0;
+  }
+
+  // Advance the clock to `untilMs`, sending, polling and delivering each ms
+  void run(uint32_t untilMs) {
+    for (; now_ < untilMs; ++now_) {
+      sim_.setNow(now_);
+      for (size_t i = 0; i < count_; ++i) {
+        Satellite &s = sats_[i];
+        if (now_ % PERIOD_MS == 1000 * i) {
+          s.link->send(static_cast<int16_t>(2300 + s.sent % 50), 8100, true, 0, now_);
+          s.sent++;
+        }
+        if (s.link->poll(now_) == SatelliteLink<SimEspNow::Port>::Event::GatewayLost) {
+          s.lostEvents++;
+        }
+      }
+      sim_.deliver([&](SimEspNow::Port &to, const uint8_t from[6], const uint8_t *data, size_t len) {
+        if (&to == gateway_) {
+          noteReading(from, data, len);
+          gw_.onFrame(*gateway_, from, data, len, now_);
+          return;
+        }
+        for (size_t i = 0; i < count_; ++i) {
+          if (&to == sats_[i].port) {
+            sats_[i].link->onFrame(from, data, len);
+          }
+        }
+      });
+    }
+  }
+
+  const SatelliteNode *nodeOf(size_t i) const {
+    for (size_t n = 0; n < 8; ++n) {
+      const SatelliteNode &node = gw_.node(n);
+      if (node.used && memcmp(node.mac, sats_[i].port->mac, 6) == 0) {
+        return &node;
+      }
+    }
+    return nullptr;
+  }
+
+  // Seqs of the current boot that left the gateway's window undelivered
+  uint32_t expectedLost(size_t i) const {
+    const Satellite &s = sats_[i];
+    const SatelliteNode *node = nodeOf(i);
+    if (node == nullptr || s.delivered.empty()) {
+      return 0;
+    }
+    uint32_t lost = 0;
+    for (int32_t seq = s.firstHeard; seq <= static_cast<int32_t>(node->window.highest()) -
+                                                 static_cast<int32_t>(SequenceWindow::WINDOW);
+         ++seq) {
+      lost += s.delivered.count(static_cast<uint16_t>(seq)) ? 0 : 1;
+    }
+    return lost;
+  }
+
+ private:
+  void noteReading(const uint8_t from[6], const uint8_t *data, size_t len) {
+    SatReading r;
+    if (!decodeReading(data, len, r)) {
+      return;
+    }
+    for (size_t i = 0; i < count_; ++i) {
+      Satellite &s = sats_[i];
+      if (memcmp(from, s.port->mac, 6) == 0 && r.bootId == s.bootId) {
+        if (s.delivered.empty()) {
+          s.firstHeard = r.seq;
+        }
+        s.delivered.insert(r.seq);
+        s.deliveries++;
+      }
+    }
+  }
+
+  SimEspNow sim_;
+  SimEspNow::Port *gateway_ = nullptr;
+  SatelliteGateway<8> gw_;
+  Satellite sats_[MAX_SATS];
+  size_t count_;
+  uint32_t now_ = 0;
+  uint16_t boots_ = 0;
+};
+
+void checkThresholds(Bench &b, size_t sats, const char *scenario) {
+  const SatThresholds expected = thresholdsFor(2800);
+  for (size_t i = 0; i < sats; ++i) {
+    const SatelliteLink<SimEspNow::Port> &link = *b.sat(i).link;
+    CHECK(link.thresholdsVersion() == b.gateway().thresholdsVersion(), "%s sat%u version %u, gateway %u",
+          scenario, static_cast<unsigned>(i), link.thresholdsVersion(), b.gateway().thresholdsVersion());
+    CHECK(link.thresholds() == expected, "%s sat%u thresholds", scenario, static_cast<unsigned>(i));
+  }
+}
+
+void clean() {
+  const size_t sats = 3;
+  Bench b(sats, 1);
+  b.gateway().setThresholds(thresholdsFor(2600));
+  b.run(50 * PERIOD_MS);
+  b.gateway().setThresholds(thresholdsFor(2800));
+  b.gateway().setThresholds(thresholdsFor(2800));  // unchanged: no new version
+  CHECK(b.gateway().thresholdsVersion() == 2, "version %u", b.gateway().thresholdsVersion());
+  b.run(60 * PERIOD_MS);
+  const uint32_t sentBeforeReboot = b.sat(0).sent;
+  b.reboot(0);
+  b.run(100 * PERIOD_MS);
+
+  for (size_t i = 0; i < sats; ++i) {
+    const Satellite &s = b.sat(i);
+    const SatelliteNode *node = b.nodeOf(i);
+    CHECK(node != nullptr, "clean sat%u missing", static_cast<unsigned>(i));
+    if (node == nullptr) {
+      continue;
+    }
+    CHECK(node->received == s.sent, "clean sat%u received %lu of %lu", static_cast<unsigned>(i),
+          static_cast<unsigned long>(node->received), static_cast<unsigned long>(s.sent));
+    CHECK(node->duplicates == 0 && node->window.lost() == 0, "clean sat%u dup %lu lost %lu",
+          static_cast<unsigned>(i), static_cast<unsigned long>(node->duplicates),
+          static_cast<unsigned long>(node->window.lost()));
+    CHECK(node->restarts == (i == 0 ? 1u : 0u), "clean sat%u restarts %lu", static_cast<unsigned>(i),
+          static_cast<unsigned long>(node->restarts));
+    CHECK(node->last.seq == (i == 0 ? s.sent - sentBeforeReboot : s.sent), "clean sat%u last seq %u",
+          static_cast<unsigned>(i), node->last.seq);
+    CHECK(s.link->haveGateway() && s.lostEvents == 0, "clean sat%u gateway lost", static_cast<unsigned>(i));
+  }
+  checkThresholds(b, sats, "clean");
+
+  // A batch stays fresh until it is marked drained (failed publish)
+  SatelliteGateway<8> &gw = b.gateway();
+  CHECK(gw.freshCount() == sats, "fresh %u", static_cast<unsigned>(gw.freshCount()));
+  size_t visited = gw.forEachFresh([](const SatelliteNode &) {}, 2);
+  CHECK(visited == 2 && gw.freshCount() == sats, "visited %u fresh %u", static_cast<unsigned>(visited),
+        static_cast<unsigned>(gw.freshCount()));
+  gw.markDrained(visited);
+  CHECK(gw.freshCount() == sats - 2, "fresh after drain %u", static_cast<unsigned>(gw.freshCount()));
+
+  CHECK(gw.foreignFrames() == 0 && gw.sendFailures() == 0 && b.sim().lost() == 0, "clean foreign %lu",
+        static_cast<unsigned long>(gw.foreignFrames()));
+  printf("clean: %lu frames, %u satellites, thresholds v%u\n", static_cast<unsigned long>(b.sim().sent()),
+         static_cast<unsigned>(gw.nodeCount()), gw.thresholdsVersion());
+}
+
+void lossy(uint32_t seed) {
+  const size_t sats = 4;
+  Bench b(sats, seed);
+  b.sim().setLossPct(20);
+  b.sim().setDuplicatePct(10);
+  b.sim().setDelayMs(0, 40);
+  b.gateway().setThresholds(thresholdsFor(2600));
+  b.run(150 * PERIOD_MS);
+  b.gateway().setThresholds(thresholdsFor(2800));
+  b.run(300 * PERIOD_MS);
+
+  uint32_t received = 0, duplicates = 0, lost = 0, sent = 0;
+  for (size_t i = 0; i < sats; ++i) {
+    const Satellite &s = b.sat(i);
+    const SatelliteNode *node = b.nodeOf(i);
+    CHECK(node != nullptr, "seed %lu sat%u missing", static_cast<unsigned long>(seed), static_cast<unsigned>(i));
+    if (node == nullptr) {
+      continue;
+    }
+    CHECK(node->received == s.delivered.size(), "seed %lu sat%u received %lu, delivered %u",
+          static_cast<unsigned long>(seed), static_cast<unsigned>(i), static_cast<unsigned long>(node->received),
+          static_cast<unsigned>(s.delivered.size()));
+    CHECK(node->duplicates == s.deliveries - s.delivered.size(), "seed %lu sat%u duplicates %lu of %lu",
+          static_cast<unsigned long>(seed), static_cast<unsigned>(i), static_cast<unsigned long>(node->duplicates),
+          static_cast<unsigned long>(s.deliveries - s.delivered.size()));
+    CHECK(node->window.lost() == b.expectedLost(i), "seed %lu sat%u lost %lu, expected %lu",
+          static_cast<unsigned long>(seed), static_cast<unsigned>(i), static_cast<unsigned long>(node->window.lost()),
+          static_cast<unsigned long>(b.expectedLost(i)));
+    CHECK(node->received <= s.sent, "seed %lu sat%u received %lu > sent %lu", static_cast<unsigned long>(seed),
+          static_cast<unsigned>(i), static_cast<unsigned long>(node->received), static_cast<unsigned long>(s.sent));
+    received += node->received;
+    duplicates += node->duplicates;
+    lost += node->window.lost();
+    sent += s.sent;
+  }
+  checkThresholds(b, sats, "lossy");
+  CHECK(b.sim().lost() > 0 && b.sim().duplicated() > 0, "seed %lu: no impairment", static_cast<unsigned long>(seed));
+  printf("lossy seed %lu: sent %lu, received %lu, dup %lu, lost %lu (medium lost %lu, duplicated %lu)\n",
+         static_cast<unsigned long>(seed), static_cast<unsigned long>(sent), static_cast<unsigned long>(received),
+         static_cast<unsigned long>(duplicates), static_cast<unsigned long>(lost),
+         static_cast<unsigned long>(b.sim().lost()), static_cast<unsigned long>(b.sim().duplicated()));
+}
+
+void outage() {
+  const size_t sats = 2;
+  Bench b(sats, 7);
+  b.gateway().setThresholds(thresholdsFor(2800));
+  b.run(20 * PERIOD_MS);
+  b.sim().setLossPct(100);
+  b.run(26 * PERIOD_MS);  // readings 21-26 of each satellite never arrive
+  b.sim().setLossPct(0);
+  b.run(80 * PERIOD_MS);
+
+  for (size_t i = 0; i < sats; ++i) {
+    const Satellite &s = b.sat(i);
+    const SatelliteNode *node = b.nodeOf(i);
+    CHECK(s.lostEvents == 1, "outage sat%u gateway lost %lu times", static_cast<unsigned>(i),
+          static_cast<unsigned long>(s.lostEvents));
+    CHECK(s.link->haveGateway(), "outage sat%u did not find the gateway again", static_cast<unsigned>(i));
+    if (node == nullptr) {
+      CHECK(false, "outage sat%u missing", static_cast<unsigned>(i));
+      continue;
+    }
+    CHECK(node->window.lost() == 6 && node->received == s.sent - 6, "outage sat%u lost %lu received %lu",
+          static_cast<unsigned>(i), static_cast<unsigned long>(node->window.lost()),
+          static_cast<unsigned long>(node->received));
+  }
+  checkThresholds(b, sats, "outage");
+  printf("outage: %lu frames lost, %lu satellites recovered\n", static_cast<unsigned long>(b.sim().lost()),
+         static_cast<unsigned long>(sats));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  uint32_t seeds = 5;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--seeds") && i + 1 < argc) {
+      seeds = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else {
+      fprintf(stderr, "usage: %s [--seeds n]\n", argv[0]);
+      return 2;
+    }
+  }
+  clean();
+  for (uint32_t seed = 1; seed <= seeds; ++seed) {
+    lossy(seed);
+  }
+  outage();
+  printf("%s (%d failed checks)\n", g_failures ? "FAIL" : "OK", g_failures);
+  return g_failures ? 1 : 0;
+}
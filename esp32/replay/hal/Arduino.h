@@ -0,0 +1,272 @@
+#pragma once
+// Host shim: the subset of the Arduino-ESP32 core the firmwares use, backed
+// by replay::Hal's virtual clock and pins.
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "../replay_hal.h"
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define RISING 1
+#define FALLING 2
+#define CHANGE 3
+#define PROGMEM
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define F(x) (x)
+#define FPSTR(x) (x)
+
+typedef uint8_t byte;
+
+#if !defined(__GLIBC__) || !__GLIBC_PREREQ(2, 38)
+inline size_t strlcpy(char *dst, const char *src, size_t size) {
+  const size_t len = strlen(src);
+  if (size) {
+    const size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+#endif
+
+class String {
+ public:
+  String() {}
+  String(const char *c) : s_(c ? c : "") {}
+  String(const std::string &c) : s_(c) {}
+  String(char c) : s_(1, c) {}
+  String(int v) : s_(std::to_string(v)) {}
+  String(unsigned v) : s_(std::to_string(v)) {}
+  String(long v) : s_(std::to_string(v)) {}
+  String(unsigned long v) : s_(std::to_string(v)) {}
+  String(double v, unsigned decimals = 2) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", static_cast<int>(decimals), v);
+    s_ = buf;
+  }
+
+  bool reserve(unsigned n) {
+    s_.reserve(n);
+    return true;
+  }
+  unsigned length() const { return static_cast<unsigned>(s_.size()); }
+  const char *c_str() const { return s_.c_str(); }
+  bool isEmpty() const { return s_.empty(); }
+  char operator[](unsigned i) const { return i < s_.size() ? s_[i] : 0; }
+  char charAt(unsigned i) const { return (*this)[i]; }
+  bool concat(const char *p) {
+    s_ += p;
+    return true;
+  }
+  bool concat(const char *p, unsigned n) {
+    s_.append(p, n);
+    return true;
+  }
+  bool concat(char c) {
+    s_ += c;
+    return true;
+  }
+  String &operator+=(const String &o) {
+    s_ += o.s_;
+    return *this;
+  }
+  String &operator+=(const char *o) {
+    s_ += o;
+    return *this;
+  }
+  String &operator+=(char o) {
+    s_ += o;
+    return *this;
+  }
+  String &operator+=(int o) { return *this += String(o); }
+  String &operator+=(unsigned o) { return *this += String(o); }
+  String &operator+=(long o) { return *this += String(o); }
+  String &operator+=(unsigned long o) { return *this += String(o); }
+  bool operator==(const String &o) const { return s_ == o.s_; }
+  bool operator!=(const String &o) const { return s_ != o.s_; }
+  bool operator==(const char *o) const { return s_ == o; }
+  bool operator!=(const char *o) const { return s_ != o; }
+  bool equals(const String &o) const { return s_ == o.s_; }
+  int indexOf(char c, unsigned from = 0) const { return find(s_.find(c, from)); }
+  int indexOf(const String &o, unsigned from = 0) const { return find(s_.find(o.s_, from)); }
+  bool startsWith(const String &o) const { return s_.compare(0, o.s_.size(), o.s_) == 0; }
+  bool endsWith(const String &o) const {
+    return s_.size() >= o.s_.size() && s_.compare(s_.size() - o.s_.size(), o.s_.size(), o.s_) == 0;
+  }
+  String substring(unsigned from, unsigned to = ~0u) const {
+    if (from >= s_.size()) {
+      return String();
+    }
+    return String(s_.substr(from, to == ~0u ? std::string::npos : to - from));
+  }
+  void replace(const String &from, const String &to) {
+    if (from.s_.empty()) {
+      return;
+    }
+    for (size_t pos = 0; (pos = s_.find(from.s_, pos)) != std::string::npos; pos += to.s_.size()) {
+      s_.replace(pos, from.s_.size(), to.s_);
+    }
+  }
+  void toUpperCase() {
+    for (size_t i = 0; i < s_.size(); ++i) {
+      s_[i] = static_cast<char>(toupper(static_cast<unsigned char>(s_[i])));
+    }
+  }
+  void toLowerCase() {
+    for (size_t i = 0; i < s_.size(); ++i) {
+      s_[i] = static_cast<char>(tolower(static_cast<unsigned char>(s_[i])));
+    }
+  }
+  void trim() {
+    const size_t a = s_.find_first_not_of(" \t\r\n");
+    const size_t b = s_.find_last_not_of(" \t\r\n");
+    s_ = a == std::string::npos ? std::string() : s_.substr(a, b - a + 1);
+  }
+  long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(s_.c_str(), nullptr); }
+
+ private:
+  static int find(size_t pos) { return pos == std::string::npos ? -1 : static_cast<int>(pos); }
+  std::string s_;
+};
+
+// ArduinoJson adapts both String and the type of `a + b`
+class StringSumHelper : public String {
+ public:
+  StringSumHelper(const String &s) : String(s) {}
+};
+
+inline String operator+(const String &a, const String &b) {
+  String r = a;
+  r += b;
+  return r;
+}
+inline String operator+(const char *a, const String &b) { return String(a) + b; }
+inline String operator+(const String &a, const char *b) { return a + String(b); }
+
+class Print {
+ public:
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    replay::Hal::get().serial(buf);
+    return n > 0 ? static_cast<size_t>(n) : 0;
+  }
+  size_t print(const String &s) { return printf("%s", s.c_str()); }
+  size_t print(const char *s) { return printf("%s", s); }
+  size_t print(char c) { return printf("%c", c); }
+  size_t print(long v) { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t print(int v) { return printf("%d", v); }
+  size_t print(unsigned v) { return printf("%u", v); }
+  size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+  template <class T>
+  size_t println(const T &v) {
+    return print(v) + printf("\n");
+  }
+  size_t println() { return printf("\n"); }
+  size_t write(const uint8_t *data, size_t n) { return printf("%.*s", static_cast<int>(n), data); }
+  size_t write(uint8_t c) { return printf("%c", c); }
+};
+
+class Stream : public Print {
+ public:
+  int available() { return 0; }
+  int read() { return -1; }
+};
+
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long) {}
+  void flush() {}
+};
+extern HardwareSerial Serial;
+
+inline unsigned long millis() { return replay::Hal::get().now(); }
+inline unsigned long micros() { return replay::Hal::get().now() * 1000UL; }
+inline void delay(unsigned long ms) { replay::Hal::get().advance(static_cast<uint32_t>(ms)); }
+inline void delayMicroseconds(unsigned) {}
+inline void yield() {}
+
+inline void pinMode(uint8_t pin, uint8_t mode) { replay::Hal::get().pinMode(pin, mode); }
+inline void digitalWrite(uint8_t pin, uint8_t level) { replay::Hal::get().write(pin, level ? 1 : 0); }
+inline int digitalRead(uint8_t pin) { return replay::Hal::get().read(pin); }
+inline uint8_t digitalPinToInterrupt(uint8_t pin) { return pin; }
+inline void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) { replay::Hal::get().attachIsr(pin, isr, mode); }
+inline void detachInterrupt(uint8_t pin) { replay::Hal::get().attachIsr(pin, nullptr, 0); }
+
+inline uint32_t ledcSetup(uint8_t, uint32_t freq, uint8_t) { return freq; }
+inline void ledcAttachPin(uint8_t, uint8_t) {}
+inline double ledcWriteTone(uint8_t, double freq) { return freq; }
+
+inline uint32_t esp_random() { return 0x5EED; }
+
+// Power-on, or a software reset when the runner keeps RTC memory across
+// ESP.restart() (Hal::boot())
+typedef enum {
+  ESP_RST_UNKNOWN,
+  ESP_RST_POWERON,
+  ESP_RST_EXT,
+  ESP_RST_SW,
+  ESP_RST_PANIC,
+  ESP_RST_INT_WDT,
+  ESP_RST_TASK_WDT,
+  ESP_RST_WDT,
+  ESP_RST_DEEPSLEEP,
+  ESP_RST_BROWNOUT,
+  ESP_RST_SDIO,
+} esp_reset_reason_t;
+inline esp_reset_reason_t esp_reset_reason() {
+  return replay::Hal::get().softwareReset() ? ESP_RST_SW : ESP_RST_POWERON;
+}
+inline void configTime(long, int, const char *, const char * = nullptr, const char * = nullptr) {}
+
+class EspClass {
+ public:
+  [[noreturn]] void restart() { throw replay::Reboot(); }
+  uint64_t getEfuseMac() { return 0x0100286F24ULL; }
+  uint32_t getFreeHeap() { return 200000; }
+  uint32_t getMinFreeHeap() { return 180000; }
+  uint32_t getMaxAllocHeap() { return 110000; }
+  const char *getChipModel() { return "ESP32-D0WDQ6"; }
+  uint8_t getChipRevision() { return 1; }
+  uint32_t getCpuFreqMHz() { return 240; }
+};
+extern EspClass ESP;
+
+// FreeRTOS / portmacro pieces the core pulls in
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffff
+#define pdMS_TO_TICKS(x) (x)
+#define portYIELD_FROM_ISR() \
+  do {                       \
+  } while (0)
+typedef struct {
+  int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(m) (void)(m)
+#define portEXIT_CRITICAL(m) (void)(m)
+#define portENTER_CRITICAL_ISR(m) (void)(m)
+#define portEXIT_CRITICAL_ISR(m) (void)(m)
+#define portENTER_CRITICAL_SAFE(m) (void)(m)
+#define portEXIT_CRITICAL_SAFE(m) (void)(m)
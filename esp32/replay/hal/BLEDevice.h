@@ -0,0 +1,100 @@
+#pragma once
+// Host shim: the ESP32 BLE library surface bluetooth_provisioning_main.cpp
+// uses. Nothing is advertised; a characteristic keeps its value so host code
+// can feed writes to the callbacks.
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class BLEServer;
+class BLECharacteristic;
+
+class BLEServerCallbacks {
+ public:
+  virtual ~BLEServerCallbacks() {}
+  virtual void onConnect(BLEServer *) {}
+  virtual void onDisconnect(BLEServer *) {}
+};
+
+class BLECharacteristicCallbacks {
+ public:
+  virtual ~BLECharacteristicCallbacks() {}
+  virtual void onWrite(BLECharacteristic *) {}
+  virtual void onRead(BLECharacteristic *) {}
+};
+
+class BLEDescriptor {
+ public:
+  virtual ~BLEDescriptor() {}
+};
+
+class BLECharacteristic {
+ public:
+  static const uint32_t PROPERTY_READ = 1 << 0;
+  static const uint32_t PROPERTY_WRITE = 1 << 1;
+  static const uint32_t PROPERTY_NOTIFY = 1 << 2;
+
+  BLECharacteristic() {}
+  explicit BLECharacteristic(const char *uuid, uint32_t properties = 0) : uuid_(uuid), properties_(properties) {}
+  void setCallbacks(BLECharacteristicCallbacks *cb) { callbacks_ = cb; }
+  BLECharacteristicCallbacks *callbacks() const { return callbacks_; }
+  void addDescriptor(BLEDescriptor *d) { descriptors_.push_back(d); }
+  void setValue(const char *v) { value_ = v ? v : ""; }
+  void setValue(const std::string &v) { value_ = v; }
+  void setValue(const uint8_t *data, size_t len) { value_.assign(reinterpret_cast<const char *>(data), len); }
+  std::string getValue() const { return value_; }
+  void notify() {}
+
+ private:
+  std::string uuid_;
+  uint32_t properties_ = 0;
+  std::string value_;
+  BLECharacteristicCallbacks *callbacks_ = nullptr;
+  std::vector<BLEDescriptor *> descriptors_;
+};
+
+class BLEService {
+ public:
+  BLECharacteristic *createCharacteristic(const char *uuid, uint32_t properties) {
+    characteristics_[uuid] = BLECharacteristic(uuid, properties);
+    return &characteristics_[uuid];
+  }
+  void start() {}
+
+ private:
+  std::map<std::string, BLECharacteristic> characteristics_;
+};
+
+class BLEServer {
+ public:
+  void setCallbacks(BLEServerCallbacks *cb) { callbacks_ = cb; }
+  BLEService *createService(const char *uuid) { return &services_[uuid]; }
+
+ private:
+  BLEServerCallbacks *callbacks_ = nullptr;
+  std::map<std::string, BLEService> services_;
+};
+
+class BLEAdvertising {
+ public:
+  void addServiceUUID(const char *) {}
+  void setScanResponse(bool) {}
+  void setMinPreferred(uint16_t) {}
+};
+
+class BLEDevice {
+ public:
+  static void init(const std::string &) {}
+  static void deinit(bool = false) {}
+  static void setMTU(uint16_t) {}
+  static BLEServer *createServer() {
+    static BLEServer server;
+    return &server;
+  }
+  static BLEAdvertising *getAdvertising() {
+    static BLEAdvertising advertising;
+    return &advertising;
+  }
+  static void startAdvertising() {}
+};
@@ -0,0 +1,16 @@
+#pragma once
+// Replay shim: DHT22 readings come from the trace's latest "dht" event
+#include <Arduino.h>
+#define DHT22 22
+
+class DHT {
+ public:
+  DHT(uint8_t, uint8_t) {}
+  void begin() {}
+  float readTemperature(bool = false, bool = false) { return replay::Hal::get().dhtT(); }
+  float readHumidity(bool = false) { return replay::Hal::get().dhtH(); }
+  bool read(bool = false) {
+    const float t = replay::Hal::get().dhtT();
+    return t == t;  // false on a NaN read
+  }
+};
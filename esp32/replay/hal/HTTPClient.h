@@ -0,0 +1,25 @@
+#pragma once
+// Replay shim: GET returns the trace's latest "thresholds" response after
+// HTTPS_REQUEST_MS of virtual time; the registration POST always fails
+// (replays run with reg=true preseeded).
+#include <WiFi.h>
+
+class HTTPClient {
+ public:
+  void setTimeout(uint16_t) {}
+  bool begin(WiFiClient &, const String &) { return true; }
+  void addHeader(const String &, const String &) {}
+  int GET() {
+    replay::Hal &hal = replay::Hal::get();
+    hal.advance(replay::HTTPS_REQUEST_MS);
+    body_ = hal.thresholdCode() == 200 ? String(hal.thresholdBody()) : String();
+    return hal.thresholdCode();
+  }
+  int POST(const String &) { return -1; }
+  String getString() { return body_; }
+  void end() {}
+  static String errorToString(int code) { return String(code < 0 ? "connection refused" : "http error"); }
+
+ private:
+  String body_;
+};
@@ -0,0 +1,54 @@
+#pragma once
+// Replay shim: NVS as string maps held by replay::Hal (seeded per boot)
+#include <Arduino.h>
+
+class Preferences {
+ public:
+  bool begin(const char *ns, bool = false) {
+    kv_ = &replay::Hal::get().prefs(ns);
+    return true;
+  }
+  void end() { kv_ = nullptr; }
+  bool clear() {
+    kv_->clear();
+    return true;
+  }
+  bool remove(const char *key) { return kv_->erase(key) > 0; }
+  bool isKey(const char *key) { return kv_->count(key) > 0; }
+  String getString(const char *key, const String &def = String()) {
+    return isKey(key) ? String((*kv_)[key]) : def;
+  }
+  size_t putString(const char *key, const String &v) {
+    (*kv_)[key] = v.c_str();
+    return v.length();
+  }
+  bool getBool(const char *key, bool def = false) { return isKey(key) ? (*kv_)[key] == "1" : def; }
+  size_t putBool(const char *key, bool v) {
+    (*kv_)[key] = v ? "1" : "0";
+    return 1;
+  }
+  uint32_t getUInt(const char *key, uint32_t def = 0) {
+    return isKey(key) ? static_cast<uint32_t>(strtoul((*kv_)[key].c_str(), nullptr, 10)) : def;
+  }
+  size_t putUInt(const char *key, uint32_t v) {
+    (*kv_)[key] = std::to_string(v);
+    return 4;
+  }
+  // Blobs are stored as raw bytes in the string value
+  size_t getBytes(const char *key, void *buf, size_t len) {
+    if (!isKey(key)) {
+      return 0;
+    }
+    const std::string &v = (*kv_)[key];
+    const size_t n = v.size() < len ? v.size() : len;
+    memcpy(buf, v.data(), n);
+    return n;
+  }
+  size_t putBytes(const char *key, const void *buf, size_t len) {
+    (*kv_)[key] = std::string(static_cast<const char *>(buf), len);
+    return len;
+  }
+
+ private:
+  std::map<std::string, std::string> *kv_ = nullptr;
+};
@@ -0,0 +1,73 @@
+#pragma once
+// Replay shim: broker reachability follows the trace's "mqtt" events;
+// publishes go to the timeline when the runner asks for them (--pubs).
+// Trace "cmd" requests arrive through loop(), one message per call like the
+// real client, with the payload in the client's buffer.
+#include <string>
+#include <vector>
+#include <WiFi.h>
+
+class PubSubClient {
+ public:
+  explicit PubSubClient(WiFiClient &) {}
+  PubSubClient &setServer(const char *, uint16_t) { return *this; }
+  bool setBufferSize(uint16_t size) {
+    bufferSize_ = size;
+    return true;
+  }
+  uint16_t getBufferSize() { return bufferSize_; }
+  PubSubClient &setCallback(void (*callback)(char *, uint8_t *, unsigned int)) {
+    callback_ = callback;
+    return *this;
+  }
+  bool subscribe(const char *topic, uint8_t = 0) {
+    if (!connected()) {
+      return false;
+    }
+    replay::Hal::get().subscribe(topic);
+    return true;
+  }
+  bool unsubscribe(const char *) { return connected(); }
+  bool connect(const char *, const char *, const char *) {
+    replay::Hal::get().clearSubscriptions();
+    connected_ = replay::Hal::get().mqttUp();
+    return connected_;
+  }
+  bool connected() {
+    connected_ = connected_ && replay::Hal::get().mqttUp();
+    return connected_;
+  }
+  bool publish(const char *topic, const char *payload, bool = false) {
+    if (!connected()) {
+      return false;
+    }
+    replay::Hal::get().published(topic, payload);
+    return true;
+  }
+  void disconnect() {
+    connected_ = false;
+    replay::Hal::get().clearSubscriptions();
+  }
+  bool loop() {
+    if (!connected()) {
+      return false;
+    }
+    std::string topic, payload;
+    // Messages that do not fit the buffer are dropped, as by the real client
+    if (callback_ && replay::Hal::get().takeCommand(topic, payload) &&
+        payload.size() + topic.size() + 7 <= bufferSize_) {
+      std::vector<char> name(topic.begin(), topic.end());
+      name.push_back('\0');
+      buffer_.assign(payload.begin(), payload.end());
+      callback_(name.data(), buffer_.data(), static_cast<unsigned int>(buffer_.size()));
+    }
+    return true;
+  }
+  int state() { return connected_ ? 0 : -2; }
+
+ private:
+  bool connected_ = false;
+  uint16_t bufferSize_ = 256;
+  void (*callback_)(char *, uint8_t *, unsigned int) = nullptr;
+  std::vector<uint8_t> buffer_;
+};
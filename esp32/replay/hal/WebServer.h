@@ -0,0 +1,25 @@
+#pragma once
+// Replay shim: nobody browses the controller during a replay
+#include <WiFi.h>
+#include <functional>
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_POST };
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+
+class WebServer {
+ public:
+  explicit WebServer(int) {}
+  void begin() {}
+  void stop() {}
+  void handleClient() {}
+  void on(const char *, HTTPMethod, std::function<void()>) {}
+  void onNotFound(std::function<void()>) {}
+  void enableCORS(bool) {}
+  String arg(const char *) { return String(); }
+  bool hasArg(const char *) { return false; }
+  void send(int, const char *, const String &) {}
+  void sendHeader(const char *, const String &, bool = false) {}
+  void setContentLength(size_t) {}
+  void sendContent(const char *, size_t) {}
+  void sendContent(const String &) {}
+};
@@ -0,0 +1,35 @@
+#pragma once
+// Replay shim: station link follows the trace's "net" events; AP calls are no-ops
+#include <Arduino.h>
+
+typedef enum { WL_IDLE_STATUS = 0, WL_CONNECTED = 3, WL_CONNECT_FAILED = 4, WL_DISCONNECTED = 6 } wl_status_t;
+typedef enum { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+
+class IPAddress {
+ public:
+  explicit IPAddress(const char *s = "0.0.0.0") : s_(s) {}
+  String toString() const { return String(s_); }
+  operator String() const { return toString(); }
+
+ private:
+  const char *s_;
+};
+
+class WiFiClass {
+ public:
+  wl_status_t status() { return replay::Hal::get().wifiUp() ? WL_CONNECTED : WL_DISCONNECTED; }
+  bool mode(wifi_mode_t) { return true; }
+  wl_status_t begin(const char *, const char * = nullptr) { return status(); }
+  bool disconnect(bool = false, bool = false) { return true; }
+  bool softAP(const char *, const char * = nullptr) { return true; }
+  bool softAPdisconnect(bool = false) { return true; }
+  IPAddress softAPIP() { return IPAddress("192.168.4.1"); }
+  IPAddress localIP() { return IPAddress("10.0.0.2"); }
+  String macAddress() { return String("24:6F:28:00:01:00"); }
+  int32_t channel() { return 1; }
+  int8_t RSSI() { return -60; }
+  bool setSleep(bool) { return true; }
+};
+extern WiFiClass WiFi;
+
+class WiFiClient : public Stream {};
@@ -0,0 +1,9 @@
+#pragma once
+#include <WiFi.h>
+
+class WiFiClientSecure : public WiFiClient {
+ public:
+  void setInsecure() {}
+  int connect(const char *, uint16_t) { return 0; }  // no TLS endpoints in a replay
+  void stop() {}
+};
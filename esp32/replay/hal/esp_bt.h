@@ -0,0 +1,6 @@
+#pragma once
+// Host shim: no controller memory to release
+#include <esp_timer.h>
+
+typedef enum { ESP_BT_MODE_IDLE, ESP_BT_MODE_BLE, ESP_BT_MODE_CLASSIC_BT, ESP_BT_MODE_BTDM } esp_bt_mode_t;
+inline esp_err_t esp_bt_mem_release(esp_bt_mode_t) { return ESP_OK; }
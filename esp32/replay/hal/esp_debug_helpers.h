@@ -0,0 +1,17 @@
+#pragma once
+// Replay shim: no Xtensa frames to walk, backtraces come out empty
+#include <Arduino.h>
+
+typedef struct {
+  uint32_t pc;
+  uint32_t sp;
+  uint32_t next_pc;
+  const void *exc_frame;
+} esp_backtrace_frame_t;
+
+inline void esp_backtrace_get_start(uint32_t *pc, uint32_t *sp, uint32_t *next_pc) {
+  *pc = 0;
+  *sp = 0;
+  *next_pc = 0;
+}
+inline bool esp_backtrace_get_next_frame(esp_backtrace_frame_t *) { return false; }
@@ -0,0 +1,6 @@
+#pragma once
+// Replay shim: time never syncs in a replay; samples carry age_ms
+#include <sys/time.h>
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+inline void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t) {}
+inline void sntp_set_sync_interval(uint32_t) {}
@@ -0,0 +1,7 @@
+#pragma once
+// Replay shim: loop() passes take no real time, nothing to watch
+#include <esp_timer.h>
+
+inline esp_err_t esp_task_wdt_init(uint32_t, bool) { return ESP_OK; }
+inline esp_err_t esp_task_wdt_add(void *) { return ESP_OK; }
+inline esp_err_t esp_task_wdt_reset() { return ESP_OK; }
@@ -0,0 +1,36 @@
+#pragma once
+// Replay shim: esp_timer on replay::Hal's clock (ms resolution)
+#include <Arduino.h>
+
+typedef replay::Timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *);
+typedef enum { ESP_TIMER_TASK } esp_timer_dispatch_t;
+typedef struct {
+  esp_timer_cb_t callback;
+  void *arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char *name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+typedef int esp_err_t;
+#define ESP_OK 0
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out) {
+  const esp_timer_cb_t cb = args->callback;
+  void *arg = args->arg;
+  *out = replay::Hal::get().createTimer([cb, arg]() { cb(arg); });
+  return ESP_OK;
+}
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t us) {
+  replay::Hal::get().arm(t, static_cast<uint32_t>((us + 999) / 1000), false);
+  return ESP_OK;
+}
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t t, uint64_t us) {
+  replay::Hal::get().arm(t, static_cast<uint32_t>((us + 999) / 1000), true);
+  return ESP_OK;
+}
+inline esp_err_t esp_timer_stop(esp_timer_handle_t t) {
+  t->armed = false;
+  return ESP_OK;
+}
+inline int64_t esp_timer_get_time() { return static_cast<int64_t>(replay::Hal::get().now()) * 1000; }
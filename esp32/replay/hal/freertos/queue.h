@@ -0,0 +1,34 @@
+#pragma once
+// Replay shim: FreeRTOS queues as byte-copy deques (single task, no blocking)
+#include <Arduino.h>
+#include <deque>
+#include <vector>
+
+struct ReplayQueue {
+  size_t depth;
+  size_t itemSize;
+  std::deque<std::vector<uint8_t> > items;
+};
+typedef ReplayQueue *QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t depth, UBaseType_t itemSize) {
+  return new ReplayQueue{depth, itemSize, std::deque<std::vector<uint8_t> >()};
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t) {
+  if (q->items.size() >= q->depth) {
+    return pdFALSE;
+  }
+  const uint8_t *p = static_cast<const uint8_t *>(item);
+  q->items.push_back(std::vector<uint8_t>(p, p + q->itemSize));
+  return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t q, void *out, TickType_t) {
+  if (q->items.empty()) {
+    return pdFALSE;
+  }
+  memcpy(out, q->items.front().data(), q->itemSize);
+  q->items.pop_front();
+  return pdTRUE;
+}
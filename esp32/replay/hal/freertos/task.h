@@ -0,0 +1,11 @@
+#pragma once
+// Replay shim: one task, no stack to measure
+#include <Arduino.h>
+
+typedef void *TaskHandle_t;
+
+inline TaskHandle_t xTaskGetHandle(const char *) { return nullptr; }
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) { return 0; }
+inline const char *pcTaskGetTaskName(TaskHandle_t) { return "loopTask"; }
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return nullptr; }
+inline BaseType_t xPortInIsrContext() { return pdFALSE; }
@@ -0,0 +1,34 @@
+#pragma once
+// Replay shim: FreeRTOS software timers on replay::Hal's clock
+#include <Arduino.h>
+
+typedef replay::Timer *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t);
+
+inline TimerHandle_t xTimerCreate(const char *, TickType_t period, UBaseType_t autoReload, void *,
+                                  TimerCallbackFunction_t cb) {
+  replay::Timer **self = new replay::Timer *(nullptr);
+  replay::Timer *t = replay::Hal::get().createTimer([cb, self]() { cb(*self); });
+  *self = t;
+  t->periodMs = period;
+  t->autoReload = autoReload != 0;
+  return t;
+}
+
+inline void *xTimerGetTimerDaemonTaskHandle() { return nullptr; }
+
+inline BaseType_t xTimerStart(TimerHandle_t t, TickType_t) {
+  replay::Hal::get().arm(t, t->periodMs, t->autoReload);
+  return pdPASS;
+}
+inline BaseType_t xTimerReset(TimerHandle_t t, TickType_t ticks) { return xTimerStart(t, ticks); }
+inline BaseType_t xTimerResetFromISR(TimerHandle_t t, BaseType_t *woken) {
+  if (woken) {
+    *woken = pdFALSE;
+  }
+  return xTimerStart(t, 0);
+}
+inline BaseType_t xTimerStop(TimerHandle_t t, TickType_t) {
+  t->armed = false;
+  return pdPASS;
+}
@@ -0,0 +1,308 @@
+// Sensor-health replay: runs the detectors in sensor_health.h over recorded
+// readings on Linux and prints every health change, so their tuning can be
+// checked against traces of real failures without a device.
+//
+// Each trace is one sensor of the same zone, in the replay_main.cpp format;
+// only "dht" lines are used. Every --period ms (default 2500, a DHT22's
+// cadence) each sensor reads the latest value in its trace, as the
+// firmware's sampler does; "dht fail" reads are skipped like a NaN read.
+// With three or more traces every accepted reading is also checked against
+// the median of the others, as in the firmware. History-derived traces have
+// no sensor noise, so --jitter adds a deterministic +-c to keep live but
+// steady stretches from looking frozen. Output, one line per change:
+//
+//   <ms> sensor<i> <flags|ok> T=<t> H=<h>
+//
+// followed by a per-sensor summary (readings, rejected, spikes, final flags).
+// The exit code is 1 when any sensor ended excluded.
+//
+// With --suite (the default without traces) it instead runs every case in
+// <dir>/cases.txt, one per line as "<name> <trace>... [options]", and
+// compares the output with <dir>/<name>.expected; the exit code is 1 on any
+// difference. replay/traces/health holds recorded failures (frozen, spike,
+// drift, implausible) with the flags and times they must raise.
+//
+// usage: health <trace> [<trace>...] [--period ms] [--until ms] [--jitter c]
+//        health [--suite dir]
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../sensor_health.h"
+
+namespace {
+
+struct Reading {
+  uint32_t ms;
+  float t;
+  float h;
+  bool fail;
+};
+
+bool loadTrace(const char *path, std::vector<Reading> &out) {
+  std::ifstream in(path);
+  if (!in) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    unsigned long ms;
+    std::string kind;
+    if (!(fields >> ms >> kind) || kind != "dht") {
+      continue;
+    }
+    std::string a, b;
+    fields >> a >> b;
+    Reading r = {static_cast<uint32_t>(ms), 0.0f, 0.0f, a == "fail"};
+    if (!r.fail) {
+      r.t = strtof(a.c_str(), nullptr);
+      r.h = strtof(b.c_str(), nullptr);
+    }
+    out.push_back(r);
+  }
+  return true;
+}
+
+std::string flagText(uint8_t flags) {
+  std::string s;
+  for (uint8_t bit = 1; bit != 0; bit <<= 1) {
+    if (flags & bit) {
+      s += s.empty() ? "" : ",";
+      s += healthFlagName(bit);
+    }
+  }
+  return s.empty() ? "ok" : s;
+}
+
+struct Sensor {
+  std::vector<Reading> trace;
+  size_t next = 0;
+  const Reading *current = nullptr;
+  SensorHealth health;
+  bool ok = false;
+  float t = 0.0f;
+  float h = 0.0f;
+  uint32_t readings = 0;
+  uint32_t rejected = 0;
+};
+
+float median(std::vector<float> v) {
+  std::sort(v.begin(), v.end());
+  const size_t n = v.size();
+  return (n % 2) ? v[n / 2] : 0.5f * (v[n / 2 - 1] + v[n / 2]);
+}
+
+void appendf(std::string &out, const char *fmt, ...) {
+  char line[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  out += line;
+}
+
+struct Options {
+  uint32_t period = 2500;
+  uint32_t until = 0;
+  float jitter = 0.0f;
+  std::vector<std::string> traces;
+};
+
+// False on an unknown option
+bool parseArgs(const std::vector<std::string> &args, Options &opt) {
+  for (size_t i = 0; i < args.size(); ++i) {
+    const std::string &a = args[i];
+    const bool hasValue = i + 1 < args.size();
+    if (a == "--period" && hasValue) {
+      opt.period = static_cast<uint32_t>(strtoul(args[++i].c_str(), nullptr, 10));
+    } else if (a == "--until" && hasValue) {
+      opt.until = static_cast<uint32_t>(strtoul(args[++i].c_str(), nullptr, 10));
+    } else if (a == "--jitter" && hasValue) {
+      opt.jitter = strtof(args[++i].c_str(), nullptr);
+    } else if (!a.empty() && a[0] != '-') {
+      opt.traces.push_back(a);
+    } else {
+      return false;
+    }
+  }
+  return !opt.traces.empty() && opt.period != 0;
+}
+
+// Runs the detectors over opt.traces and appends the report to `out`.
+// Returns the number of sensors that ended excluded, or -1 when a trace
+// cannot be read.
+int runTraces(const Options &opt, std::string &out) {
+  std::vector<Sensor> sensors(opt.traces.size());
+  for (size_t s = 0; s < sensors.size(); ++s) {
+    if (!loadTrace(opt.traces[s].c_str(), sensors[s].trace)) {
+      fprintf(stderr, "cannot read trace %s\n", opt.traces[s].c_str());
+      return -1;
+    }
+  }
+  const uint32_t period = opt.period;
+  const float jitter = opt.jitter;
+  uint32_t until = opt.until;
+  if (until == 0) {
+    for (size_t s = 0; s < sensors.size(); ++s) {
+      if (!sensors[s].trace.empty()) {
+        until = std::max(until, sensors[s].trace.back().ms);
+      }
+    }
+  }
+
+  const SensorHealthConfig config = sensorHealthDefaults(period);
+  uint32_t lcg = 12345;
+  for (uint32_t now = 0; now <= until; now += period) {
+    for (size_t s = 0; s < sensors.size(); ++s) {
+      Sensor &sensor = sensors[s];
+      while (sensor.next < sensor.trace.size() && sensor.trace[sensor.next].ms <= now) {
+        sensor.current = &sensor.trace[sensor.next++];
+      }
+      if (!sensor.current || sensor.current->fail) {
+        continue;
+      }
+      float t = sensor.current->t;
+      float h = sensor.current->h;
+      if (jitter > 0.0f) {
+        lcg = lcg * 1103515245u + 12345u;
+        t += jitter * static_cast<float>(static_cast<int>((lcg >> 16) % 3) - 1);
+        lcg = lcg * 1103515245u + 12345u;
+        h += jitter * static_cast<float>(static_cast<int>((lcg >> 16) % 3) - 1);
+      }
+
+      const uint8_t before = sensor.health.flags();
+      sensor.readings++;
+      if (sensor.health.check(t, h, now, config)) {
+        sensor.ok = true;
+        sensor.t = t;
+        sensor.h = h;
+        std::vector<float> ts, hs;
+        for (size_t o = 0; o < sensors.size(); ++o) {
+          if (o != s && sensors[o].ok && sensors[o].health.usable()) {
+            ts.push_back(sensors[o].t);
+            hs.push_back(sensors[o].h);
+          }
+        }
+        if (ts.size() >= 2) {
+          sensor.health.crossCheck(t - median(ts), h - median(hs), config);
+        }
+      } else {
+        sensor.rejected++;
+      }
+      if (sensor.health.flags() != before) {
+        appendf(out, "%lu sensor%u %s T=%.2f H=%.2f\n", static_cast<unsigned long>(now), static_cast<unsigned>(s),
+               flagText(sensor.health.flags()).c_str(), t, h);
+      }
+    }
+  }
+
+  int excluded = 0;
+  for (size_t s = 0; s < sensors.size(); ++s) {
+    const Sensor &sensor = sensors[s];
+    appendf(out, "# sensor%u: %lu readings, %lu rejected, %lu spikes, drift T%+.2f H%+.2f, final %s\n",
+            static_cast<unsigned>(s), static_cast<unsigned long>(sensor.readings),
+            static_cast<unsigned long>(sensor.rejected), static_cast<unsigned long>(sensor.health.spikes()),
+            sensor.health.tempDrift(), sensor.health.humDrift(), flagText(sensor.health.flags()).c_str());
+    excluded += sensor.health.usable() ? 0 : 1;
+  }
+  return excluded;
+}
+
+bool readFile(const std::string &path, std::string &out) {
+  std::ifstream in(path);
+  if (!in) {
+    return false;
+  }
+  std::ostringstream body;
+  body << in.rdbuf();
+  out = body.str();
+  return true;
+}
+
+// Line number and text of the first difference, for the failure report
+void firstDifference(const std::string &expected, const std::string &got) {
+  std::istringstream e(expected), g(got);
+  std::string el, gl;
+  for (int line = 1;; ++line) {
+    const bool haveE = static_cast<bool>(std::getline(e, el));
+    const bool haveG = static_cast<bool>(std::getline(g, gl));
+    if (!haveE && !haveG) {
+      return;
+    }
+    if (!haveE || !haveG || el != gl) {
+      printf("  line %d\n  expected: %s\n  got:      %s\n", line, haveE ? el.c_str() : "(end)",
+             haveG ? gl.c_str() : "(end)");
+      return;
+    }
+  }
+}
+
+int runSuite(const std::string &dir) {
+  std::ifstream cases(dir + "/cases.txt");
+  if (!cases) {
+    fprintf(stderr, "cannot read %s/cases.txt\n", dir.c_str());
+    return 2;
+  }
+  int failed = 0, run = 0;
+  std::string line;
+  while (std::getline(cases, line)) {
+    std::istringstream fields(line);
+    std::string name, word;
+    if (!(fields >> name) || name[0] == '#') {
+      continue;
+    }
+    std::vector<std::string> args;
+    while (fields >> word) {
+      const bool isValue = !args.empty() && args.back()[0] == '-';
+      args.push_back(word[0] == '-' || isValue ? word : dir + "/" + word);  // traces are relative to dir
+    }
+    Options opt;
+    std::string expected, got;
+    run++;
+    if (!parseArgs(args, opt) || !readFile(dir + "/" + name + ".expected", expected) ||
+        runTraces(opt, got) < 0) {
+      printf("%s: cannot run\n", name.c_str());
+      failed++;
+      continue;
+    }
+    const bool same = got == expected;
+    printf("%s: %s\n", name.c_str(), same ? "ok" : "FAIL");
+    if (!same) {
+      firstDifference(expected, got);
+      failed++;
+    }
+  }
+  printf("%d of %d cases failed\n", failed, run);
+  return failed ? 1 : 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+  if (args.empty() || args[0] == "--suite") {
+    return runSuite(args.size() > 1 ? args[1] : "replay/traces/health");
+  }
+  Options opt;
+  if (!parseArgs(args, opt)) {
+    fprintf(stderr, "usage: %s <trace> [<trace>...] [--period ms] [--until ms] [--jitter c]\n"
+                    "       %s [--suite dir]\n", argv[0], argv[0]);
+    return 2;
+  }
+  std::string out;
+  const int excluded = runTraces(opt, out);
+  if (excluded < 0) {
+    return 2;
+  }
+  fputs(out.c_str(), stdout);
+  return excluded ? 1 : 0;
+}
@@ -0,0 +1,58 @@
+# Turn stored field history into a replay trace (see replay_main.cpp).
+#
+# Input is a response of the graph API (/api/millometer/by-controller):
+#   {"items": [{"data": [humidity, temperature, water], "ts": {"$numberLong": "..."}}, ...]}
+# Each item becomes a "dht" line at its offset from the first item, and the
+# water value a "water" line whenever it changes. Published w=1 means the
+# float switch pulled the pin LOW, so it is written as pin level 0.
+#
+# usage: python3 history_to_trace.py history.json > field.trace
+
+import json
+import sys
+
+
+def timestamp_ms(ts):
+    if isinstance(ts, dict):
+        return int(ts.get("$numberLong", 0))
+    return int(ts or 0)
+
+
+def convert(doc, out):
+    items = []
+    for item in doc.get("items", []):
+        data = item.get("data") or []
+        if len(data) >= 3:
+            items.append((timestamp_ms(item.get("ts")), data))
+    items.sort(key=lambda it: it[0])
+    if not items:
+        return 0
+
+    start = items[0][0]
+    last_level = None
+    for ts, (hum, temp, water) in items:
+        ms = ts - start
+        if hum is None or temp is None:
+            out.write("%d dht fail\n" % ms)
+        else:
+            out.write("%d dht %.1f %.1f\n" % (ms, float(temp), float(hum)))
+        level = 0 if water == 1 else 1
+        if level != last_level:
+            out.write("%d water %d\n" % (ms, level))
+            last_level = level
+    return len(items)
+
+
+def main(argv):
+    if len(argv) != 2:
+        sys.stderr.write("usage: %s <history.json>\n" % argv[0])
+        return 2
+    with open(argv[1]) as f:
+        doc = json.load(f)
+    count = convert(doc, sys.stdout)
+    sys.stderr.write("%d samples\n" % count)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,244 @@
+// I2C driver check: runs the Sht3x / Sht4x / Scd4x drivers from
+// i2c_sensors.h against the device models in sim_i2c_bus.h on Linux.
+//
+// Each case steps the bus's virtual clock by hand and asserts on the
+// driver's status, the values it decodes and the bus traffic it causes:
+// conversions that are not finished (the part NACKs), CRC errors, absent or
+// hung devices, recovery through begin(), and the SCD4x's multi-command
+// sequences interleaved with an SHT3x on the same bus.
+//
+// Output is one line per case plus a line per failed check; the exit code
+// is 1 when any check failed.
+//
+// usage: i2c
+
+#include <math.h>
+#include <stdio.h>
+
+#include "../sim_i2c_bus.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond, ...)                                   \
+  do {                                                     \
+    if (!(cond)) {                                         \
+      g_failures++;                                        \
+      printf("FAIL %s:%d %s: ", __FILE__, __LINE__, #cond); \
+      printf(__VA_ARGS__);                                 \
+      printf("\n");                                        \
+    }                                                      \
+  } while (0)
+
+const char *statusName(SensorStatus s) {
+  static const char *const NAMES[] = {"idle", "busy", "ready", "error"};
+  return NAMES[static_cast<uint8_t>(s)];
+}
+
+// One raw step is 175/65535 C or 100/65535 %RH
+bool near(float a, float b) { return fabsf(a - b) < 0.01f; }
+
+template <class Sensor>
+SensorStatus pollAt(SimI2cBus &bus, Sensor &sensor, uint32_t nowMs, ClimateReading &out) {
+  bus.setNow(nowMs);
+  return sensor.poll(nowMs, out);
+}
+
+template <class Sensor>
+bool triggerAt(SimI2cBus &bus, Sensor &sensor, uint32_t nowMs) {
+  bus.setNow(nowMs);
+  return sensor.trigger(nowMs);
+}
+
+void sht3x() {
+  SimI2cBus bus;
+  SimI2cBus::Device *dev = bus.add(Sht3xChip::DEFAULT_ADDR, SimI2cBus::Kind::Sht3x);
+  dev->temperatureC = 24.5f;
+  dev->humidityPct = 81.2f;
+  Sht3x<SimI2cBus> sensor(bus);
+  ClimateReading r = {};
+
+  CHECK(sensor.begin(0), "soft reset NACKed");
+  CHECK(!triggerAt(bus, sensor, 1), "trigger inside the 2 ms reset window");
+  CHECK(triggerAt(bus, sensor, 2), "trigger after reset");
+  const uint32_t writes = bus.writes();
+  CHECK(triggerAt(bus, sensor, 3), "trigger while busy");
+  CHECK(bus.writes() == writes, "a busy trigger wrote %lu commands", static_cast<unsigned long>(bus.writes() - writes));
+
+  SensorStatus s = pollAt(bus, sensor, 17, r);
+  CHECK(s == SensorStatus::Busy && bus.reads() == 0, "poll at 15 ms: %s, %lu reads", statusName(s),
+        static_cast<unsigned long>(bus.reads()));
+  uint8_t raw[6];
+  CHECK(!bus.read(Sht3xChip::DEFAULT_ADDR, raw, sizeof(raw)), "the part ACKed a read mid-conversion");
+
+  s = pollAt(bus, sensor, 18, r);
+  CHECK(s == SensorStatus::Ready, "poll at 16 ms: %s", statusName(s));
+  CHECK(near(r.temperatureC, 24.5f) && near(r.humidityPct, 81.2f) && r.co2Ppm == 0, "read %.3f C %.3f %%",
+        r.temperatureC, r.humidityPct);
+  CHECK(r.acquiredMs == 18, "acquired at %lu", static_cast<unsigned long>(r.acquiredMs));
+  s = pollAt(bus, sensor, 19, r);
+  CHECK(s == SensorStatus::Idle, "poll after the result: %s", statusName(s));
+  printf("sht3x: %lu writes, %lu reads\n", static_cast<unsigned long>(bus.writes()),
+         static_cast<unsigned long>(bus.reads()));
+}
+
+void sht4x() {
+  SimI2cBus bus;
+  SimI2cBus::Device *dev = bus.add(Sht4xChip::DEFAULT_ADDR, SimI2cBus::Kind::Sht4x);
+  Sht4x<SimI2cBus> sensor(bus);
+  ClimateReading r = {};
+  sensor.begin(0);
+
+  dev->temperatureC = -3.25f;
+  dev->humidityPct = 42.0f;
+  CHECK(triggerAt(bus, sensor, 1), "trigger after reset");
+  SensorStatus s = pollAt(bus, sensor, 9, r);
+  CHECK(s == SensorStatus::Busy, "poll at 8 ms: %s", statusName(s));
+  s = pollAt(bus, sensor, 10, r);
+  CHECK(s == SensorStatus::Ready && near(r.temperatureC, -3.25f) && near(r.humidityPct, 42.0f),
+        "%s %.3f C %.3f %%", statusName(s), r.temperatureC, r.humidityPct);
+
+  // SHT4x reports -6..119 %RH raw; the driver clamps to 0..100
+  dev->humidityPct = 104.0f;
+  triggerAt(bus, sensor, 20);
+  s = pollAt(bus, sensor, 29, r);
+  CHECK(s == SensorStatus::Ready && r.humidityPct == 100.0f, "%s %.3f %%", statusName(s), r.humidityPct);
+  dev->humidityPct = -2.0f;
+  triggerAt(bus, sensor, 40);
+  s = pollAt(bus, sensor, 49, r);
+  CHECK(s == SensorStatus::Ready && r.humidityPct == 0.0f, "%s %.3f %%", statusName(s), r.humidityPct);
+  printf("sht4x: %lu writes, %lu reads\n", static_cast<unsigned long>(bus.writes()),
+         static_cast<unsigned long>(bus.reads()));
+}
+
+void faults() {
+  SimI2cBus bus;
+  SimI2cBus::Device *dev = bus.add(Sht4xChip::DEFAULT_ADDR, SimI2cBus::Kind::Sht4x);
+  Sht4x<SimI2cBus> sensor(bus);
+  ClimateReading r = {};
+  r.temperatureC = 99.0f;
+  sensor.begin(0);
+
+  // CRC error: Error until begin(), and the bad reading is not stored
+  dev->corruptReads = 1;
+  triggerAt(bus, sensor, 1);
+  SensorStatus s = pollAt(bus, sensor, 10, r);
+  CHECK(s == SensorStatus::Error && r.temperatureC == 99.0f, "crc: %s, T %.2f", statusName(s), r.temperatureC);
+  s = pollAt(bus, sensor, 11, r);
+  CHECK(s == SensorStatus::Error, "crc error did not stick: %s", statusName(s));
+  CHECK(sensor.begin(20) && triggerAt(bus, sensor, 21), "recovery after crc");
+  s = pollAt(bus, sensor, 30, r);
+  CHECK(s == SensorStatus::Ready && near(r.temperatureC, 22.0f), "after crc: %s %.2f", statusName(s),
+        r.temperatureC);
+
+  // Absent device: the command NACKs
+  dev->nack = true;
+  bus.setNow(40);
+  CHECK(!sensor.begin(40), "reset ACKed by an absent device");
+  CHECK(!triggerAt(bus, sensor, 41), "trigger ACKed by an absent device");
+  s = pollAt(bus, sensor, 50, r);
+  CHECK(s == SensorStatus::Error, "absent: %s", statusName(s));
+
+  // Hung mid-conversion: the read times out (NACK) after the wait
+  dev->nack = false;
+  sensor.begin(60);
+  CHECK(triggerAt(bus, sensor, 61), "trigger after the device came back");
+  dev->nack = true;
+  s = pollAt(bus, sensor, 65, r);
+  CHECK(s == SensorStatus::Busy, "hung, before the conversion time: %s", statusName(s));
+  s = pollAt(bus, sensor, 70, r);
+  CHECK(s == SensorStatus::Error, "hung: %s", statusName(s));
+
+  dev->nack = false;
+  sensor.begin(80);
+  triggerAt(bus, sensor, 81);
+  s = pollAt(bus, sensor, 90, r);
+  CHECK(s == SensorStatus::Ready, "recovery after a hang: %s", statusName(s));
+  printf("faults: crc, absent and hung device recovered\n");
+}
+
+void scd4x() {
+  SimI2cBus bus;
+  SimI2cBus::Device *co2 = bus.add(Scd4x<SimI2cBus>::DEFAULT_ADDR, SimI2cBus::Kind::Scd4x);
+  SimI2cBus::Device *sht = bus.add(Sht3xChip::DEFAULT_ADDR, SimI2cBus::Kind::Sht3x);
+  co2->co2Ppm = 1234;
+  co2->temperatureC = 23.0f;
+  co2->humidityPct = 70.0f;
+  sht->temperatureC = 21.0f;
+  Scd4x<SimI2cBus> sensor(bus);
+  Sht3x<SimI2cBus> climate(bus);
+  ClimateReading r = {};
+  ClimateReading c = {};
+
+  CHECK(sensor.begin(0) && climate.begin(0), "begin");
+  uint32_t writes = bus.writes();
+  CHECK(triggerAt(bus, sensor, 100), "trigger during the stop delay");
+  CHECK(bus.writes() == writes, "wrote during the 500 ms stop delay");
+  CHECK(triggerAt(bus, sensor, 500) && co2->periodic, "periodic measurement not started");
+
+  // Nothing measured yet: data-ready says no, and the driver goes idle
+  CHECK(triggerAt(bus, sensor, 1000), "data-ready command");
+  SensorStatus s = pollAt(bus, sensor, 1000, r);
+  CHECK(s == SensorStatus::Busy, "data-ready before its 1 ms delay: %s", statusName(s));
+  s = pollAt(bus, sensor, 1001, r);
+  CHECK(s == SensorStatus::Idle, "no sample yet: %s", statusName(s));
+
+  // First sample at 5.5 s; an SHT3x conversion runs between the SCD4x's
+  // data-ready and read-measurement commands
+  triggerAt(bus, sensor, 5500);
+  CHECK(triggerAt(bus, climate, 5500), "sht3x trigger");
+  s = pollAt(bus, sensor, 5501, r);
+  CHECK(s == SensorStatus::Busy, "read-measurement issued: %s", statusName(s));
+  s = pollAt(bus, sensor, 5502, r);
+  CHECK(s == SensorStatus::Ready && r.co2Ppm == 1234 && near(r.temperatureC, 23.0f) && near(r.humidityPct, 70.0f),
+        "%s %u ppm %.3f C %.3f %%", statusName(s), r.co2Ppm, r.temperatureC, r.humidityPct);
+  CHECK(r.acquiredMs == 5502, "acquired at %lu", static_cast<unsigned long>(r.acquiredMs));
+  s = pollAt(bus, climate, 5516, c);
+  CHECK(s == SensorStatus::Ready && near(c.temperatureC, 21.0f), "sht3x on the shared bus: %s %.3f C",
+        statusName(s), c.temperatureC);
+
+  // The sample is consumed: the next data-ready says no
+  triggerAt(bus, sensor, 6000);
+  pollAt(bus, sensor, 6001, r);
+  s = pollAt(bus, sensor, 6002, r);
+  CHECK(s == SensorStatus::Idle, "sample read twice: %s", statusName(s));
+
+  // CRC error on the status word, then a hang on read-measurement; begin()
+  // restarts periodic mode each time
+  co2->corruptReads = 1;
+  triggerAt(bus, sensor, 10500);
+  s = pollAt(bus, sensor, 10501, r);
+  CHECK(s == SensorStatus::Error && !triggerAt(bus, sensor, 10600), "status crc: %s", statusName(s));
+  CHECK(sensor.begin(11000) && triggerAt(bus, sensor, 11500), "restart after crc");
+  triggerAt(bus, sensor, 16500);
+  s = pollAt(bus, sensor, 16501, r);
+  CHECK(s == SensorStatus::Busy, "read-measurement issued: %s", statusName(s));
+  co2->nack = true;
+  s = pollAt(bus, sensor, 16502, r);
+  CHECK(s == SensorStatus::Error, "hung on read-measurement: %s", statusName(s));
+  co2->nack = false;
+  sensor.begin(17000);
+  triggerAt(bus, sensor, 17500);
+  triggerAt(bus, sensor, 22500);
+  pollAt(bus, sensor, 22501, r);
+  s = pollAt(bus, sensor, 22502, r);
+  CHECK(s == SensorStatus::Ready && r.co2Ppm == 1234, "after restart: %s %u ppm", statusName(s), r.co2Ppm);
+  printf("scd4x: %lu writes, %lu reads\n", static_cast<unsigned long>(bus.writes()),
+         static_cast<unsigned long>(bus.reads()));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    fprintf(stderr, "usage: %s\n", argv[0]);
+    return 2;
+  }
+  sht3x();
+  sht4x();
+  faults();
+  scd4x();
+  printf("%s (%d failed checks)\n", g_failures ? "FAIL" : "OK", g_failures);
+  return g_failures ? 1 : 0;
+}
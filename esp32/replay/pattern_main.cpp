@@ -0,0 +1,182 @@
+// Pattern sequencer check: drives PatternSequencer (pattern_sequencer.h) on
+// a fake 1 ms clock on Linux and compares every output edge with the
+// expected timeline.
+//
+// Covers on/off timing and repeat counts, queue order by priority (FIFO
+// within one priority), preemption by a higher priority and the preempted
+// pattern resuming afterwards, stop() by priority, and a full queue. Edges
+// are written "<ms> <toneHz>" when the output turns on or changes tone and
+// "<ms> off" when it turns off.
+//
+// Output is one line per case plus the actual timeline of any case that
+// failed; the exit code is 1 when any check failed.
+//
+// usage: pattern
+
+#include <stdio.h>
+#include <string>
+
+#include "../pattern_sequencer.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond, ...)                                   \
+  do {                                                     \
+    if (!(cond)) {                                         \
+      g_failures++;                                        \
+      printf("FAIL %s:%d %s: ", __FILE__, __LINE__, #cond); \
+      printf(__VA_ARGS__);                                 \
+      printf("\n");                                        \
+    }                                                      \
+  } while (0)
+
+// Records output edges while stepping the clock one ms at a time
+template <size_t Depth>
+class Timeline {
+ public:
+  PatternSequencer<Depth> seq;
+
+  bool enqueue(const TonePattern &p, uint32_t nowMs) {
+    const bool ok = seq.enqueue(p, nowMs);
+    note(nowMs);
+    return ok;
+  }
+
+  void stop(uint32_t nowMs, uint8_t maxPriority) {
+    seq.stop(nowMs, maxPriority);
+    note(nowMs);
+  }
+
+  // Advance the clock from the last step up to and including untilMs
+  void runTo(uint32_t untilMs) {
+    for (; now_ <= untilMs; ++now_) {
+      seq.tick(now_);
+      note(now_);
+    }
+  }
+
+  const std::string &edges() const { return edges_; }
+
+ private:
+  void note(uint32_t nowMs) {
+    const uint16_t out = seq.outputOn() ? (seq.outputToneHz() ? seq.outputToneHz() : 1) : 0;
+    if (out == out_) {
+      return;
+    }
+    out_ = out;
+    char edge[24];
+    if (out) {
+      snprintf(edge, sizeof(edge), "%s%lu %u", edges_.empty() ? "" : ", ", static_cast<unsigned long>(nowMs), out);
+    } else {
+      snprintf(edge, sizeof(edge), "%s%lu off", edges_.empty() ? "" : ", ", static_cast<unsigned long>(nowMs));
+    }
+    edges_ += edge;
+  }
+
+  std::string edges_;
+  uint16_t out_ = 0;
+  uint32_t now_ = 0;
+};
+
+template <size_t Depth>
+void expectEdges(const char *name, const Timeline<Depth> &t, const char *expected) {
+  const bool same = t.edges() == expected;
+  CHECK(same, "%s\n  expected: %s\n  got:      %s", name, expected, t.edges().c_str());
+  if (same) {
+    printf("%s: %s\n", name, expected);
+  }
+}
+
+void repeats() {
+  Timeline<4> t;
+  t.enqueue({1000, 100, 50, 3, 1}, 0);
+  CHECK(t.seq.tick(0) == 100, "next change in %lu ms", static_cast<unsigned long>(t.seq.tick(0)));
+  t.runTo(1000);
+  expectEdges("repeats", t, "0 1000, 100 off, 150 1000, 250 off, 300 1000, 400 off");
+  CHECK(!t.seq.active() && t.seq.tick(1000) == 0, "still active after the last cycle");
+
+  // No off time: the cycles run together as one on stretch
+  Timeline<4> solid;
+  solid.enqueue({2000, 100, 0, 2, 1}, 0);
+  solid.runTo(500);
+  expectEdges("repeats-solid", solid, "0 2000, 200 off");
+}
+
+void queueOrder() {
+  Timeline<4> t;
+  t.enqueue({1000, 100, 0, 1, 2}, 0);
+  t.runTo(10);
+  CHECK(t.enqueue({2000, 50, 0, 1, 1}, 10), "low 1 rejected");
+  CHECK(t.enqueue({3000, 50, 0, 1, 1}, 10), "low 2 rejected");
+  CHECK(t.enqueue({4000, 50, 0, 1, 2}, 10), "equal priority rejected");
+  CHECK(t.seq.queued() == 3 && t.seq.activePriority() == 2, "queued %u, playing priority %u",
+        static_cast<unsigned>(t.seq.queued()), t.seq.activePriority());
+  t.runTo(1000);
+  expectEdges("queue-order", t, "0 1000, 100 4000, 150 2000, 200 3000, 250 off");
+}
+
+void preemption() {
+  // Preempted in the on phase of its second cycle; resumes with that cycle
+  Timeline<4> t;
+  t.enqueue({1000, 100, 100, 3, 1}, 0);
+  t.runTo(250);
+  t.enqueue({2000, 50, 0, 2, 3}, 250);
+  CHECK(t.seq.activePriority() == 3 && t.seq.queued() == 1, "playing priority %u, queued %u",
+        t.seq.activePriority(), static_cast<unsigned>(t.seq.queued()));
+  t.runTo(2000);
+  expectEdges("preempt-resume", t, "0 1000, 100 off, 200 1000, 250 2000, 350 1000, 450 off, 550 1000, 650 off");
+
+  // A pattern repeating until stop() resumes too, ahead of equal waiters
+  Timeline<4> forever;
+  forever.enqueue({1000, 500, 500, 0, 1}, 0);
+  forever.runTo(700);
+  forever.enqueue({3000, 100, 0, 1, 1}, 700);  // waits behind the blink
+  forever.enqueue({2000, 100, 100, 3, 2}, 700);
+  forever.runTo(2500);
+  forever.stop(2500, 1);
+  forever.runTo(3000);
+  expectEdges("preempt-forever", forever, "0 1000, 500 off, 700 2000, 800 off, 900 2000, 1000 off, 1100 2000, "
+                                          "1200 off, 1300 1000, 1800 off, 2300 1000, 2500 off");
+  CHECK(!forever.seq.active() && forever.seq.queued() == 0, "left active %d, queued %u", forever.seq.active(),
+        static_cast<unsigned>(forever.seq.queued()));
+}
+
+void stopByPriority() {
+  Timeline<4> t;
+  t.enqueue({1000, 100, 0, 1, 1}, 0);
+  t.enqueue({3000, 100, 0, 1, 3}, 10);  // preempts; the first waits to resume
+  t.enqueue({2000, 100, 0, 1, 2}, 20);
+  CHECK(t.seq.queued() == 2, "queued %u", static_cast<unsigned>(t.seq.queued()));
+  t.stop(30, 2);  // the priority 3 pattern keeps playing, the waiters go
+  t.runTo(1000);
+  expectEdges("stop-priority", t, "0 1000, 10 3000, 110 off");
+}
+
+void fullQueue() {
+  Timeline<2> t;
+  t.enqueue({1000, 100, 0, 1, 3}, 0);
+  CHECK(t.enqueue({2000, 50, 0, 1, 1}, 0) && t.enqueue({3000, 50, 0, 1, 1}, 0), "queue refused a waiter");
+  CHECK(!t.enqueue({4000, 50, 0, 1, 1}, 0), "accepted into a full queue of equal priority");
+  CHECK(t.enqueue({5000, 50, 0, 1, 2}, 0), "did not evict a lower priority");
+  CHECK(!t.enqueue({6000, 0, 0, 1, 9}, 0), "accepted a pattern with no on time");
+  t.runTo(1000);
+  expectEdges("full-queue", t, "0 1000, 100 5000, 150 2000, 200 off");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    fprintf(stderr, "usage: %s\n", argv[0]);
+    return 2;
+  }
+  repeats();
+  queueOrder();
+  preemption();
+  stopByPriority();
+  fullQueue();
+  printf("%s (%d failed checks)\n", g_failures ? "FAIL" : "OK", g_failures);
+  return g_failures ? 1 : 0;
+}
@@ -0,0 +1,387 @@
+#pragma once
+// Virtual-time hardware behind the replay shims (replay/hal/*.h).
+//
+// One Hal instance owns the clock, pin levels, FreeRTOS/esp_timer timers,
+// queues, Preferences and the "outside world" state a trace drives (DHT
+// values, water pin, threshold responses, Wi-Fi/MQTT reachability). Time
+// only moves in advance(): loop() passes, delay() and the runner's tick all
+// go through it, and trace events and timers fire in timestamp order on the
+// way. Output pin changes are written to the actuator timeline. A Plant, if
+// set, replaces the trace's sensor values with a simulated chamber.
+//
+// It also stands in for the MQTT broker: a trace "cmd" reaches the firmware
+// through PubSubClient::loop() if the client is subscribed to topic/<id>/cmd
+// at that moment (clean session, so nothing is kept while it is not), and
+// every response on topic/<id>/resp is written to the timeline with the
+// time since its request was sent. Blocking HTTPS requests take
+// HTTPS_REQUEST_MS of virtual time, so a command that arrives during one
+// waits for it as it would on the device.
+//
+// Host-only; the firmware never includes this.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+
+namespace replay {
+
+// Thrown by ESP.restart(); the runner ends the boot there
+struct Reboot {};
+
+// One HTTPS request (TLS handshake + GET) on the ESP32, blocking loop()
+const uint32_t HTTPS_REQUEST_MS = 800;
+
+enum class EventKind : uint8_t { Dht, Water, Thresholds, Net, Mqtt, Command };
+
+struct TraceEvent {
+  uint32_t ms;
+  EventKind kind;
+  float t;           // Dht (NaN = failed read)
+  float h;
+  int level;         // Water: pin level
+  int httpCode;      // Thresholds: 200 + body, or the failing status
+  std::string body;  // Thresholds, Command (request JSON)
+  bool up;           // Net / Mqtt
+};
+
+// Simulated world behind the sensor and relay pins (twin_main.cpp). When
+// set, DHT reads come from it instead of the trace, and it is brought up to
+// the current time before every output change.
+class Plant {
+ public:
+  virtual ~Plant() {}
+  virtual void advanceTo(uint32_t ms) = 0;
+  virtual float readTemperature() = 0;
+  virtual float readHumidity() = 0;
+};
+
+struct Timer {
+  uint32_t dueMs;
+  uint32_t periodMs;
+  bool armed;
+  bool autoReload;
+  std::function<void()> fire;
+};
+
+class Hal {
+ public:
+  static Hal &get() {
+    static Hal hal;
+    return hal;
+  }
+
+  // Start a boot at startMs; events at or before it only set the initial
+  // state (no ISRs fire for history the device slept through). A runner
+  // that keeps RTC memory across ESP.restart() boots with softwareReset.
+  void boot(const std::vector<TraceEvent> *events, uint32_t startMs, bool softwareReset = false) {
+    events_ = events;
+    next_ = 0;
+    nowMs_ = startMs;
+    softwareReset_ = softwareReset;
+    while (next_ < events_->size() && (*events_)[next_].ms <= startMs) {
+      apply((*events_)[next_++], false);
+    }
+  }
+
+  uint32_t now() const { return nowMs_; }
+  bool softwareReset() const { return softwareReset_; }
+
+  void advance(uint32_t ms) {
+    const uint32_t target = nowMs_ + ms;
+    if (inAdvance_) {
+      nowMs_ = target;  // delay() from inside a timer callback: just move the clock
+      return;
+    }
+    inAdvance_ = true;
+    for (;;) {
+      Timer *timer = nextTimer();
+      const bool haveEvent = events_ && next_ < events_->size() && (*events_)[next_].ms <= target;
+      const bool haveTimer = timer && static_cast<int32_t>(target - timer->dueMs) >= 0;
+      if (!haveEvent && !haveTimer) {
+        break;
+      }
+      if (haveEvent && (!haveTimer || static_cast<int32_t>(timer->dueMs - (*events_)[next_].ms) >= 0)) {
+        nowMs_ = (*events_)[next_].ms > nowMs_ ? (*events_)[next_].ms : nowMs_;
+        apply((*events_)[next_++], true);
+      } else {
+        nowMs_ = static_cast<int32_t>(timer->dueMs - nowMs_) > 0 ? timer->dueMs : nowMs_;
+        if (timer->autoReload) {
+          timer->dueMs += timer->periodMs;
+        } else {
+          timer->armed = false;
+        }
+        timer->fire();
+      }
+    }
+    nowMs_ = target;
+    inAdvance_ = false;
+  }
+
+  // ---- timers ----
+  Timer *createTimer(std::function<void()> fire) {
+    timers_.emplace_back(new Timer{0, 0, false, false, fire});
+    return timers_.back().get();
+  }
+  void arm(Timer *t, uint32_t delayMs, bool autoReload) {
+    t->dueMs = nowMs_ + delayMs;
+    t->periodMs = delayMs ? delayMs : 1;
+    t->autoReload = autoReload;
+    t->armed = true;
+  }
+
+  // ---- pins ----
+  typedef void (*Isr)();
+  void labelPin(uint8_t pin, const char *name) { labels_[pin] = name; }
+  void setWaterPin(uint8_t pin) { waterPin_ = pin; }
+  void pinMode(uint8_t pin, uint8_t mode) {
+    if (mode == 2 /* INPUT_PULLUP */ && levels_.find(pin) == levels_.end()) {
+      levels_[pin] = 1;
+    }
+  }
+  int read(uint8_t pin) const {
+    std::map<uint8_t, int>::const_iterator it = levels_.find(pin);
+    return it == levels_.end() ? 0 : it->second;
+  }
+  void write(uint8_t pin, int level) {
+    const int prev = read(pin);
+    if (plant_ && prev != level) {
+      plant_->advanceTo(nowMs_);
+    }
+    levels_[pin] = level;
+    if (prev != level) {
+      std::map<uint8_t, std::string>::const_iterator it = labels_.find(pin);
+      if (it != labels_.end()) {
+        fprintf(out_, "%lu %s %s\n", static_cast<unsigned long>(nowMs_), it->second.c_str(), level ? "ON" : "OFF");
+      }
+    }
+  }
+  void attachIsr(uint8_t pin, Isr isr, int mode) { isrs_[pin] = std::make_pair(isr, mode); }
+  // Outputs drop when the chip resets
+  void resetOutputs(const char *why) {
+    for (std::map<uint8_t, std::string>::const_iterator it = labels_.begin(); it != labels_.end(); ++it) {
+      if (read(it->first)) {
+        if (plant_) {
+          plant_->advanceTo(nowMs_);
+        }
+        levels_[it->first] = 0;
+        fprintf(out_, "%lu %s OFF (%s)\n", static_cast<unsigned long>(nowMs_), it->second.c_str(), why);
+      }
+    }
+  }
+
+  // ---- world state read by the shims ----
+  void setPlant(Plant *plant) { plant_ = plant; }
+  float dhtT() {
+    if (plant_) {
+      plant_->advanceTo(nowMs_);
+      return plant_->readTemperature();
+    }
+    return dhtT_;
+  }
+  float dhtH() {
+    if (plant_) {
+      plant_->advanceTo(nowMs_);
+      return plant_->readHumidity();
+    }
+    return dhtH_;
+  }
+  // ---- broker ----
+  void subscribe(const char *topic) { subscriptions_.push_back(topic); }
+  void clearSubscriptions() { subscriptions_.clear(); }
+  // Next command for the client, oldest first
+  bool takeCommand(std::string &topic, std::string &payload) {
+    if (commands_.empty()) {
+      return false;
+    }
+    topic = commands_.front().first;
+    payload = commands_.front().second;
+    commands_.pop_front();
+    return true;
+  }
+
+  bool wifiUp() const { return wifiUp_; }
+  bool mqttUp() const { return mqttUp_ && wifiUp_; }
+  int thresholdCode() const { return wifiUp_ ? thresholdCode_ : -1; }
+  const std::string &thresholdBody() const { return thresholdBody_; }
+
+  // ---- Preferences ----
+  std::map<std::string, std::string> &prefs(const std::string &ns) { return prefs_[ns]; }
+
+  // ---- output ----
+  void setOutput(FILE *out) { out_ = out; }
+  FILE *output() const { return out_; }
+  void setEchoSerial(bool on) { echoSerial_ = on; }
+  void setLogPublishes(bool on) { logPublishes_ = on; }
+  void setLogTopic(const std::string &name) { logTopic_ = name.empty() ? name : "/" + name; }
+  // First responses later than this after their request are flagged (0: off)
+  void setRpcBoundMs(uint32_t ms) { rpcBoundMs_ = ms; }
+  uint32_t slowResponses() const { return slowResponses_; }
+  void serial(const char *text) {
+    if (!echoSerial_) {
+      return;
+    }
+    for (const char *p = text; *p; ++p) {
+      if (atLineStart_) {
+        fprintf(stderr, "[%9lu] ", static_cast<unsigned long>(nowMs_));
+      }
+      fputc(*p, stderr);
+      atLineStart_ = (*p == '\n');
+    }
+  }
+  void published(const char *topic, const char *payload) {
+    if (logPublishes_ || (!logTopic_.empty() && endsWith(topic, logTopic_.c_str()))) {
+      fprintf(out_, "%lu pub %s %s\n", static_cast<unsigned long>(nowMs_), topic, payload);
+    }
+    if (endsWith(topic, "/resp")) {
+      const std::string id = jsonString(payload, "id");
+      std::map<std::string, uint32_t>::const_iterator sent = commandSentMs_.find(id);
+      fprintf(out_, "%lu # rpc %s %s", static_cast<unsigned long>(nowMs_), id.empty() ? "-" : id.c_str(),
+              jsonString(payload, "status").c_str());
+      if (sent != commandSentMs_.end()) {
+        const uint32_t latency = nowMs_ - sent->second;
+        fprintf(out_, " %lu ms", static_cast<unsigned long>(latency));
+        // Only the first answer counts: a final response after "accepted" or
+        // a resent duplicate is not what the requester waits on
+        if (answered_.insert(id).second && rpcBoundMs_ && latency > rpcBoundMs_) {
+          fprintf(out_, " (over %lu ms)", static_cast<unsigned long>(rpcBoundMs_));
+          slowResponses_++;
+        }
+      }
+      fprintf(out_, "\n");
+    }
+  }
+
+ private:
+  Hal() {}
+
+  // On the raw strings: runs for every publish, which the bench counts
+  static bool endsWith(const char *s, const char *suffix) {
+    const size_t n = strlen(s);
+    const size_t m = strlen(suffix);
+    return n >= m && memcmp(s + n - m, suffix, m) == 0;
+  }
+
+  // Value of a string field in flat JSON; enough for request ids and status
+  static std::string jsonString(const std::string &json, const char *key) {
+    const std::string tag = std::string("\"") + key + "\":\"";
+    const size_t at = json.find(tag);
+    if (at == std::string::npos) {
+      return std::string();
+    }
+    const size_t start = at + tag.size();
+    const size_t end = json.find('"', start);
+    return end == std::string::npos ? std::string() : json.substr(start, end - start);
+  }
+
+  // Delivered only to a current subscription, as a clean-session broker does
+  void sendCommand(const TraceEvent &e, bool live) {
+    if (!live) {
+      return;  // sent before this boot
+    }
+    for (size_t i = 0; i < subscriptions_.size(); ++i) {
+      if (mqttUp() && endsWith(subscriptions_[i].c_str(), "/cmd")) {
+        commands_.push_back(std::make_pair(subscriptions_[i], e.body));
+        commandSentMs_[jsonString(e.body, "id")] = nowMs_;
+        answered_.erase(jsonString(e.body, "id"));
+        return;
+      }
+    }
+    fprintf(out_, "%lu # cmd %s dropped (not subscribed)\n", static_cast<unsigned long>(nowMs_),
+            jsonString(e.body, "id").c_str());
+  }
+
+  Timer *nextTimer() {
+    Timer *best = nullptr;
+    for (size_t i = 0; i < timers_.size(); ++i) {
+      Timer *t = timers_[i].get();
+      if (t->armed && (best == nullptr || static_cast<int32_t>(t->dueMs - best->dueMs) < 0)) {
+        best = t;
+      }
+    }
+    return best;
+  }
+
+  void apply(const TraceEvent &e, bool live) {
+    switch (e.kind) {
+      case EventKind::Dht:
+        dhtT_ = e.t;
+        dhtH_ = e.h;
+        break;
+      case EventKind::Water: {
+        const int prev = read(waterPin_);
+        levels_[waterPin_] = e.level;
+        std::map<uint8_t, std::pair<Isr, int> >::const_iterator it = isrs_.find(waterPin_);
+        if (live && prev != e.level && it != isrs_.end()) {
+          const int mode = it->second.second;  // 1 RISING, 2 FALLING, 3 CHANGE
+          if (mode == 3 || (mode == 1 && e.level) || (mode == 2 && !e.level)) {
+            it->second.first();
+          }
+        }
+        break;
+      }
+      case EventKind::Thresholds:
+        thresholdCode_ = e.httpCode;
+        thresholdBody_ = e.body;
+        break;
+      case EventKind::Net:
+        wifiUp_ = e.up;
+        break;
+      case EventKind::Mqtt:
+        mqttUp_ = e.up;
+        break;
+      case EventKind::Command:
+        sendCommand(e, live);
+        return;
+    }
+    if (!mqttUp()) {
+      subscriptions_.clear();
+      commands_.clear();
+    }
+    if (live && e.kind != EventKind::Dht && e.kind != EventKind::Water) {
+      fprintf(out_, "%lu # %s\n", static_cast<unsigned long>(nowMs_),
+              e.kind == EventKind::Thresholds ? "thresholds changed"
+              : e.kind == EventKind::Net      ? (e.up ? "net up" : "net down")
+                                              : (e.up ? "mqtt up" : "mqtt down"));
+    }
+  }
+
+  const std::vector<TraceEvent> *events_ = nullptr;
+  Plant *plant_ = nullptr;
+  size_t next_ = 0;
+  uint32_t nowMs_ = 0;
+  bool softwareReset_ = false;
+  bool inAdvance_ = false;
+  std::vector<std::unique_ptr<Timer> > timers_;
+  std::map<uint8_t, int> levels_;
+  std::map<uint8_t, std::string> labels_;
+  std::map<uint8_t, std::pair<Isr, int> > isrs_;
+  uint8_t waterPin_ = 0xFF;
+  float dhtT_ = NAN;
+  float dhtH_ = NAN;
+  bool wifiUp_ = true;
+  bool mqttUp_ = true;
+  int thresholdCode_ = -1;
+  std::string thresholdBody_;
+  std::map<std::string, std::map<std::string, std::string> > prefs_;
+  FILE *out_ = stdout;
+  bool echoSerial_ = false;
+  bool atLineStart_ = true;
+  bool logPublishes_ = false;
+  std::string logTopic_;  // "/<name>": publishes on topic/<id>/<name> only
+  std::vector<std::string> subscriptions_;
+  std::deque<std::pair<std::string, std::string> > commands_;
+  std::map<std::string, uint32_t> commandSentMs_;
+  std::set<std::string> answered_;
+  uint32_t rpcBoundMs_ = 0;
+  uint32_t slowResponses_ = 0;
+};
+
+}  // namespace replay
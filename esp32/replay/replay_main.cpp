@@ -0,0 +1,338 @@
+// Trace replay runner for the controller firmware (main.cpp), on Linux.
+//
+// Compiles the real main.cpp against the shims in replay/hal and drives
+// setup()/loop() on a virtual clock, so handleRelays(), handleWaterLevel(),
+// readTempHum() and the threshold fetch run unmodified at whatever speed the
+// host manages (a day of 10 s publishes replays in seconds). Output is the
+// actuator timeline, one change per line, meant to be diffed between
+// firmware versions:
+//
+//   <ms> relay1 ON
+//   <ms> buzzer OFF
+//   <ms> reboot
+//   <ms> # rpc <id> <status> <ms since the request was sent>
+//
+// Trace format (one event per line; lines that do not start with a number
+// are ignored, so a serial log of a TRACE_RECORD build can be fed as is
+// once the "TRACE " prefix is stripped):
+//
+//   <ms> dht <tempC> <hum%>        sensor reads return this from <ms> on
+//   <ms> dht fail                  reads return NaN
+//   <ms> water <0|1>               float switch pin level (edge fires the ISR)
+//   <ms> thresholds <json body>    threshold GETs return 200 + body
+//   <ms> thresholds http <code>    threshold GETs fail with <code>
+//   <ms> net up|down               Wi-Fi station link
+//   <ms> mqtt up|down              broker reachability
+//   <ms> cmd <json request>        published on topic/<id>/cmd
+//
+// Each boot runs in a forked child (boot_runner.h) so ESP.restart() (e.g. the
+// DHT reboot path) really starts from fresh globals; Preferences are reseeded with a
+// provisioned, registered config each boot. The RTC_NOINIT_ATTR records (crash
+// record, last reboot command) are carried across ESP.restart(), which the
+// next boot sees as a software reset.
+//
+// --max-rpc-ms <ms> flags every request whose first response took longer
+// and makes the run exit with 1.
+//
+// --pubs adds every publish to the timeline, --topic <name> only those on
+// topic/<id>/<name> (e.g. alarm). Run without a trace (from esp32/), it
+// replays the cases in replay/traces/controller/cases.txt and compares each
+// timeline with the case's .expected file; any difference exits with 1.
+//
+// usage: replay <trace> [--until ms] [--tick ms] [--pubs] [--topic name] [--max-rpc-ms ms] [--serial]
+//        replay [--suite dir]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../main.cpp"
+#include "boot_runner.h"
+
+HardwareSerial Serial;
+WiFiClass WiFi;
+EspClass ESP;
+
+namespace {
+
+const uint32_t REBOOT_MS = 1500;  // reset + ROM boot before setup() runs again
+
+struct Options {
+  std::string trace;
+  uint32_t untilMs = 0;
+  uint32_t tickMs = 5;  // one loop() pass
+  bool pubs = false;
+  std::string topic;
+  uint32_t maxRpcMs = 0;
+  bool serial = false;
+};
+
+// What outlives ESP.restart(): RTC memory, plus the runner's count of
+// responses over --max-rpc-ms
+struct BootState {
+  CrashRecord crash;
+  RpcRebootMark<RPC_ID_SIZE> rebootMark;
+  uint32_t slowResponses;
+};
+
+bool parseLine(const std::string &line, replay::TraceEvent &e) {
+  std::istringstream in(line);
+  std::string kind;
+  unsigned long ms;
+  if (!(in >> ms >> kind)) {
+    return false;
+  }
+  e = replay::TraceEvent();
+  e.ms = static_cast<uint32_t>(ms);
+  if (kind == "dht") {
+    std::string a, b;
+    in >> a >> b;
+    e.kind = replay::EventKind::Dht;
+    e.t = a == "fail" ? NAN : strtof(a.c_str(), nullptr);
+    e.h = a == "fail" ? NAN : strtof(b.c_str(), nullptr);
+    return true;
+  }
+  if (kind == "water") {
+    e.kind = replay::EventKind::Water;
+    return static_cast<bool>(in >> e.level);
+  }
+  if (kind == "thresholds") {
+    e.kind = replay::EventKind::Thresholds;
+    std::string rest;
+    std::getline(in >> std::ws, rest);
+    if (rest.compare(0, 5, "http ") == 0) {
+      e.httpCode = atoi(rest.c_str() + 5);
+    } else {
+      e.httpCode = 200;
+      e.body = rest;
+    }
+    return true;
+  }
+  if (kind == "cmd") {
+    e.kind = replay::EventKind::Command;
+    std::getline(in >> std::ws, e.body);
+    return !e.body.empty();
+  }
+  if (kind == "net" || kind == "mqtt") {
+    std::string state;
+    in >> state;
+    e.kind = kind == "net" ? replay::EventKind::Net : replay::EventKind::Mqtt;
+    e.up = state == "up";
+    return true;
+  }
+  return false;
+}
+
+bool loadTrace(const char *path, std::vector<replay::TraceEvent> &events) {
+  std::ifstream f(path);
+  if (!f) {
+    return false;
+  }
+  std::string line;
+  replay::TraceEvent e;
+  while (std::getline(f, line)) {
+    if (line.compare(0, 6, "TRACE ") == 0) {
+      line.erase(0, 6);
+    }
+    if (parseLine(line, e)) {
+      events.push_back(e);
+    }
+  }
+  // Recorded water edges are logged when validated, so they can trail
+  // other events; keep same-time events in file order.
+  std::stable_sort(events.begin(), events.end(),
+                   [](const replay::TraceEvent &a, const replay::TraceEvent &b) { return a.ms < b.ms; });
+  return true;
+}
+
+// One boot, in the child. Returns the reboot time, or 0 if the trace ended.
+uint32_t runBoot(const std::vector<replay::TraceEvent> &events, BootState &state, uint32_t startMs,
+                 uint32_t endMs, uint32_t tickMs) {
+  replay::Hal &hal = replay::Hal::get();
+  hal.setWaterPin(WATER_PIN);
+  hal.boot(&events, startMs, startMs != 0);
+  g_crash = state.crash;
+  g_rpcRebootMark = state.rebootMark;
+  hal.labelPin(RELAY1_PIN, "relay1");
+  hal.labelPin(RELAY2_PIN, "relay2");
+  hal.labelPin(RELAY4_PIN, "relay4");
+  hal.labelPin(RELAY5_PIN, "relay5");
+  hal.labelPin(BUZZER_PIN, "buzzer");
+  replay::seedProvisionedPreferences();
+  uint32_t rebootAt = 0;
+  try {
+    setup();
+    while (static_cast<int32_t>(endMs - hal.now()) > 0) {
+      loop();
+      hal.advance(tickMs);
+    }
+  } catch (const replay::Reboot &) {
+    const uint32_t at = hal.now();
+    fprintf(hal.output(), "%lu reboot\n", static_cast<unsigned long>(at));
+    hal.resetOutputs("reset");
+    rebootAt = at ? at : 1;
+  }
+  state.crash = g_crash;
+  state.rebootMark = g_rpcRebootMark;
+  state.slowResponses += hal.slowResponses();
+  return rebootAt;
+}
+
+bool parseArgs(const std::vector<std::string> &args, Options &opt) {
+  for (size_t i = 0; i < args.size(); ++i) {
+    const std::string &a = args[i];
+    const bool hasValue = i + 1 < args.size();
+    if (a == "--until" && hasValue) {
+      opt.untilMs = static_cast<uint32_t>(strtoul(args[++i].c_str(), nullptr, 10));
+    } else if (a == "--tick" && hasValue) {
+      opt.tickMs = static_cast<uint32_t>(strtoul(args[++i].c_str(), nullptr, 10));
+    } else if (a == "--topic" && hasValue) {
+      opt.topic = args[++i];
+    } else if (a == "--max-rpc-ms" && hasValue) {
+      opt.maxRpcMs = static_cast<uint32_t>(strtoul(args[++i].c_str(), nullptr, 10));
+    } else if (a == "--pubs") {
+      opt.pubs = true;
+    } else if (a == "--serial") {
+      opt.serial = true;
+    } else if (a[0] != '-' && opt.trace.empty()) {
+      opt.trace = a;
+    } else {
+      return false;
+    }
+  }
+  return !opt.trace.empty();
+}
+
+// Replay one trace, writing the timeline to out; label names it in the
+// header. Returns 2 if the trace cannot be read, 1 if a boot crashed or a
+// response was over --max-rpc-ms.
+int runTrace(const Options &opt, const std::string &label, FILE *out) {
+  std::vector<replay::TraceEvent> events;
+  if (!loadTrace(opt.trace.c_str(), events)) {
+    fprintf(stderr, "cannot read %s\n", opt.trace.c_str());
+    return 2;
+  }
+  replay::Hal &hal = replay::Hal::get();
+  hal.setOutput(out);
+  hal.setLogPublishes(opt.pubs);
+  hal.setLogTopic(opt.topic);
+  hal.setRpcBoundMs(opt.maxRpcMs);
+  hal.setEchoSerial(opt.serial);
+  const uint32_t endMs = opt.untilMs ? opt.untilMs : (events.empty() ? 0 : events.back().ms) + 2 * PUBLISH_MS;
+  fprintf(out, "# replay %s: %u events, until %lu ms\n", label.c_str(), static_cast<unsigned>(events.size()),
+          static_cast<unsigned long>(endMs));
+
+  BootState state = {};  // RTC memory after a power-on fails its magic checks
+  const bool ok = replay::runBoots(state, endMs, REBOOT_MS, [&](BootState &s, uint32_t bootMs) {
+    return runBoot(events, s, bootMs, endMs, opt.tickMs);
+  });
+  if (state.slowResponses) {
+    fprintf(out, "# %lu responses over %lu ms\n", static_cast<unsigned long>(state.slowResponses),
+            static_cast<unsigned long>(opt.maxRpcMs));
+  }
+  fflush(out);
+  return ok && state.slowResponses == 0 ? 0 : 1;
+}
+
+bool readFile(const std::string &path, std::string &text) {
+  std::ifstream f(path);
+  if (!f) {
+    return false;
+  }
+  std::ostringstream s;
+  s << f.rdbuf();
+  text = s.str();
+  return true;
+}
+
+void firstDifference(const std::string &expected, const std::string &got) {
+  std::istringstream e(expected), g(got);
+  std::string el, gl;
+  for (int line = 1;; ++line) {
+    const bool haveE = static_cast<bool>(std::getline(e, el));
+    const bool haveG = static_cast<bool>(std::getline(g, gl));
+    if (!haveE && !haveG) {
+      return;
+    }
+    if (!haveE || !haveG || el != gl) {
+      printf("  line %d\n  expected: %s\n  got:      %s\n", line, haveE ? el.c_str() : "(end)",
+             haveG ? gl.c_str() : "(end)");
+      return;
+    }
+  }
+}
+
+// Each case line: <name> <trace> [options]; the trace is relative to dir
+int runSuite(const std::string &dir) {
+  std::ifstream cases(dir + "/cases.txt");
+  if (!cases) {
+    fprintf(stderr, "cannot read %s/cases.txt\n", dir.c_str());
+    return 2;
+  }
+  int failed = 0, run = 0;
+  std::string line;
+  while (std::getline(cases, line)) {
+    std::istringstream fields(line);
+    std::string name, word;
+    if (!(fields >> name) || name[0] == '#') {
+      continue;
+    }
+    std::vector<std::string> args;
+    while (fields >> word) {
+      args.push_back(word);
+    }
+    Options opt;
+    std::string expected, got;
+    run++;
+    const bool parsed = parseArgs(args, opt);
+    const std::string label = opt.trace;
+    opt.trace = dir + "/" + opt.trace;
+    FILE *out = tmpfile();
+    const int rc = parsed && out != nullptr && readFile(dir + "/" + name + ".expected", expected)
+                       ? runTrace(opt, label, out)
+                       : 2;
+    if (rc == 2) {
+      printf("%s: cannot run\n", name.c_str());
+      failed++;
+      if (out) {
+        fclose(out);
+      }
+      continue;
+    }
+    rewind(out);
+    char buf[4096];
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), out)) > 0;) {
+      got.append(buf, n);
+    }
+    fclose(out);
+    const bool same = rc == 0 && got == expected;  // 1: a boot crashed or a response was slow
+    printf("%s: %s\n", name.c_str(), same ? "ok" : "FAIL");
+    if (!same) {
+      firstDifference(expected, got);
+      failed++;
+    }
+  }
+  printf("%d of %d cases failed\n", failed, run);
+  return failed ? 1 : 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+  if (args.empty() || args[0] == "--suite") {
+    return runSuite(args.size() > 1 ? args[1] : "replay/traces/controller");
+  }
+  Options opt;
+  if (!parseArgs(args, opt)) {
+    fprintf(stderr, "usage: %s <trace> [--until ms] [--tick ms] [--pubs] [--topic name] [--max-rpc-ms ms] [--serial]\n"
+                    "       %s [--suite dir]\n", argv[0], argv[0]);
+    return 2;
+  }
+  return runTrace(opt, opt.trace, stdout);
+}
@@ -0,0 +1,92 @@
+# Turn a controller's timeline dump (GET /timeline) into Chrome trace JSON,
+# which chrome://tracing and ui.perfetto.dev open directly.
+#
+# The dump layout is described in timeline_trace.h. Event start times are
+# the low 32 bits of the device's microsecond clock. They are unwrapped
+# against the full clock in the header, walking back from the newest event,
+# so the output timestamps are microseconds since boot. Each context (loop
+# task, timer task, interrupts) becomes one thread row.
+#
+# usage: curl -s http://<controller>/timeline -o dump.bin
+#        python3 timeline_to_chrome.py dump.bin > timeline.json
+
+import json
+import struct
+import sys
+
+HEADER = struct.Struct("<4sBBBBIIQ")
+EVENT = struct.Struct("<IIIHBB")
+KIND_SPAN = 0
+WRAP = 1 << 32
+
+
+def read_strings(data, offset, count):
+    names = []
+    for _ in range(count):
+        end = data.index(b"\0", offset)
+        names.append(data[offset:end].decode("utf-8", "replace"))
+        offset = end + 1
+    return names, offset
+
+
+def signed32(value):
+    value %= WRAP
+    return value - WRAP if value >= WRAP // 2 else value
+
+
+def parse(data):
+    magic, version, event_size, name_count, context_count, count, dropped, now_us = HEADER.unpack_from(data, 0)
+    if magic != b"MLTL" or version != 1 or event_size != EVENT.size:
+        raise ValueError("not a version 1 timeline dump")
+    names, offset = read_strings(data, HEADER.size, name_count)
+    contexts, offset = read_strings(data, offset, context_count)
+    events = [EVENT.unpack_from(data, offset + i * EVENT.size) for i in range(count)]
+    return names, contexts, events, dropped, now_us
+
+
+def unwrap(events, now_us):
+    # Events are pushed when they end; end times are in push order, give or
+    # take an interrupt landing between timestamp and push.
+    ends = [None] * len(events)
+    later = now_us
+    later_low = now_us % WRAP
+    for i in range(len(events) - 1, -1, -1):
+        start, dur = events[i][0], events[i][1]
+        low = (start + dur) % WRAP
+        later -= signed32(later_low - low)
+        later_low = low
+        ends[i] = later
+    return [end - ev[1] for end, ev in zip(ends, events)]
+
+
+def convert(data):
+    names, contexts, events, dropped, now_us = parse(data)
+    trace = [{"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "controller"}}]
+    for tid, name in enumerate(contexts):
+        trace.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": tid, "args": {"name": name}})
+    for (start, dur, arg, point, kind, context), ts in zip(events, unwrap(events, now_us)):
+        name = names[point] if point < len(names) and names[point] else "point_%d" % point
+        event = {"name": name, "pid": 1, "tid": context, "ts": ts, "args": {"arg": arg}}
+        if kind == KIND_SPAN:
+            event.update(ph="X", dur=dur)
+        else:
+            event.update(ph="i", s="t")
+        trace.append(event)
+    return {"traceEvents": trace, "otherData": {"dropped": dropped, "dump_at_us": now_us}}, len(events)
+
+
+def main(argv):
+    if len(argv) != 2:
+        sys.stderr.write("usage: %s <dump.bin>\n" % argv[0])
+        return 2
+    with open(argv[1], "rb") as f:
+        data = f.read()
+    doc, count = convert(data)
+    json.dump(doc, sys.stdout)
+    sys.stdout.write("\n")
+    sys.stderr.write("%d events\n" % count)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
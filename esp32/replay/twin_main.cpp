@@ -0,0 +1,282 @@
+// Closed-loop digital twin: the controller firmware (main.cpp) driving a
+// simulated grow chamber (chamber_model.h), on Linux.
+//
+// Same host build as replay_main.cpp, but the DHT reads come from the
+// chamber and the chamber responds to the relay pins the firmware sets. Each
+// relay strategy (relay_control.h) runs the unmodified setup()/loop() for
+// the simulated days, once per seed. Runs are spread over the cores, one
+// forked worker each. Every strategy sees the same room and door
+// disturbances for a given seed. Scores are taken on the true chamber
+// values against zone 0's default thresholds:
+//
+//   out%   time with temperature or humidity outside the band (T / H split)
+//   worst  furthest excursion beyond a limit
+//   starts relay off->on transitions per day (relay1/relay2/relay4/relay5)
+//   kWh/d  relay energy per day at the draws in ChamberParams
+//
+// usage: twin [--days N] [--seeds N] [--jobs N] [--tick ms] [--csv]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <map>
+
+#include "../main.cpp"
+#include "boot_runner.h"
+#include "chamber_model.h"
+
+HardwareSerial Serial;
+WiFiClass WiFi;
+EspClass ESP;
+
+namespace {
+
+const uint32_t REBOOT_MS = 1500;
+
+struct Strategy {
+  const char *name;
+  RelayControlConfig config;
+};
+
+const Strategy STRATEGIES[] = {
+    {"threshold", {RelayStrategy::Threshold, 0.0f, 0.0f, 1}},
+    // handleRelays() sees full-precision readings, so fractional bands act as
+    // given; band() caps them at half the span, so 1.5 is the widest humidity
+    // band on the default 80-83 %
+    {"hysteresis-1", {RelayStrategy::Hysteresis, 1.0f, 1.0f, 1}},
+    {"hysteresis-1.5", {RelayStrategy::Hysteresis, 1.5f, 1.5f, 1}},
+    {"timeprop-1min", {RelayStrategy::TimeProportional, 1.0f, 1.0f, 6}},
+    {"timeprop-5min", {RelayStrategy::TimeProportional, 1.0f, 1.0f, 30}},
+    {"timeprop-10min", {RelayStrategy::TimeProportional, 1.0f, 1.0f, 60}},
+};
+const size_t STRATEGY_COUNT = sizeof(STRATEGIES) / sizeof(STRATEGIES[0]);
+
+// Carried across reboots within one run
+struct TwinState {
+  Chamber chamber;
+  uint32_t reboots;
+};
+
+// Plant adapter: relay pins in, DHT values out
+class ChamberPlant : public replay::Plant {
+ public:
+  explicit ChamberPlant(Chamber &chamber) : chamber_(chamber) {}
+  void advanceTo(uint32_t ms) override {
+    const replay::Hal &hal = replay::Hal::get();
+    ChamberActuators a;
+    a.cooler = hal.read(RELAY1_PIN) != 0;
+    a.boost = hal.read(RELAY2_PIN) != 0;
+    a.humidifier = hal.read(RELAY4_PIN) != 0;
+    a.vent = hal.read(RELAY5_PIN) != 0;
+    chamber_.advanceTo(ms, a);
+  }
+  float readTemperature() override { return chamber_.readTemperature(); }
+  float readHumidity() override { return chamber_.readHumidity(); }
+
+ private:
+  Chamber &chamber_;
+};
+
+uint32_t runBoot(TwinState &state, uint32_t startMs, uint32_t endMs, uint32_t tickMs,
+                 const RelayControlConfig &config) {
+  static const std::vector<replay::TraceEvent> noEvents;
+  replay::Hal &hal = replay::Hal::get();
+  FILE *devNull = fopen("/dev/null", "w");
+  hal.setOutput(devNull ? devNull : stderr);
+  hal.setWaterPin(WATER_PIN);
+  hal.boot(&noEvents, startMs);
+  hal.labelPin(RELAY1_PIN, "relay1");
+  hal.labelPin(RELAY2_PIN, "relay2");
+  hal.labelPin(RELAY4_PIN, "relay4");
+  hal.labelPin(RELAY5_PIN, "relay5");
+  ChamberPlant plant(state.chamber);
+  hal.setPlant(&plant);
+  replay::seedProvisionedPreferences();
+  g_relayControl = config;
+  try {
+    setup();
+    while (static_cast<int32_t>(endMs - hal.now()) > 0) {
+      loop();
+      hal.advance(tickMs);
+    }
+    plant.advanceTo(endMs);
+  } catch (const replay::Reboot &) {
+    const uint32_t at = hal.now();
+    hal.resetOutputs("reset");
+    plant.advanceTo(at + REBOOT_MS);  // outputs stay off until the next setup()
+    state.reboots++;
+    return at ? at : 1;
+  }
+  return 0;
+}
+
+struct RunResult {
+  bool ok;
+  uint32_t reboots;
+  ChamberScore score;
+};
+
+RunResult runOne(const Strategy &s, uint64_t seed, uint32_t endMs, uint32_t tickMs) {
+  TwinState state;
+  const RelayLimits band = {DEFAULT_THRESHOLDS.tempMin, DEFAULT_THRESHOLDS.tempMax, DEFAULT_THRESHOLDS.humMin,
+                            DEFAULT_THRESHOLDS.humMax};
+  state.chamber.begin(ChamberParams(), band, seed, 25.0, 80.0);
+  state.reboots = 0;
+  RunResult r;
+  r.ok = replay::runBoots(state, endMs, REBOOT_MS, [&](TwinState &st, uint32_t bootMs) {
+    return runBoot(st, bootMs, endMs, tickMs, s.config);
+  });
+  r.reboots = state.reboots;
+  r.score = state.chamber.score();
+  return r;
+}
+
+struct Job {
+  size_t strategy;
+  uint64_t seed;
+  int fd;
+};
+
+struct Summary {
+  size_t runs;
+  uint32_t reboots;
+  ChamberScore sum;  // worst* hold the maximum, the rest the sum
+};
+
+void accumulate(Summary &s, const ChamberScore &c, uint32_t reboots) {
+  s.runs++;
+  s.reboots += reboots;
+  s.sum.seconds += c.seconds;
+  s.sum.outTempS += c.outTempS;
+  s.sum.outHumS += c.outHumS;
+  s.sum.outAnyS += c.outAnyS;
+  s.sum.worstTempC = c.worstTempC > s.sum.worstTempC ? c.worstTempC : s.sum.worstTempC;
+  s.sum.worstHumPct = c.worstHumPct > s.sum.worstHumPct ? c.worstHumPct : s.sum.worstHumPct;
+  for (int i = 0; i < CR_COUNT; ++i) {
+    s.sum.starts[i] += c.starts[i];
+    s.sum.energyWh[i] += c.energyWh[i];
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  uint32_t days = 3;
+  uint32_t seeds = 4;
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t tickMs = 5;
+  bool csv = false;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--days") && i + 1 < argc) {
+      days = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else if (!strcmp(argv[i], "--seeds") && i + 1 < argc) {
+      seeds = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else if (!strcmp(argv[i], "--jobs") && i + 1 < argc) {
+      jobs = strtol(argv[++i], nullptr, 10);
+    } else if (!strcmp(argv[i], "--tick") && i + 1 < argc) {
+      tickMs = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else if (!strcmp(argv[i], "--csv")) {
+      csv = true;
+    } else {
+      fprintf(stderr, "usage: %s [--days N] [--seeds N] [--jobs N] [--tick ms] [--csv]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (days == 0 || days > 45 || seeds == 0 || tickMs == 0) {
+    fprintf(stderr, "days must be 1..45 (32-bit millis), seeds and tick > 0\n");
+    return 2;
+  }
+  if (jobs < 1) {
+    jobs = 1;
+  }
+  const uint32_t endMs = days * 86400000UL;
+
+  std::vector<Job> pending;
+  for (uint32_t seed = 1; seed <= seeds; ++seed) {
+    for (size_t s = 0; s < STRATEGY_COUNT; ++s) {
+      pending.push_back(Job{s, seed, -1});
+    }
+  }
+  std::map<pid_t, Job> running;
+  std::vector<Summary> summaries(STRATEGY_COUNT, Summary());
+  size_t next = 0;
+  bool failed = false;
+  fflush(stdout);
+  while (next < pending.size() || !running.empty()) {
+    while (next < pending.size() && running.size() < static_cast<size_t>(jobs)) {
+      Job job = pending[next++];
+      int fds[2];
+      if (pipe(fds) != 0) {
+        perror("pipe");
+        return 1;
+      }
+      const pid_t pid = fork();
+      if (pid == 0) {
+        close(fds[0]);
+        const RunResult r = runOne(STRATEGIES[job.strategy], job.seed, endMs, tickMs);
+        const bool sent = write(fds[1], &r, sizeof(r)) == static_cast<ssize_t>(sizeof(r));
+        _exit(sent ? 0 : 1);
+      }
+      close(fds[1]);
+      job.fd = fds[0];
+      running[pid] = job;
+    }
+    int status = 0;
+    const pid_t done = wait(&status);
+    std::map<pid_t, Job>::iterator it = running.find(done);
+    if (it == running.end()) {
+      continue;
+    }
+    const Job job = it->second;
+    running.erase(it);
+    RunResult r;
+    const bool got = read(job.fd, &r, sizeof(r)) == static_cast<ssize_t>(sizeof(r));
+    close(job.fd);
+    if (!got || !r.ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "%s seed %llu failed\n", STRATEGIES[job.strategy].name,
+              static_cast<unsigned long long>(job.seed));
+      failed = true;
+      continue;
+    }
+    accumulate(summaries[job.strategy], r.score, r.reboots);
+  }
+
+  if (csv) {
+    printf("strategy,runs,out_pct,out_temp_pct,out_hum_pct,worst_temp_c,worst_hum_pct,"
+           "starts_relay1,starts_relay2,starts_relay4,starts_relay5,kwh_per_day,reboots\n");
+  } else {
+    printf("# %u day(s) x %u seed(s), band %.1f-%.1f C / %.1f-%.1f %%\n", days, seeds,
+           DEFAULT_THRESHOLDS.tempMin, DEFAULT_THRESHOLDS.tempMax, DEFAULT_THRESHOLDS.humMin,
+           DEFAULT_THRESHOLDS.humMax);
+    printf("%-16s %6s %6s %6s %6s %6s   %-23s %6s %4s\n", "strategy", "out%", "T%", "H%", "worstT", "worstH",
+           "starts/day r1/r2/r4/r5", "kWh/d", "rbt");
+  }
+  for (size_t s = 0; s < STRATEGY_COUNT; ++s) {
+    const Summary &sum = summaries[s];
+    if (sum.runs == 0) {
+      continue;
+    }
+    const ChamberScore &c = sum.sum;
+    const double simDays = c.seconds / 86400.0;
+    const double pct = 100.0 / c.seconds;
+    double perDay[CR_COUNT];
+    for (int i = 0; i < CR_COUNT; ++i) {
+      perDay[i] = c.starts[i] / simDays;
+    }
+    if (csv) {
+      printf("%s,%u,%.2f,%.2f,%.2f,%.2f,%.2f,%.1f,%.1f,%.1f,%.1f,%.3f,%u\n", STRATEGIES[s].name,
+             static_cast<unsigned>(sum.runs), c.outAnyS * pct, c.outTempS * pct, c.outHumS * pct, c.worstTempC,
+             c.worstHumPct, perDay[0], perDay[1], perDay[2], perDay[3], c.totalWh() / 1000.0 / simDays,
+             sum.reboots);
+    } else {
+      char starts[32];
+      snprintf(starts, sizeof(starts), "%.0f/%.0f/%.0f/%.0f", perDay[0], perDay[1], perDay[2], perDay[3]);
+      printf("%-16s %6.2f %6.2f %6.2f %6.2f %6.2f   %-23s %6.3f %4u\n", STRATEGIES[s].name, c.outAnyS * pct,
+             c.outTempS * pct, c.outHumS * pct, c.worstTempC, c.worstHumPct, starts,
+             c.totalWh() / 1000.0 / simDays, sum.reboots);
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+#pragma once
+// Remote commands over MQTT: requests on topic/<id>/cmd, responses on
+// topic/<id>/resp, matched by a request id the client picks.
+//
+// Pure logic (no Arduino headers). The MQTT callback only copies a request
+// into the inbox, since PubSubClient reuses its buffer for the next publish;
+// loop() runs it right after mqtt.loop(). The last few ids are kept with
+// the response they got, so a request retried after a lost response is
+// answered again instead of run twice.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+enum class RpcCommand : uint8_t { PublishNow, Relay, SetInterval, FetchThresholds, Reboot, Count };
+
+inline const char *rpcCommandName(RpcCommand cmd) {
+  static const char *const NAMES[] = {"publish_now", "relay", "set_interval", "fetch_thresholds", "reboot"};
+  return cmd < RpcCommand::Count ? NAMES[static_cast<size_t>(cmd)] : "unknown";
+}
+
+// Count for an unknown name
+inline RpcCommand rpcCommandFromName(const char *name) {
+  for (uint8_t i = 0; i < static_cast<uint8_t>(RpcCommand::Count); ++i) {
+    if (name && strcmp(name, rpcCommandName(static_cast<RpcCommand>(i))) == 0) {
+      return static_cast<RpcCommand>(i);
+    }
+  }
+  return RpcCommand::Count;
+}
+
+// Requests waiting for loop(), oldest first. Bodies are NUL-terminated.
+template <size_t N, size_t BodySize>
+class RpcInbox {
+ public:
+  struct Entry {
+    char body[BodySize];
+    uint32_t rxUs;  // arrival, for the response's latency
+  };
+
+  // False when full or the body does not fit; the request is dropped
+  bool push(const uint8_t *body, size_t len, uint32_t rxUs) {
+    if (count_ == N || len >= BodySize) {
+      return false;
+    }
+    Entry &e = entries_[(head_ + count_) % N];
+    memcpy(e.body, body, len);
+    e.body[len] = '\0';
+    e.rxUs = rxUs;
+    count_++;
+    return true;
+  }
+
+  bool pop(Entry &out) {
+    if (count_ == 0) {
+      return false;
+    }
+    out = entries_[head_];
+    head_ = (head_ + 1) % N;
+    count_--;
+    return true;
+  }
+
+  size_t size() const { return count_; }
+
+ private:
+  Entry entries_[N];
+  size_t head_ = 0;
+  size_t count_ = 0;
+};
+
+// Final responses of the last N request ids, oldest overwritten first
+template <size_t N, size_t IdSize, size_t ResponseSize>
+class RpcReplayCache {
+ public:
+  // The response an id already got, or nullptr
+  const char *find(const char *id) const {
+    for (size_t i = 0; i < N; ++i) {
+      if (slots_[i].id[0] != '\0' && strcmp(slots_[i].id, id) == 0) {
+        return slots_[i].response;
+      }
+    }
+    return nullptr;
+  }
+
+  // Ids or responses too long for a slot are not kept
+  void remember(const char *id, const char *response) {
+    if (strlen(id) >= IdSize || strlen(response) >= ResponseSize) {
+      return;
+    }
+    Slot &s = slots_[next_];
+    strcpy(s.id, id);
+    strcpy(s.response, response);
+    next_ = (next_ + 1) % N;
+  }
+
+ private:
+  struct Slot {
+    char id[IdSize];
+    char response[ResponseSize];
+  };
+  Slot slots_[N] = {};
+  size_t next_ = 0;
+};
+
+// Id of the last reboot request carried out. The firmware keeps it in RTC
+// memory, which survives the restart: a retained or redelivered reboot
+// request reaches every boot, and the in-RAM replay cache does not.
+template <size_t IdSize>
+struct RpcRebootMark {
+  uint32_t magic;
+  char id[IdSize];
+
+  static const uint32_t MAGIC = 0x4d4c5242;  // "MLRB"
+
+  // Garbage after a power cycle never matches
+  bool matches(const char *requestId) const {
+    return magic == MAGIC && memchr(id, '\0', IdSize) != nullptr && strcmp(id, requestId) == 0;
+  }
+  void set(const char *requestId) {
+    magic = MAGIC;
+    strncpy(id, requestId, IdSize - 1);
+    id[IdSize - 1] = '\0';
+  }
+};
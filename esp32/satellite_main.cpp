@@ -0,0 +1,191 @@
+// ESP-NOW satellite sensor node.
+//
+// No Wi-Fi association, TLS or MQTT: the node reads its DHT22 (and float
+// switch, where the board has one) every SAT_PERIOD_MS and sends one compact
+// frame to a gateway controller (main.cpp built with ESPNOW_GATEWAY=1), which
+// batches it into its own uplink. The gateway answers with an ack and, when
+// they change, the thresholds this node applies to its fan/humidifier pins.
+// Protocol logic lives in espnow_link.h; see there for the framing.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <Preferences.h>
+#include <DHT.h>
+
+#if !defined(MILLO_BOARD_CONTROLLER_V1) && !defined(MILLO_BOARD_BLE_KIT)
+#define MILLO_BOARD_BLE_KIT
+#endif
+#include "board_profile.h"
+#include "espnow_link.h"
+#include "espnow_radio.h"
+
+#define SAT_PERIOD_MS 10000
+static const uint32_t DISCOVERY_STEP_MS = 250;  // per channel while looking for the gateway
+static const uint8_t MAX_CHANNEL = 13;
+
+static DHT dht(board::DHT_PIN, DHT22);
+static EspNowRadio g_radio;
+static SatelliteLink<EspNowRadio> g_link(g_radio);
+static Preferences g_prefs;
+
+static uint8_t g_channel = 1;
+static uint32_t g_lastSendMs = 0;
+static bool g_fanOn = false;
+static bool g_humidifierOn = false;
+
+// ---------- Persistence ----------
+static void loadState() {
+  g_prefs.begin("satellite", true);
+  g_channel = g_prefs.getUChar("channel", 1);
+  const uint16_t version = g_prefs.getUShort("th_ver", 0);
+  SatThresholds t;
+  t.tempMinCenti = g_prefs.getShort("t_min", 2200);
+  t.tempMaxCenti = g_prefs.getShort("t_max", 2700);
+  t.humMinCenti = g_prefs.getShort("h_min", 8000);
+  t.humMaxCenti = g_prefs.getShort("h_max", 8300);
+  t.tempEnabled = g_prefs.getBool("t_en", true);
+  t.humEnabled = g_prefs.getBool("h_en", true);
+  g_prefs.end();
+  if (g_channel < 1 || g_channel > MAX_CHANNEL) {
+    g_channel = 1;
+  }
+  g_link.restoreThresholds(t, version);
+}
+
+static void saveThresholds() {
+  const SatThresholds &t = g_link.thresholds();
+  g_prefs.begin("satellite", false);
+  g_prefs.putUShort("th_ver", g_link.thresholdsVersion());
+  g_prefs.putShort("t_min", t.tempMinCenti);
+  g_prefs.putShort("t_max", t.tempMaxCenti);
+  g_prefs.putShort("h_min", t.humMinCenti);
+  g_prefs.putShort("h_max", t.humMaxCenti);
+  g_prefs.putBool("t_en", t.tempEnabled);
+  g_prefs.putBool("h_en", t.humEnabled);
+  g_prefs.end();
+}
+
+static void saveChannel() {
+  g_prefs.begin("satellite", false);
+  g_prefs.putUChar("channel", g_channel);
+  g_prefs.end();
+}
+
+// ---------- Outputs ----------
+// Fan on above max, off below min; humidifier on below min, off above max.
+static void applyThresholds(bool valid, int16_t tempCenti, uint16_t humCenti) {
+  const SatThresholds &t = g_link.thresholds();
+  if (!valid) {
+    return;  // hold outputs on a failed read
+  }
+  if (t.tempEnabled) {
+    if (tempCenti > t.tempMaxCenti) {
+      g_fanOn = true;
+    } else if (tempCenti < t.tempMinCenti) {
+      g_fanOn = false;
+    }
+  }
+  if (t.humEnabled) {
+    if (static_cast<int32_t>(humCenti) < t.humMinCenti) {
+      g_humidifierOn = true;
+    } else if (static_cast<int32_t>(humCenti) > t.humMaxCenti) {
+      g_humidifierOn = false;
+    }
+  }
+  digitalWrite(board::FAN1_PIN, g_fanOn ? HIGH : LOW);
+  digitalWrite(board::HUMIDIFIER1_PIN, g_humidifierOn ? HIGH : LOW);
+}
+
+static uint8_t readWater() {
+#if MILLO_WATER_ANALOG
+  return 0xFF;  // analog probe calibration lives in the BLE firmware; not reported
+#else
+  return digitalRead(board::WATER_PIN) == LOW ? 1 : 0;
+#endif
+}
+
+static void sendReading(uint32_t now) {
+  const float h = dht.readHumidity();
+  const float t = dht.readTemperature();
+  const bool valid = !isnan(h) && !isnan(t);
+  const int16_t tempCenti = valid ? static_cast<int16_t>(lroundf(t * 100.0f)) : 0;
+  const uint16_t humCenti = valid ? static_cast<uint16_t>(lroundf(h * 100.0f)) : 0;
+  if (!valid) {
+    Serial.println("DHT read failed; sending without climate");
+  }
+  applyThresholds(valid, tempCenti, humCenti);
+  g_link.send(tempCenti, humCenti, valid, readWater(), now);
+  g_lastSendMs = now;
+}
+
+static void nextChannel() {
+  g_channel = g_channel % MAX_CHANNEL + 1;
+  g_radio.setChannel(g_channel);
+}
+
+// ---------- Setup / Loop ----------
+void setup() {
+  Serial.begin(115200);
+  delay(50);
+
+  pinMode(board::FAN1_PIN, OUTPUT);
+  pinMode(board::HUMIDIFIER1_PIN, OUTPUT);
+#if !MILLO_WATER_ANALOG
+  pinMode(board::WATER_PIN, INPUT_PULLUP);
+#endif
+  dht.begin();
+  loadState();
+
+  WiFi.mode(WIFI_STA);
+  WiFi.disconnect();
+  if (!g_radio.begin()) {
+    Serial.println("ESP-NOW init failed; restarting");
+    delay(1000);
+    ESP.restart();
+  }
+  g_radio.setChannel(g_channel);
+  g_link.begin(static_cast<uint16_t>(esp_random()));
+  Serial.printf("Satellite %s on %s, starting at channel %u, thresholds v%u\n",
+                WiFi.macAddress().c_str(), board::NAME, g_channel, g_link.thresholdsVersion());
+  delay(2000);  // DHT22 needs ~2 s after power-up
+}
+
+void loop() {
+  const uint32_t now = millis();
+
+  g_radio.poll([](const uint8_t *mac, const uint8_t *data, size_t len) {
+    const bool hadGateway = g_link.haveGateway();
+    switch (g_link.onFrame(mac, data, len)) {
+      case SatelliteLink<EspNowRadio>::Event::ThresholdsUpdated:
+        Serial.printf("Thresholds v%u received\n", g_link.thresholdsVersion());
+        saveThresholds();
+        break;
+      case SatelliteLink<EspNowRadio>::Event::Acked:
+      default:
+        break;
+    }
+    if (!hadGateway && g_link.haveGateway()) {
+      Serial.printf("Gateway found on channel %u\n", g_channel);
+      saveChannel();
+    }
+  });
+
+  if (g_link.poll(now) == SatelliteLink<EspNowRadio>::Event::GatewayLost) {
+    Serial.println("Gateway lost; scanning channels");
+  }
+
+  if (!g_link.haveGateway()) {
+    // Discovery: one broadcast reading per channel until someone answers
+    if (!g_link.awaitingAck() && (now - g_lastSendMs) >= DISCOVERY_STEP_MS) {
+      if (g_lastSendMs != 0) {
+        nextChannel();  // the saved channel gets the first probe
+      }
+      sendReading(now);
+    }
+    return;
+  }
+
+  if ((now - g_lastSendMs) >= SAT_PERIOD_MS) {
+    sendReading(now);
+  }
+}
@@ -0,0 +1,164 @@
+#pragma once
+// Streaming sensor-health checks for climate sensors that fail slowly:
+// frozen values, spikes, out-of-range readings and drift away from the
+// zone's other sensors, usually long before a DHT22 starts returning NaN.
+//
+// Pure logic (no Arduino headers). The firmware runs check() on every
+// reading and crossCheck() once the zone has enough other sensors; both are
+// O(1) per reading. Readings check() rejects, and sensors that are not
+// usable(), stay out of fusion and control.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include "zones.h"
+
+enum SensorHealthFlag : uint8_t {
+  HEALTH_IMPLAUSIBLE = 0x01,  // last reading outside the part's range
+  HEALTH_STUCK = 0x02,        // both quantities frozen for a whole window
+  HEALTH_SPIKE = 0x04,        // last reading jumped faster than physics allows
+  HEALTH_DRIFT = 0x08,        // persistent offset from the zone's other sensors
+};
+
+// Flags that keep a sensor out of fusion (a spike only drops that reading)
+static const uint8_t HEALTH_EXCLUDE = HEALTH_IMPLAUSIBLE | HEALTH_STUCK | HEALTH_DRIFT;
+
+inline const char *healthFlagName(uint8_t flag) {
+  switch (flag) {
+    case HEALTH_IMPLAUSIBLE: return "implausible";
+    case HEALTH_STUCK: return "stuck";
+    case HEALTH_SPIKE: return "spike";
+    case HEALTH_DRIFT: return "drift";
+    default: return "unknown";
+  }
+}
+
+struct SensorHealthConfig {
+  float tempMinC, tempMaxC;        // plausible range
+  float humMinPct, humMaxPct;
+  float tempMaxPerMin;             // fastest believable change...
+  float humMaxPerMin;
+  float tempMinStep;               // ...but never stricter than this per reading
+  float humMinStep;
+  uint8_t spikeConfirm;            // out-of-rate readings in a row taken as a real step
+  uint32_t flatWindow;             // readings per flatline window
+  float tempFlatSd;                // stddev below this (both quantities) = stuck
+  float humFlatSd;
+  float tempDriftTol;              // smoothed offset from the others that counts as drift
+  float humDriftTol;
+  float driftAlpha;                // smoothing of that offset per reading
+};
+
+// Tuning for DHT22 / SHT3x parts read every readIntervalMs. Flatline needs
+// 30 min of bit-identical readings: a live DHT22 jitters by 0.1.
+inline SensorHealthConfig sensorHealthDefaults(uint32_t readIntervalMs) {
+  SensorHealthConfig c;
+  c.tempMinC = -40.0f;
+  c.tempMaxC = 80.0f;
+  c.humMinPct = 0.0f;
+  c.humMaxPct = 100.0f;
+  c.tempMaxPerMin = 3.0f;
+  c.humMaxPerMin = 15.0f;
+  c.tempMinStep = 2.0f;
+  c.humMinStep = 10.0f;
+  c.spikeConfirm = 3;
+  c.flatWindow = static_cast<uint32_t>(1800000 / (readIntervalMs ? readIntervalMs : 1));
+  c.tempFlatSd = 0.001f;
+  c.humFlatSd = 0.001f;
+  c.tempDriftTol = 1.0f;
+  c.humDriftTol = 3.0f;
+  c.driftAlpha = 0.02f;  // ~50 readings
+  return c;
+}
+
+class SensorHealth {
+ public:
+  // One new reading. Returns false when it must be dropped: out of range,
+  // or a spike not yet confirmed by spikeConfirm readings at the new level.
+  bool check(float t, float h, uint32_t nowMs, const SensorHealthConfig &c) {
+    if (t < c.tempMinC || t > c.tempMaxC || h < c.humMinPct || h > c.humMaxPct) {
+      flags_ |= HEALTH_IMPLAUSIBLE;
+      return false;
+    }
+    flags_ &= ~HEALTH_IMPLAUSIBLE;
+
+    if (haveLast_) {
+      const float minutes = static_cast<float>(nowMs - lastMs_) / 60000.0f;
+      const float tStep = fmaxf(c.tempMinStep, c.tempMaxPerMin * minutes);
+      const float hStep = fmaxf(c.humMinStep, c.humMaxPerMin * minutes);
+      if (fabsf(t - lastT_) > tStep || fabsf(h - lastH_) > hStep) {
+        if (++spikeRun_ < c.spikeConfirm) {
+          flags_ |= HEALTH_SPIKE;
+          spikes_++;
+          return false;
+        }
+        // Held the new level: a real step (door opened, heater on)
+      }
+    }
+    spikeRun_ = 0;
+    flags_ &= ~HEALTH_SPIKE;
+    haveLast_ = true;
+    lastT_ = t;
+    lastH_ = h;
+    lastMs_ = nowMs;
+
+    updateFlatline(t, h, c);
+    return true;
+  }
+
+  // Offset of an accepted reading from the median of the zone's other
+  // usable sensors (needs at least two others to know which one is off)
+  void crossCheck(float tResidual, float hResidual, const SensorHealthConfig &c) {
+    tDrift_ += c.driftAlpha * (tResidual - tDrift_);
+    hDrift_ += c.driftAlpha * (hResidual - hDrift_);
+    const bool beyond = fabsf(tDrift_) > c.tempDriftTol || fabsf(hDrift_) > c.humDriftTol;
+    const bool within = fabsf(tDrift_) <= 0.5f * c.tempDriftTol && fabsf(hDrift_) <= 0.5f * c.humDriftTol;
+    if (beyond) {
+      flags_ |= HEALTH_DRIFT;
+    } else if (within) {
+      flags_ &= ~HEALTH_DRIFT;
+    }
+  }
+
+  uint8_t flags() const { return flags_; }
+  bool usable() const { return (flags_ & HEALTH_EXCLUDE) == 0; }
+  uint32_t spikes() const { return spikes_; }
+  float tempDrift() const { return tDrift_; }
+  float humDrift() const { return hDrift_; }
+
+ private:
+  void updateFlatline(float t, float h, const SensorHealthConfig &c) {
+    if (flags_ & HEALTH_STUCK) {
+      // Any real movement ends it; no need to wait for a full window
+      if (fabsf(t - flatT_.mean()) > c.tempFlatSd * 4.0f || fabsf(h - flatH_.mean()) > c.humFlatSd * 4.0f) {
+        flags_ &= ~HEALTH_STUCK;
+        flatT_.reset();
+        flatH_.reset();
+      }
+      return;
+    }
+    flatT_.add(t);
+    flatH_.add(h);
+    if (flatT_.count() < c.flatWindow) {
+      return;
+    }
+    if (flatT_.stddev() < c.tempFlatSd && flatH_.stddev() < c.humFlatSd) {
+      flags_ |= HEALTH_STUCK;  // keep the frozen window's mean to detect recovery
+      return;
+    }
+    flatT_.reset();
+    flatH_.reset();
+  }
+
+  WindowStats flatT_;
+  WindowStats flatH_;
+  float lastT_ = 0.0f;
+  float lastH_ = 0.0f;
+  uint32_t lastMs_ = 0;
+  bool haveLast_ = false;
+  uint8_t spikeRun_ = 0;
+  uint8_t flags_ = 0;
+  uint32_t spikes_ = 0;
+  float tDrift_ = 0.0f;
+  float hDrift_ = 0.0f;
+};
@@ -0,0 +1,161 @@
+#pragma once
+// Simulated ESP-NOW medium for running espnow_link.h on the host.
+//
+// Ports are radios with a MAC and a channel; a frame reaches every port on
+// the sender's channel whose MAC matches (or all of them for broadcast).
+// Time is virtual (setNow()); loss, duplication and per-frame delay (which
+// reorders frames) come from a seeded PRNG so runs are reproducible.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+class SimEspNow {
+ public:
+  static const size_t MAX_PORTS = 8;
+  static const size_t MAX_FRAMES = 64;
+  static const size_t MAX_LEN = 250;  // ESP_NOW_MAX_DATA_LEN
+
+  class Port {
+   public:
+    bool send(const uint8_t mac[6], const uint8_t *data, size_t len) {
+      return sim_->enqueue(*this, mac, data, len);
+    }
+    uint8_t mac[6];
+    uint8_t channel;
+
+   private:
+    friend class SimEspNow;
+    SimEspNow *sim_;
+  };
+
+  Port *addPort(const uint8_t mac[6], uint8_t channel) {
+    if (portCount_ == MAX_PORTS) {
+      return nullptr;
+    }
+    Port &p = ports_[portCount_++];
+    memcpy(p.mac, mac, 6);
+    p.channel = channel;
+    p.sim_ = this;
+    return &p;
+  }
+
+  void setLossPct(uint8_t pct) { lossPct_ = pct; }
+  void setDuplicatePct(uint8_t pct) { duplicatePct_ = pct; }
+  void setDelayMs(uint32_t minMs, uint32_t maxMs) {
+    minDelayMs_ = minMs;
+    maxDelayMs_ = maxMs;
+  }
+  void seed(uint32_t s) { rng_ = s ? s : 1; }
+  void setNow(uint32_t nowMs) { nowMs_ = nowMs; }
+
+  // Deliver every frame due by now:
+  //   fn(Port &to, const uint8_t fromMac[6], const uint8_t *data, size_t len)
+  // Frames sent from inside fn are queued for a later deliver().
+  template <class Fn>
+  size_t deliver(Fn fn) {
+    size_t delivered = 0;
+    const size_t pending = frameCount_;
+    for (size_t i = 0; i < pending; ++i) {
+      Frame &f = frames_[i];
+      if (!f.live || static_cast<int32_t>(nowMs_ - f.dueMs) < 0) {
+        continue;
+      }
+      f.live = false;
+      for (size_t p = 0; p < portCount_; ++p) {
+        Port &to = ports_[p];
+        if (to.channel != f.channel || memcmp(to.mac, f.from, 6) == 0) {
+          continue;
+        }
+        if (f.broadcast || memcmp(to.mac, f.to, 6) == 0) {
+          fn(to, f.from, f.data, f.len);
+          delivered++;
+        }
+      }
+    }
+    compact();
+    return delivered;
+  }
+
+  uint32_t sent() const { return sent_; }
+  uint32_t lost() const { return lost_; }
+  uint32_t duplicated() const { return duplicated_; }
+
+ private:
+  struct Frame {
+    bool live;
+    bool broadcast;
+    uint8_t channel;
+    uint8_t from[6];
+    uint8_t to[6];
+    uint8_t data[MAX_LEN];
+    size_t len;
+    uint32_t dueMs;
+  };
+
+  uint32_t random() {
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 17;
+    rng_ ^= rng_ << 5;
+    return rng_;
+  }
+
+  bool enqueue(const Port &from, const uint8_t mac[6], const uint8_t *data, size_t len) {
+    if (len > MAX_LEN) {
+      return false;
+    }
+    sent_++;
+    if (random() % 100 < lossPct_) {
+      lost_++;
+      return true;  // esp_now_send() succeeds; the frame just never arrives
+    }
+    const int copies = (random() % 100 < duplicatePct_) ? 2 : 1;
+    duplicated_ += copies - 1;
+    for (int c = 0; c < copies; ++c) {
+      if (frameCount_ == MAX_FRAMES) {
+        return false;
+      }
+      Frame &f = frames_[frameCount_++];
+      f.live = true;
+      f.channel = from.channel;
+      memcpy(f.from, from.mac, 6);
+      memcpy(f.to, mac, 6);
+      f.broadcast = true;
+      for (int b = 0; b < 6; ++b) {
+        f.broadcast = f.broadcast && mac[b] == 0xFF;
+      }
+      memcpy(f.data, data, len);
+      f.len = len;
+      const uint32_t span = maxDelayMs_ - minDelayMs_;
+      f.dueMs = nowMs_ + minDelayMs_ + (span ? random() % (span + 1) : 0);
+    }
+    return true;
+  }
+
+  void compact() {
+    size_t out = 0;
+    for (size_t i = 0; i < frameCount_; ++i) {
+      if (frames_[i].live) {
+        if (out != i) {
+          frames_[out] = frames_[i];
+        }
+        out++;
+      }
+    }
+    frameCount_ = out;
+  }
+
+  Port ports_[MAX_PORTS];
+  size_t portCount_ = 0;
+  Frame frames_[MAX_FRAMES];
+  size_t frameCount_ = 0;
+  uint32_t nowMs_ = 0;
+  uint32_t rng_ = 1;
+  uint8_t lossPct_ = 0;
+  uint8_t duplicatePct_ = 0;
+  uint32_t minDelayMs_ = 0;
+  uint32_t maxDelayMs_ = 0;
+  uint32_t sent_ = 0;
+  uint32_t lost_ = 0;
+  uint32_t duplicated_ = 0;
+};
@@ -0,0 +1,171 @@
+#pragma once
+// Simulated I2C bus with SHT3x / SHT4x / SCD4x models for running the
+// i2c_sensors.h drivers on the host.
+//
+// Time is virtual (setNow()); reads before a conversion has finished NACK
+// like the real parts do. Faults can be injected per device to exercise the
+// drivers' error paths.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "i2c_sensors.h"
+
+class SimI2cBus {
+ public:
+  enum class Kind : uint8_t { Sht3x, Sht4x, Scd4x };
+
+  struct Device {
+    uint8_t addr;
+    Kind kind;
+    float temperatureC;
+    float humidityPct;
+    uint16_t co2Ppm;
+    bool nack;              // device absent / hung
+    uint8_t corruptReads;   // flip a CRC on the next N reads
+    // model state
+    uint8_t response[9];
+    size_t responseLen;
+    uint32_t readyAtMs;
+    bool periodic;
+    uint32_t nextSampleMs;
+    bool sampleReady;
+  };
+
+  static const size_t MAX_DEVICES = 4;
+  static const uint32_t SCD4X_PERIOD_MS = 5000;
+
+  Device *add(uint8_t addr, Kind kind) {
+    if (count_ == MAX_DEVICES) {
+      return nullptr;
+    }
+    Device &d = devices_[count_++];
+    memset(&d, 0, sizeof(d));
+    d.addr = addr;
+    d.kind = kind;
+    d.temperatureC = 22.0f;
+    d.humidityPct = 85.0f;
+    d.co2Ppm = 800;
+    return &d;
+  }
+
+  void setNow(uint32_t nowMs) {
+    nowMs_ = nowMs;
+    for (size_t i = 0; i < count_; ++i) {
+      Device &d = devices_[i];
+      if (d.periodic && static_cast<int32_t>(nowMs_ - d.nextSampleMs) >= 0) {
+        d.sampleReady = true;
+        d.nextSampleMs += SCD4X_PERIOD_MS;
+      }
+    }
+  }
+
+  bool write(uint8_t addr, const uint8_t *data, size_t len) {
+    writes_++;
+    Device *d = find(addr);
+    if (d == nullptr || d->nack || len == 0) {
+      return false;
+    }
+    const uint16_t cmd = len >= 2 ? static_cast<uint16_t>((data[0] << 8) | data[1]) : data[0];
+    d->responseLen = 0;
+    switch (d->kind) {
+      case Kind::Sht3x:
+        if (cmd == 0x2400) {
+          loadClimate(*d, 16, false);
+        }
+        return true;
+      case Kind::Sht4x:
+        if (cmd == 0xFD) {
+          loadClimate(*d, 9, true);
+        }
+        return true;
+      case Kind::Scd4x:
+        return scd4xCommand(*d, cmd);
+    }
+    return false;
+  }
+
+  bool read(uint8_t addr, uint8_t *data, size_t len) {
+    reads_++;
+    Device *d = find(addr);
+    if (d == nullptr || d->nack || d->responseLen < len ||
+        static_cast<int32_t>(nowMs_ - d->readyAtMs) < 0) {
+      return false;
+    }
+    memcpy(data, d->response, len);
+    if (d->corruptReads > 0) {
+      d->corruptReads--;
+      data[2] ^= 0x01;
+    }
+    d->responseLen = 0;
+    return true;
+  }
+
+  uint32_t writes() const { return writes_; }
+  uint32_t reads() const { return reads_; }
+
+ private:
+  Device *find(uint8_t addr) {
+    for (size_t i = 0; i < count_; ++i) {
+      if (devices_[i].addr == addr) {
+        return &devices_[i];
+      }
+    }
+    return nullptr;
+  }
+
+  static uint16_t rawTemperature(float c) { return clampRaw((c + 45.0f) * 65535.0f / 175.0f); }
+
+  static uint16_t clampRaw(float v) {
+    return static_cast<uint16_t>(v < 0.0f ? 0.0f : (v > 65535.0f ? 65535.0f : v + 0.5f));
+  }
+
+  static void putWord(uint8_t *out, uint16_t w) {
+    out[0] = static_cast<uint8_t>(w >> 8);
+    out[1] = static_cast<uint8_t>(w & 0xFF);
+    out[2] = sensirionCrc(out, 2);
+  }
+
+  void loadClimate(Device &d, uint32_t conversionMs, bool sht4xScale) {
+    const uint16_t rh = sht4xScale ? clampRaw((d.humidityPct + 6.0f) * 65535.0f / 125.0f)
+                                   : clampRaw(d.humidityPct * 65535.0f / 100.0f);
+    putWord(&d.response[0], rawTemperature(d.temperatureC));
+    putWord(&d.response[3], rh);
+    d.responseLen = 6;
+    d.readyAtMs = nowMs_ + conversionMs;
+  }
+
+  bool scd4xCommand(Device &d, uint16_t cmd) {
+    switch (cmd) {
+      case 0x3F86:  // stop_periodic_measurement
+        d.periodic = false;
+        d.sampleReady = false;
+        return true;
+      case 0x21B1:  // start_periodic_measurement
+        d.periodic = true;
+        d.nextSampleMs = nowMs_ + SCD4X_PERIOD_MS;
+        return true;
+      case 0xE4B8:  // get_data_ready_status
+        putWord(&d.response[0], d.sampleReady ? 0x8006 : 0x8000);
+        d.responseLen = 3;
+        d.readyAtMs = nowMs_ + 1;
+        return true;
+      case 0xEC05:  // read_measurement
+        putWord(&d.response[0], d.co2Ppm);
+        putWord(&d.response[3], rawTemperature(d.temperatureC));
+        putWord(&d.response[6], clampRaw(d.humidityPct * 65535.0f / 100.0f));
+        d.responseLen = 9;
+        d.readyAtMs = nowMs_ + 1;
+        d.sampleReady = false;
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  Device devices_[MAX_DEVICES] = {};
+  size_t count_ = 0;
+  uint32_t nowMs_ = 0;
+  uint32_t writes_ = 0;
+  uint32_t reads_ = 0;
+};
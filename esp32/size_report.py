@@ -0,0 +1,36 @@
+# PlatformIO post-build hook: flash/RAM footprint of the env's firmware,
+# checked against the OTA app slot (custom_ota_slot_bytes in platformio.ini).
+Import("env")
+
+import subprocess
+
+FLASH_SECTIONS = (".flash.text", ".flash.rodata", ".iram0.vectors", ".iram0.text",
+                  ".dram0.data", ".rtc.text", ".rtc.data")
+RAM_SECTIONS = (".dram0.data", ".dram0.bss", ".noinit")
+
+
+def section_sizes(elf):
+    out = subprocess.check_output([env.subst("$SIZETOOL"), "-A", elf]).decode()
+    sizes = {}
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[0].startswith(".") and parts[1].isdigit():
+            sizes[parts[0]] = int(parts[1])
+    return sizes
+
+
+def report(source, target, env):
+    sizes = section_sizes(str(target[0]))
+    flash = sum(sizes.get(s, 0) for s in FLASH_SECTIONS)
+    ram = sum(sizes.get(s, 0) for s in RAM_SECTIONS)
+    slot = int(env.GetProjectOption("custom_ota_slot_bytes", "0"))
+    print("Size [%s]: flash %d B, static RAM %d B (IRAM %d B)"
+          % (env["PIOENV"], flash, ram, sizes.get(".iram0.text", 0)))
+    if slot:
+        print("Size [%s]: %.1f%% of %d B OTA slot, %d B headroom"
+              % (env["PIOENV"], 100.0 * flash / slot, slot, slot - flash))
+        if flash > slot:
+            print("Size [%s]: WARNING image does not fit the OTA slot" % env["PIOENV"])
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", report)
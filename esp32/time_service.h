@@ -0,0 +1,77 @@
+#pragma once
+// Background SNTP time for both firmwares.
+//
+// lwIP SNTP runs in the tcpip task and calls back on every successful poll;
+// each callback becomes an EpochClock sync point against millis(). Nothing
+// in loop() ever waits on the network for time. Samples are stamped with
+// millis() when acquired and resolved through epochMs()/epoch() when sent.
+
+#include <Arduino.h>
+#include <esp_sntp.h>
+#include <sys/time.h>
+#include "epoch_clock.h"
+
+class TimeService {
+ public:
+  static const uint32_t SYNC_INTERVAL_MS = 15UL * 60UL * 1000UL;
+
+  // Safe to call again after a reconnect; SNTP is restarted with the servers.
+  void begin(const char *server1, const char *server2 = nullptr) {
+    instance() = this;
+    sntp_set_time_sync_notification_cb(&TimeService::onSntpSync);
+    sntp_set_sync_interval(SYNC_INTERVAL_MS);
+    configTime(0, 0, server1, server2);
+    started_ = true;
+  }
+
+  bool started() const { return started_; }
+
+  bool synced() {
+    portENTER_CRITICAL(&mux_);
+    const bool s = clock_.synced();
+    portEXIT_CRITICAL(&mux_);
+    return s;
+  }
+
+  // Epoch for a millis() stamp, 0 while unsynced
+  uint64_t epochMs(uint32_t monoMs) {
+    portENTER_CRITICAL(&mux_);
+    const uint64_t ms = clock_.toEpochMs(monoMs);
+    portEXIT_CRITICAL(&mux_);
+    return ms;
+  }
+
+  uint32_t epoch(uint32_t monoMs) { return static_cast<uint32_t>(epochMs(monoMs) / 1000); }
+  uint32_t now() { return epoch(millis()); }
+
+  void printStatus() {
+    portENTER_CRITICAL(&mux_);
+    const EpochClock c = clock_;
+    portEXIT_CRITICAL(&mux_);
+    Serial.printf("Time: synced=%s syncs=%u drift=%dppm last_correction=%dms\n",
+                  c.synced() ? "yes" : "no", c.syncCount(), c.driftPpm(), c.lastCorrectionMs());
+  }
+
+ private:
+  static void onSntpSync(struct timeval *tv) {
+    TimeService *self = instance();
+    if (self == nullptr || tv == nullptr) {
+      return;
+    }
+    const uint32_t mono = millis();
+    const uint64_t epochMs = static_cast<uint64_t>(tv->tv_sec) * 1000ULL + tv->tv_usec / 1000;
+    portENTER_CRITICAL(&self->mux_);
+    self->clock_.onSync(mono, epochMs);
+    portEXIT_CRITICAL(&self->mux_);
+  }
+
+  // Function-local static keeps this header-only (the SNTP callback has no arg)
+  static TimeService *&instance() {
+    static TimeService *self = nullptr;
+    return self;
+  }
+
+  EpochClock clock_;
+  bool started_ = false;
+  portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+};
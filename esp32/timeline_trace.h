@@ -0,0 +1,74 @@
+#pragma once
+// Timeline trace: a fixed RAM ring of 16-byte binary events showing how
+// loop() stages, callbacks and interrupts overlap on a device.
+//
+// Pure logic (no Arduino headers). The firmware timestamps events and
+// serialises push(); this file keeps the ring and defines the dump layout
+// that timeline_to_chrome.py turns into Chrome trace / Perfetto JSON:
+//
+//   TimelineDumpHeader
+//   nameCount NUL-terminated point names (index = TimelineEvent::id)
+//   contextCount NUL-terminated context names (index = TimelineEvent::context)
+//   count TimelineEvent, oldest first
+//
+// All fields are little-endian, as on the ESP32.
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum class TimelineKind : uint8_t { Span, Instant };
+
+struct TimelineEvent {
+  uint32_t startUs;  // low 32 bits of the microsecond clock (wraps every ~71 min)
+  uint32_t durUs;    // 0 for instants
+  uint32_t arg;      // point-specific value (HTTP status, level, length...)
+  uint16_t id;
+  uint8_t kind;      // TimelineKind
+  uint8_t context;   // task or interrupt that recorded it
+};
+static_assert(sizeof(TimelineEvent) == 16, "dump layout");
+
+struct TimelineDumpHeader {
+  char magic[4];  // "MLTL"
+  uint8_t version;
+  uint8_t eventSize;
+  uint8_t nameCount;
+  uint8_t contextCount;
+  uint32_t count;
+  uint32_t dropped;  // events lost while a dump was being sent
+  uint64_t nowUs;    // full clock when the dump started, to unwrap startUs
+};
+static_assert(sizeof(TimelineDumpHeader) == 24, "dump layout");
+
+static const uint8_t TIMELINE_DUMP_VERSION = 1;
+
+template <size_t N>
+class TimelineRing {
+ public:
+  void push(const TimelineEvent &e) {
+    if (paused_) {
+      dropped_++;
+      return;
+    }
+    ring_[next_] = e;
+    next_ = (next_ + 1) % N;
+    if (count_ < N) {
+      count_++;
+    }
+  }
+
+  // Writers drop their events while a reader walks the ring
+  void pause() { paused_ = true; }
+  void resume() { paused_ = false; }
+
+  size_t count() const { return count_; }
+  const TimelineEvent &at(size_t i) const { return ring_[(next_ + N - count_ + i) % N]; }  // oldest first
+  uint32_t dropped() const { return dropped_; }
+
+ private:
+  TimelineEvent ring_[N] = {};
+  size_t next_ = 0;
+  size_t count_ = 0;
+  volatile bool paused_ = false;
+  uint32_t dropped_ = 0;
+};
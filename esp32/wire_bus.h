@@ -0,0 +1,35 @@
+#pragma once
+// Adapts Arduino Wire to the Bus interface used by i2c_sensors.h.
+// Each call is one bounded I2C transaction (~0.2 ms for 6 bytes at 400 kHz).
+
+#include <Arduino.h>
+#include <Wire.h>
+
+class WireBus {
+ public:
+  explicit WireBus(TwoWire &wire = Wire) : wire_(wire) {}
+
+  void begin(uint8_t sda, uint8_t scl, uint32_t hz = 400000) {
+    wire_.begin(sda, scl, hz);
+    wire_.setTimeOut(10);  // ms; a stuck bus fails the transaction instead of the loop
+  }
+
+  bool write(uint8_t addr, const uint8_t *data, size_t len) {
+    wire_.beginTransmission(addr);
+    wire_.write(data, len);
+    return wire_.endTransmission() == 0;
+  }
+
+  bool read(uint8_t addr, uint8_t *data, size_t len) {
+    if (wire_.requestFrom(addr, static_cast<uint8_t>(len)) != len) {
+      return false;
+    }
+    for (size_t i = 0; i < len; ++i) {
+      data[i] = static_cast<uint8_t>(wire_.read());
+    }
+    return true;
+  }
+
+ private:
+  TwoWire &wire_;
+};
@@ -0,0 +1,241 @@
+#pragma once
+// Multi-sensor zones: staggered sampling and per-zone value fusion.
+//
+// Pure logic (no Arduino headers). The firmware owns the sensors and the
+// zone table; this file decides which sensor to read next, how often to
+// run the control cycle (faster near thresholds), turns the latest readings
+// of a zone's sensors into one value per quantity and summarises those
+// values over each publish window.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+
+// Round-robin scheduler that spreads reads of N sensors evenly over a
+// period, never reads a sensor faster than its own minimum interval and
+// never starts two reads closer than spacingMs (so one slow or blocking
+// sensor cannot starve the loop in a burst).
+template <size_t N>
+class SampleScheduler {
+ public:
+  void begin(uint32_t nowMs, uint32_t periodMs, uint32_t spacingMs) {
+    periodMs_ = periodMs;
+    spacingMs_ = spacingMs;
+    lastStartMs_ = nowMs - spacingMs;
+    for (size_t i = 0; i < N; ++i) {
+      // Stagger first reads across the period
+      dueMs_[i] = nowMs + static_cast<uint32_t>(periodMs * i / N);
+      if (minIntervalMs_[i] == 0) {
+        minIntervalMs_[i] = periodMs;
+      }
+    }
+  }
+
+  void setMinInterval(size_t sensor, uint32_t ms) { minIntervalMs_[sensor] = ms; }
+
+  // Sensor to start now, or -1. Among due sensors the most overdue wins;
+  // ties go round-robin from the last one started.
+  int next(uint32_t nowMs) const {
+    if (static_cast<int32_t>(nowMs - lastStartMs_) < static_cast<int32_t>(spacingMs_)) {
+      return -1;
+    }
+    int best = -1;
+    int32_t bestLate = -1;
+    for (size_t k = 1; k <= N; ++k) {
+      const size_t i = (last_ + k) % N;
+      const int32_t late = static_cast<int32_t>(nowMs - dueMs_[i]);
+      if (late >= 0 && late > bestLate) {
+        best = static_cast<int>(i);
+        bestLate = late;
+      }
+    }
+    return best;
+  }
+
+  // Record that sensor i was started at nowMs
+  void started(size_t i, uint32_t nowMs) {
+    last_ = i;
+    lastStartMs_ = nowMs;
+    const uint32_t interval = std::max(periodMs_, minIntervalMs_[i]);
+    dueMs_[i] += interval;
+    if (static_cast<int32_t>(nowMs - dueMs_[i]) >= 0) {
+      dueMs_[i] = nowMs + interval;  // fell a whole period behind; don't burst to catch up
+    }
+  }
+
+ private:
+  uint32_t dueMs_[N] = {};
+  uint32_t minIntervalMs_[N] = {};
+  uint32_t periodMs_ = 0;
+  uint32_t spacingMs_ = 0;
+  uint32_t lastStartMs_ = 0;
+  size_t last_ = N - 1;
+};
+
+// Rate of change over a window of at least windowMs. Rates over shorter
+// spans are mostly sensor noise (a DHT22 jitters by a few tenths), so the
+// rate only updates once the window has passed.
+class RateTracker {
+ public:
+  explicit RateTracker(uint32_t windowMs = 30000) : windowMs_(windowMs) {}
+
+  void add(float value, uint32_t nowMs) {
+    if (!anchored_) {
+      anchorValue_ = value;
+      anchorMs_ = nowMs;
+      anchored_ = true;
+      return;
+    }
+    const uint32_t elapsed = nowMs - anchorMs_;
+    if (elapsed >= windowMs_) {
+      perMinute_ = (value - anchorValue_) * 60000.0f / static_cast<float>(elapsed);
+      anchorValue_ = value;
+      anchorMs_ = nowMs;
+    }
+  }
+
+  // Forget the anchor (e.g. after the zone had no valid reading)
+  void reset() {
+    anchored_ = false;
+    perMinute_ = 0.0f;
+  }
+
+  float perMinute() const { return perMinute_; }
+
+ private:
+  uint32_t windowMs_;
+  uint32_t anchorMs_ = 0;
+  float anchorValue_ = 0.0f;
+  float perMinute_ = 0.0f;
+  bool anchored_ = false;
+};
+
+// How urgently a quantity needs fresh readings: 0 when it is still and
+// mid-band, rising linearly to 1 as it comes within nearMargin of an
+// enabled limit (1 past it) or as its rate approaches fastPerMin.
+inline float samplingUrgency(float value, float perMinute, float lo, float hi, bool limits, float nearMargin,
+                             float fastPerMin) {
+  float urgency = std::min(1.0f, fabsf(perMinute) / fastPerMin);
+  if (limits) {
+    const float distance = std::min(value - lo, hi - value);  // negative outside the band
+    urgency = std::max(urgency, 1.0f - std::max(0.0f, std::min(1.0f, distance / nearMargin)));
+  }
+  return urgency;
+}
+
+// Sampling period between fastMs and slowMs from the zones' urgency. The
+// period shortens at once and lengthens by at most half per cycle, so a
+// value wandering near a limit does not flip between the two bounds.
+class AdaptivePeriod {
+ public:
+  void begin(uint32_t fastMs, uint32_t slowMs, uint32_t startMs) {
+    fastMs_ = fastMs;
+    slowMs_ = std::max(fastMs, slowMs);
+    periodMs_ = std::min(slowMs_, std::max(fastMs_, startMs));
+  }
+
+  uint32_t update(float urgency) {
+    urgency = std::max(0.0f, std::min(1.0f, urgency));
+    const uint32_t target = slowMs_ - static_cast<uint32_t>((slowMs_ - fastMs_) * urgency + 0.5f);
+    periodMs_ = target < periodMs_ ? target : std::min(target, periodMs_ + periodMs_ / 2);
+    return periodMs_;
+  }
+
+  // Urgency that maps to periodMs (to hold a zone at a fixed cadence)
+  float urgencyFor(uint32_t periodMs) const {
+    if (slowMs_ == fastMs_) {
+      return 0.0f;
+    }
+    const uint32_t p = std::min(slowMs_, std::max(fastMs_, periodMs));
+    return static_cast<float>(slowMs_ - p) / static_cast<float>(slowMs_ - fastMs_);
+  }
+
+  uint32_t periodMs() const { return periodMs_; }
+  uint32_t fastMs() const { return fastMs_; }
+  uint32_t slowMs() const { return slowMs_; }
+
+ private:
+  uint32_t fastMs_ = 10000;
+  uint32_t slowMs_ = 10000;
+  uint32_t periodMs_ = 10000;
+};
+
+// Streaming min/max/mean/stddev of one quantity over a window, O(1) per
+// value (Welford's update, so no sum of squares loses precision in float).
+class WindowStats {
+ public:
+  void add(float x) {
+    if (count_ == 0) {
+      min_ = max_ = x;
+    } else {
+      min_ = std::min(min_, x);
+      max_ = std::max(max_, x);
+    }
+    count_++;
+    const float delta = x - mean_;
+    mean_ += delta / static_cast<float>(count_);
+    m2_ += delta * (x - mean_);
+  }
+
+  void reset() { *this = WindowStats(); }
+
+  uint32_t count() const { return count_; }
+  float minValue() const { return min_; }
+  float maxValue() const { return max_; }
+  float mean() const { return mean_; }
+  // Sample standard deviation; 0 with fewer than two values
+  float stddev() const { return count_ > 1 ? sqrtf(m2_ / static_cast<float>(count_ - 1)) : 0.0f; }
+
+ private:
+  uint32_t count_ = 0;
+  float min_ = 0.0f;
+  float max_ = 0.0f;
+  float mean_ = 0.0f;
+  float m2_ = 0.0f;
+};
+
+struct FusedValue {
+  float value;
+  uint8_t used;      // readings that agreed
+  uint8_t rejected;  // outliers dropped
+  bool valid;
+};
+
+// Median of the inliers. A reading is an outlier when it is further than
+// max(minSpread, 3 * MAD) from the median of all readings; with one or two
+// readings nothing is rejected (there is no majority to trust).
+inline FusedValue fuseMedian(const float *values, size_t n, float minSpread) {
+  FusedValue out = {0.0f, 0, 0, false};
+  float tmp[16];
+  n = std::min(n, sizeof(tmp) / sizeof(tmp[0]));
+  if (n == 0) {
+    return out;
+  }
+  std::copy(values, values + n, tmp);
+  std::sort(tmp, tmp + n);
+  const float median = (n % 2) ? tmp[n / 2] : 0.5f * (tmp[n / 2 - 1] + tmp[n / 2]);
+
+  float limit = INFINITY;
+  if (n >= 3) {
+    float dev[16];
+    for (size_t i = 0; i < n; ++i) {
+      dev[i] = fabsf(tmp[i] - median);
+    }
+    std::sort(dev, dev + n);
+    const float mad = (n % 2) ? dev[n / 2] : 0.5f * (dev[n / 2 - 1] + dev[n / 2]);
+    limit = std::max(minSpread, 3.0f * mad);
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (fabsf(tmp[i] - median) <= limit) {
+      tmp[kept++] = tmp[i];  // stays sorted
+    }
+  }
+  out.used = static_cast<uint8_t>(kept);
+  out.rejected = static_cast<uint8_t>(n - kept);
+  out.value = (kept % 2) ? tmp[kept / 2] : 0.5f * (tmp[kept / 2 - 1] + tmp[kept / 2]);
+  out.valid = true;
+  return out;
+}
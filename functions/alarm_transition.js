@@ -0,0 +1,62 @@
+/**
+ * Alarm transitions published by the controller firmware on topic/<id>/alarm
+ * (esp32/alarm_engine.h), and the issues index.js notifies for them.
+ */
+
+/**
+ * Parse a transition from the controller's alarm engine (esp32/alarm_engine.h):
+ * {"ev":"raise"|"clear","type":"hum_low","zone":0,"value":77.4,"limit":80,"active":1,"ts":...}
+ * "active" is how many alarms are still raised on the device after this one.
+ */
+function parseAlarmTransition(payload) {
+  try {
+    const event = JSON.parse(payload);
+    if ((event.ev !== 'raise' && event.ev !== 'clear') || typeof event.type !== 'string') {
+      throw new Error(`Invalid transition: ${payload}`);
+    }
+    return event;
+  } catch (error) {
+    console.error('❌ Error parsing alarm transition:', error);
+    return null;
+  }
+}
+
+const TRANSITION_MESSAGES = {
+  temp_high: (e) => `Temperature high (${e.value.toFixed(1)}°C > ${e.limit}°C)`,
+  temp_low: (e) => `Temperature low (${e.value.toFixed(1)}°C < ${e.limit}°C)`,
+  hum_high: (e) => `Humidity too high (${e.value.toFixed(1)}% > ${e.limit}%)`,
+  hum_low: (e) => `Humidity too low (${e.value.toFixed(1)}% < ${e.limit}%)`,
+  sensor_failure: () => 'Climate sensor not responding',
+  water_low: () => 'Water tank empty',
+};
+
+// Device alarm type -> the sensor name the app matches on
+// (lib/shared/services/fcm_service.dart) and checkThresholds() uses
+const TRANSITION_SENSORS = {
+  temp_high: 'temperature',
+  temp_low: 'temperature',
+  hum_high: 'humidity',
+  hum_low: 'humidity',
+  sensor_failure: 'sensor',
+  water_low: 'water',
+};
+
+/**
+ * Turn a raise transition into the same issue shape checkThresholds() returns
+ */
+function issueFromTransition(event) {
+  const describe = TRANSITION_MESSAGES[event.type];
+  const zone = event.zone ? ` (zone ${event.zone})` : '';
+  return {
+    sensor: TRANSITION_SENSORS[event.type] || 'sensor',
+    value: event.value ?? null,
+    threshold: event.limit ?? null,
+    message: (describe ? describe(event) : `Alarm ${event.type}`) + zone,
+  };
+}
+
+module.exports = {
+  TRANSITION_SENSORS,
+  parseAlarmTransition,
+  issueFromTransition,
+};
@@ -3,12 +3,17 @@
  * 
  * This function:
  * 1. Subscribes to MQTT broker for alarm events: topic/+/alarm
- * 2. Parses sensor data: [humidity, light, temp, water, mode]
- * 3. Checks thresholds based on cultivation mode
+ * 2. Parses the event: a raise/clear transition from the controller's own
+ *    alarm engine, or legacy sensor data [humidity, light, temp, water, mode]
+ * 3. Legacy data only: checks thresholds based on cultivation mode
+ *    (transitions were already judged on the device)
  * 4. Queries Firestore for device owner
  * 5. Checks alarm state (deduplication)
  * 6. Sends FCM notification to user
  * 7. Updates alarm state in Firestore
+ *
+ * It also sends remote reprovision requests (requestReprovision) and clears
+ * the retained request once the device acks it on devices/+/provision/ack.
  * 
  * Deployment:
  *   firebase deploy --only functions:mqttAlarmMonitor
@@ -20,6 +25,8 @@
 const functions = require('firebase-functions');
 const admin = require('firebase-admin');
 const mqtt = require('mqtt');
+const crypto = require('crypto');
+const { parseAlarmTransition, issueFromTransition } = require('./alarm_transition');
 
 // Initialize Firebase Admin
 admin.initializeApp();
@@ -29,6 +36,7 @@ const MQTT_BROKER = 'mqtts://api.milloserver.uk:8883';
 const MQTT_USERNAME = 'zhangyifei';
 const MQTT_PASSWORD = '123456';
 const ALARM_TOPIC = 'topic/+/alarm';
+const REPROVISION_ACK_TOPIC = 'devices/+/provision/ack';
 
 // Threshold Configuration
 const THRESHOLDS = {
@@ -72,6 +80,11 @@ function initializeMqtt() {
         console.log(`📬 Subscribed to ${ALARM_TOPIC}`);
       }
     });
+    mqttClient.subscribe(REPROVISION_ACK_TOPIC, { qos: 1 }, (err) => {
+      if (err) {
+        console.error('❌ MQTT subscription error:', err);
+      }
+    });
   });
 
   mqttClient.on('error', (error) => {
@@ -81,6 +94,10 @@ function initializeMqtt() {
   mqttClient.on('message', async (topic, message) => {
     try {
       console.log(`📨 MQTT message received: ${topic} -> ${message.toString()}`);
+      if (topic.endsWith('/provision/ack')) {
+        handleReprovisionAck(topic, message.toString());
+        return;
+      }
       await handleAlarmMessage(topic, message.toString());
     } catch (error) {
       console.error('❌ Error handling MQTT message:', error);
@@ -180,6 +197,63 @@ function checkThresholds(data) {
   return issues;
 }
 
+/**
+ * Find the user whose devices array holds this MQTT id
+ * Structure: users/{userId}/devices (array) where each device has mqttId
+ */
+async function findDeviceOwner(deviceId) {
+  console.log('🔍 Searching for device in users collection...');
+  const usersSnapshot = await admin.firestore().collection('users').get();
+  for (const doc of usersSnapshot.docs) {
+    const userData = doc.data();
+    if (userData.devices && Array.isArray(userData.devices)) {
+      const device = userData.devices.find(d => d.mqttId === deviceId);
+      if (device) {
+        return { userDoc: doc, deviceData: device };
+      }
+    }
+  }
+  return null;
+}
+
+/**
+ * The device reports it is all clear: the next raise notifies again
+ */
+async function clearAlarmState(deviceId) {
+  const owner = await findDeviceOwner(deviceId);
+  if (!owner) {
+    console.error(`❌ Device ${deviceId} not found in any user's devices`);
+    return;
+  }
+  await admin.firestore().collection('users').doc(owner.userDoc.id).update({
+    [`alarmState.${deviceId}.alarmActive`]: false,
+    [`alarmState.${deviceId}.alarmAcknowledged`]: false,
+  });
+  console.log(`✅ Alarm state cleared for ${deviceId}`);
+}
+
+/**
+ * Reprovision ack from the device: {"nonce":"...","accepted":true|false}.
+ * The request was published retained so an offline device still gets it;
+ * clear it now so it is not delivered again on every reconnect.
+ */
+function handleReprovisionAck(topic, message) {
+  const topicParts = topic.split('/');
+  if (topicParts.length !== 4 || topicParts[0] !== 'devices') {
+    console.error('❌ Invalid topic format:', topic);
+    return;
+  }
+  const deviceId = topicParts[1];
+  let ack = {};
+  try {
+    ack = JSON.parse(message);
+  } catch (error) {
+    console.error('❌ Error parsing reprovision ack:', error);
+  }
+  console.log(`🔁 Reprovision ${ack.accepted ? 'accepted' : 'ignored'} by ${deviceId} (nonce ${ack.nonce})`);
+  mqttClient.publish(`devices/${deviceId}/provision/reset`, '', { qos: 1, retain: true });
+}
+
 /**
  * Handle incoming alarm MQTT message
  */
@@ -198,49 +272,47 @@ async function handleAlarmMessage(topic, message) {
   const deviceId = topicParts[1];
   console.log(`Device ID: ${deviceId}`);
   
-  // Parse sensor data
-  const sensorData = parseAlarmPayload(message);
-  if (!sensorData) {
-    console.error('❌ Failed to parse sensor data');
-    return;
-  }
-  
-  console.log('📊 Sensor Data:', sensorData);
-  
-  // Check which sensors exceeded thresholds
-  const issues = checkThresholds(sensorData);
-  if (issues.length === 0) {
-    console.log('✅ All sensors within safe range (false alarm?)');
-    return;
-  }
-  
-  console.log(`⚠️ ${issues.length} sensor(s) out of range:`, issues);
-  
-  // Query Firestore for device - devices are stored as subcollections under users
-  // Structure: users/{userId}/devices (array) where each device has mqttId
-  console.log('🔍 Searching for device in users collection...');
-  
-  const usersSnapshot = await admin.firestore().collection('users').get();
-  let userDoc = null;
-  let deviceData = null;
-  
-  // Find which user owns this device
-  for (const doc of usersSnapshot.docs) {
-    const userData = doc.data();
-    if (userData.devices && Array.isArray(userData.devices)) {
-      const device = userData.devices.find(d => d.mqttId === deviceId);
-      if (device) {
-        userDoc = doc;
-        deviceData = device;
-        break;
+  // Controllers with the on-device alarm engine send JSON transitions
+  let sensorData = null;
+  let issues;
+  const transition = message.trim().startsWith('{') ? parseAlarmTransition(message) : null;
+  if (transition) {
+    console.log('📊 Alarm transition:', transition);
+    if (transition.ev === 'clear') {
+      if (transition.active === 0) {
+        await clearAlarmState(deviceId);
+      } else {
+        console.log(`⏸️ ${transition.type} cleared, ${transition.active} alarm(s) still active`);
       }
+      return;
+    }
+    issues = [issueFromTransition(transition)];
+  } else {
+    // Parse sensor data
+    sensorData = parseAlarmPayload(message);
+    if (!sensorData) {
+      console.error('❌ Failed to parse sensor data');
+      return;
+    }
+
+    console.log('📊 Sensor Data:', sensorData);
+
+    // Check which sensors exceeded thresholds
+    issues = checkThresholds(sensorData);
+    if (issues.length === 0) {
+      console.log('✅ All sensors within safe range (false alarm?)');
+      return;
     }
   }
   
-  if (!userDoc || !deviceData) {
+  console.log(`⚠️ ${issues.length} sensor(s) out of range:`, issues);
+  
+  const owner = await findDeviceOwner(deviceId);
+  if (!owner) {
     console.error(`❌ Device ${deviceId} not found in any user's devices`);
     return;
   }
+  const { userDoc, deviceData } = owner;
   
   const userId = userDoc.id;
   const userData = userDoc.data();
@@ -308,7 +380,7 @@ async function handleAlarmMessage(topic, message) {
       alarmType: issues[0].sensor, // Primary issue
       value: String(issues[0].value),
       threshold: String(issues[0].threshold),
-      mode: sensorData.mode === 'p' ? 'pinning' : 'normal',
+      mode: sensorData && sensorData.mode === 'p' ? 'pinning' : 'normal',
       allIssues: JSON.stringify(issues),
     },
     android: {
@@ -372,6 +444,7 @@ exports.mqttAlarmMonitor = functions
  * HTTP endpoint to manually trigger alarm for testing
  * POST /testAlarm
  * Body: { deviceId: "94B97EC04AD4", payload: "[72.2,47.0,31.5,60.5,n]" }
+ *   or a transition: payload: "{\"ev\":\"raise\",\"type\":\"temp_high\",\"zone\":0,\"value\":31.5,\"limit\":30,\"active\":1}"
  */
 exports.testAlarm = functions.https.onRequest(async (req, res) => {
   if (req.method !== 'POST') {
@@ -395,6 +468,38 @@ exports.testAlarm = functions.https.onRequest(async (req, res) => {
   }
 });
 
+/**
+ * HTTP endpoint to put a device back into BLE provisioning
+ * POST /requestReprovision
+ * Body: { deviceId: "94B97EC04AD4" }
+ * Publishes {"confirm":"reprovision","nonce":<fresh>} retained on
+ * devices/{deviceId}/provision/reset; the device acts on each nonce once.
+ */
+exports.requestReprovision = functions.https.onRequest(async (req, res) => {
+  if (req.method !== 'POST') {
+    res.status(405).send('Method Not Allowed');
+    return;
+  }
+
+  const { deviceId } = req.body;
+  if (!deviceId || !/^[0-9A-Fa-f]{12}$/.test(deviceId)) {
+    res.status(400).send('Missing or invalid deviceId');
+    return;
+  }
+
+  const client = initializeMqtt();
+  const nonce = crypto.randomBytes(8).toString('hex');
+  const payload = JSON.stringify({ confirm: 'reprovision', nonce });
+  client.publish(`devices/${deviceId}/provision/reset`, payload, { qos: 1, retain: true }, (err) => {
+    if (err) {
+      console.error('Reprovision request error:', err);
+      res.status(500).send({ success: false, error: err.message });
+      return;
+    }
+    res.status(200).send({ success: true, nonce });
+  });
+});
+
 /**
  * Scheduled function to keep MQTT connection alive
  * Runs every 5 minutes to prevent cold starts
@@ -0,0 +1,70 @@
+/**
+ * Device alarm transitions -> notified issues. Run with `npm test`.
+ */
+
+const test = require('node:test');
+const assert = require('node:assert');
+const fs = require('fs');
+const path = require('path');
+const {
+  TRANSITION_SENSORS,
+  parseAlarmTransition,
+  issueFromTransition,
+} = require('../alarm_transition');
+
+// Sensor names the app matches an alarmType against (fcm_service.dart)
+const APP_SENSORS = ['temperature', 'humidity', 'water'];
+
+function raise(type, extra = {}) {
+  return parseAlarmTransition(JSON.stringify({ ev: 'raise', type, zone: 0, active: 1, ts: 0, ...extra }));
+}
+
+test('every firmware alarm type has a sensor name', () => {
+  const header = fs.readFileSync(path.join(__dirname, '../../esp32/alarm_engine.h'), 'utf8');
+  const names = header.match(/NAMES\[\] = \{([^}]*)\}/)[1].match(/"([a-z_]+)"/g).map((n) => n.slice(1, -1));
+  assert.ok(names.length > 0);
+  for (const name of names) {
+    assert.ok(TRANSITION_SENSORS[name], `no sensor for ${name}`);
+  }
+});
+
+test('threshold and water alarms map to the names the app shows', () => {
+  const cases = {
+    temp_high: 'temperature',
+    temp_low: 'temperature',
+    hum_high: 'humidity',
+    hum_low: 'humidity',
+    water_low: 'water',
+  };
+  for (const [type, sensor] of Object.entries(cases)) {
+    const issue = issueFromTransition(raise(type, { value: 30.5, limit: 28 }));
+    assert.strictEqual(issue.sensor, sensor, type);
+    assert.ok(APP_SENSORS.includes(issue.sensor), type);
+  }
+});
+
+test('issue carries value, limit, message and zone', () => {
+  const issue = issueFromTransition(raise('hum_low', { zone: 2, value: 77.4, limit: 80 }));
+  assert.deepStrictEqual(issue, {
+    sensor: 'humidity',
+    value: 77.4,
+    threshold: 80,
+    message: 'Humidity too low (77.4% < 80%) (zone 2)',
+  });
+  const failure = issueFromTransition(raise('sensor_failure'));
+  assert.strictEqual(failure.sensor, 'sensor');
+  assert.strictEqual(failure.value, null);
+  assert.strictEqual(failure.message, 'Climate sensor not responding');
+});
+
+test('unknown types and bad payloads', () => {
+  assert.strictEqual(issueFromTransition(raise('co2_high')).sensor, 'sensor');
+  const quiet = console.error;
+  console.error = () => {};
+  try {
+    assert.strictEqual(parseAlarmTransition('{"ev":"flip","type":"hum_low"}'), null);
+    assert.strictEqual(parseAlarmTransition('not json'), null);
+  } finally {
+    console.error = quiet;
+  }
+});
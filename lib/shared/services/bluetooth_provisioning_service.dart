@@ -9,6 +9,10 @@ class BluetoothProvisioningService extends ChangeNotifier {
   // BLE Service and Characteristic UUIDs (must match ESP32 code)
   static const String serviceUUID = "4fafc201-1fb5-459e-8fcc-c5c9c331914b";
   static const String wifiCharacteristicUUID = "beb5483e-36e1-4688-b7f5-ea07361b26a8";
+  static const String statusCharacteristicUUID = "beb5483f-36e1-4688-b7f5-ea07361b26a8";
+  
+  // Large enough for the whole credentials JSON in a single write
+  static const int preferredMtu = 517;
   
   // Connection state
   BluetoothDevice? _connectedDevice;
@@ -16,6 +20,11 @@ class BluetoothProvisioningService extends ChangeNotifier {
   bool _isConnected = false;
   String? _error;
   
+  // Provisioning progress notified by the ESP32
+  // (credentials_parsed, associating, ip_acquired, time_synced, mqtt_up, registered, failed)
+  String? _provisioningStatus;
+  StreamSubscription<List<int>>? _statusSubscription;
+  
   // Discovered devices
   final List<BluetoothDevice> _discoveredDevices = [];
   
@@ -25,6 +34,7 @@ class BluetoothProvisioningService extends ChangeNotifier {
   String? get error => _error;
   List<BluetoothDevice> get discoveredDevices => List.unmodifiable(_discoveredDevices);
   BluetoothDevice? get connectedDevice => _connectedDevice;
+  String? get provisioningStatus => _provisioningStatus;
   
   /// Initialize Bluetooth adapter
   Future<bool> initialize() async {
@@ -136,6 +146,16 @@ class BluetoothProvisioningService extends ChangeNotifier {
       _connectedDevice = device;
       _isConnected = true;
       
+      // Android defaults to a 23-byte MTU; iOS negotiates automatically
+      if (defaultTargetPlatform == TargetPlatform.android) {
+        try {
+          final mtu = await device.requestMtu(preferredMtu);
+          debugPrint('📏 BluetoothProvisioningService: MTU negotiated to $mtu');
+        } catch (e) {
+          debugPrint('⚠️ BluetoothProvisioningService: MTU request failed: $e');
+        }
+      }
+      
       debugPrint('✅ BluetoothProvisioningService: Connected to ${device.platformName}');
       notifyListeners();
       return true;
@@ -196,6 +216,14 @@ class BluetoothProvisioningService extends ChangeNotifier {
         return false;
       }
       
+      // Subscribe to progress notifications (older firmware has no status characteristic)
+      for (var characteristic in targetService.characteristics) {
+        if (characteristic.uuid.toString().toLowerCase() == statusCharacteristicUUID.toLowerCase()) {
+          await _listenToStatus(characteristic);
+          break;
+        }
+      }
+      
       // Prepare credentials as JSON
       final credentials = jsonEncode({
         'ssid': ssid,
@@ -219,8 +247,26 @@ class BluetoothProvisioningService extends ChangeNotifier {
     }
   }
   
+  Future<void> _listenToStatus(BluetoothCharacteristic characteristic) async {
+    await _statusSubscription?.cancel();
+    _provisioningStatus = null;
+    _statusSubscription = characteristic.onValueReceived.listen((value) {
+      try {
+        final data = jsonDecode(utf8.decode(value)) as Map<String, dynamic>;
+        _provisioningStatus = data['status'] as String?;
+        debugPrint('📶 BluetoothProvisioningService: Device status $data');
+        notifyListeners();
+      } catch (e) {
+        debugPrint('⚠️ BluetoothProvisioningService: Bad status notification: $e');
+      }
+    });
+    await characteristic.setNotifyValue(true);
+  }
+  
   /// Disconnect from current device
   Future<void> disconnect() async {
+    await _statusSubscription?.cancel();
+    _statusSubscription = null;
     if (_connectedDevice != null) {
       try {
         debugPrint('🔌 BluetoothProvisioningService: Disconnecting...');